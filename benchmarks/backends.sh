@@ -0,0 +1,24 @@
+#! /bin/sh
+# Runs each script in benchmarks/lox on both clox backends and prints the wall
+# time of each. Given a second build of clox with LOX_PROFILE_OPCODES (see
+# profile.sh) it also prints how many instructions each executed.
+# usage: benchmarks/backends.sh [build dir] [profile build dir]
+
+build=${1:-build}
+profile=$2
+
+for script in "$(dirname "$0")"/lox/*.lox; do
+  for backend in stack register; do
+    start=$(date +%s%N)
+    "$build/clox" --no-cache --backend $backend "$script" > /dev/null ||
+      exit 1
+    end=$(date +%s%N)
+    line="$(basename "$script" .lox) $backend $(((end - start) / 1000000)) ms"
+    if [ -n "$profile" ]; then
+      count=$("$profile/clox" --no-cache --backend $backend "$script" 2>&1 \
+        > /dev/null | sed -n 's/^== opcodes (\([0-9]*\) executed) ==$/\1/p')
+      line="$line $count instructions"
+    fi
+    echo "$line"
+  done
+done
@@ -0,0 +1,38 @@
+#! /bin/sh
+# Times bundle startup (scan, parse/compile and link) against thread count.
+# usage: benchmarks/bundle.sh [build dir] [file count] [functions per file]
+
+build=${1:-build}
+files=${2:-400}
+funs=${3:-30}
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+i=0
+while [ $i -lt $files ]; do
+  j=0
+  while [ $j -lt $funs ]; do
+    echo "fun f${i}_${j}(a, b) { var c = a * b; if (c > ${j}) return c - a; return \"${i}_${j}\"; }"
+    echo "class C${i}_${j} { init(x) { this.x = x; } get() { return this.x + ${j}; } }"
+    j=$((j + 1))
+  done > "$dir/f$i.lox"
+  echo "f$i.lox" >> "$dir/bundle.txt"
+  i=$((i + 1))
+done
+
+echo "$files files, $(cat "$dir"/*.lox | wc -c) bytes"
+
+threads=1
+max=${THREADS_MAX:-$(nproc 2>/dev/null || echo 8)}
+while :; do
+  for lox in clox jlox; do
+    start=$(date +%s%N)
+    "$build/$lox" --bundle --threads $threads "@$dir/bundle.txt" || exit 1
+    end=$(date +%s%N)
+    echo "$lox threads=$threads $(((end - start) / 1000000)) ms"
+  done
+  [ $threads -ge $max ] && break
+  threads=$((threads * 2))
+  [ $threads -gt $max ] && threads=$max
+done
@@ -0,0 +1,33 @@
+#! /bin/sh
+# Differential test of the clox JIT: runs each script on both backends with
+# the JIT off and with every function compiled on first use, and fails if the
+# output differs. The last line of output is taken to be a timing and is only
+# printed. Needs a build configured with -Dclox_jit=true.
+# usage: benchmarks/jit.sh [build dir] [script...]
+
+build=${1:-build}
+[ $# -gt 0 ] && shift
+[ $# -eq 0 ] && set -- "$(dirname "$0")"/lox/*.lox
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+status=0
+for script in "$@"; do
+  for backend in stack register; do
+    for threshold in 0 1; do
+      "$build/clox" --no-cache --backend $backend --jit-threshold $threshold \
+        "$script" > "$dir/$threshold" 2>&1
+    done
+    name="$(basename "$script" .lox) $backend"
+    if [ "$(sed '$d' "$dir/0")" = "$(sed '$d' "$dir/1")" ]; then
+      echo "$name: same, $(tail -n 1 "$dir/0")s interpreted," \
+        "$(tail -n 1 "$dir/1")s compiled"
+    else
+      echo "$name: DIFFERENT"
+      diff "$dir/0" "$dir/1" | head -n 10
+      status=1
+    fi
+  done
+done
+exit $status
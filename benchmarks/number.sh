@@ -0,0 +1,36 @@
+#! /bin/sh
+# Times number formatting (to_string in a loop) and number parsing (a script
+# made of numeric literals).
+# usage: benchmarks/number.sh [build dir] [count]
+
+build=${1:-build}
+count=${2:-1000000}
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+cat > "$dir/format.lox" << EOF
+var s;
+for (var i = 0; i < $count; i = i + 1) s = to_string(i * 0.37);
+EOF
+
+# clox allows 256 constants per function, so the literals are spread over
+# functions of 80 statements, nested 200 to an outer function.
+awk -v count=$count 'BEGIN {
+  for (i = 0; i < count; ++i) {
+    if (i % 16000 == 0) print "fun g" i "() {";
+    if (i % 80 == 0) print "fun f" i "() {";
+    print i "." (i % 97) " + 12345.678 - 0.0001;";
+    if (i % 80 == 79 || i == count - 1) print "}";
+    if (i % 16000 == 15999 || i == count - 1) print "}";
+  }
+}' > "$dir/parse.lox"
+
+for lox in clox jlox; do
+  for script in format parse; do
+    start=$(date +%s%N)
+    "$build/$lox" --no-cache "$dir/$script.lox" > /dev/null || exit 1
+    end=$(date +%s%N)
+    echo "$lox $script $count $(((end - start) / 1000000)) ms"
+  done
+done
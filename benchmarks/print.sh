@@ -0,0 +1,21 @@
+#! /bin/sh
+# Times a script that prints a long run of numbers, with the output thrown
+# away.
+# usage: benchmarks/print.sh [build dir] [count]
+
+build=${1:-build}
+count=${2:-10000000}
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+cat > "$dir/print.lox" << EOF
+for (var i = 0; i < $count; i = i + 1) print i * 0.5;
+EOF
+
+for lox in clox jlox; do
+  start=$(date +%s%N)
+  "$build/$lox" --no-cache "$dir/print.lox" > /dev/null || exit 1
+  end=$(date +%s%N)
+  echo "$lox $count prints $(((end - start) / 1000000)) ms"
+done
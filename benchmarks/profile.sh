@@ -0,0 +1,12 @@
+#! /bin/sh
+# Prints the opcode, pair and triple counts of each script in benchmarks/lox.
+# Needs a clox built with LOX_PROFILE_OPCODES, for example
+#   meson setup build-profile -Dcpp_args=-DLOX_PROFILE_OPCODES
+# usage: benchmarks/profile.sh [build dir]
+
+build=${1:-build-profile}
+
+for script in "$(dirname "$0")"/lox/*.lox; do
+  echo "### $(basename "$script")"
+  "$build/clox" --no-cache "$script" 2>&1 > /dev/null || exit 1
+done
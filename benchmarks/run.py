@@ -0,0 +1,186 @@
+#! /usr/bin/env python3
+# Runs every workload in benchmarks/lox, plus a generated parse-only script,
+# under jlox and clox, and reports each one's median wall time, peak RSS and
+# allocations as JSON. This is what `meson test --benchmark` runs.
+# usage: benchmarks/run.py [--jlox path] [--clox path] [--runs n]
+#                          [--output file] [--filter name]
+
+import argparse
+import json
+import os
+import pathlib
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+here = pathlib.Path(__file__).resolve().parent
+
+# the lines --alloc-stats prints, one per kind of object.
+made = re.compile(r"^(\w+): (\d+) made", re.MULTILINE)
+
+
+def write_parse(path, count):
+    # clox allows 256 constants per function, so the functions are nested 200
+    # to an outer function. none of them are called, so this only measures
+    # scanning, parsing, resolving and compiling.
+    with open(path, "w") as f:
+        for i in range(count):
+            if i % 200 == 0:
+                f.write(f"fun g{i}() {{\n")
+            f.write(
+                f"fun f{i}(a, b) {{\n"
+                f"  var s = \"f{i}\" + \"-\" + \"{i % 97}\";\n"
+                f"  for (var j = 0; j < a; j = j + 1) {{\n"
+                f"    if (j * {i % 13} > b or !(j == {i})) s = s + \"x\";\n"
+                f"    else b = b - {i}.5 / (a + 1);\n"
+                f"  }}\n"
+                f"  class C{i} {{ m(x) {{ return this.v + x * {i}; }} }}\n"
+                f"  return s;\n"
+                f"}}\n"
+            )
+            if i % 200 == 199 or i == count - 1:
+                f.write("}\n")
+
+
+def become_subreaper():
+    # a process's peak RSS starts at that of the process it was forked from,
+    # so anything run from here would be reported as being at least as big as
+    # python. instead the interpreters are started from a shell, which exits
+    # straight away and leaves them to be reaped (and measured) by us.
+    if not sys.platform.startswith("linux"):
+        return False
+    import ctypes
+
+    PR_SET_CHILD_SUBREAPER = 36
+    libc = ctypes.CDLL(None, use_errno=True)
+    return libc.prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0) == 0
+
+
+def measure(command, stderr, subreaper):
+    start = time.perf_counter()
+    if subreaper:
+        shell = subprocess.run(
+            ["/bin/sh", "-c", '"$@" > /dev/null & echo $!', "sh", *command],
+            stdout=subprocess.PIPE,
+            stderr=stderr,
+            check=True,
+        )
+        pid = int(shell.stdout)
+    else:
+        pid = subprocess.Popen(
+            command, stdout=subprocess.DEVNULL, stderr=stderr
+        ).pid
+    if hasattr(os, "wait4"):
+        _, status, usage = os.wait4(pid, 0)
+        elapsed = time.perf_counter() - start
+        # linux reports kilobytes, macOS bytes.
+        rss = usage.ru_maxrss
+        if sys.platform == "darwin":
+            rss //= 1024
+        # without a subreaper this is at least python's own.
+        if not subreaper and sys.platform.startswith("linux"):
+            rss = None
+    else:
+        _, status = os.waitpid(pid, 0)
+        elapsed = time.perf_counter() - start
+        rss = None
+    return os.waitstatus_to_exitcode(status), elapsed * 1000.0, rss
+
+
+def run(name, interpreter, path, script, runs, scratch, subreaper):
+    command = [path, "--no-cache", "--alloc-stats", script]
+    times = []
+    peak = None
+    allocations = None
+    for _ in range(runs):
+        with open(scratch, "w+") as stderr:
+            code, elapsed, rss = measure(command, stderr, subreaper)
+            stderr.seek(0)
+            report = stderr.read()
+        if code != 0:
+            sys.stderr.write(f"{interpreter} {name} failed ({code}):\n")
+            sys.stderr.write(report)
+            return None
+        times.append(elapsed)
+        if rss is not None:
+            peak = rss if peak is None else max(peak, rss)
+        # allocations don't vary between runs, so the last one's are kept.
+        allocations = sum(int(n) for _, n in made.findall(report))
+    return {
+        "benchmark": name,
+        "interpreter": interpreter,
+        "median_ms": round(statistics.median(times), 3),
+        "times_ms": [round(t, 3) for t in times],
+        "peak_rss_kib": peak,
+        "allocations": allocations,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Runs the Lox benchmarks under jlox and clox."
+    )
+    parser.add_argument("--jlox", help="the jlox to run, skipped if not given")
+    parser.add_argument("--clox", help="the clox to run, skipped if not given")
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--output", help="also write the JSON to this file")
+    parser.add_argument("--filter", help="only run benchmarks named this")
+    parser.add_argument(
+        "--parse-count",
+        type=int,
+        default=4000,
+        help="how many functions the parse benchmark declares",
+    )
+    args = parser.parse_args()
+
+    interpreters = [
+        (name, path)
+        for name, path in (("jlox", args.jlox), ("clox", args.clox))
+        if path
+    ]
+    if not interpreters:
+        parser.error("at least one of --jlox and --clox is needed")
+    if args.runs < 1:
+        parser.error("--runs must be at least 1")
+
+    subreaper = become_subreaper()
+    results = []
+    failed = False
+    with tempfile.TemporaryDirectory() as dir:
+        dir = pathlib.Path(dir)
+        parse = dir / "parse.lox"
+        write_parse(parse, args.parse_count)
+
+        scripts = sorted((here / "lox").glob("*.lox")) + [parse]
+        for script in scripts:
+            if args.filter and script.stem != args.filter:
+                continue
+            for interpreter, path in interpreters:
+                result = run(
+                    script.stem,
+                    interpreter,
+                    path,
+                    str(script),
+                    args.runs,
+                    dir / "stderr",
+                    subreaper,
+                )
+                if result is None:
+                    failed = True
+                else:
+                    results.append(result)
+
+    report = json.dumps({"runs": args.runs, "results": results}, indent=2)
+    print(report)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(report + "\n")
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
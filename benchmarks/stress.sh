@@ -0,0 +1,45 @@
+#! /bin/sh
+# Runs one small allocation heavy script many times on fresh VMs and reports
+# scripts per second against thread count.
+# usage: benchmarks/stress.sh [build dir] [run count]
+
+build=${1:-build}
+runs=${2:-2000}
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+cat > "$dir/stress.lox" << 'EOF'
+class Node {
+  init(value, next) {
+    this.value = value;
+    this.next = next;
+  }
+}
+
+fun fib(n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+var list = nil;
+for (var i = 0; i < 200; i = i + 1) list = Node(i, list);
+
+var sum = 0;
+for (var node = list; node != nil; node = node.next) sum = sum + node.value;
+
+print sum + fib(12);
+EOF
+
+threads=1
+max=${THREADS_MAX:-$(nproc 2>/dev/null || echo 8)}
+while :; do
+  for lox in clox jlox; do
+    printf '%s: ' $lox
+    "$build/$lox" --runs $runs --threads $threads "$dir/stress.lox" 2>&1 ||
+      exit 1
+  done
+  [ $threads -ge $max ] && break
+  threads=$((threads * 2))
+  [ $threads -gt $max ] && threads=$max
+done
@@ -0,0 +1,32 @@
+#! /bin/sh
+# Times a tail-recursive loop count calls deep, far deeper than either
+# interpreter could go if each call took a frame or a level of the native
+# stack. It's run again with the native stack limited to 1 MiB, which should
+# make no difference.
+# usage: benchmarks/tail.sh [build dir] [count]
+
+build=${1:-build}
+count=${2:-1000000}
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+cat > "$dir/tail.lox" << EOF
+fun loop(n, total) {
+  if (n == 0) return total;
+  return loop(n - 1, total + n);
+}
+
+print loop($count, 0);
+EOF
+
+for lox in clox jlox; do
+  for stack in "$(ulimit -s)" 1024; do
+    start=$(date +%s%N)
+    (ulimit -s "$stack" && "$build/$lox" --no-cache "$dir/tail.lox") \
+      > /dev/null || exit 1
+    end=$(date +%s%N)
+    echo "$lox $count tail calls, $stack KiB stack" \
+      "$(((end - start) / 1000000)) ms"
+  done
+done
@@ -0,0 +1,128 @@
+#include "bundle.hpp"
+#include "parallel.hpp"
+
+#include <lak/optional.hpp>
+#include <lak/string_literals.hpp>
+
+#include <cerrno>
+#include <fstream>
+
+struct bundle_unit
+{
+	lox::global_table globals;
+	lak::optional<lak::result<lox::function_ptr, lox::bundle_file_error>>
+	  script;
+};
+
+lak::result<lox::function_ptr, lox::bundle_file_error> compile_unit(
+  const std::filesystem::path &file,
+  lox::global_table &globals,
+  const lox::compile_options &options)
+{
+	std::ifstream strm(file, std::ios::binary);
+	if (!strm) return lak::err_t{lak::errno_error{errno}};
+	RES_TRY_ASSIGN(lox::function_ptr script =,
+	               lox::compile(strm, globals, options));
+	return lak::ok_t{lak::move(script)};
+}
+
+// rewrite the global operands of func (and every function nested in it) from
+// the indices of the file's own table to those of the linked table.
+void relink_globals(lox::function &func, lak::span<const uint16_t> remap)
+{
+	lox::chunk &chunk = func.chunk;
+
+	for (size_t offset = 0U; offset < chunk.code.size();
+	     offset        = chunk.next_instruction(offset))
+	{
+		switch (static_cast<lox::opcode>(chunk.code[offset]))
+		{
+			case lox::opcode::OP_GET_GLOBAL: [[fallthrough]];
+			case lox::opcode::OP_DEFINE_GLOBAL: [[fallthrough]];
+			case lox::opcode::OP_SET_GLOBAL:
+			{
+				const uint16_t index    = remap[chunk.read_u16(offset + 1U)];
+				chunk.code[offset + 1U] = static_cast<uint8_t>((index >> 8) & 0xFF);
+				chunk.code[offset + 2U] = static_cast<uint8_t>(index & 0xFF);
+			}
+			break;
+
+			default: break;
+		}
+	}
+
+	for (lox::value &constant : chunk.constants)
+	{
+		if_let_ok (lox::function_ptr & inner, constant.as_function())
+			relink_globals(*inner, remap);
+	}
+}
+
+lak::result<std::vector<std::filesystem::path>, lak::errno_error>
+lox::read_manifest(const std::filesystem::path &manifest)
+{
+	std::ifstream strm(manifest);
+	if (!strm) return lak::err_t{lak::errno_error{errno}};
+
+	const std::filesystem::path directory = manifest.parent_path();
+
+	std::vector<std::filesystem::path> result;
+	for (std::string line; std::getline(strm, line);)
+	{
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty() || line.front() == '#') continue;
+		result.push_back(directory / line);
+	}
+
+	return lak::move_ok(result);
+}
+
+lox::bundle_result<std::vector<lox::function_ptr>> lox::compile_bundle(
+  lak::span<const std::filesystem::path> files,
+  lox::global_table &globals,
+  size_t thread_count,
+  const lox::compile_options &options)
+{
+	std::vector<bundle_unit> units(files.size());
+
+	auto compile = [&](size_t i)
+	{
+		bundle_unit &unit = units[i];
+		unit.script       = compile_unit(files[i], unit.globals, options);
+	};
+	lox::parallel_for(files.size(), thread_count, compile);
+
+	for (size_t i = 0U; i < units.size(); ++i)
+	{
+		if_let_err (lox::bundle_file_error & err, *units[i].script)
+			return lak::err_t{lox::bundle_error{
+			  .file  = files[i],
+			  .error = lak::move(err),
+			}};
+	}
+
+	std::vector<lox::function_ptr> scripts;
+	scripts.reserve(units.size());
+	std::vector<uint16_t> remap;
+	for (size_t i = 0U; i < units.size(); ++i)
+	{
+		remap.clear();
+		for (const lak::u8string &name : units[i].globals.names)
+		{
+			if_let_ok (const uint16_t index, globals.find_or_emplace(name))
+				remap.push_back(index);
+			else
+				return lak::err_t{lox::bundle_error{
+				  .file  = files[i],
+				  .error = lox::compile_error::at(
+				    0U, u8"Too many global variables."_str),
+				}};
+		}
+
+		lox::function_ptr script = lak::move(*units[i].script).unwrap();
+		relink_globals(*script, remap);
+		scripts.push_back(lak::move(script));
+	}
+
+	return lak::move_ok(scripts);
+}
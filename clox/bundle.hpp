@@ -0,0 +1,51 @@
+#ifndef LOX_BUNDLE_HPP
+#define LOX_BUNDLE_HPP
+
+#include "compiler.hpp"
+#include "error.hpp"
+#include "global_table.hpp"
+#include "object.hpp"
+
+#include <lak/file.hpp>
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/string.hpp>
+
+#include <filesystem>
+#include <vector>
+
+namespace lox
+{
+	using bundle_file_error = lox::result_set<lak::errno_error,
+	                                          lox::scan_error,
+	                                          lox::parse_error,
+	                                          lox::compile_error>;
+
+	struct bundle_error
+	{
+		std::filesystem::path file;
+		lox::bundle_file_error error;
+	};
+
+	template<typename T = lak::monostate>
+	using bundle_result = lak::result<T, lox::bundle_error>;
+
+	// One file per line, relative to the directory the manifest is in. Blank
+	// lines and lines starting with # are skipped.
+	lak::result<std::vector<std::filesystem::path>, lak::errno_error>
+	read_manifest(const std::filesystem::path &manifest);
+
+	// Compiles each file against its own global table on a pool of
+	// thread_count threads (0 for one per hardware thread), then links the
+	// scripts in the order the files were given: names are added to globals
+	// file by file and every OP_*_GLOBAL operand is renumbered to match. The
+	// result is therefore the same however the threads were scheduled, and if
+	// several files fail the error is for the first of them.
+	lox::bundle_result<std::vector<lox::function_ptr>> compile_bundle(
+	  lak::span<const std::filesystem::path> files,
+	  lox::global_table &globals,
+	  size_t thread_count                 = 0U,
+	  const lox::compile_options &options = {});
+}
+
+#endif
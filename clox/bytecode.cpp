@@ -0,0 +1,312 @@
+#include "bytecode.hpp"
+
+#include <lak/string_literals.hpp>
+
+#include <cstring>
+
+enum struct constant_tag : uint8_t
+{
+	NIL,
+	BOOL,
+	NUMBER,
+	STRING,
+	FUNCTION,
+};
+
+/* --- writing --- */
+
+void write_u8(std::vector<byte_t> &out, uint8_t v)
+{
+	out.push_back(static_cast<byte_t>(v));
+}
+
+void write_u16(std::vector<byte_t> &out, uint16_t v)
+{
+	write_u8(out, static_cast<uint8_t>(v & 0xFF));
+	write_u8(out, static_cast<uint8_t>((v >> 8) & 0xFF));
+}
+
+void write_u32(std::vector<byte_t> &out, uint32_t v)
+{
+	write_u16(out, static_cast<uint16_t>(v & 0xFFFF));
+	write_u16(out, static_cast<uint16_t>((v >> 16) & 0xFFFF));
+}
+
+void write_u64(std::vector<byte_t> &out, uint64_t v)
+{
+	write_u32(out, static_cast<uint32_t>(v & 0xFFFF'FFFF));
+	write_u32(out, static_cast<uint32_t>((v >> 32) & 0xFFFF'FFFF));
+}
+
+lox::bytecode_result<> write_size(std::vector<byte_t> &out, size_t v)
+{
+	if (v > UINT32_MAX)
+		return lak::err_t{lox::bytecode_error{
+		  .offset  = out.size(),
+		  .message = u8"Size too large to serialise."_str,
+		}};
+	write_u32(out, static_cast<uint32_t>(v));
+	return lak::ok_t{};
+}
+
+lox::bytecode_result<> write_string(std::vector<byte_t> &out,
+                                    lak::u8string_view str)
+{
+	RES_TRY(write_size(out, str.size()));
+	for (const char8_t c : str) write_u8(out, static_cast<uint8_t>(c));
+	return lak::ok_t{};
+}
+
+lox::bytecode_result<> write_function(std::vector<byte_t> &out,
+                                      const lox::function &func)
+{
+	const lox::chunk &chunk = func.chunk;
+
+	RES_TRY(write_string(out, func.name));
+	RES_TRY(write_size(out, func.arity));
+	RES_TRY(write_size(out, func.upvalue_count));
+
+	RES_TRY(write_size(out, chunk.code_size()));
+	for (size_t i = 0U; i < chunk.code_size(); ++i)
+		write_u8(out, chunk.code_at(i));
+	for (size_t i = 0U; i < chunk.code_size(); ++i)
+		RES_TRY(write_size(out, chunk.line_at(i)));
+
+	RES_TRY(write_size(out, chunk.constants.size()));
+	for (const lox::value &constant : chunk.constants)
+	{
+		if (constant.is_nil())
+		{
+			write_u8(out, static_cast<uint8_t>(constant_tag::NIL));
+		}
+		else if_let_ok (const bool &b, constant.as_bool())
+		{
+			write_u8(out, static_cast<uint8_t>(constant_tag::BOOL));
+			write_u8(out, b ? 1U : 0U);
+		}
+		else if_let_ok (const double &d, constant.as_number())
+		{
+			uint64_t bits;
+			static_assert(sizeof(bits) == sizeof(d));
+			std::memcpy(&bits, &d, sizeof(bits));
+			write_u8(out, static_cast<uint8_t>(constant_tag::NUMBER));
+			write_u64(out, bits);
+		}
+		else if_let_ok (const lox::string_ptr &s, constant.as_string())
+		{
+			write_u8(out, static_cast<uint8_t>(constant_tag::STRING));
+			RES_TRY(write_string(out, s->value));
+		}
+		else if_let_ok (const lox::function_ptr &f, constant.as_function())
+		{
+			write_u8(out, static_cast<uint8_t>(constant_tag::FUNCTION));
+			RES_TRY(write_function(out, *f));
+		}
+		else
+		{
+			return lak::err_t{lox::bytecode_error{
+			  .offset  = out.size(),
+			  .message = u8"Constant cannot be serialised."_str,
+			}};
+		}
+	}
+
+	return lak::ok_t{};
+}
+
+/* --- reading --- */
+
+struct bytecode_reader
+{
+	lak::span<const byte_t> data;
+	size_t cursor = 0U;
+
+	lox::bytecode_error error(lak::u8string message) const
+	{
+		return lox::bytecode_error{
+		  .offset  = cursor,
+		  .message = lak::move(message),
+		};
+	}
+
+	lox::bytecode_result<lak::span<const byte_t>> read_bytes(size_t count)
+	{
+		if (count > data.size() - cursor)
+			return lak::err_t{error(u8"Unexpected end of file."_str)};
+		lak::span<const byte_t> result = data.subspan(cursor, count);
+		cursor += count;
+		return lak::ok_t{result};
+	}
+
+	lox::bytecode_result<uint8_t> read_u8()
+	{
+		RES_TRY_ASSIGN(lak::span<const byte_t> bytes =, read_bytes(1U));
+		return lak::ok_t{static_cast<uint8_t>(bytes[0])};
+	}
+
+	lox::bytecode_result<uint16_t> read_u16()
+	{
+		RES_TRY_ASSIGN(lak::span<const byte_t> bytes =, read_bytes(2U));
+		return lak::ok_t{static_cast<uint16_t>(uint16_t(bytes[0]) |
+		                                       (uint16_t(bytes[1]) << 8))};
+	}
+
+	lox::bytecode_result<uint32_t> read_u32()
+	{
+		RES_TRY_ASSIGN(const uint16_t lo =, read_u16());
+		RES_TRY_ASSIGN(const uint16_t hi =, read_u16());
+		return lak::ok_t{uint32_t(lo) | (uint32_t(hi) << 16)};
+	}
+
+	lox::bytecode_result<uint64_t> read_u64()
+	{
+		RES_TRY_ASSIGN(const uint32_t lo =, read_u32());
+		RES_TRY_ASSIGN(const uint32_t hi =, read_u32());
+		return lak::ok_t{uint64_t(lo) | (uint64_t(hi) << 32)};
+	}
+
+	lox::bytecode_result<lak::u8string_view> read_string()
+	{
+		RES_TRY_ASSIGN(const uint32_t size =, read_u32());
+		RES_TRY_ASSIGN(lak::span<const byte_t> bytes =, read_bytes(size));
+		return lak::ok_t{lak::u8string_view(
+		  reinterpret_cast<const char8_t *>(bytes.data()), bytes.size())};
+	}
+
+	lox::bytecode_result<lox::function_ptr> read_function()
+	{
+		RES_TRY_ASSIGN(lak::u8string_view name =, read_string());
+		lox::function_ptr func = lox::function::make(name);
+
+		RES_TRY_ASSIGN(func->arity =, read_u32());
+		RES_TRY_ASSIGN(func->upvalue_count =, read_u32());
+
+		// the code and line table are used in place
+		RES_TRY_ASSIGN(const uint32_t code_size =, read_u32());
+		RES_TRY_ASSIGN(func->chunk.mapped_code =, read_bytes(code_size));
+		RES_TRY_ASSIGN(func->chunk.mapped_lines =,
+		               read_bytes(size_t(code_size) * 4U));
+
+		RES_TRY_ASSIGN(const uint32_t constant_count =, read_u32());
+		func->chunk.constants.reserve(constant_count);
+		for (uint32_t i = 0U; i < constant_count; ++i)
+		{
+			RES_TRY_ASSIGN(const uint8_t tag =, read_u8());
+			switch (static_cast<constant_tag>(tag))
+			{
+				case constant_tag::NIL:
+					func->chunk.constants.push_back(lox::value{});
+					break;
+
+				case constant_tag::BOOL:
+				{
+					RES_TRY_ASSIGN(const uint8_t b =, read_u8());
+					func->chunk.constants.push_back(lox::value{b != 0U});
+				}
+				break;
+
+				case constant_tag::NUMBER:
+				{
+					RES_TRY_ASSIGN(const uint64_t bits =, read_u64());
+					double d;
+					std::memcpy(&d, &bits, sizeof(d));
+					func->chunk.constants.push_back(lox::value{d});
+				}
+				break;
+
+				case constant_tag::STRING:
+				{
+					RES_TRY_ASSIGN(lak::u8string_view str =, read_string());
+					func->chunk.constants.push_back(
+					  lox::value{lox::string::make(str)});
+				}
+				break;
+
+				case constant_tag::FUNCTION:
+				{
+					RES_TRY_ASSIGN(lox::function_ptr inner =, read_function());
+					func->chunk.constants.push_back(lox::value{lak::move(inner)});
+				}
+				break;
+
+				default:
+					return lak::err_t{error(u8"Invalid constant tag."_str)};
+			}
+		}
+
+		return lak::ok_t{lak::move(func)};
+	}
+};
+
+/* --- bytecode --- */
+
+static constexpr byte_t bytecode_magic[] = {'L', 'O', 'X', 'C'};
+
+lak::u8string lox::to_string(const lox::bytecode_error &err)
+{
+	return u8"[offset "_str +
+	       lak::as_u8string(std::to_string(err.offset)).to_string() +
+	       u8"] Error: "_str + err.message;
+}
+
+lox::bytecode_result<std::vector<byte_t>> lox::serialise(
+  const lox::function &script, const lox::global_table &globals)
+{
+	std::vector<byte_t> result;
+
+	for (const byte_t b : bytecode_magic) write_u8(result, b);
+	write_u16(result, lox::bytecode_version);
+	write_u16(result, static_cast<uint16_t>(lox::opcode_count));
+
+	RES_TRY(write_size(result, globals.names.size()));
+	for (const lak::u8string &name : globals.names)
+		RES_TRY(write_string(result, name));
+
+	RES_TRY(write_function(result, script));
+
+	return lak::move_ok(result);
+}
+
+lox::bytecode_result<lox::function_ptr> lox::deserialise(
+  lak::span<const byte_t> data, lox::global_table &globals)
+{
+	bytecode_reader reader{.data = data};
+
+	RES_TRY_ASSIGN(lak::span<const byte_t> magic =,
+	               reader.read_bytes(sizeof(bytecode_magic)));
+	if (std::memcmp(magic.data(), bytecode_magic, sizeof(bytecode_magic)) != 0)
+		return lak::err_t{reader.error(u8"Not a .loxc file."_str)};
+
+	RES_TRY_ASSIGN(const uint16_t version =, reader.read_u16());
+	if (version != lox::bytecode_version)
+		return lak::err_t{reader.error(u8"Unsupported bytecode version "_str +
+		                               lak::as_u8string(std::to_string(version))
+		                                 .to_string() +
+		                               u8"."_str)};
+
+	RES_TRY_ASSIGN(const uint16_t opcode_count =, reader.read_u16());
+	if (opcode_count != lox::opcode_count)
+		return lak::err_t{
+		  reader.error(u8"Bytecode was compiled for a different VM."_str)};
+
+	// the code refers to globals by index, so the loading VM must assign
+	// every name the same index as the compiling VM did
+	RES_TRY_ASSIGN(const uint32_t global_count =, reader.read_u32());
+	for (uint32_t i = 0U; i < global_count; ++i)
+	{
+		RES_TRY_ASSIGN(lak::u8string_view name =, reader.read_string());
+		if_let_ok (const uint16_t index, globals.find_or_emplace(name))
+		{
+			if (index == i) continue;
+		}
+		return lak::err_t{reader.error(u8"Global '"_str + name.to_string() +
+		                               u8"' does not match this VM."_str)};
+	}
+
+	RES_TRY_ASSIGN(lox::function_ptr script =, reader.read_function());
+
+	if (reader.cursor != data.size())
+		return lak::err_t{reader.error(u8"Trailing data after script."_str)};
+
+	return lak::ok_t{lak::move(script)};
+}
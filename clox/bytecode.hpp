@@ -0,0 +1,58 @@
+#ifndef LOX_BYTECODE_HPP
+#define LOX_BYTECODE_HPP
+
+#include "global_table.hpp"
+#include "object.hpp"
+
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+#include <lak/string.hpp>
+
+#include <vector>
+
+namespace lox
+{
+	// Bump whenever the layout below changes. Files are also rejected if they
+	// were written with a different number of opcodes.
+	//
+	// All integers are little endian.
+	//
+	// file:
+	//   "LOXC" u16:version u16:opcode_count
+	//   u32:global_count { u32:length u8[length]:name }
+	//   function
+	//
+	// function:
+	//   u32:length u8[length]:name u32:arity u32:upvalue_count
+	//   u32:code_size u8[code_size]:code u32[code_size]:lines
+	//   u32:constant_count constant[constant_count]
+	//
+	// constant:
+	//   u8:tag (nil | bool u8 | number f64 | string u32 u8[] | function)
+	inline constexpr uint16_t bytecode_version = 1U;
+
+	struct bytecode_error
+	{
+		size_t offset;
+		lak::u8string message;
+	};
+
+	lak::u8string to_string(const lox::bytecode_error &err);
+
+	template<typename T = lak::monostate>
+	using bytecode_result = lak::result<T, lox::bytecode_error>;
+
+	// Serialise script and every function reachable through its constants.
+	// The global names are included so that the OP_*_GLOBAL indices baked into
+	// the code can be checked against the loading VM.
+	lox::bytecode_result<std::vector<byte_t>> serialise(
+	  const lox::function &script, const lox::global_table &globals);
+
+	// The code and line tables of the returned functions point directly into
+	// data rather than being copied out, so data must outlive them.
+	lox::bytecode_result<lox::function_ptr> deserialise(
+	  lak::span<const byte_t> data, lox::global_table &globals);
+}
+
+#endif
@@ -1,8 +1,10 @@
 #include "chunk.hpp"
+#include "object.hpp"
 
 #include <lak/debug.hpp>
 #include <lak/string_literals.hpp>
 
+#include <bit>
 #include <iomanip>
 
 lak::u8string_view lox::to_string(lox::opcode op)
@@ -17,11 +19,134 @@ lak::u8string_view lox::to_string(lox::opcode op)
 	}
 }
 
+lox::opcode lox::generic_opcode(lox::opcode op)
+{
+	switch (op)
+	{
+#define LOX_QUICKENING_GENERIC(QUICK, GENERIC, ...)                           \
+	case lox::opcode::QUICK: return lox::opcode::GENERIC;
+		LOX_QUICKENING_FOREACH(LOX_QUICKENING_GENERIC)
+#undef LOX_QUICKENING_GENERIC
+		default: return op;
+	}
+}
+
+size_t lox::chunk::line_at(size_t offset) const
+{
+	if (mapped_lines.empty()) return lines[offset];
+
+	const uint8_t *line = mapped_lines.data() + (offset * 4U);
+	return size_t(line[0]) | (size_t(line[1]) << 8) | (size_t(line[2]) << 16) |
+	       (size_t(line[3]) << 24);
+}
+
+lak::optional<uint8_t> lox::chunk::number_constant(double d)
+{
+	for (size_t i = 0U; i < constants.size(); ++i)
+	{
+		if_let_ok (const double c, constants[i].as_number())
+			if (std::bit_cast<uint64_t>(c) == std::bit_cast<uint64_t>(d))
+				return static_cast<uint8_t>(i);
+	}
+	if (constants.size() > UINT8_MAX) return lak::nullopt;
+	return static_cast<uint8_t>(push_constant(lox::value{d}));
+}
+
+void lox::chunk::unmap_code()
+{
+	if (mapped_code.empty()) return;
+	code.assign(mapped_code.begin(), mapped_code.end());
+	mapped_code = {};
+}
+
+size_t lox::chunk::next_instruction(size_t offset) const
+{
+	ASSERT_LESS(offset, code_size());
+
+	switch (static_cast<lox::opcode>(code_at(offset)))
+	{
+		case lox::opcode::OP_CONSTANT: [[fallthrough]];
+		case lox::opcode::OP_GET_LOCAL: [[fallthrough]];
+		case lox::opcode::OP_SET_LOCAL: [[fallthrough]];
+		case lox::opcode::OP_GET_UPVALUE: [[fallthrough]];
+		case lox::opcode::OP_SET_UPVALUE: [[fallthrough]];
+		case lox::opcode::OP_GET_PROPERTY: [[fallthrough]];
+		case lox::opcode::OP_SET_PROPERTY: [[fallthrough]];
+		case lox::opcode::OP_GET_SUPER: [[fallthrough]];
+		case lox::opcode::OP_CALL: [[fallthrough]];
+		case lox::opcode::OP_TAIL_CALL: [[fallthrough]];
+		case lox::opcode::OP_CLASS: [[fallthrough]];
+		case lox::opcode::OP_METHOD: [[fallthrough]];
+		case lox::opcode::OP_ADD_CONSTANT: [[fallthrough]];
+		case lox::opcode::OP_SUBTRACT_CONSTANT: [[fallthrough]];
+		case lox::opcode::OP_LESS_CONSTANT: [[fallthrough]];
+		case lox::opcode::OP_ADD_CONSTANT_NUMBER: [[fallthrough]];
+		case lox::opcode::OP_ADD_CONSTANT_STRING: [[fallthrough]];
+		case lox::opcode::OP_SUBTRACT_CONSTANT_NUMBER: [[fallthrough]];
+		case lox::opcode::OP_LESS_CONSTANT_NUMBER: [[fallthrough]];
+		case lox::opcode::OP_SET_LOCAL_POP: return offset + 2U;
+
+		case lox::opcode::OP_GET_GLOBAL: [[fallthrough]];
+		case lox::opcode::OP_DEFINE_GLOBAL: [[fallthrough]];
+		case lox::opcode::OP_SET_GLOBAL: [[fallthrough]];
+		case lox::opcode::OP_JUMP: [[fallthrough]];
+		case lox::opcode::OP_JUMP_IF_FALSE: [[fallthrough]];
+		case lox::opcode::OP_LOOP: [[fallthrough]];
+		case lox::opcode::OP_INVOKE: [[fallthrough]];
+		case lox::opcode::OP_TAIL_INVOKE: [[fallthrough]];
+		case lox::opcode::OP_SUPER_INVOKE: [[fallthrough]];
+		case lox::opcode::OP_GET_LOCAL_PROPERTY: [[fallthrough]];
+		case lox::opcode::OP_JUMP_IF_FALSE_POP: [[fallthrough]];
+		case lox::opcode::OP_MOVE_RR: [[fallthrough]];
+		case lox::opcode::OP_MOVE_RK: return offset + 3U;
+
+#define LOX_REGISTER_PUSH_CASE(OP, ...)                                       \
+	case lox::opcode::OP_##OP##_RR: [[fallthrough]];                            \
+	case lox::opcode::OP_##OP##_RK: return offset + 3U;
+		LOX_REGISTER_ARITHMETIC_FOREACH(LOX_REGISTER_PUSH_CASE)
+		LOX_REGISTER_COMPARISON_FOREACH(LOX_REGISTER_PUSH_CASE)
+#undef LOX_REGISTER_PUSH_CASE
+
+#define LOX_REGISTER_STORE_CASE(OP, ...)                                      \
+	case lox::opcode::OP_##OP##_RRR: [[fallthrough]];                           \
+	case lox::opcode::OP_##OP##_RRK: return offset + 4U;
+		LOX_REGISTER_ARITHMETIC_FOREACH(LOX_REGISTER_STORE_CASE)
+#undef LOX_REGISTER_STORE_CASE
+
+		case lox::opcode::OP_CLOSURE:
+		{
+			// followed by an (is_local, index) pair for each upvalue
+			const lox::value &constant = constants[code_at(offset + 1U)];
+			return offset + 2U +
+			       (constant.as_function().unwrap()->upvalue_count * 2U);
+		}
+
+		default: return offset + 1U;
+	}
+}
+
+lak::optional<size_t> lox::chunk::jump_target(size_t offset) const
+{
+	ASSERT_LESS(offset, code_size());
+
+	switch (static_cast<lox::opcode>(code_at(offset)))
+	{
+		case lox::opcode::OP_JUMP: [[fallthrough]];
+		case lox::opcode::OP_JUMP_IF_FALSE: [[fallthrough]];
+		case lox::opcode::OP_JUMP_IF_FALSE_POP:
+			return offset + 3U + read_u16(offset + 1U);
+
+		case lox::opcode::OP_LOOP: return offset + 3U - read_u16(offset + 1U);
+
+		default: return lak::nullopt;
+	}
+}
+
 void lox::chunk::disassemble(lak::u8string_view name) const
 {
 	std::cout << "== " << name << " ==\n";
 
-	for (size_t offset = 0; offset < code.size();)
+	for (size_t offset = 0; offset < code_size();)
 	{
 		offset = disassemble_instruction(offset);
 	}
@@ -38,9 +163,10 @@ size_t constant_instruction(const lox::chunk &chunk,
 	std::cout << " ";
 
 	std::cout << std::setfill('0') << std::setw(4)
-	          << unsigned(chunk.code[offset + 1]) << " ";
+	          << unsigned(chunk.code_at(offset + 1)) << " ";
 
-	std::cout << "'" << lox::to_string(chunk.constants[chunk.code[offset + 1]])
+	std::cout << "'"
+	          << lox::to_string(chunk.constants[chunk.code_at(offset + 1)])
 	          << "'\n";
 
 	return offset + 2U;
@@ -55,19 +181,160 @@ size_t simple_instruction(lak::u8string_view name, size_t offset)
 	return offset + 1U;
 }
 
+size_t byte_instruction(const lox::chunk &chunk,
+                        lak::u8string_view name,
+                        size_t offset)
+{
+	using lak::operator<<;
+
+	std::cout << name;
+	for (size_t i = name.size(); i < 16; ++i) std::cout << " ";
+	std::cout << " ";
+
+	std::cout << std::setfill('0') << std::setw(4)
+	          << unsigned(chunk.code_at(offset + 1)) << "\n";
+
+	return offset + 2U;
+}
+
+size_t short_instruction(const lox::chunk &chunk,
+                         lak::u8string_view name,
+                         size_t offset)
+{
+	using lak::operator<<;
+
+	std::cout << name;
+	for (size_t i = name.size(); i < 16; ++i) std::cout << " ";
+	std::cout << " ";
+
+	std::cout << std::setfill('0') << std::setw(4)
+	          << unsigned(chunk.read_u16(offset + 1)) << "\n";
+
+	return offset + 3U;
+}
+
+size_t jump_instruction(const lox::chunk &chunk,
+                        lak::u8string_view name,
+                        int sign,
+                        size_t offset)
+{
+	using lak::operator<<;
+
+	const uint16_t jump = chunk.read_u16(offset + 1);
+
+	std::cout << name;
+	for (size_t i = name.size(); i < 16; ++i) std::cout << " ";
+	std::cout << " ";
+
+	std::cout << std::setfill('0') << std::setw(4) << offset << " -> "
+	          << std::setfill('0') << std::setw(4)
+	          << (offset + 3 + sign * static_cast<ptrdiff_t>(jump)) << "\n";
+
+	return offset + 3U;
+}
+
+size_t invoke_instruction(const lox::chunk &chunk,
+                          lak::u8string_view name,
+                          size_t offset)
+{
+	using lak::operator<<;
+
+	const uint8_t constant  = chunk.code_at(offset + 1);
+	const uint8_t arg_count = chunk.code_at(offset + 2);
+
+	std::cout << name;
+	for (size_t i = name.size(); i < 16; ++i) std::cout << " ";
+	std::cout << " ";
+
+	std::cout << "(" << unsigned(arg_count) << " args) " << std::setfill('0')
+	          << std::setw(4) << unsigned(constant) << " '"
+	          << lox::to_string(chunk.constants[constant]) << "'\n";
+
+	return offset + 3U;
+}
+
+size_t local_constant_instruction(const lox::chunk &chunk,
+                                  lak::u8string_view name,
+                                  size_t offset)
+{
+	using lak::operator<<;
+
+	const uint8_t slot     = chunk.code_at(offset + 1);
+	const uint8_t constant = chunk.code_at(offset + 2);
+
+	std::cout << name;
+	for (size_t i = name.size(); i < 16; ++i) std::cout << " ";
+	std::cout << " ";
+
+	std::cout << std::setfill('0') << std::setw(4) << unsigned(slot) << " "
+	          << std::setfill('0') << std::setw(4) << unsigned(constant) << " '"
+	          << lox::to_string(chunk.constants[constant]) << "'\n";
+
+	return offset + 3U;
+}
+
+// registers slot operands, followed by a constant operand if constant is set.
+size_t register_instruction(const lox::chunk &chunk,
+                            lak::u8string_view name,
+                            size_t registers,
+                            bool constant,
+                            size_t offset)
+{
+	using lak::operator<<;
+
+	std::cout << name;
+	for (size_t i = name.size(); i < 16; ++i) std::cout << " ";
+
+	size_t operand = offset + 1U;
+	for (; operand < offset + 1U + registers; ++operand)
+		std::cout << " R" << std::setfill('0') << std::setw(3)
+		          << unsigned(chunk.code_at(operand));
+
+	if (constant)
+	{
+		const uint8_t index = chunk.code_at(operand++);
+		std::cout << " K" << std::setfill('0') << std::setw(3) << unsigned(index)
+		          << " '" << lox::to_string(chunk.constants[index]) << "'";
+	}
+
+	std::cout << "\n";
+
+	return operand;
+}
+
+size_t closure_instruction(const lox::chunk &chunk, size_t offset)
+{
+	const size_t next =
+	  constant_instruction(chunk, u8"OP_CLOSURE"_view, offset);
+
+	const lox::value &constant = chunk.constants[chunk.code_at(offset + 1)];
+	const size_t upvalue_count =
+	  constant.as_function().unwrap()->upvalue_count;
+
+	for (size_t i = 0U; i < upvalue_count; ++i)
+	{
+		const size_t uv = next + (i * 2U);
+		std::cout << std::setfill('0') << std::setw(4) << uv
+		          << "    |                     "
+		          << (chunk.code_at(uv) ? "local " : "upvalue ")
+		          << unsigned(chunk.code_at(uv + 1U)) << "\n";
+	}
+
+	return next + (upvalue_count * 2U);
+}
+
 size_t lox::chunk::disassemble_instruction(size_t offset) const
 {
-	ASSERT_LESS(offset, code.size());
-	ASSERT_LESS(offset, lines.size());
+	ASSERT_LESS(offset, code_size());
 
 	std::cout << std::setfill('0') << std::setw(4) << offset << " ";
 
-	if (offset > 0 && lines[offset] == lines[offset - 1U])
+	if (offset > 0 && line_at(offset) == line_at(offset - 1U))
 		std::cout << "   | ";
 	else
-		std::cout << std::setfill('0') << std::setw(4) << lines[offset] << " ";
+		std::cout << std::setfill('0') << std::setw(4) << line_at(offset) << " ";
 
-	const uint8_t instruction = code[offset];
+	const uint8_t instruction = code_at(offset);
 
 	switch (static_cast<lox::opcode>(instruction))
 	{
@@ -83,6 +350,39 @@ size_t lox::chunk::disassemble_instruction(size_t offset) const
 		case lox::opcode::OP_FALSE:
 			return simple_instruction(u8"OP_FALSE"_view, offset);
 
+		case lox::opcode::OP_POP:
+			return simple_instruction(u8"OP_POP"_view, offset);
+
+		case lox::opcode::OP_GET_LOCAL:
+			return byte_instruction(*this, u8"OP_GET_LOCAL"_view, offset);
+
+		case lox::opcode::OP_SET_LOCAL:
+			return byte_instruction(*this, u8"OP_SET_LOCAL"_view, offset);
+
+		case lox::opcode::OP_GET_GLOBAL:
+			return short_instruction(*this, u8"OP_GET_GLOBAL"_view, offset);
+
+		case lox::opcode::OP_DEFINE_GLOBAL:
+			return short_instruction(*this, u8"OP_DEFINE_GLOBAL"_view, offset);
+
+		case lox::opcode::OP_SET_GLOBAL:
+			return short_instruction(*this, u8"OP_SET_GLOBAL"_view, offset);
+
+		case lox::opcode::OP_GET_UPVALUE:
+			return byte_instruction(*this, u8"OP_GET_UPVALUE"_view, offset);
+
+		case lox::opcode::OP_SET_UPVALUE:
+			return byte_instruction(*this, u8"OP_SET_UPVALUE"_view, offset);
+
+		case lox::opcode::OP_GET_PROPERTY:
+			return constant_instruction(*this, u8"OP_GET_PROPERTY"_view, offset);
+
+		case lox::opcode::OP_SET_PROPERTY:
+			return constant_instruction(*this, u8"OP_SET_PROPERTY"_view, offset);
+
+		case lox::opcode::OP_GET_SUPER:
+			return constant_instruction(*this, u8"OP_GET_SUPER"_view, offset);
+
 		case lox::opcode::OP_EQUAL:
 			return simple_instruction(u8"OP_EQUAL"_view, offset);
 
@@ -110,9 +410,146 @@ size_t lox::chunk::disassemble_instruction(size_t offset) const
 		case lox::opcode::OP_NEGATE:
 			return simple_instruction(u8"OP_NEGATE"_view, offset);
 
+		case lox::opcode::OP_PRINT:
+			return simple_instruction(u8"OP_PRINT"_view, offset);
+
+		case lox::opcode::OP_JUMP:
+			return jump_instruction(*this, u8"OP_JUMP"_view, 1, offset);
+
+		case lox::opcode::OP_JUMP_IF_FALSE:
+			return jump_instruction(*this, u8"OP_JUMP_IF_FALSE"_view, 1, offset);
+
+		case lox::opcode::OP_LOOP:
+			return jump_instruction(*this, u8"OP_LOOP"_view, -1, offset);
+
+		case lox::opcode::OP_CALL:
+			return byte_instruction(*this, u8"OP_CALL"_view, offset);
+
+		case lox::opcode::OP_TAIL_CALL:
+			return byte_instruction(*this, u8"OP_TAIL_CALL"_view, offset);
+
+		case lox::opcode::OP_INVOKE:
+			return invoke_instruction(*this, u8"OP_INVOKE"_view, offset);
+
+		case lox::opcode::OP_TAIL_INVOKE:
+			return invoke_instruction(*this, u8"OP_TAIL_INVOKE"_view, offset);
+
+		case lox::opcode::OP_SUPER_INVOKE:
+			return invoke_instruction(*this, u8"OP_SUPER_INVOKE"_view, offset);
+
+		case lox::opcode::OP_CLOSURE: return closure_instruction(*this, offset);
+
+		case lox::opcode::OP_CLOSE_UPVALUE:
+			return simple_instruction(u8"OP_CLOSE_UPVALUE"_view, offset);
+
 		case lox::opcode::OP_RETURN:
 			return simple_instruction(u8"OP_RETURN"_view, offset);
 
+		case lox::opcode::OP_CLASS:
+			return constant_instruction(*this, u8"OP_CLASS"_view, offset);
+
+		case lox::opcode::OP_INHERIT:
+			return simple_instruction(u8"OP_INHERIT"_view, offset);
+
+		case lox::opcode::OP_METHOD:
+			return constant_instruction(*this, u8"OP_METHOD"_view, offset);
+
+		case lox::opcode::OP_ADD_CONSTANT:
+			return constant_instruction(*this, u8"OP_ADD_CONSTANT"_view, offset);
+
+		case lox::opcode::OP_SUBTRACT_CONSTANT:
+			return constant_instruction(
+			  *this, u8"OP_SUBTRACT_CONSTANT"_view, offset);
+
+		case lox::opcode::OP_LESS_CONSTANT:
+			return constant_instruction(*this, u8"OP_LESS_CONSTANT"_view, offset);
+
+		case lox::opcode::OP_NOT_EQUAL:
+			return simple_instruction(u8"OP_NOT_EQUAL"_view, offset);
+
+		case lox::opcode::OP_NOT_LESS:
+			return simple_instruction(u8"OP_NOT_LESS"_view, offset);
+
+		case lox::opcode::OP_NOT_GREATER:
+			return simple_instruction(u8"OP_NOT_GREATER"_view, offset);
+
+		case lox::opcode::OP_GET_LOCAL_PROPERTY:
+			return local_constant_instruction(
+			  *this, u8"OP_GET_LOCAL_PROPERTY"_view, offset);
+
+		case lox::opcode::OP_SET_LOCAL_POP:
+			return byte_instruction(*this, u8"OP_SET_LOCAL_POP"_view, offset);
+
+		case lox::opcode::OP_JUMP_IF_FALSE_POP:
+			return jump_instruction(
+			  *this, u8"OP_JUMP_IF_FALSE_POP"_view, 1, offset);
+
+#define LOX_REGISTER_PUSH_DISASSEMBLE(OP, ...)                                \
+	case lox::opcode::OP_##OP##_RR:                                             \
+		return register_instruction(                                              \
+		  *this, u8"OP_" #OP "_RR"_view, 2U, false, offset);                      \
+	case lox::opcode::OP_##OP##_RK:                                             \
+		return register_instruction(                                              \
+		  *this, u8"OP_" #OP "_RK"_view, 1U, true, offset);
+		LOX_REGISTER_ARITHMETIC_FOREACH(LOX_REGISTER_PUSH_DISASSEMBLE)
+		LOX_REGISTER_COMPARISON_FOREACH(LOX_REGISTER_PUSH_DISASSEMBLE)
+#undef LOX_REGISTER_PUSH_DISASSEMBLE
+
+#define LOX_REGISTER_STORE_DISASSEMBLE(OP, ...)                               \
+	case lox::opcode::OP_##OP##_RRR:                                            \
+		return register_instruction(                                              \
+		  *this, u8"OP_" #OP "_RRR"_view, 3U, false, offset);                     \
+	case lox::opcode::OP_##OP##_RRK:                                            \
+		return register_instruction(                                              \
+		  *this, u8"OP_" #OP "_RRK"_view, 2U, true, offset);
+		LOX_REGISTER_ARITHMETIC_FOREACH(LOX_REGISTER_STORE_DISASSEMBLE)
+#undef LOX_REGISTER_STORE_DISASSEMBLE
+
+		case lox::opcode::OP_MOVE_RR:
+			return register_instruction(
+			  *this, u8"OP_MOVE_RR"_view, 2U, false, offset);
+
+		case lox::opcode::OP_MOVE_RK:
+			return register_instruction(
+			  *this, u8"OP_MOVE_RK"_view, 1U, true, offset);
+
+		case lox::opcode::OP_ADD_NUMBER:
+			return simple_instruction(u8"OP_ADD_NUMBER"_view, offset);
+
+		case lox::opcode::OP_ADD_STRING:
+			return simple_instruction(u8"OP_ADD_STRING"_view, offset);
+
+		case lox::opcode::OP_SUBTRACT_NUMBER:
+			return simple_instruction(u8"OP_SUBTRACT_NUMBER"_view, offset);
+
+		case lox::opcode::OP_MULTIPLY_NUMBER:
+			return simple_instruction(u8"OP_MULTIPLY_NUMBER"_view, offset);
+
+		case lox::opcode::OP_DIVIDE_NUMBER:
+			return simple_instruction(u8"OP_DIVIDE_NUMBER"_view, offset);
+
+		case lox::opcode::OP_LESS_NUMBER:
+			return simple_instruction(u8"OP_LESS_NUMBER"_view, offset);
+
+		case lox::opcode::OP_GREATER_NUMBER:
+			return simple_instruction(u8"OP_GREATER_NUMBER"_view, offset);
+
+		case lox::opcode::OP_ADD_CONSTANT_NUMBER:
+			return constant_instruction(
+			  *this, u8"OP_ADD_CONSTANT_NUMBER"_view, offset);
+
+		case lox::opcode::OP_ADD_CONSTANT_STRING:
+			return constant_instruction(
+			  *this, u8"OP_ADD_CONSTANT_STRING"_view, offset);
+
+		case lox::opcode::OP_SUBTRACT_CONSTANT_NUMBER:
+			return constant_instruction(
+			  *this, u8"OP_SUBTRACT_CONSTANT_NUMBER"_view, offset);
+
+		case lox::opcode::OP_LESS_CONSTANT_NUMBER:
+			return constant_instruction(
+			  *this, u8"OP_LESS_CONSTANT_NUMBER"_view, offset);
+
 		default:
 			std::cout << "Unknown opcode " << unsigned(instruction) << "\n";
 			return offset + 1U;
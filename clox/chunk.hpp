@@ -3,6 +3,8 @@
 
 #include "value.hpp"
 
+#include <lak/optional.hpp>
+#include <lak/span.hpp>
 #include <lak/stdint.hpp>
 #include <lak/string_literals.hpp>
 #include <lak/string_view.hpp>
@@ -16,6 +18,17 @@ namespace lox
 	EXPAND(MACRO(OP_NIL, __VA_ARGS__))                                          \
 	EXPAND(MACRO(OP_TRUE, __VA_ARGS__))                                         \
 	EXPAND(MACRO(OP_FALSE, __VA_ARGS__))                                        \
+	EXPAND(MACRO(OP_POP, __VA_ARGS__))                                          \
+	EXPAND(MACRO(OP_GET_LOCAL, __VA_ARGS__))                                    \
+	EXPAND(MACRO(OP_SET_LOCAL, __VA_ARGS__))                                    \
+	EXPAND(MACRO(OP_GET_GLOBAL, __VA_ARGS__))                                   \
+	EXPAND(MACRO(OP_DEFINE_GLOBAL, __VA_ARGS__))                                \
+	EXPAND(MACRO(OP_SET_GLOBAL, __VA_ARGS__))                                   \
+	EXPAND(MACRO(OP_GET_UPVALUE, __VA_ARGS__))                                  \
+	EXPAND(MACRO(OP_SET_UPVALUE, __VA_ARGS__))                                  \
+	EXPAND(MACRO(OP_GET_PROPERTY, __VA_ARGS__))                                 \
+	EXPAND(MACRO(OP_SET_PROPERTY, __VA_ARGS__))                                 \
+	EXPAND(MACRO(OP_GET_SUPER, __VA_ARGS__))                                    \
 	EXPAND(MACRO(OP_EQUAL, __VA_ARGS__))                                        \
 	EXPAND(MACRO(OP_GREATER, __VA_ARGS__))                                      \
 	EXPAND(MACRO(OP_LESS, __VA_ARGS__))                                         \
@@ -25,7 +38,116 @@ namespace lox
 	EXPAND(MACRO(OP_DIVIDE, __VA_ARGS__))                                       \
 	EXPAND(MACRO(OP_NOT, __VA_ARGS__))                                          \
 	EXPAND(MACRO(OP_NEGATE, __VA_ARGS__))                                       \
-	EXPAND(MACRO(OP_RETURN, __VA_ARGS__))
+	EXPAND(MACRO(OP_PRINT, __VA_ARGS__))                                        \
+	EXPAND(MACRO(OP_JUMP, __VA_ARGS__))                                         \
+	EXPAND(MACRO(OP_JUMP_IF_FALSE, __VA_ARGS__))                                \
+	EXPAND(MACRO(OP_LOOP, __VA_ARGS__))                                         \
+	EXPAND(MACRO(OP_CALL, __VA_ARGS__))                                         \
+	EXPAND(MACRO(OP_INVOKE, __VA_ARGS__))                                       \
+	EXPAND(MACRO(OP_SUPER_INVOKE, __VA_ARGS__))                                 \
+	EXPAND(MACRO(OP_CLOSURE, __VA_ARGS__))                                      \
+	EXPAND(MACRO(OP_CLOSE_UPVALUE, __VA_ARGS__))                                \
+	EXPAND(MACRO(OP_RETURN, __VA_ARGS__))                                       \
+	EXPAND(MACRO(OP_CLASS, __VA_ARGS__))                                        \
+	EXPAND(MACRO(OP_INHERIT, __VA_ARGS__))                                      \
+	EXPAND(MACRO(OP_METHOD, __VA_ARGS__))                                       \
+	EXPAND(MACRO(OP_ADD_CONSTANT, __VA_ARGS__))                                 \
+	EXPAND(MACRO(OP_SUBTRACT_CONSTANT, __VA_ARGS__))                            \
+	EXPAND(MACRO(OP_LESS_CONSTANT, __VA_ARGS__))                                \
+	EXPAND(MACRO(OP_NOT_EQUAL, __VA_ARGS__))                                    \
+	EXPAND(MACRO(OP_NOT_LESS, __VA_ARGS__))                                     \
+	EXPAND(MACRO(OP_NOT_GREATER, __VA_ARGS__))                                  \
+	EXPAND(MACRO(OP_GET_LOCAL_PROPERTY, __VA_ARGS__))                           \
+	EXPAND(MACRO(OP_SET_LOCAL_POP, __VA_ARGS__))                                \
+	EXPAND(MACRO(OP_JUMP_IF_FALSE_POP, __VA_ARGS__))                            \
+	EXPAND(MACRO(OP_ADD_RR, __VA_ARGS__))                                       \
+	EXPAND(MACRO(OP_ADD_RK, __VA_ARGS__))                                       \
+	EXPAND(MACRO(OP_ADD_RRR, __VA_ARGS__))                                      \
+	EXPAND(MACRO(OP_ADD_RRK, __VA_ARGS__))                                      \
+	EXPAND(MACRO(OP_SUBTRACT_RR, __VA_ARGS__))                                  \
+	EXPAND(MACRO(OP_SUBTRACT_RK, __VA_ARGS__))                                  \
+	EXPAND(MACRO(OP_SUBTRACT_RRR, __VA_ARGS__))                                 \
+	EXPAND(MACRO(OP_SUBTRACT_RRK, __VA_ARGS__))                                 \
+	EXPAND(MACRO(OP_MULTIPLY_RR, __VA_ARGS__))                                  \
+	EXPAND(MACRO(OP_MULTIPLY_RK, __VA_ARGS__))                                  \
+	EXPAND(MACRO(OP_MULTIPLY_RRR, __VA_ARGS__))                                 \
+	EXPAND(MACRO(OP_MULTIPLY_RRK, __VA_ARGS__))                                 \
+	EXPAND(MACRO(OP_DIVIDE_RR, __VA_ARGS__))                                    \
+	EXPAND(MACRO(OP_DIVIDE_RK, __VA_ARGS__))                                    \
+	EXPAND(MACRO(OP_DIVIDE_RRR, __VA_ARGS__))                                   \
+	EXPAND(MACRO(OP_DIVIDE_RRK, __VA_ARGS__))                                   \
+	EXPAND(MACRO(OP_LESS_RR, __VA_ARGS__))                                      \
+	EXPAND(MACRO(OP_LESS_RK, __VA_ARGS__))                                      \
+	EXPAND(MACRO(OP_GREATER_RR, __VA_ARGS__))                                   \
+	EXPAND(MACRO(OP_GREATER_RK, __VA_ARGS__))                                   \
+	EXPAND(MACRO(OP_EQUAL_RR, __VA_ARGS__))                                     \
+	EXPAND(MACRO(OP_EQUAL_RK, __VA_ARGS__))                                     \
+	EXPAND(MACRO(OP_MOVE_RR, __VA_ARGS__))                                      \
+	EXPAND(MACRO(OP_MOVE_RK, __VA_ARGS__))                                      \
+	EXPAND(MACRO(OP_ADD_NUMBER, __VA_ARGS__))                                   \
+	EXPAND(MACRO(OP_ADD_STRING, __VA_ARGS__))                                   \
+	EXPAND(MACRO(OP_SUBTRACT_NUMBER, __VA_ARGS__))                              \
+	EXPAND(MACRO(OP_MULTIPLY_NUMBER, __VA_ARGS__))                              \
+	EXPAND(MACRO(OP_DIVIDE_NUMBER, __VA_ARGS__))                                \
+	EXPAND(MACRO(OP_LESS_NUMBER, __VA_ARGS__))                                  \
+	EXPAND(MACRO(OP_GREATER_NUMBER, __VA_ARGS__))                               \
+	EXPAND(MACRO(OP_ADD_CONSTANT_NUMBER, __VA_ARGS__))                          \
+	EXPAND(MACRO(OP_ADD_CONSTANT_STRING, __VA_ARGS__))                          \
+	EXPAND(MACRO(OP_SUBTRACT_CONSTANT_NUMBER, __VA_ARGS__))                     \
+	EXPAND(MACRO(OP_LESS_CONSTANT_NUMBER, __VA_ARGS__))                         \
+	EXPAND(MACRO(OP_TAIL_CALL, __VA_ARGS__))                                    \
+	EXPAND(MACRO(OP_TAIL_INVOKE, __VA_ARGS__))
+
+// Superinstructions, (FUSED, FIRST, SECOND): FUSED replaces FIRST followed by
+// SECOND wherever nothing jumps in between them, and takes FIRST's operands
+// followed by SECOND's. The pairs were picked from LOX_PROFILE_OPCODES runs
+// of benchmarks/lox, see benchmarks/superinstructions.txt.
+#define LOX_SUPERINSTRUCTION_FOREACH(MACRO, ...)                              \
+	EXPAND(MACRO(OP_ADD_CONSTANT, OP_CONSTANT, OP_ADD, __VA_ARGS__))            \
+	EXPAND(MACRO(OP_SUBTRACT_CONSTANT, OP_CONSTANT, OP_SUBTRACT, __VA_ARGS__))  \
+	EXPAND(MACRO(OP_LESS_CONSTANT, OP_CONSTANT, OP_LESS, __VA_ARGS__))          \
+	EXPAND(MACRO(OP_NOT_EQUAL, OP_EQUAL, OP_NOT, __VA_ARGS__))                  \
+	EXPAND(MACRO(OP_NOT_LESS, OP_LESS, OP_NOT, __VA_ARGS__))                    \
+	EXPAND(MACRO(OP_NOT_GREATER, OP_GREATER, OP_NOT, __VA_ARGS__))              \
+	EXPAND(MACRO(                                                               \
+	  OP_GET_LOCAL_PROPERTY, OP_GET_LOCAL, OP_GET_PROPERTY, __VA_ARGS__))       \
+	EXPAND(MACRO(OP_SET_LOCAL_POP, OP_SET_LOCAL, OP_POP, __VA_ARGS__))          \
+	EXPAND(MACRO(OP_JUMP_IF_FALSE_POP, OP_JUMP_IF_FALSE, OP_POP, __VA_ARGS__))
+
+// Three-address forms of the binary operators, emitted by the register
+// backend. R operands are frame slots and K operands constants, with the
+// destination first: OP_ADD_RK a k pushes slots[a] + constants[k] and
+// OP_ADD_RRK d a k stores it to slots[d] instead. Comparisons only have the
+// pushing forms, since their result is nearly always a jump condition.
+// OP_MOVE_RR d a and OP_MOVE_RK d k are plain assignments.
+#define LOX_REGISTER_ARITHMETIC_FOREACH(MACRO, ...)                           \
+	EXPAND(MACRO(ADD, __VA_ARGS__))                                             \
+	EXPAND(MACRO(SUBTRACT, __VA_ARGS__))                                        \
+	EXPAND(MACRO(MULTIPLY, __VA_ARGS__))                                        \
+	EXPAND(MACRO(DIVIDE, __VA_ARGS__))
+
+#define LOX_REGISTER_COMPARISON_FOREACH(MACRO, ...)                           \
+	EXPAND(MACRO(LESS, __VA_ARGS__))                                            \
+	EXPAND(MACRO(GREATER, __VA_ARGS__))                                         \
+	EXPAND(MACRO(EQUAL, __VA_ARGS__))
+
+// Type-specialised forms of the generic instructions, (QUICK, GENERIC). The
+// compiler only emits GENERIC, the VM rewrites it to QUICK in place once it
+// has seen operands of QUICK's type and back again the first time QUICK sees
+// operands it doesn't handle. QUICK takes the same operands as GENERIC.
+#define LOX_QUICKENING_FOREACH(MACRO, ...)                                    \
+	EXPAND(MACRO(OP_ADD_NUMBER, OP_ADD, __VA_ARGS__))                           \
+	EXPAND(MACRO(OP_ADD_STRING, OP_ADD, __VA_ARGS__))                           \
+	EXPAND(MACRO(OP_SUBTRACT_NUMBER, OP_SUBTRACT, __VA_ARGS__))                 \
+	EXPAND(MACRO(OP_MULTIPLY_NUMBER, OP_MULTIPLY, __VA_ARGS__))                 \
+	EXPAND(MACRO(OP_DIVIDE_NUMBER, OP_DIVIDE, __VA_ARGS__))                     \
+	EXPAND(MACRO(OP_LESS_NUMBER, OP_LESS, __VA_ARGS__))                         \
+	EXPAND(MACRO(OP_GREATER_NUMBER, OP_GREATER, __VA_ARGS__))                   \
+	EXPAND(MACRO(OP_ADD_CONSTANT_NUMBER, OP_ADD_CONSTANT, __VA_ARGS__))         \
+	EXPAND(MACRO(OP_ADD_CONSTANT_STRING, OP_ADD_CONSTANT, __VA_ARGS__))         \
+	EXPAND(MACRO(                                                               \
+	  OP_SUBTRACT_CONSTANT_NUMBER, OP_SUBTRACT_CONSTANT, __VA_ARGS__))          \
+	EXPAND(MACRO(OP_LESS_CONSTANT_NUMBER, OP_LESS_CONSTANT, __VA_ARGS__))
 
 	enum struct opcode : uint8_t
 	{
@@ -34,14 +156,51 @@ namespace lox
 #undef LOX_OPCODE_ENUM
 	};
 
+#define LOX_OPCODE_COUNT(OP, ...) +1
+	inline constexpr size_t opcode_count =
+	  0 LOX_OPCODE_FOREACH(LOX_OPCODE_COUNT);
+#undef LOX_OPCODE_COUNT
+
 	lak::u8string_view to_string(lox::opcode op);
 
+	// the instruction op is a quickened form of, or op if it isn't one.
+	lox::opcode generic_opcode(lox::opcode op);
+
 	struct chunk
 	{
 		std::vector<uint8_t> code;
 		std::vector<size_t> lines;
 		lox::value_array constants;
 
+		// set when the chunk was loaded from a .loxc file, the bytecode is then
+		// executed directly out of the mapped file and code/lines are empty.
+		// the mapping may be shared, so it's copied into code by unmap_code
+		// before anything is rewritten.
+		lak::span<const uint8_t> mapped_code;
+		// little endian uint32_t line for each byte of the mapped code, these
+		// stay mapped after unmap_code.
+		lak::span<const uint8_t> mapped_lines;
+
+		inline const uint8_t *code_begin() const
+		{
+			return mapped_code.empty() ? code.data() : mapped_code.data();
+		}
+
+		inline size_t code_size() const
+		{
+			return mapped_code.empty() ? code.size() : mapped_code.size();
+		}
+
+		inline uint8_t code_at(size_t offset) const
+		{
+			return code_begin()[offset];
+		}
+
+		size_t line_at(size_t offset) const;
+
+		// copies mapped_code into code so that it can be modified in place.
+		void unmap_code();
+
 		inline void push_code(uint8_t c, size_t line)
 		{
 			code.push_back(c);
@@ -53,12 +212,34 @@ namespace lox
 			push_code(static_cast<uint8_t>(inst), line);
 		}
 
+		inline void push_u16(uint16_t c, size_t line)
+		{
+			push_code(static_cast<uint8_t>((c >> 8) & 0xFF), line);
+			push_code(static_cast<uint8_t>(c & 0xFF), line);
+		}
+
+		inline uint16_t read_u16(size_t offset) const
+		{
+			return static_cast<uint16_t>((code_at(offset) << 8) |
+			                             code_at(offset + 1));
+		}
+
 		inline size_t push_constant(const lox::value &val)
 		{
 			constants.push_back(val);
 			return constants.size() - 1U;
 		}
 
+		// the index of a number constant with exactly the bits of d, added if
+		// there isn't one yet and there's room for it.
+		lak::optional<uint8_t> number_constant(double d);
+
+		// the offset of the instruction following the one at offset.
+		size_t next_instruction(size_t offset) const;
+
+		// where the instruction at offset jumps to, if it is a jump or loop.
+		lak::optional<size_t> jump_target(size_t offset) const;
+
 		void disassemble(lak::u8string_view name) const;
 
 		size_t disassemble_instruction(size_t offset) const;
@@ -1,9 +1,20 @@
 #ifndef LOX_COMMON_HPP
 #define LOX_COMMON_HPP
 
-#define LOX_DEBUG_PRINT_CODE
-#define LOX_DEBUG_TRACE_EXECUTION
+// #define LOX_DEBUG_PRINT_CODE
+// #define LOX_DEBUG_TRACE_EXECUTION
+// #define LOX_PROFILE_OPCODES
 
-#define LOX_STACK_MAX 256
+#define LOX_LOCALS_MAX 256
+
+#define LOX_UPVALUES_MAX 256
+
+#define LOX_FRAMES_MAX 64
+
+#define LOX_STACK_MAX (LOX_FRAMES_MAX * LOX_LOCALS_MAX)
+
+// calls and loop iterations before a function is compiled to native code,
+// when built with the clox_jit option.
+#define LOX_JIT_THRESHOLD 1000
 
 #endif
@@ -0,0 +1,105 @@
+#include "compile_cache.hpp"
+
+#include "bytecode.hpp"
+#include "chunk.hpp"
+
+#include <lak/file.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+lox::compile_cache lox::compile_cache::make_default()
+{
+	if (const char *dir = std::getenv("LOX_CACHE_DIR"); dir && *dir)
+		return lox::compile_cache{.directory = dir};
+
+	std::error_code ec;
+	std::filesystem::path temp = std::filesystem::temp_directory_path(ec);
+	// an empty directory just means every lookup misses
+	if (ec) return lox::compile_cache{};
+	return lox::compile_cache{.directory = temp / "lox-cache"};
+}
+
+uint64_t lox::compile_cache::key(std::istream &source,
+                                 const lox::compile_options &options)
+{
+	// 64 bit FNV-1a, seeded with the format so that entries written by a
+	// different compiler are never picked up.
+	uint64_t hash = 0xCBF2'9CE4'8422'2325U;
+	auto mix      = [&](uint8_t b)
+	{
+		hash ^= b;
+		hash *= 0x0000'0100'0000'01B3U;
+	};
+	mix(static_cast<uint8_t>(lox::bytecode_version & 0xFF));
+	mix(static_cast<uint8_t>(lox::bytecode_version >> 8));
+	mix(static_cast<uint8_t>(lox::opcode_count & 0xFF));
+	mix(static_cast<uint8_t>(lox::opcode_count >> 8));
+	mix(static_cast<uint8_t>(options.backend));
+	mix(options.opt_level);
+	for (size_t i = 0U; i < sizeof(options.ir_budget); ++i)
+		mix(static_cast<uint8_t>(options.ir_budget >> (i * 8U)));
+	char block[4096];
+	do
+	{
+		source.read(block, sizeof(block));
+		const size_t count = static_cast<size_t>(source.gcount());
+		for (size_t i = 0U; i < count; ++i) mix(static_cast<uint8_t>(block[i]));
+	} while (source);
+	return hash;
+}
+
+std::filesystem::path lox::compile_cache::entry_path(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(
+	  name, sizeof(name), "%016llx.loxc", static_cast<unsigned long long>(key));
+	return directory / name;
+}
+
+lak::result<lox::function_ptr> lox::compile_cache::load(
+  uint64_t key, lox::global_table &globals, lox::mapped_file &mapping)
+{
+	if (!directory.empty())
+	{
+		if_let_ok (lox::mapped_file & file,
+		           lox::mapped_file::open(entry_path(key)))
+		{
+			if_let_ok (lox::function_ptr & script,
+			           lox::deserialise(file.data(), globals))
+			{
+				++hits;
+				mapping = lak::move(file);
+				return lak::ok_t{lak::move(script)};
+			}
+		}
+	}
+
+	++misses;
+	return lak::err_t{};
+}
+
+void lox::compile_cache::store(uint64_t key,
+                               const lox::function &script,
+                               const lox::global_table &globals) const
+{
+	if (directory.empty()) return;
+
+	if_let_ok (const std::vector<byte_t> &bytecode,
+	           lox::serialise(script, globals))
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+		if (ec) return;
+
+		// write then rename so that a concurrent run never maps a partially
+		// written entry
+		const std::filesystem::path path = entry_path(key);
+		std::filesystem::path temp       = path;
+		temp += ".tmp";
+		if (lak::save_file(temp, lak::span<const byte_t>(bytecode)).is_err())
+			return;
+		std::filesystem::rename(temp, path, ec);
+		if (ec) std::filesystem::remove(temp, ec);
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef LOX_COMPILE_CACHE_HPP
+#define LOX_COMPILE_CACHE_HPP
+
+#include "compile_options.hpp"
+#include "global_table.hpp"
+#include "mapped_file.hpp"
+#include "object.hpp"
+
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <filesystem>
+#include <istream>
+
+namespace lox
+{
+	// An on-disk cache of compiled scripts, keyed by a hash of the source bytes
+	// and the bytecode format. Entries are ordinary .loxc files, so a hit skips
+	// the scanner, parser and compiler entirely.
+	struct compile_cache
+	{
+		std::filesystem::path directory;
+
+		size_t hits{0U};
+		size_t misses{0U};
+
+		// $LOX_CACHE_DIR if set, otherwise "lox-cache" in the temp directory.
+		static lox::compile_cache make_default();
+
+		// hashes the rest of source in fixed size blocks, along with options.
+		static uint64_t key(std::istream &source,
+		                    const lox::compile_options &options);
+
+		std::filesystem::path entry_path(uint64_t key) const;
+
+		// On a hit the returned script executes out of mapping, so mapping must
+		// outlive it. Missing, stale or corrupt entries count as a miss.
+		lak::result<lox::function_ptr> load(uint64_t key,
+		                                    lox::global_table &globals,
+		                                    lox::mapped_file &mapping);
+
+		// Failing to write an entry is not an error, the script just won't be
+		// cached.
+		void store(uint64_t key,
+		           const lox::function &script,
+		           const lox::global_table &globals) const;
+	};
+}
+
+#endif
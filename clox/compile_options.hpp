@@ -0,0 +1,30 @@
+#ifndef LOX_COMPILE_OPTIONS_HPP
+#define LOX_COMPILE_OPTIONS_HPP
+
+#include "registers.hpp"
+
+#include <lak/stdint.hpp>
+
+namespace lox
+{
+	inline constexpr uint8_t max_opt_level = 3U;
+
+	// How a script is compiled. Scripts compiled with different options are
+	// cached separately.
+	struct compile_options
+	{
+		lox::backend backend = lox::backend::stack;
+
+		// 0 keeps the bytecode as the parser emitted it, 1 runs lox::optimise
+		// over it, 2 also fuses superinstructions and 3 runs it through the IR
+		// passes first.
+		uint8_t opt_level = lox::max_opt_level;
+
+		// at -O3, how many bytes of bytecode a script may put through the IR.
+		// functions that would go over it skip the IR passes, the rest of the
+		// pipeline is cheap enough to always run.
+		size_t ir_budget = 64U * 1024U;
+	};
+}
+
+#endif
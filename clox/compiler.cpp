@@ -5,27 +5,41 @@
 #include <lak/debug.hpp>
 #include <lak/string_literals.hpp>
 
-lox::compile_result<lox::chunk> lox::compile(lak::u8string_view file)
+lox::compile_result<lox::function_ptr> compile_script(
+  lox::scanner &scanner,
+  lox::global_table &globals,
+  const lox::compile_options &options)
 {
-	lox::scanner scanner{file};
+	lox::parser parser{scanner, globals, options};
 
-	lox::parser parser{scanner};
+	lox::parser::function_compiler script;
+	parser.begin_compiler(script);
 
 	RES_TRY(parser.next());
 
-	RES_TRY(parser.parse_expression());
-
-	RES_TRY_ASSIGN(lox::token eof_tok =,
-	               parser.consume(lox::token_type::EOF_TOK,
-	                              u8"Expected end of expression."_view));
+	while (!parser.check(lox::token_type::EOF_TOK))
+		RES_TRY(parser.parse_declaration());
 
-	lox::chunk result{lak::move(parser.chunk)};
+	RES_TRY(parser.consume(lox::token_type::EOF_TOK,
+	                       u8"Expected end of file."_view));
 
-	result.push_opcode(lox::opcode::OP_RETURN, eof_tok.line);
+	return lak::ok_t{parser.end_compiler()};
+}
 
-#ifdef LOX_DEBUG_PRINT_CODE
-	result.disassemble(u8"code"_view);
-#endif
+lox::compile_result<lox::function_ptr> lox::compile(
+  lak::u8string_view file,
+  lox::global_table &globals,
+  const lox::compile_options &options)
+{
+	lox::scanner scanner{file};
+	return compile_script(scanner, globals, options);
+}
 
-	return lak::move_ok(result);
+lox::compile_result<lox::function_ptr> lox::compile(
+  std::istream &file,
+  lox::global_table &globals,
+  const lox::compile_options &options)
+{
+	lox::scanner scanner{file};
+	return compile_script(scanner, globals, options);
 }
@@ -2,7 +2,10 @@
 #define LOX_COMPILER_HPP
 
 #include "chunk.hpp"
+#include "compile_options.hpp"
 #include "error.hpp"
+#include "global_table.hpp"
+#include "object.hpp"
 #include "parser.hpp"
 #include "scanner.hpp"
 
@@ -12,6 +15,8 @@
 #include <lak/string_view.hpp>
 #include <lak/variant.hpp>
 
+#include <istream>
+
 namespace lox
 {
 	struct compile_error_tag;
@@ -23,7 +28,16 @@ namespace lox
 	  T,
 	  lox::result_set<lox::scan_error, lox::parse_error, lox::compile_error>>;
 
-	lox::compile_result<lox::chunk> compile(lak::u8string_view file);
+	lox::compile_result<lox::function_ptr> compile(
+	  lak::u8string_view file,
+	  lox::global_table &globals,
+	  const lox::compile_options &options = {});
+
+	// the file is scanned incrementally rather than being read up front.
+	lox::compile_result<lox::function_ptr> compile(
+	  std::istream &file,
+	  lox::global_table &globals,
+	  const lox::compile_options &options = {});
 }
 
 #endif
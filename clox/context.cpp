@@ -0,0 +1,69 @@
+#include "context.hpp"
+
+#include <lak/debug.hpp>
+#include <lak/string_literals.hpp>
+
+lak::result<lox::context, lox::virtual_machine::run_file_error>
+lox::context::load(const lox::program &program)
+{
+	lox::context result{.vm = std::make_unique<lox::virtual_machine>()};
+	result.vm->out = nullptr;
+	result.vm->init_globals();
+	RES_TRY(result.vm->run_program(program));
+	return lak::move_ok(result);
+}
+
+lak::result<lox::value> lox::context::global(lak::u8string_view name) const
+{
+	auto it = vm->global_names.indices.find(lak::u8string(name));
+	if (it == vm->global_names.indices.end()) return lak::err_t{};
+	// declared somewhere but never reached
+	if (it->second >= vm->globals.size() || !vm->globals[it->second])
+		return lak::err_t{};
+	return lak::ok_t<lox::value>{*vm->globals[it->second]};
+}
+
+lox::interpret_result<lox::value> lox::context::call(
+  const lox::value &callee, lak::span<const lox::value> arguments)
+{
+	ASSERT_EQUAL(vm->frame_count, 0U);
+
+	if (arguments.size() > UINT8_MAX)
+		return vm->error(u8"Can't have more than 255 arguments."_str);
+	if (arguments.size() >= vm->stack.size())
+		return vm->error(u8"Stack overflow."_str);
+
+	vm->stack_push(callee).unwrap();
+	for (const lox::value &argument : arguments)
+		vm->stack_push(argument).unwrap();
+
+	auto execute = [&]() -> lox::interpret_result<>
+	{
+		RES_TRY(vm->call_value(callee, static_cast<uint8_t>(arguments.size())));
+		// natives and classes without an initialiser complete without a frame
+		if (vm->frame_count > 0U) RES_TRY(vm->run());
+		return lak::ok_t{};
+	};
+
+	if_let_err (lox::interpret_error & err, execute())
+	{
+		vm->frame_count = 0U;
+		vm->open_upvalues.clear();
+		vm->stack_top = 0U;
+		return lak::err_t{lak::move(err)};
+	}
+
+	// the callee's slot now holds the result
+	ASSERT_EQUAL(vm->stack_top, 1U);
+	vm->stack_top = 0U;
+	return lak::ok_t<lox::value>{lak::move(vm->stack[0U])};
+}
+
+lox::interpret_result<lox::value> lox::context::call(
+  lak::u8string_view name, lak::span<const lox::value> arguments)
+{
+	if_let_ok (const lox::value &callee, global(name))
+		return call(callee, arguments);
+	return vm->error(u8"Undefined variable '"_str + lak::u8string(name) +
+	                 u8"'."_str);
+}
@@ -0,0 +1,45 @@
+#ifndef LOX_CONTEXT_HPP
+#define LOX_CONTEXT_HPP
+
+#include "program.hpp"
+#include "value.hpp"
+#include "virtual_machine.hpp"
+
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/string_view.hpp>
+
+#include <memory>
+
+namespace lox
+{
+	// The embedding API: a program loaded into a VM of its own. Loading runs
+	// the program's top level once, after which the functions and classes it
+	// defined can be called any number of times without going back through
+	// the scanner, parser or compiler.
+	//
+	// Print statements are discarded unless vm->out is set, nothing else
+	// touches an iostream. A context is not thread safe, but any number of
+	// them can be loaded from the same program on different threads.
+	struct context
+	{
+		std::unique_ptr<lox::virtual_machine> vm;
+
+		// program must outlive the context, its code is executed in place.
+		static lak::result<lox::context, lox::virtual_machine::run_file_error>
+		load(const lox::program &program);
+
+		// look up a global once and keep the value, rather than calling by name.
+		lak::result<lox::value> global(lak::u8string_view name) const;
+
+		// callee may be anything Lox could call: a function, class, bound method
+		// or native. On error the VM is unwound and the context stays usable.
+		lox::interpret_result<lox::value> call(
+		  const lox::value &callee, lak::span<const lox::value> arguments);
+
+		lox::interpret_result<lox::value> call(
+		  lak::u8string_view name, lak::span<const lox::value> arguments);
+	};
+}
+
+#endif
@@ -32,7 +32,7 @@ namespace lox
 			if (token.type == lox::token_type::EOF_TOK)
 				result.where = u8" at end"_str;
 			else if (token.type != lox::token_type::ERROR_TOK)
-				result.where = u8" at '"_str + lak::u8string(token.lexeme) + u8"'";
+				result.where = u8" at '"_str + lak::u8string(token.lexeme()) + u8"'";
 			result.message = lak::move(msg);
 			return result;
 		}
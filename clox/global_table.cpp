@@ -0,0 +1,22 @@
+#include "global_table.hpp"
+
+lak::result<uint16_t> lox::global_table::find_or_emplace(
+  lak::u8string_view name)
+{
+	lak::u8string key{name.to_string()};
+
+	if (auto iter = indices.find(key); iter != indices.end())
+		return lak::ok_t<uint16_t>{iter->second};
+
+	if (names.size() > UINT16_MAX) return lak::err_t{};
+
+	const uint16_t index = static_cast<uint16_t>(names.size());
+	names.push_back(key);
+	indices.emplace(lak::move(key), index);
+	return lak::ok_t<uint16_t>{index};
+}
+
+size_t lox::global_table::size() const
+{
+	return names.size();
+}
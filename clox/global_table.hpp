@@ -0,0 +1,29 @@
+#ifndef LOX_GLOBAL_TABLE_HPP
+#define LOX_GLOBAL_TABLE_HPP
+
+#include <lak/result.hpp>
+#include <lak/stdint.hpp>
+#include <lak/string.hpp>
+#include <lak/string_view.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace lox
+{
+	// Maps global variable names to the slot indices that the compiler bakes
+	// into OP_*_GLOBAL instructions. Names are only ever appended, so a table
+	// can be shared by every chunk run on the same virtual machine (such as
+	// successive REPL lines).
+	struct global_table
+	{
+		std::unordered_map<lak::u8string, uint16_t> indices;
+		std::vector<lak::u8string> names;
+
+		lak::result<uint16_t> find_or_emplace(lak::u8string_view name);
+
+		size_t size() const;
+	};
+}
+
+#endif
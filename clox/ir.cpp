@@ -0,0 +1,756 @@
+#include "ir.hpp"
+#include "rewrite.hpp"
+
+#include <lak/debug.hpp>
+#include <lak/string_literals.hpp>
+
+#include <bit>
+#include <iomanip>
+
+// how many values an instruction pops and pushes, the ones it only peeks at
+// are passed through.
+struct stack_effect
+{
+	size_t pops   = 0U;
+	size_t peeks  = 0U;
+	size_t pushes = 0U;
+};
+
+// nullopt for anything the parser doesn't emit.
+lak::optional<stack_effect> effect_of(const lox::chunk &chunk, size_t offset)
+{
+	switch (static_cast<lox::opcode>(chunk.code[offset]))
+	{
+		case lox::opcode::OP_CONSTANT: [[fallthrough]];
+		case lox::opcode::OP_NIL: [[fallthrough]];
+		case lox::opcode::OP_TRUE: [[fallthrough]];
+		case lox::opcode::OP_FALSE: [[fallthrough]];
+		case lox::opcode::OP_GET_LOCAL: [[fallthrough]];
+		case lox::opcode::OP_GET_GLOBAL: [[fallthrough]];
+		case lox::opcode::OP_GET_UPVALUE: [[fallthrough]];
+		case lox::opcode::OP_CLOSURE: [[fallthrough]];
+		case lox::opcode::OP_CLASS: return stack_effect{.pushes = 1U};
+
+		case lox::opcode::OP_POP: [[fallthrough]];
+		case lox::opcode::OP_DEFINE_GLOBAL: [[fallthrough]];
+		case lox::opcode::OP_PRINT: [[fallthrough]];
+		case lox::opcode::OP_CLOSE_UPVALUE: [[fallthrough]];
+		case lox::opcode::OP_RETURN: [[fallthrough]];
+		case lox::opcode::OP_INHERIT: [[fallthrough]];
+		case lox::opcode::OP_METHOD: return stack_effect{.pops = 1U};
+
+		case lox::opcode::OP_SET_LOCAL: [[fallthrough]];
+		case lox::opcode::OP_SET_GLOBAL: [[fallthrough]];
+		case lox::opcode::OP_SET_UPVALUE: [[fallthrough]];
+		case lox::opcode::OP_JUMP_IF_FALSE: return stack_effect{.peeks = 1U};
+
+		case lox::opcode::OP_GET_PROPERTY: [[fallthrough]];
+		case lox::opcode::OP_NOT: [[fallthrough]];
+		case lox::opcode::OP_NEGATE:
+			return stack_effect{.pops = 1U, .pushes = 1U};
+
+		case lox::opcode::OP_SET_PROPERTY: [[fallthrough]];
+		case lox::opcode::OP_GET_SUPER: [[fallthrough]];
+		case lox::opcode::OP_EQUAL: [[fallthrough]];
+		case lox::opcode::OP_GREATER: [[fallthrough]];
+		case lox::opcode::OP_LESS: [[fallthrough]];
+		case lox::opcode::OP_ADD: [[fallthrough]];
+		case lox::opcode::OP_SUBTRACT: [[fallthrough]];
+		case lox::opcode::OP_MULTIPLY: [[fallthrough]];
+		case lox::opcode::OP_DIVIDE:
+			return stack_effect{.pops = 2U, .pushes = 1U};
+
+		case lox::opcode::OP_JUMP: [[fallthrough]];
+		case lox::opcode::OP_LOOP: return stack_effect{};
+
+		case lox::opcode::OP_CALL: [[fallthrough]];
+		case lox::opcode::OP_TAIL_CALL:
+			return stack_effect{.pops   = chunk.code[offset + 1U] + 1U,
+			                    .pushes = 1U};
+
+		case lox::opcode::OP_INVOKE: [[fallthrough]];
+		case lox::opcode::OP_TAIL_INVOKE:
+			return stack_effect{.pops   = chunk.code[offset + 2U] + 1U,
+			                    .pushes = 1U};
+
+		case lox::opcode::OP_SUPER_INVOKE:
+			return stack_effect{.pops   = chunk.code[offset + 2U] + 2U,
+			                    .pushes = 1U};
+
+		default: return lak::nullopt;
+	}
+}
+
+// the local slots captured by the OP_CLOSURE at offset.
+template<typename F>
+void for_each_capture(const lox::chunk &chunk, size_t offset, F &&f)
+{
+	const lox::value &constant = chunk.constants[chunk.code[offset + 1U]];
+	const size_t upvalue_count = constant.as_function().unwrap()->upvalue_count;
+	for (size_t i = 0U; i < upvalue_count; ++i)
+	{
+		const size_t uv = offset + 2U + (i * 2U);
+		if (chunk.code[uv]) f(size_t(chunk.code[uv + 1U]));
+	}
+}
+
+// the constants propagate_constants tracks.
+bool is_trackable(const lox::value &val)
+{
+	return val.is_nil() || val.is_bool() || val.is_number();
+}
+
+// nil, bool and number constants that are the same down to the bits, unlike
+// operator== this keeps 0 and -0 apart.
+bool same_constant(const lox::value &a, const lox::value &b)
+{
+	if_let_ok (const double da, a.as_number())
+	{
+		if_let_ok (const double db, b.as_number())
+			return std::bit_cast<uint64_t>(da) == std::bit_cast<uint64_t>(db);
+		return false;
+	}
+	return a == b;
+}
+
+// instructions that can be dropped along with whatever they popped, if the
+// value they push is never used.
+bool is_pure(const lox::ir_instruction &inst)
+{
+	if (inst.folded) return true;
+	switch (inst.op)
+	{
+		case lox::opcode::OP_CONSTANT: [[fallthrough]];
+		case lox::opcode::OP_NIL: [[fallthrough]];
+		case lox::opcode::OP_TRUE: [[fallthrough]];
+		case lox::opcode::OP_FALSE: [[fallthrough]];
+		case lox::opcode::OP_GET_LOCAL: [[fallthrough]];
+		case lox::opcode::OP_GET_UPVALUE: [[fallthrough]];
+		case lox::opcode::OP_NOT: [[fallthrough]];
+		case lox::opcode::OP_EQUAL: return true;
+		default: return false;
+	}
+}
+
+// instructions that can be replaced with the constant they always push.
+bool is_foldable(lox::opcode op)
+{
+	switch (op)
+	{
+		case lox::opcode::OP_GET_LOCAL: [[fallthrough]];
+		case lox::opcode::OP_EQUAL: [[fallthrough]];
+		case lox::opcode::OP_GREATER: [[fallthrough]];
+		case lox::opcode::OP_LESS: [[fallthrough]];
+		case lox::opcode::OP_ADD: [[fallthrough]];
+		case lox::opcode::OP_SUBTRACT: [[fallthrough]];
+		case lox::opcode::OP_MULTIPLY: [[fallthrough]];
+		case lox::opcode::OP_DIVIDE: [[fallthrough]];
+		case lox::opcode::OP_NOT: [[fallthrough]];
+		case lox::opcode::OP_NEGATE: return true;
+		default: return false;
+	}
+}
+
+lak::optional<lox::ir_function> lox::ir_function::build(
+  const lox::chunk &chunk, size_t arity)
+{
+	const size_t size = chunk.code.size();
+
+	std::vector<bool> is_leader(size + 1U, false);
+	std::vector<bool> captured(UINT8_MAX + 1U, false);
+	is_leader[0] = true;
+	for (size_t offset = 0U; offset < size;
+	     offset        = chunk.next_instruction(offset))
+	{
+		if (!effect_of(chunk, offset)) return lak::nullopt;
+
+		const auto op = static_cast<lox::opcode>(chunk.code[offset]);
+		if (const lak::optional<size_t> target = chunk.jump_target(offset);
+		    target)
+		{
+			if (*target > size) return lak::nullopt;
+			is_leader[*target] = true;
+		}
+		if (op == lox::opcode::OP_JUMP || op == lox::opcode::OP_LOOP ||
+		    op == lox::opcode::OP_JUMP_IF_FALSE || op == lox::opcode::OP_RETURN)
+			is_leader[chunk.next_instruction(offset)] = true;
+		if (op == lox::opcode::OP_CLOSURE)
+			for_each_capture(
+			  chunk, offset, [&](size_t slot) { captured[slot] = true; });
+	}
+
+	lox::ir_function result;
+
+	// the block starting at each leader.
+	std::vector<size_t> block_at(size + 1U, SIZE_MAX);
+	for (size_t offset = 0U; offset < size;
+	     offset        = chunk.next_instruction(offset))
+	{
+		if (is_leader[offset])
+		{
+			if (!result.blocks.empty())
+				result.blocks.back().last = result.instructions.size();
+			block_at[offset] = result.blocks.size();
+			result.blocks.push_back(lox::ir_block{
+			  .first = result.instructions.size(),
+			  .last  = result.instructions.size(),
+			});
+		}
+		result.instructions.push_back(lox::ir_instruction{
+		  .offset = offset,
+		  .op     = static_cast<lox::opcode>(chunk.code[offset]),
+		});
+	}
+	if (result.blocks.empty()) return lak::nullopt;
+	result.blocks.back().last = result.instructions.size();
+
+	for (size_t b = 0U; b < result.blocks.size(); ++b)
+	{
+		lox::ir_block &block               = result.blocks[b];
+		const lox::ir_instruction &last    = result.instructions[block.last - 1U];
+		const lak::optional<size_t> target = chunk.jump_target(last.offset);
+
+		// OP_JUMP_IF_FALSE falls through first and jumps second.
+		if (last.op != lox::opcode::OP_JUMP && last.op != lox::opcode::OP_LOOP &&
+		    last.op != lox::opcode::OP_RETURN && b + 1U < result.blocks.size())
+			block.successors.push_back(b + 1U);
+		if (last.op == lox::opcode::OP_JUMP_IF_FALSE &&
+		    b + 1U == result.blocks.size())
+			return lak::nullopt;
+		if (target)
+		{
+			if (block_at[*target] == SIZE_MAX) return lak::nullopt;
+			block.successors.push_back(block_at[*target]);
+		}
+	}
+
+	// walk the blocks in the order they can be entered, giving each slot of
+	// the stack a value as it's pushed.
+	auto make_value = [&](lak::optional<size_t> instruction,
+	                      size_t slot) -> lox::ir_value_id
+	{
+		result.values.push_back(lox::ir_value{
+		  .instruction = instruction,
+		  .slot        = slot,
+		});
+		return static_cast<lox::ir_value_id>(result.values.size() - 1U);
+	};
+
+	std::vector<lak::optional<size_t>> heights(result.blocks.size());
+	heights[0].emplace(arity + 1U);
+	std::vector<size_t> pending = {0U};
+	while (!pending.empty())
+	{
+		const size_t b = pending.back();
+		pending.pop_back();
+		lox::ir_block &block = result.blocks[b];
+
+		for (size_t slot = 0U; slot < *heights[b]; ++slot)
+			block.entry.push_back(make_value(lak::nullopt, slot));
+		std::vector<lox::ir_value_id> stack = block.entry;
+
+		for (size_t i = block.first; i < block.last; ++i)
+		{
+			lox::ir_instruction &inst = result.instructions[i];
+			const stack_effect effect = *effect_of(chunk, inst.offset);
+
+			if (stack.size() < effect.pops + effect.peeks) return lak::nullopt;
+			inst.args.assign(stack.end() - (effect.pops + effect.peeks),
+			                 stack.end());
+			stack.resize(stack.size() - effect.pops);
+
+			switch (inst.op)
+			{
+				case lox::opcode::OP_GET_LOCAL: [[fallthrough]];
+				case lox::opcode::OP_SET_LOCAL:
+				{
+					const size_t slot = chunk.code[inst.offset + 1U];
+					if (slot >= stack.size()) return lak::nullopt;
+					inst.local.emplace(slot);
+					if (inst.op == lox::opcode::OP_GET_LOCAL)
+						inst.source.emplace(stack[slot]);
+					else
+						stack[slot] = stack.back();
+				}
+				break;
+
+				case lox::opcode::OP_CLOSURE:
+					for_each_capture(chunk,
+					                 inst.offset,
+					                 [&](size_t slot)
+					                 {
+						                 if (!inst.local || slot > *inst.local)
+							                 inst.local.emplace(slot);
+					                 });
+					break;
+
+				default: break;
+			}
+
+			if (effect.pushes > 0U)
+			{
+				inst.result.emplace(make_value(i, stack.size()));
+				stack.push_back(*inst.result);
+			}
+		}
+
+		for (const size_t s : block.successors)
+		{
+			lox::ir_block &successor = result.blocks[s];
+			successor.predecessors.push_back(b);
+			successor.incoming.push_back(stack);
+			successor.executable.push_back(false);
+
+			if (!heights[s])
+			{
+				heights[s].emplace(stack.size());
+				pending.push_back(s);
+			}
+			else if (*heights[s] != stack.size())
+				return lak::nullopt;
+		}
+	}
+
+	// the captured locals can change behind the function's back.
+	for (lox::ir_instruction &inst : result.instructions)
+	{
+		if (inst.op == lox::opcode::OP_GET_LOCAL && captured[*inst.local])
+			inst.source.reset();
+	}
+
+	return result;
+}
+
+void lox::ir_function::propagate_constants(const lox::chunk &chunk)
+{
+	bool changed = true;
+
+	auto merge = [&](lox::ir_value_id id,
+	                 lox::ir_value::state known,
+	                 const lox::value &constant = {})
+	{
+		lox::ir_value &val = values[id];
+		if (known == lox::ir_value::state::undefined ||
+		    val.known == lox::ir_value::state::varying)
+			return;
+		if (val.known == lox::ir_value::state::constant &&
+		    known == lox::ir_value::state::constant &&
+		    same_constant(val.constant, constant))
+			return;
+		if (val.known == lox::ir_value::state::undefined &&
+		    known == lox::ir_value::state::constant)
+		{
+			val.known    = known;
+			val.constant = constant;
+		}
+		else
+			val.known = lox::ir_value::state::varying;
+		changed = true;
+	};
+
+	auto mark_edge = [&](size_t from, size_t to)
+	{
+		lox::ir_block &block = blocks[to];
+		for (size_t j = 0U; j < block.predecessors.size(); ++j)
+		{
+			if (block.predecessors[j] != from || block.executable[j]) continue;
+			block.executable[j] = true;
+			block.reachable     = true;
+			changed             = true;
+		}
+	};
+
+	for (const lox::ir_value_id id : blocks[0].entry)
+		merge(id, lox::ir_value::state::varying);
+	blocks[0].reachable = true;
+
+	while (changed)
+	{
+		changed = false;
+		for (size_t b = 0U; b < blocks.size(); ++b)
+		{
+			lox::ir_block &block = blocks[b];
+			if (!block.reachable) continue;
+
+			for (size_t j = 0U; j < block.predecessors.size(); ++j)
+			{
+				if (!block.executable[j]) continue;
+				for (size_t k = 0U; k < block.entry.size(); ++k)
+				{
+					const lox::ir_value &in = values[block.incoming[j][k]];
+					merge(block.entry[k], in.known, in.constant);
+				}
+			}
+
+			for (size_t i = block.first; i < block.last; ++i)
+			{
+				const lox::ir_instruction &inst = instructions[i];
+
+				if (inst.op == lox::opcode::OP_JUMP_IF_FALSE)
+				{
+					const lox::ir_value &condition = values[inst.args[0]];
+					if (condition.known == lox::ir_value::state::varying)
+					{
+						for (const size_t s : block.successors) mark_edge(b, s);
+					}
+					else if (condition.known == lox::ir_value::state::constant)
+					{
+						// JUMP_IF_FALSE always ends its block, so this is the last
+						// instruction and successors are (fallthrough, target).
+						const bool jumps = !condition.constant.is_truthy();
+						mark_edge(b, block.successors[jumps ? 1U : 0U]);
+					}
+					continue;
+				}
+
+				if (!inst.result) continue;
+
+				auto arg = [&](size_t a) -> const lox::ir_value &
+				{ return values[inst.args[a]]; };
+
+				// the state of the result if every arg is a constant.
+				lak::optional<lox::value> folded;
+				bool undefined = false;
+				for (const lox::ir_value_id a : inst.args)
+					undefined |= values[a].known == lox::ir_value::state::undefined;
+				bool constant_args = true;
+				for (const lox::ir_value_id a : inst.args)
+					constant_args &=
+					  values[a].known == lox::ir_value::state::constant;
+
+				switch (inst.op)
+				{
+					case lox::opcode::OP_CONSTANT:
+					{
+						const lox::value &val =
+						  chunk.constants[chunk.code[inst.offset + 1U]];
+						if (is_trackable(val)) folded = val;
+					}
+					break;
+
+					case lox::opcode::OP_NIL: folded = lox::value{}; break;
+					case lox::opcode::OP_TRUE: folded = lox::value{true}; break;
+					case lox::opcode::OP_FALSE: folded = lox::value{false}; break;
+
+					case lox::opcode::OP_GET_LOCAL:
+						if (inst.source)
+						{
+							const lox::ir_value &source = values[*inst.source];
+							undefined = source.known == lox::ir_value::state::undefined;
+							if (source.known == lox::ir_value::state::constant)
+								folded = source.constant;
+						}
+						break;
+
+					case lox::opcode::OP_NOT:
+						if (constant_args)
+							folded = lox::value{!arg(0).constant.is_truthy()};
+						break;
+
+					case lox::opcode::OP_NEGATE:
+						if (constant_args)
+						{
+							if_let_ok (const double d, arg(0).constant.as_number())
+								folded = lox::value{-d};
+						}
+						break;
+
+					case lox::opcode::OP_EQUAL:
+						if (constant_args)
+							folded = lox::value{arg(0).constant == arg(1).constant};
+						break;
+
+#define LOX_IR_FOLD_BINARY(OP, EXPR)                                          \
+	case lox::opcode::OP:                                                       \
+		if (constant_args &&                                                      \
+		    lox::value::both_numbers(arg(0).constant, arg(1).constant))           \
+		{                                                                         \
+			const double a = arg(0).constant.as_number().unwrap();                  \
+			const double b = arg(1).constant.as_number().unwrap();                  \
+			folded         = lox::value{EXPR};                                      \
+		}                                                                         \
+		break;
+						LOX_IR_FOLD_BINARY(OP_GREATER, a > b)
+						LOX_IR_FOLD_BINARY(OP_LESS, a < b)
+						LOX_IR_FOLD_BINARY(OP_ADD, a + b)
+						LOX_IR_FOLD_BINARY(OP_SUBTRACT, a - b)
+						LOX_IR_FOLD_BINARY(OP_MULTIPLY, a * b)
+						LOX_IR_FOLD_BINARY(OP_DIVIDE, a / b)
+#undef LOX_IR_FOLD_BINARY
+
+					default: break;
+				}
+
+				if (folded)
+					merge(*inst.result, lox::ir_value::state::constant, *folded);
+				else if (!undefined)
+					merge(*inst.result, lox::ir_value::state::varying);
+			}
+
+			const lox::ir_instruction &last = instructions[block.last - 1U];
+			if (last.op != lox::opcode::OP_JUMP_IF_FALSE)
+				for (const size_t s : block.successors) mark_edge(b, s);
+		}
+	}
+}
+
+void lox::ir_function::eliminate_dead_code(lox::chunk &chunk)
+{
+	std::vector<size_t> block_of(instructions.size());
+	for (size_t b = 0U; b < blocks.size(); ++b)
+		for (size_t i = blocks[b].first; i < blocks[b].last; ++i)
+			block_of[i] = b;
+
+	// decide the branches and folds first, they change what's used.
+	for (const lox::ir_block &block : blocks)
+	{
+		if (!block.reachable) continue;
+		for (size_t i = block.first; i < block.last; ++i)
+		{
+			lox::ir_instruction &inst = instructions[i];
+
+			if (inst.op == lox::opcode::OP_JUMP_IF_FALSE)
+			{
+				const lox::ir_value &condition = values[inst.args[0]];
+				if (condition.known == lox::ir_value::state::constant)
+					inst.branch.emplace(!condition.constant.is_truthy());
+				continue;
+			}
+
+			if (!inst.result || !is_foldable(inst.op)) continue;
+			const lox::ir_value &val = values[*inst.result];
+			if (val.known != lox::ir_value::state::constant) continue;
+			if_let_ok (const double d, val.constant.as_number())
+			{
+				if (!chunk.number_constant(d)) continue;
+			}
+			inst.folded = val.constant;
+		}
+	}
+
+	for (size_t b = 0U; b < blocks.size(); ++b)
+	{
+		const lox::ir_block &block = blocks[b];
+		if (!block.reachable) continue;
+		for (size_t i = block.first; i < block.last; ++i)
+		{
+			const lox::ir_instruction &inst = instructions[i];
+			if (inst.branch) continue;
+			for (const lox::ir_value_id a : inst.args) ++values[a].uses;
+		}
+		for (const size_t s : block.successors)
+		{
+			const lox::ir_block &successor = blocks[s];
+			for (size_t j = 0U; j < successor.predecessors.size(); ++j)
+			{
+				if (successor.predecessors[j] != b || !successor.executable[j])
+					continue;
+				for (const lox::ir_value_id v : successor.incoming[j])
+					++values[v].uses;
+			}
+		}
+	}
+
+	// removes the instruction that pushed id, if consumer is the only thing
+	// that uses it and nothing in between depends on where it is on the stack.
+	auto try_remove = [&](auto &self,
+	                      lox::ir_value_id id,
+	                      size_t consumer) -> bool
+	{
+		const lox::ir_value &val = values[id];
+		if (!val.instruction || val.uses != 1U) return false;
+
+		const size_t producer     = *val.instruction;
+		lox::ir_instruction &inst = instructions[producer];
+		if (inst.removed || !is_pure(inst) ||
+		    block_of[producer] != block_of[consumer])
+			return false;
+
+		for (size_t i = producer + 1U; i < consumer; ++i)
+		{
+			const lox::ir_instruction &between = instructions[i];
+			if (!between.removed && !between.folded && between.local &&
+			    *between.local >= val.slot)
+				return false;
+		}
+
+		inst.removed = true;
+		// a folded instruction has already dealt with its args.
+		if (!inst.folded)
+		{
+			for (const lox::ir_value_id a : inst.args)
+				if (!self(self, a, producer)) ++inst.pops;
+		}
+		return true;
+	};
+
+	for (const lox::ir_block &block : blocks)
+	{
+		if (!block.reachable) continue;
+		for (size_t i = block.first; i < block.last; ++i)
+		{
+			lox::ir_instruction &inst = instructions[i];
+			if (inst.removed) continue;
+
+			if (inst.folded)
+			{
+				for (const lox::ir_value_id a : inst.args)
+					if (!try_remove(try_remove, a, i)) ++inst.pops;
+			}
+			else if (inst.op == lox::opcode::OP_POP &&
+			         try_remove(try_remove, inst.args[0], i))
+			{
+				inst.removed = true;
+			}
+		}
+	}
+}
+
+void lox::ir_function::lower(lox::chunk &chunk) const
+{
+	std::vector<size_t> instruction_at(chunk.code.size(), SIZE_MAX);
+	std::vector<bool> reachable(instructions.size(), false);
+	for (size_t i = 0U; i < instructions.size(); ++i)
+		instruction_at[instructions[i].offset] = i;
+	for (const lox::ir_block &block : blocks)
+		for (size_t i = block.first; i < block.last; ++i)
+			reachable[i] = block.reachable;
+
+	lox::rewrite_chunk(
+	  chunk,
+	  [&](const lox::chunk &source,
+	      size_t offset,
+	      const std::vector<bool> &,
+	      lox::chunk &out) -> lak::optional<size_t>
+	  {
+		  const size_t next               = source.next_instruction(offset);
+		  const size_t line               = source.lines[offset];
+		  const size_t i                  = instruction_at[offset];
+		  const lox::ir_instruction &inst = instructions[i];
+
+		  if (!reachable[i]) return next;
+
+		  if (inst.branch)
+		  {
+			  if (*inst.branch)
+			  {
+				  out.push_opcode(lox::opcode::OP_JUMP, line);
+				  out.push_code(source.code[offset + 1U], line);
+				  out.push_code(source.code[offset + 2U], line);
+			  }
+			  return next;
+		  }
+
+		  if (!inst.removed && !inst.folded) return lak::nullopt;
+
+		  for (size_t p = 0U; p < inst.pops; ++p)
+			  out.push_opcode(lox::opcode::OP_POP, line);
+
+		  if (inst.removed) return next;
+
+		  if_let_ok (const double d, inst.folded->as_number())
+		  {
+			  out.push_opcode(lox::opcode::OP_CONSTANT, line);
+			  out.push_code(*chunk.number_constant(d), line);
+		  }
+		  else if (inst.folded->is_nil())
+			  out.push_opcode(lox::opcode::OP_NIL, line);
+		  else
+			  out.push_opcode(inst.folded->is_truthy() ? lox::opcode::OP_TRUE
+			                                           : lox::opcode::OP_FALSE,
+			                  line);
+		  return next;
+	  });
+}
+
+void lox::ir_function::dump(std::ostream &strm) const
+{
+	using lak::operator<<;
+
+	auto write_values = [&](const std::vector<lox::ir_value_id> &ids)
+	{
+		for (const lox::ir_value_id id : ids) strm << " v" << id;
+	};
+
+	for (size_t b = 0U; b < blocks.size(); ++b)
+	{
+		const lox::ir_block &block = blocks[b];
+		strm << "b" << b << " (";
+		write_values(block.entry);
+		strm << " )";
+		if (!block.predecessors.empty())
+		{
+			strm << " <-";
+			for (const size_t p : block.predecessors) strm << " b" << p;
+		}
+		if (!block.reachable) strm << " unreachable";
+		strm << "\n";
+
+		for (size_t i = block.first; i < block.last; ++i)
+		{
+			const lox::ir_instruction &inst = instructions[i];
+			strm << "  " << std::setfill('0') << std::setw(4) << inst.offset
+			     << std::setfill(' ') << " ";
+			if (inst.result)
+				strm << "v" << std::left << std::setw(4) << *inst.result << std::right
+				     << " = ";
+			else
+				strm << "         ";
+			strm << lox::to_string(inst.op);
+			write_values(inst.args);
+			if (inst.source) strm << " [v" << *inst.source << "]";
+
+			if (inst.removed)
+				strm << " ; removed";
+			else if (inst.folded)
+				strm << " ; folded to " << *inst.folded;
+			else if (inst.branch)
+				strm << (*inst.branch ? " ; always jumps" : " ; never jumps");
+			else if (inst.result &&
+			         values[*inst.result].known == lox::ir_value::state::constant)
+				strm << " ; = " << values[*inst.result].constant;
+			if (inst.pops > 0U) strm << " (" << inst.pops << " popped)";
+			strm << "\n";
+		}
+	}
+}
+
+bool lox::optimise_ir(lox::chunk &chunk, size_t arity)
+{
+	lak::optional<lox::ir_function> ir = lox::ir_function::build(chunk, arity);
+	if (!ir) return false;
+	ir->propagate_constants(chunk);
+	ir->eliminate_dead_code(chunk);
+	ir->lower(chunk);
+	return true;
+}
+
+void lox::dump_ir(std::ostream &strm, const lox::function &func)
+{
+	using lak::operator<<;
+
+	strm << "== "
+	     << (func.name.empty() ? u8"<script>"_view
+	                           : lak::u8string_view(func.name))
+	     << " ==\n";
+
+	// the passes may add constants, so they get a copy to work on.
+	lox::chunk chunk = func.chunk;
+	chunk.unmap_code();
+	if (lak::optional<lox::ir_function> ir =
+	      lox::ir_function::build(chunk, func.arity);
+	    ir)
+	{
+		ir->propagate_constants(chunk);
+		ir->eliminate_dead_code(chunk);
+		ir->dump(strm);
+	}
+	else
+		strm << "can't be lifted to the IR\n";
+
+	for (const lox::value &constant : func.chunk.constants)
+	{
+		if_let_ok (const lox::function_ptr &inner, constant.as_function())
+			lox::dump_ir(strm, *inner);
+	}
+}
@@ -0,0 +1,125 @@
+#ifndef LOX_IR_HPP
+#define LOX_IR_HPP
+
+#include "chunk.hpp"
+#include "object.hpp"
+#include "value.hpp"
+
+#include <lak/optional.hpp>
+#include <lak/stdint.hpp>
+
+#include <ostream>
+#include <vector>
+
+namespace lox
+{
+	using ir_value_id = uint32_t;
+
+	// A value that one slot of the frame's stack holds between the instruction
+	// that pushes it and the one that pops it.
+	struct ir_value
+	{
+		enum struct state : uint8_t
+		{
+			// nothing that reaches it has been seen yet
+			undefined,
+			// always a nil, bool or number, see constant
+			constant,
+			varying,
+		};
+
+		// the index of the instruction that pushes it, or nullopt if the value
+		// is one of a block's entry values.
+		lak::optional<size_t> instruction = {};
+		// where on the frame's stack it lives, slot 0 is the callee.
+		size_t slot = 0U;
+
+		state known         = state::undefined;
+		lox::value constant = {};
+
+		// the instructions that consume it, plus one for each control flow edge
+		// it's live across.
+		size_t uses = 0U;
+	};
+
+	struct ir_instruction
+	{
+		size_t offset;
+		lox::opcode op;
+		// the values it pops or peeks at, deepest first.
+		std::vector<lox::ir_value_id> args     = {};
+		lak::optional<lox::ir_value_id> result = {};
+		// OP_GET_LOCAL: the value in the slot it reads.
+		lak::optional<lox::ir_value_id> source = {};
+		// the highest local slot it reads, writes or captures.
+		lak::optional<size_t> local = {};
+
+		// decided by the passes, and applied by lower.
+		bool removed                     = false;
+		lak::optional<lox::value> folded = {};
+		// how many args are left on the stack to pop if removed or folded.
+		size_t pops = 0U;
+		// an OP_JUMP_IF_FALSE that always (true) or never (false) jumps.
+		lak::optional<bool> branch = {};
+	};
+
+	struct ir_block
+	{
+		// its instructions are [first, last).
+		size_t first;
+		size_t last;
+		// the values on the stack when the block starts, phis of incoming.
+		std::vector<lox::ir_value_id> entry = {};
+		std::vector<size_t> predecessors    = {};
+		// the stack each predecessor leaves, lined up with entry.
+		std::vector<std::vector<lox::ir_value_id>> incoming = {};
+		std::vector<bool> executable                        = {};
+		std::vector<size_t> successors                      = {};
+		bool reachable                                      = false;
+	};
+
+	// An SSA view of the bytecode the parser emitted for one function: every
+	// slot of the frame's stack, locals included, holds an ir_value. Each
+	// instruction takes the values it pops (or peeks at) as arguments and
+	// defines a new value for whatever it pushes, and each block starts with
+	// a fresh value for every slot that's live on entry to it.
+	//
+	// The passes only decide what should change, lower then applies that to
+	// the chunk while keeping every other instruction in place. Stack bytecode
+	// has nowhere to keep a value for later use, so common subexpressions and
+	// loop invariants can't be reused and aren't looked for.
+	struct ir_function
+	{
+		std::vector<lox::ir_value> values;
+		std::vector<lox::ir_instruction> instructions;
+		std::vector<lox::ir_block> blocks;
+
+		// nullopt if chunk has anything the parser wouldn't have emitted, or
+		// its stack doesn't balance.
+		static lak::optional<lox::ir_function> build(const lox::chunk &chunk,
+		                                             size_t arity);
+
+		// sparse conditional constant propagation: finds the values that are
+		// always the same nil, bool or number, and the blocks and branches that
+		// are never taken.
+		void propagate_constants(const lox::chunk &chunk);
+
+		// folds the instructions that propagate_constants found a constant for,
+		// and removes pure instructions whose values are only popped. Constants
+		// the folded instructions need are added to chunk.
+		void eliminate_dead_code(lox::chunk &chunk);
+
+		void lower(lox::chunk &chunk) const;
+
+		void dump(std::ostream &strm) const;
+	};
+
+	// runs chunk through the IR passes, if it can be built. returns whether it
+	// could be.
+	bool optimise_ir(lox::chunk &chunk, size_t arity);
+
+	// dumps the IR, after the passes, of func and every function nested in it.
+	void dump_ir(std::ostream &strm, const lox::function &func);
+}
+
+#endif
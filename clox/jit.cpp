@@ -0,0 +1,627 @@
+#include "jit.hpp"
+
+#ifdef LOX_JIT
+
+#	include "virtual_machine.hpp"
+
+#	include <lak/debug.hpp>
+
+#	include <sys/mman.h>
+
+#	include <cerrno>
+#	include <cstring>
+#	include <functional>
+#	include <utility>
+
+// handlers return one of these, except for the conditional jumps which
+// return whether the jump is taken.
+enum : uint32_t
+{
+	// carry on with the next instruction.
+	NEXT = 0U,
+	// leave this instruction to the interpreter.
+	BAIL = 1U,
+};
+
+// vm, frame and up to three operand bytes, packed first byte lowest.
+using jit_handler = uint32_t (*)(lox::virtual_machine *,
+                                 lox::call_frame *,
+                                 uint32_t);
+
+uint8_t operand_u8(uint32_t operands, size_t index)
+{
+	return static_cast<uint8_t>(operands >> (index * 8U));
+}
+
+uint16_t operand_u16(uint32_t operands)
+{
+	return static_cast<uint16_t>((operand_u8(operands, 0U) << 8) |
+	                             operand_u8(operands, 1U));
+}
+
+const lox::value &constant(lox::call_frame *frame, uint8_t index)
+{
+	return frame->closure->function->chunk.constants[index];
+}
+
+lox::value &top(lox::virtual_machine *vm, size_t depth = 0U)
+{
+	return vm->stack[vm->stack_top - 1U - depth];
+}
+
+struct not_less
+{
+	bool operator()(double a, double b) const { return !(a < b); }
+};
+
+struct not_greater
+{
+	bool operator()(double a, double b) const { return !(a > b); }
+};
+
+/* --- handlers --- */
+
+uint32_t op_constant(lox::virtual_machine *vm,
+                     lox::call_frame *frame,
+                     uint32_t operands)
+{
+	vm->stack_push(constant(frame, operand_u8(operands, 0U))).unwrap();
+	return NEXT;
+}
+
+uint32_t op_nil(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	vm->stack_push(lox::value{}).unwrap();
+	return NEXT;
+}
+
+uint32_t op_true(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	vm->stack_push(lox::value{true}).unwrap();
+	return NEXT;
+}
+
+uint32_t op_false(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	vm->stack_push(lox::value{false}).unwrap();
+	return NEXT;
+}
+
+uint32_t op_pop(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	vm->stack_pop().unwrap();
+	return NEXT;
+}
+
+uint32_t op_get_local(lox::virtual_machine *vm,
+                      lox::call_frame *frame,
+                      uint32_t operands)
+{
+	vm->stack_push(frame->slots[operand_u8(operands, 0U)]).unwrap();
+	return NEXT;
+}
+
+uint32_t op_set_local(lox::virtual_machine *vm,
+                      lox::call_frame *frame,
+                      uint32_t operands)
+{
+	frame->slots[operand_u8(operands, 0U)] = top(vm);
+	return NEXT;
+}
+
+uint32_t op_set_local_pop(lox::virtual_machine *vm,
+                          lox::call_frame *frame,
+                          uint32_t operands)
+{
+	frame->slots[operand_u8(operands, 0U)] = vm->stack_pop().unwrap();
+	return NEXT;
+}
+
+uint32_t op_get_global(lox::virtual_machine *vm,
+                       lox::call_frame *,
+                       uint32_t operands)
+{
+	const lak::optional<lox::value> &global =
+	  vm->globals[operand_u16(operands)];
+	if (!global) return BAIL;
+	vm->stack_push(*global).unwrap();
+	return NEXT;
+}
+
+uint32_t op_define_global(lox::virtual_machine *vm,
+                          lox::call_frame *,
+                          uint32_t operands)
+{
+	vm->globals[operand_u16(operands)] = vm->stack_pop().unwrap();
+	return NEXT;
+}
+
+uint32_t op_set_global(lox::virtual_machine *vm,
+                       lox::call_frame *,
+                       uint32_t operands)
+{
+	lak::optional<lox::value> &global = vm->globals[operand_u16(operands)];
+	if (!global) return BAIL;
+	global = top(vm);
+	return NEXT;
+}
+
+uint32_t op_get_upvalue(lox::virtual_machine *vm,
+                        lox::call_frame *frame,
+                        uint32_t operands)
+{
+	vm->stack_push(
+	    *frame->closure->upvalues[operand_u8(operands, 0U)]->location)
+	  .unwrap();
+	return NEXT;
+}
+
+uint32_t op_set_upvalue(lox::virtual_machine *vm,
+                        lox::call_frame *frame,
+                        uint32_t operands)
+{
+	*frame->closure->upvalues[operand_u8(operands, 0U)]->location = top(vm);
+	return NEXT;
+}
+
+// only fields, methods are bound by the interpreter.
+const lox::value *field(const lox::value &object, const lox::value &name)
+{
+	if (!object.is_instance()) return nullptr;
+	const lox::instance_ptr &instance = object.as_instance().unsafe_unwrap();
+	auto it = instance->fields.find(name.as_string().unwrap()->value);
+	if (it == instance->fields.end()) return nullptr;
+	return &it->second;
+}
+
+uint32_t op_get_property(lox::virtual_machine *vm,
+                         lox::call_frame *frame,
+                         uint32_t operands)
+{
+	const lox::value *value =
+	  field(top(vm), constant(frame, operand_u8(operands, 0U)));
+	if (!value) return BAIL;
+	// copy the field out before the instance is released
+	lox::value result{*value};
+	top(vm) = lak::move(result);
+	return NEXT;
+}
+
+uint32_t op_get_local_property(lox::virtual_machine *vm,
+                               lox::call_frame *frame,
+                               uint32_t operands)
+{
+	const lox::value *value =
+	  field(frame->slots[operand_u8(operands, 0U)],
+	        constant(frame, operand_u8(operands, 1U)));
+	if (!value) return BAIL;
+	vm->stack_push(*value).unwrap();
+	return NEXT;
+}
+
+uint32_t op_set_property(lox::virtual_machine *vm,
+                         lox::call_frame *frame,
+                         uint32_t operands)
+{
+	if (!top(vm, 1U).is_instance()) return BAIL;
+	const lox::string &name =
+	  *constant(frame, operand_u8(operands, 0U)).as_string().unwrap();
+	lox::value value{vm->stack_pop().unwrap()};
+	top(vm).as_instance().unsafe_unwrap()->fields.insert_or_assign(name.value,
+	                                                               value);
+	top(vm) = lak::move(value);
+	return NEXT;
+}
+
+template<bool EQUAL>
+uint32_t op_equal(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	const bool equal = top(vm, 1U) == top(vm);
+	vm->stack_pop().unwrap();
+	top(vm) = lox::value{equal == EQUAL};
+	return NEXT;
+}
+
+template<typename OP>
+uint32_t op_binary(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	lox::value &a       = top(vm, 1U);
+	const lox::value &b = top(vm);
+	if (!a.is_number() || !b.is_number()) return BAIL;
+	a = lox::value{
+	  OP{}(a.as_number().unsafe_unwrap(), b.as_number().unsafe_unwrap())};
+	--vm->stack_top;
+	return NEXT;
+}
+
+template<typename OP>
+uint32_t op_binary_constant(lox::virtual_machine *vm,
+                            lox::call_frame *frame,
+                            uint32_t operands)
+{
+	lox::value &a       = top(vm);
+	const lox::value &b = constant(frame, operand_u8(operands, 0U));
+	if (!a.is_number() || !b.is_number()) return BAIL;
+	a = lox::value{
+	  OP{}(a.as_number().unsafe_unwrap(), b.as_number().unsafe_unwrap())};
+	return NEXT;
+}
+
+uint32_t op_not(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	top(vm) = lox::value{!top(vm).is_truthy()};
+	return NEXT;
+}
+
+uint32_t op_negate(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	if (!top(vm).is_number()) return BAIL;
+	top(vm) = lox::value{-top(vm).as_number().unsafe_unwrap()};
+	return NEXT;
+}
+
+uint32_t op_print(lox::virtual_machine *vm, lox::call_frame *, uint32_t)
+{
+	const lox::value value = vm->stack_pop().unwrap();
+	if (vm->out)
+	{
+		lox::write(*vm->out, value);
+		vm->out->write('\n');
+	}
+	return NEXT;
+}
+
+uint32_t op_close_upvalue(lox::virtual_machine *vm,
+                          lox::call_frame *,
+                          uint32_t)
+{
+	vm->close_upvalues(vm->stack.data() + vm->stack_top - 1U);
+	vm->stack_pop().unwrap();
+	return NEXT;
+}
+
+// returns whether to jump.
+uint32_t op_jump_if_false(lox::virtual_machine *vm,
+                          lox::call_frame *,
+                          uint32_t)
+{
+	return !top(vm).is_truthy();
+}
+
+// returns whether to jump, the condition is only popped if not.
+uint32_t op_jump_if_false_pop(lox::virtual_machine *vm,
+                              lox::call_frame *,
+                              uint32_t)
+{
+	if (!top(vm).is_truthy()) return true;
+	vm->stack_pop().unwrap();
+	return false;
+}
+
+/* --- register handlers --- */
+
+template<typename OP, bool CONSTANT>
+uint32_t op_register_push(lox::virtual_machine *vm,
+                          lox::call_frame *frame,
+                          uint32_t operands)
+{
+	const lox::value &a = frame->slots[operand_u8(operands, 0U)];
+	const lox::value &b = CONSTANT ? constant(frame, operand_u8(operands, 1U))
+	                               : frame->slots[operand_u8(operands, 1U)];
+	if (!a.is_number() || !b.is_number()) return BAIL;
+	vm->stack_push(lox::value{OP{}(a.as_number().unsafe_unwrap(),
+	                               b.as_number().unsafe_unwrap())})
+	  .unwrap();
+	return NEXT;
+}
+
+template<typename OP, bool CONSTANT>
+uint32_t op_register_store(lox::virtual_machine *,
+                           lox::call_frame *frame,
+                           uint32_t operands)
+{
+	lox::value &d       = frame->slots[operand_u8(operands, 0U)];
+	const lox::value &a = frame->slots[operand_u8(operands, 1U)];
+	const lox::value &b = CONSTANT ? constant(frame, operand_u8(operands, 2U))
+	                               : frame->slots[operand_u8(operands, 2U)];
+	if (!a.is_number() || !b.is_number()) return BAIL;
+	d = lox::value{
+	  OP{}(a.as_number().unsafe_unwrap(), b.as_number().unsafe_unwrap())};
+	return NEXT;
+}
+
+template<bool CONSTANT>
+uint32_t op_register_equal(lox::virtual_machine *vm,
+                           lox::call_frame *frame,
+                           uint32_t operands)
+{
+	const lox::value &a = frame->slots[operand_u8(operands, 0U)];
+	const lox::value &b = CONSTANT ? constant(frame, operand_u8(operands, 1U))
+	                               : frame->slots[operand_u8(operands, 1U)];
+	vm->stack_push(lox::value{a == b}).unwrap();
+	return NEXT;
+}
+
+template<bool CONSTANT>
+uint32_t op_move(lox::virtual_machine *,
+                 lox::call_frame *frame,
+                 uint32_t operands)
+{
+	frame->slots[operand_u8(operands, 0U)] =
+	  CONSTANT ? constant(frame, operand_u8(operands, 1U))
+	           : frame->slots[operand_u8(operands, 1U)];
+	return NEXT;
+}
+
+// nullptr for the instructions that are left to the interpreter, or that are
+// compiled to native jumps. quickened instructions share the generic handlers,
+// which have their own guards.
+jit_handler handler(lox::opcode op)
+{
+	using lox::opcode;
+
+	switch (lox::generic_opcode(op))
+	{
+		case opcode::OP_CONSTANT: return op_constant;
+		case opcode::OP_NIL: return op_nil;
+		case opcode::OP_TRUE: return op_true;
+		case opcode::OP_FALSE: return op_false;
+		case opcode::OP_POP: return op_pop;
+		case opcode::OP_GET_LOCAL: return op_get_local;
+		case opcode::OP_SET_LOCAL: return op_set_local;
+		case opcode::OP_SET_LOCAL_POP: return op_set_local_pop;
+		case opcode::OP_GET_GLOBAL: return op_get_global;
+		case opcode::OP_DEFINE_GLOBAL: return op_define_global;
+		case opcode::OP_SET_GLOBAL: return op_set_global;
+		case opcode::OP_GET_UPVALUE: return op_get_upvalue;
+		case opcode::OP_SET_UPVALUE: return op_set_upvalue;
+		case opcode::OP_GET_PROPERTY: return op_get_property;
+		case opcode::OP_GET_LOCAL_PROPERTY: return op_get_local_property;
+		case opcode::OP_SET_PROPERTY: return op_set_property;
+		case opcode::OP_EQUAL: return op_equal<true>;
+		case opcode::OP_NOT_EQUAL: return op_equal<false>;
+		case opcode::OP_GREATER: return op_binary<std::greater<double>>;
+		case opcode::OP_LESS: return op_binary<std::less<double>>;
+		case opcode::OP_NOT_GREATER: return op_binary<not_greater>;
+		case opcode::OP_NOT_LESS: return op_binary<not_less>;
+		case opcode::OP_ADD: return op_binary<std::plus<double>>;
+		case opcode::OP_SUBTRACT: return op_binary<std::minus<double>>;
+		case opcode::OP_MULTIPLY: return op_binary<std::multiplies<double>>;
+		case opcode::OP_DIVIDE: return op_binary<std::divides<double>>;
+		case opcode::OP_ADD_CONSTANT:
+			return op_binary_constant<std::plus<double>>;
+		case opcode::OP_SUBTRACT_CONSTANT:
+			return op_binary_constant<std::minus<double>>;
+		case opcode::OP_LESS_CONSTANT:
+			return op_binary_constant<std::less<double>>;
+		case opcode::OP_NOT: return op_not;
+		case opcode::OP_NEGATE: return op_negate;
+		case opcode::OP_PRINT: return op_print;
+		case opcode::OP_CLOSE_UPVALUE: return op_close_upvalue;
+		case opcode::OP_JUMP_IF_FALSE: return op_jump_if_false;
+		case opcode::OP_JUMP_IF_FALSE_POP: return op_jump_if_false_pop;
+
+#define LOX_JIT_ARITHMETIC(OP, FUNCTOR)                                       \
+	case opcode::OP_##OP##_RR: return op_register_push<FUNCTOR, false>;         \
+	case opcode::OP_##OP##_RK: return op_register_push<FUNCTOR, true>;          \
+	case opcode::OP_##OP##_RRR: return op_register_store<FUNCTOR, false>;       \
+	case opcode::OP_##OP##_RRK: return op_register_store<FUNCTOR, true>;
+		LOX_JIT_ARITHMETIC(ADD, std::plus<double>)
+		LOX_JIT_ARITHMETIC(SUBTRACT, std::minus<double>)
+		LOX_JIT_ARITHMETIC(MULTIPLY, std::multiplies<double>)
+		LOX_JIT_ARITHMETIC(DIVIDE, std::divides<double>)
+#undef LOX_JIT_ARITHMETIC
+
+		case opcode::OP_LESS_RR:
+			return op_register_push<std::less<double>, false>;
+		case opcode::OP_LESS_RK: return op_register_push<std::less<double>, true>;
+		case opcode::OP_GREATER_RR:
+			return op_register_push<std::greater<double>, false>;
+		case opcode::OP_GREATER_RK:
+			return op_register_push<std::greater<double>, true>;
+		case opcode::OP_EQUAL_RR: return op_register_equal<false>;
+		case opcode::OP_EQUAL_RK: return op_register_equal<true>;
+		case opcode::OP_MOVE_RR: return op_move<false>;
+		case opcode::OP_MOVE_RK: return op_move<true>;
+
+		default: return nullptr;
+	}
+}
+
+/* --- code generation --- */
+
+struct assembler
+{
+	std::vector<uint8_t> code;
+
+	// (where a rel32 is, bytecode offset it refers to)
+	std::vector<std::pair<size_t, size_t>> fixups;
+
+	void bytes(std::initializer_list<uint8_t> b)
+	{
+		code.insert(code.end(), b.begin(), b.end());
+	}
+
+	void u32(uint32_t v)
+	{
+		for (size_t i = 0U; i < 4U; ++i)
+			code.push_back(static_cast<uint8_t>(v >> (i * 8U)));
+	}
+
+	void u64(uint64_t v)
+	{
+		for (size_t i = 0U; i < 8U; ++i)
+			code.push_back(static_cast<uint8_t>(v >> (i * 8U)));
+	}
+
+	void rel32_to(size_t native)
+	{
+		u32(static_cast<uint32_t>(native - (code.size() + 4U)));
+	}
+
+	// a rel32 to the start of the instruction at offset, patched once every
+	// instruction has been emitted.
+	void rel32_to_offset(size_t offset)
+	{
+		fixups.emplace_back(code.size(), offset);
+		u32(0U);
+	}
+
+	// mov eax, offset; jmp epilogue
+	void exit(size_t offset, size_t epilogue)
+	{
+		bytes({0xB8});
+		u32(static_cast<uint32_t>(offset));
+		bytes({0xE9});
+		rel32_to(epilogue);
+	}
+
+	// rdi = vm, rsi = frame, edx = operands, then call the handler
+	void call(jit_handler handler, uint32_t operands)
+	{
+		bytes({0x48, 0x89, 0xDF}); // mov rdi, rbx
+		bytes({0x4C, 0x89, 0xE6}); // mov rsi, r12
+		bytes({0xBA});             // mov edx, imm32
+		u32(operands);
+		bytes({0x48, 0xB8}); // mov rax, imm64
+		u64(reinterpret_cast<uint64_t>(handler));
+		bytes({0xFF, 0xD0}); // call rax
+		bytes({0x85, 0xC0}); // test eax, eax
+	}
+};
+
+lox::jit_code::jit_code(jit_code &&other)
+: _memory(std::exchange(other._memory, nullptr)),
+  _size(std::exchange(other._size, 0U)),
+  _labels(lak::move(other._labels))
+{
+}
+
+lox::jit_code &lox::jit_code::operator=(jit_code &&other)
+{
+	std::swap(_memory, other._memory);
+	std::swap(_size, other._size);
+	std::swap(_labels, other._labels);
+	return *this;
+}
+
+lox::jit_code::~jit_code()
+{
+	release();
+}
+
+void lox::jit_code::release()
+{
+	if (_memory) munmap(_memory, _size);
+	_memory = nullptr;
+	_size   = 0U;
+	_labels.clear();
+}
+
+lak::result<lox::jit_code, lak::errno_error> lox::jit_code::compile(
+  const lox::chunk &chunk)
+{
+	const size_t size = chunk.code_size();
+
+	assembler a;
+
+	// size_t entry(vm *rdi, frame *rsi, const uint8_t *rdx): keep vm and frame
+	// in callee saved registers and jump to the first instruction. the third
+	// push keeps the stack 16 byte aligned for the handler calls.
+	a.bytes({0x53});             // push rbx
+	a.bytes({0x41, 0x54});       // push r12
+	a.bytes({0x41, 0x55});       // push r13
+	a.bytes({0x48, 0x89, 0xFB}); // mov rbx, rdi
+	a.bytes({0x49, 0x89, 0xF4}); // mov r12, rsi
+	a.bytes({0xFF, 0xE2});       // jmp rdx
+
+	// every exit jumps here with the offset to resume at in eax.
+	const size_t epilogue = a.code.size();
+	a.bytes({0x41, 0x5D}); // pop r13
+	a.bytes({0x41, 0x5C}); // pop r12
+	a.bytes({0x5B});       // pop rbx
+	a.bytes({0xC3});       // ret
+
+	std::vector<uint32_t> labels(size + 1U, 0U);
+
+	for (size_t offset = 0U; offset < size;
+	     offset        = chunk.next_instruction(offset))
+	{
+		labels[offset] = static_cast<uint32_t>(a.code.size());
+
+		const lox::opcode op = static_cast<lox::opcode>(chunk.code_at(offset));
+		const size_t next    = chunk.next_instruction(offset);
+
+		uint32_t operands = 0U;
+		for (size_t i = offset + 1U; i < next && i < offset + 4U; ++i)
+			operands |= uint32_t(chunk.code_at(i)) << ((i - offset - 1U) * 8U);
+
+		switch (op)
+		{
+			case lox::opcode::OP_JUMP: [[fallthrough]];
+			case lox::opcode::OP_LOOP:
+				a.bytes({0xE9}); // jmp rel32
+				a.rel32_to_offset(*chunk.jump_target(offset));
+				break;
+
+			case lox::opcode::OP_JUMP_IF_FALSE: [[fallthrough]];
+			case lox::opcode::OP_JUMP_IF_FALSE_POP:
+				a.call(handler(op), operands);
+				a.bytes({0x0F, 0x85}); // jnz rel32
+				a.rel32_to_offset(*chunk.jump_target(offset));
+				break;
+
+			default:
+				if (const jit_handler h = handler(op); h)
+				{
+					a.call(h, operands);
+					a.bytes({0x74, 0x0A}); // jz over the exit
+					a.exit(offset, epilogue);
+				}
+				else
+				{
+					a.exit(offset, epilogue);
+				}
+				break;
+		}
+	}
+	labels[size] = static_cast<uint32_t>(a.code.size());
+	a.exit(size, epilogue);
+
+	for (const auto &[at, offset] : a.fixups)
+	{
+		const uint32_t rel = static_cast<uint32_t>(labels[offset] - (at + 4U));
+		std::memcpy(a.code.data() + at, &rel, sizeof(rel));
+	}
+
+	void *memory = mmap(nullptr,
+	                    a.code.size(),
+	                    PROT_READ | PROT_WRITE,
+	                    MAP_PRIVATE | MAP_ANONYMOUS,
+	                    -1,
+	                    0);
+	if (memory == MAP_FAILED) return lak::err_t{lak::errno_error{errno}};
+
+	jit_code result;
+	result._memory = static_cast<uint8_t *>(memory);
+	result._size   = a.code.size();
+	result._labels = lak::move(labels);
+
+	std::memcpy(result._memory, a.code.data(), a.code.size());
+	if (mprotect(result._memory, result._size, PROT_READ | PROT_EXEC) != 0)
+		return lak::err_t{lak::errno_error{errno}};
+
+	return lak::move_ok(result);
+}
+
+size_t lox::jit_code::run(lox::virtual_machine &vm,
+                          lox::call_frame &frame,
+                          size_t offset) const
+{
+	using entry_t =
+	  size_t (*)(lox::virtual_machine *, lox::call_frame *, const uint8_t *);
+	const entry_t entry = reinterpret_cast<entry_t>(_memory);
+	return entry(&vm, &frame, _memory + _labels[offset]);
+}
+
+#endif
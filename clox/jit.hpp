@@ -0,0 +1,52 @@
+#ifndef LOX_JIT_HPP
+#define LOX_JIT_HPP
+
+#include <lak/result.hpp>
+#include <lak/stdint.hpp>
+
+#include <vector>
+
+namespace lox
+{
+	struct chunk;
+	struct call_frame;
+	struct virtual_machine;
+
+	// x86-64 code for one chunk, built from a template per opcode. Most
+	// templates call a handler for the instruction, jumps are native jumps.
+	// Instructions the JIT doesn't handle, such as calls and returns, make the
+	// native code return so the interpreter can run them. A handler also
+	// returns to the interpreter when its guard fails, for example OP_ADD on
+	// anything but two numbers. The instruction is then rerun from the start.
+	//
+	// Enabled with the clox_jit meson option, x86-64 Linux only.
+	struct jit_code
+	{
+	private:
+		uint8_t *_memory = nullptr;
+		size_t _size     = 0U;
+		// where the native code for each bytecode offset starts.
+		std::vector<uint32_t> _labels;
+
+		void release();
+
+	public:
+		jit_code() = default;
+		jit_code(const jit_code &) = delete;
+		jit_code &operator=(const jit_code &) = delete;
+		jit_code(jit_code &&other);
+		jit_code &operator=(jit_code &&other);
+		~jit_code();
+
+		static lak::result<jit_code, lak::errno_error> compile(
+		  const lox::chunk &chunk);
+
+		// runs frame's code from the instruction at offset until it reaches one
+		// the interpreter has to run, and returns that instruction's offset.
+		size_t run(lox::virtual_machine &vm,
+		           lox::call_frame &frame,
+		           size_t offset) const;
+	};
+}
+
+#endif
@@ -0,0 +1,9 @@
+#include "lexeme_table.hpp"
+
+const lak::u8string &lox::lexeme_table::intern(lak::u8string_view lexeme)
+{
+	// unordered_set never moves its elements, so references to them stay valid
+	if (auto iter = lexemes.find(lexeme); iter != lexemes.end())
+		return *iter;
+	return *lexemes.emplace(lexeme.to_string()).first;
+}
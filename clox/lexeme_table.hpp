@@ -0,0 +1,49 @@
+#ifndef LOX_LEXEME_TABLE_HPP
+#define LOX_LEXEME_TABLE_HPP
+
+#include <lak/string.hpp>
+#include <lak/string_view.hpp>
+
+#include <functional>
+#include <string_view>
+#include <unordered_set>
+
+namespace lox
+{
+	// Owns one copy of each distinct lexeme, so that tokens remain valid after
+	// the scanner's window has moved past the text they came from.
+	struct lexeme_table
+	{
+		struct hash
+		{
+			using is_transparent = void;
+
+			size_t operator()(lak::u8string_view str) const
+			{
+				return std::hash<std::u8string_view>{}(
+				  std::u8string_view(str.data(), str.size()));
+			}
+			size_t operator()(const lak::u8string &str) const
+			{
+				return (*this)(lak::u8string_view(str));
+			}
+		};
+
+		struct equal
+		{
+			using is_transparent = void;
+
+			bool operator()(lak::u8string_view lhs, lak::u8string_view rhs) const
+			{
+				return lhs == rhs;
+			}
+		};
+
+		std::unordered_set<lak::u8string, hash, equal> lexemes;
+
+		// the returned string is valid for the lifetime of the table.
+		const lak::u8string &intern(lak::u8string_view lexeme);
+	};
+}
+
+#endif
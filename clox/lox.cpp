@@ -4,6 +4,22 @@
 
 int lox::usage()
 {
-	std::cerr << "Usage: clox [script]\n";
+	std::cerr << "Usage: clox [--no-cache] [--cache-stats] [--alloc-stats]\n"
+	             "            [script[.loxc]]\n"
+	             "       clox --compile script [-o script.loxc]\n"
+	             "       clox --bundle [--threads n] (script | @manifest)...\n"
+	             "       clox --runs m [--threads n] script\n"
+	             "       clox --opt-report script\n"
+	             "       clox --dump-ir script\n"
+	             "Any of these may be given --backend (stack | register) to "
+	             "choose how scripts\nare compiled, stack is the default, "
+	             "--opt-level (0 | 1 | 2 | 3) to choose how\nmuch they are "
+	             "optimised, 3 is the default, and --ir-budget n to limit how "
+	             "many\nbytes of bytecode per script -O3 puts through the IR "
+	             "passes.\n";
+#ifdef LOX_JIT
+	std::cerr << "--jit-threshold n compiles functions to native code after n "
+	             "calls and loop\niterations, 0 never does.\n";
+#endif
 	return EXIT_FAILURE;
 }
@@ -1,40 +1,392 @@
 #include "chunk.hpp"
 #include "compiler.hpp"
+#include "ir.hpp"
 #include "lox.hpp"
+#include "optimiser.hpp"
+#include "output.hpp"
+#include "parallel.hpp"
+#include "program.hpp"
 #include "virtual_machine.hpp"
 
 #include <lak/string_literals.hpp>
 #include <lak/string_ostream.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
-int main(int argc, char *argv[])
+// compile file once, then run it runs times across a pool of threads. each
+// run gets a fresh VM with its output discarded.
+int run_stress(const std::filesystem::path &file,
+               size_t runs,
+               size_t thread_count,
+               const lox::compile_options &options)
+{
+	using lak::operator<<;
+
+	std::ifstream strm(file, std::ios::binary);
+	if (!strm)
+	{
+		std::cerr << "Failed to read file '" << file.string() << "'.\n";
+		return EXIT_FAILURE;
+	}
+
+	lox::program_result<lox::program> compiled =
+	  lox::program::compile(strm, options);
+	if_let_err (const lox::program_error &err, compiled)
+	{
+		err.visit(lak::overloaded{
+		  []<typename T>(const lox::positional_error<T> &err)
+		  { std::cerr << lox::to_string(err) << "\n"; },
+		  [](const lox::bytecode_error &err)
+		  { std::cerr << lox::to_string(err) << "\n"; },
+		});
+		return EXIT_FAILURE;
+	}
+	const lox::program program = lak::move(compiled).unwrap();
+
+	if (thread_count == 0U)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+
+	std::atomic_size_t failures = 0U;
+	auto run                    = [&](size_t)
+	{
+		std::ostringstream strm;
+		lox::ostream_sink sink{strm};
+		lox::output out{sink};
+		lox::virtual_machine vm;
+		vm.out = &out;
+		vm.init_globals();
+		if (vm.run_program(program).is_err()) ++failures;
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	lox::parallel_for(runs, thread_count, run);
+	const std::chrono::duration<double> elapsed =
+	  std::chrono::steady_clock::now() - start;
+
+	std::cerr << runs << " runs on " << thread_count << " threads in "
+	          << elapsed.count() << "s (" << (runs / elapsed.count())
+	          << " scripts/s)\n";
+
+	if (failures > 0U)
+	{
+		std::cerr << failures << " runs failed\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// compile file at every optimisation level and print how many of each opcode
+// the script ends up with.
+int opt_report(const std::filesystem::path &file,
+               lox::compile_options options)
+{
+	using lak::operator<<;
+
+	std::vector<std::vector<size_t>> counts;
+	for (uint8_t level = 0U; level <= lox::max_opt_level; ++level)
+	{
+		std::ifstream strm(file, std::ios::binary);
+		if (!strm)
+		{
+			std::cerr << "Failed to read file '" << file.string() << "'.\n";
+			return EXIT_FAILURE;
+		}
+
+		lox::global_table globals;
+		options.opt_level = level;
+		lox::compile_result<lox::function_ptr> compiled =
+		  lox::compile(strm, globals, options);
+		if_let_err (const auto &err, compiled)
+		{
+			err.visit([]<typename T>(const lox::positional_error<T> &err)
+			          { std::cerr << lox::to_string(err) << "\n"; });
+			return EXIT_FAILURE;
+		}
+
+		counts.emplace_back(lox::opcode_count, 0U);
+		lox::count_opcodes(*lak::move(compiled).unwrap(), counts.back());
+	}
+
+	std::cout << "== opcodes at -O0..-O" << unsigned(lox::max_opt_level)
+	          << " ==\n";
+	std::vector<size_t> totals(counts.size(), 0U);
+	for (size_t op = 0U; op < lox::opcode_count; ++op)
+	{
+		if (std::all_of(counts.begin(),
+		                counts.end(),
+		                [&](const auto &level) { return level[op] == 0U; }))
+			continue;
+		for (size_t level = 0U; level < counts.size(); ++level)
+		{
+			std::cout << std::setw(8) << counts[level][op];
+			totals[level] += counts[level][op];
+		}
+		std::cout << " " << lox::to_string(static_cast<lox::opcode>(op)) << "\n";
+	}
+	for (const size_t total : totals) std::cout << std::setw(8) << total;
+	std::cout << " total\n";
+
+	return EXIT_SUCCESS;
+}
+
+// compile file as the parser emits it and print the IR of each function, as
+// -O3 would see it.
+int dump_ir(const std::filesystem::path &file)
 {
-	if (argc > 3) return lox::usage();
+	std::ifstream strm(file, std::ios::binary);
+	if (!strm)
+	{
+		std::cerr << "Failed to read file '" << file.string() << "'.\n";
+		return EXIT_FAILURE;
+	}
+
+	lox::global_table globals;
+	lox::compile_result<lox::function_ptr> compiled =
+	  lox::compile(strm, globals, {.opt_level = 0U});
+	if_let_err (const auto &err, compiled)
+	{
+		err.visit([]<typename T>(const lox::positional_error<T> &err)
+		          { std::cerr << lox::to_string(err) << "\n"; });
+		return EXIT_FAILURE;
+	}
 
+	lox::dump_ir(std::cout, *lak::move(compiled).unwrap());
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
 	lak::optional<std::filesystem::path> file;
+	lak::optional<std::filesystem::path> output;
+	std::vector<std::filesystem::path> bundle;
+	lox::compile_options options;
+	size_t thread_count  = 0U;
+	size_t runs          = 0U;
+#ifdef LOX_JIT
+	size_t jit_threshold = LOX_JIT_THRESHOLD;
+#endif
+	bool bundle_mode     = false;
+	bool compile_only    = false;
+	bool use_cache       = true;
+	bool cache_stats     = false;
+	bool alloc_stats     = false;
+	bool report_opt      = false;
+	bool print_ir        = false;
 
-	while (argc-- > 1)
+	for (int i = 1; i < argc; ++i)
 	{
-		const auto arg{lak::astring_view::from_c_str(argv[argc])};
+		const auto arg{lak::astring_view::from_c_str(argv[i])};
 		if (arg == "--help"_view)
 		{
 			lox::usage();
 			return EXIT_SUCCESS;
 		}
+		else if (arg == "--compile"_view)
+		{
+			compile_only = true;
+		}
+		else if (arg == "--no-cache"_view)
+		{
+			use_cache = false;
+		}
+		else if (arg == "--cache-stats"_view)
+		{
+			cache_stats = true;
+		}
+		else if (arg == "--alloc-stats"_view)
+		{
+			alloc_stats = true;
+		}
+		else if (arg == "--bundle"_view)
+		{
+			bundle_mode = true;
+		}
+		else if (arg == "--threads"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto count{lak::astring_view::from_c_str(argv[i])};
+			if (std::from_chars(count.begin(), count.end(), thread_count).ec !=
+			    std::errc())
+				return lox::usage();
+		}
+		else if (arg == "--backend"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto name{lak::astring_view::from_c_str(argv[i])};
+			if (name == "stack"_view)
+				options.backend = lox::backend::stack;
+			else if (name == "register"_view)
+				options.backend = lox::backend::registers;
+			else
+				return lox::usage();
+		}
+		else if (arg == "--opt-level"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto level{lak::astring_view::from_c_str(argv[i])};
+			if (std::from_chars(level.begin(), level.end(), options.opt_level)
+			        .ec != std::errc() ||
+			    options.opt_level > lox::max_opt_level)
+				return lox::usage();
+		}
+		else if (arg == "--ir-budget"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto budget{lak::astring_view::from_c_str(argv[i])};
+			if (std::from_chars(budget.begin(), budget.end(), options.ir_budget)
+			      .ec != std::errc())
+				return lox::usage();
+		}
+		else if (arg == "--opt-report"_view)
+		{
+			report_opt = true;
+		}
+		else if (arg == "--dump-ir"_view)
+		{
+			print_ir = true;
+		}
+#ifdef LOX_JIT
+		else if (arg == "--jit-threshold"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto count{lak::astring_view::from_c_str(argv[i])};
+			if (std::from_chars(count.begin(), count.end(), jit_threshold).ec !=
+			    std::errc())
+				return lox::usage();
+		}
+#endif
+		else if (arg == "--runs"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto count{lak::astring_view::from_c_str(argv[i])};
+			if (std::from_chars(count.begin(), count.end(), runs).ec !=
+			      std::errc() ||
+			    runs == 0U)
+				return lox::usage();
+		}
+		else if (arg == "-o"_view)
+		{
+			if (++i == argc) return lox::usage();
+			output = lak::astring(lak::astring_view::from_c_str(argv[i]));
+		}
+		else if (bundle_mode && !arg.empty() && arg[0] == '@')
+		{
+			const std::filesystem::path manifest{lak::astring(arg.substr(1))};
+			if_let_ok (const std::vector<std::filesystem::path> &files,
+			           lox::read_manifest(manifest))
+			{
+				bundle.insert(bundle.end(), files.begin(), files.end());
+			}
+			else
+			{
+				std::cerr << "Failed to read manifest '" << manifest.string()
+				          << "'.\n";
+				return EXIT_FAILURE;
+			}
+		}
+		else if (bundle_mode)
+		{
+			bundle.push_back(lak::astring(arg));
+		}
+		else if (file)
+		{
+			return lox::usage();
+		}
 		else
 		{
 			file = lak::astring(arg);
 		}
 	}
 
+	if (output && !compile_only) return lox::usage();
+	if (bundle_mode && (compile_only || bundle.empty())) return lox::usage();
+	if (runs > 0U && (bundle_mode || compile_only || !file))
+		return lox::usage();
+	if (report_opt && (bundle_mode || compile_only || runs > 0U || !file))
+		return lox::usage();
+	if (print_ir && (bundle_mode || compile_only || runs > 0U || !file))
+		return lox::usage();
+
+	if (runs > 0U) return run_stress(*file, runs, thread_count, options);
+
+	if (report_opt) return opt_report(*file, options);
+
+	if (print_ir) return dump_ir(*file);
+
+	if (compile_only)
+	{
+		if (!file) return lox::usage();
+		if (!output)
+			output = std::filesystem::path(*file).replace_extension(".loxc");
+	}
+
 	lox::virtual_machine vm;
+	vm.init_globals();
+	vm.options = options;
+#ifdef LOX_JIT
+	vm.jit_threshold = jit_threshold;
+#endif
+	if (use_cache && !compile_only)
+		vm.cache = lox::compile_cache::make_default();
 
 	using lak::operator<<;
 
-	if (file)
+	if (bundle_mode)
 	{
-		return vm.run_file(*file).visit(lak::overloaded{
+		lox::virtual_machine::run_bundle_result result =
+		  vm.run_bundle(bundle, thread_count);
+
+		// keep what the script printed ahead of any error
+		lox::standard_output().flush();
+
+		return result.visit(lak::overloaded{
+		  [](lak::monostate) -> int { return EXIT_SUCCESS; },
+		  [](const lox::virtual_machine::run_bundle_error &err) -> int
+		  {
+			  err.visit(lak::overloaded{
+			    [](const lox::bundle_error &err)
+			    {
+				    std::cerr << err.file.string() << ": ";
+				    err.error.visit(lak::overloaded{
+				      [](const lak::errno_error &err) { std::cerr << err << "\n"; },
+				      []<typename T>(const lox::positional_error<T> &err)
+				      { std::cerr << lox::to_string(err) << "\n"; },
+				    });
+			    },
+			    []<typename T>(const lox::positional_error<T> &err)
+			    { std::cerr << lox::to_string(err) << "\n"; },
+			  });
+			  return EXIT_FAILURE;
+		  },
+		});
+	}
+	else if (file)
+	{
+		lox::virtual_machine::run_file_result result =
+		  compile_only ? vm.compile_file(*file, *output) : vm.run_file(*file);
+
+		lox::standard_output().flush();
+
+#ifdef LOX_PROFILE_OPCODES
+		vm.profile.report(std::cerr);
+#endif
+
+		if (cache_stats && vm.cache)
+			std::cerr << "cache: " << vm.cache->hits << " hits, "
+			          << vm.cache->misses << " misses\n";
+
+		if (alloc_stats) std::cerr << lox::object_counts::current();
+
+		return result.visit(lak::overloaded{
 		  [](lak::monostate) -> int { return EXIT_SUCCESS; },
 		  [](const lox::virtual_machine::run_file_error &err) -> int
 		  {
@@ -49,6 +401,11 @@ int main(int argc, char *argv[])
 				    std::cerr << lox::to_string(err) << "\n";
 				    return EXIT_FAILURE;
 			    },
+			    [](const lox::bytecode_error &err) -> int
+			    {
+				    std::cerr << lox::to_string(err) << "\n";
+				    return EXIT_FAILURE;
+			    },
 			  });
 		  },
 		});
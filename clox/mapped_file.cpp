@@ -0,0 +1,153 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <Windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <utility>
+
+lox::mapped_file::mapped_file(mapped_file &&other)
+: _data(std::exchange(other._data, nullptr)),
+  _size(std::exchange(other._size, 0U))
+#ifdef _WIN32
+  ,
+  _file(std::exchange(other._file, nullptr)),
+  _mapping(std::exchange(other._mapping, nullptr))
+#endif
+{
+}
+
+lox::mapped_file &lox::mapped_file::operator=(mapped_file &&other)
+{
+	std::swap(_data, other._data);
+	std::swap(_size, other._size);
+#ifdef _WIN32
+	std::swap(_file, other._file);
+	std::swap(_mapping, other._mapping);
+#endif
+	return *this;
+}
+
+lox::mapped_file::~mapped_file()
+{
+	close();
+}
+
+#ifdef _WIN32
+static int win32_errno(DWORD error)
+{
+	switch (error)
+	{
+		case ERROR_FILE_NOT_FOUND: [[fallthrough]];
+		case ERROR_PATH_NOT_FOUND: return ENOENT;
+		case ERROR_ACCESS_DENIED: return EACCES;
+		case ERROR_NOT_ENOUGH_MEMORY: return ENOMEM;
+		default: return EIO;
+	}
+}
+
+void lox::mapped_file::close()
+{
+	if (_data) UnmapViewOfFile(_data);
+	if (_mapping) CloseHandle(_mapping);
+	if (_file) CloseHandle(_file);
+	_data    = nullptr;
+	_size    = 0U;
+	_mapping = nullptr;
+	_file    = nullptr;
+}
+
+lak::result<lox::mapped_file, lak::errno_error> lox::mapped_file::open(
+  const std::filesystem::path &path)
+{
+	mapped_file result;
+
+	HANDLE file = CreateFileW(path.c_str(),
+	                          GENERIC_READ,
+	                          FILE_SHARE_READ,
+	                          nullptr,
+	                          OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL,
+	                          nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return lak::err_t{lak::errno_error{win32_errno(GetLastError())}};
+	result._file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+		return lak::err_t{lak::errno_error{win32_errno(GetLastError())}};
+	result._size = static_cast<size_t>(size.QuadPart);
+
+	// empty files cannot be mapped
+	if (result._size == 0U) return lak::move_ok(result);
+
+	HANDLE mapping =
+	  CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+		return lak::err_t{lak::errno_error{win32_errno(GetLastError())}};
+	result._mapping = mapping;
+
+	result._data = static_cast<const byte_t *>(
+	  MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!result._data)
+		return lak::err_t{lak::errno_error{win32_errno(GetLastError())}};
+
+	return lak::move_ok(result);
+}
+#else
+void lox::mapped_file::close()
+{
+	if (_data) munmap(const_cast<byte_t *>(_data), _size);
+	_data = nullptr;
+	_size = 0U;
+}
+
+lak::result<lox::mapped_file, lak::errno_error> lox::mapped_file::open(
+  const std::filesystem::path &path)
+{
+	mapped_file result;
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return lak::err_t{lak::errno_error{errno}};
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		const int error = errno;
+		::close(fd);
+		return lak::err_t{lak::errno_error{error}};
+	}
+
+	// empty files cannot be mapped
+	if (st.st_size == 0)
+	{
+		::close(fd);
+		return lak::move_ok(result);
+	}
+
+	void *data = mmap(
+	  nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	const int error = errno;
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	if (data == MAP_FAILED) return lak::err_t{lak::errno_error{error}};
+
+	result._data = static_cast<const byte_t *>(data);
+	result._size = static_cast<size_t>(st.st_size);
+
+	return lak::move_ok(result);
+}
+#endif
+
+lak::span<const byte_t> lox::mapped_file::data() const
+{
+	return lak::span<const byte_t>(_data, _size);
+}
@@ -0,0 +1,42 @@
+#ifndef LOX_MAPPED_FILE_HPP
+#define LOX_MAPPED_FILE_HPP
+
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <filesystem>
+
+namespace lox
+{
+	// A read-only memory mapping of an entire file. The mapping is released
+	// when the mapped_file is destroyed, so anything pointing into data() must
+	// not outlive it.
+	struct mapped_file
+	{
+	private:
+		const byte_t *_data = nullptr;
+		size_t _size        = 0U;
+#ifdef _WIN32
+		void *_file    = nullptr;
+		void *_mapping = nullptr;
+#endif
+
+		void close();
+
+	public:
+		mapped_file() = default;
+		mapped_file(const mapped_file &) = delete;
+		mapped_file &operator=(const mapped_file &) = delete;
+		mapped_file(mapped_file &&other);
+		mapped_file &operator=(mapped_file &&other);
+		~mapped_file();
+
+		static lak::result<mapped_file, lak::errno_error> open(
+		  const std::filesystem::path &path);
+
+		lak::span<const byte_t> data() const;
+	};
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LOX_NATIVE_HPP
+#define LOX_NATIVE_HPP
+
+#include "value.hpp"
+
+#include <lak/debug.hpp>
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/string.hpp>
+#include <lak/tuple.hpp>
+#include <lak/type_traits.hpp>
+
+namespace lox
+{
+	struct virtual_machine;
+
+	// errors are reported as runtime errors at the call site.
+	using native_result = lak::result<lox::value, lak::u8string>;
+
+	// arguments is a window directly into the VM stack, it is only valid for
+	// the duration of the call.
+	using native_function_ptr_t =
+	  lox::native_result (*)(lox::virtual_machine &,
+	                         lak::span<const lox::value> arguments);
+
+	template<typename FUNC>
+	struct function_signature;
+
+	template<typename R, typename... ARGS>
+	struct function_signature<R (*)(ARGS...)>
+	{
+		using return_type                      = R;
+		using arguments                        = lak::tuple<ARGS...>;
+		static constexpr size_t argument_count = sizeof...(ARGS);
+	};
+
+	template<typename R, typename... ARGS>
+	struct function_signature<R(ARGS...)>
+	{
+		using return_type                      = R;
+		using arguments                        = lak::tuple<ARGS...>;
+		static constexpr size_t argument_count = sizeof...(ARGS);
+	};
+
+	template<typename FUNC>
+	using function_return_t = typename function_signature<FUNC>::return_type;
+
+	template<typename FUNC>
+	using function_arguments_t = typename function_signature<FUNC>::arguments;
+
+	template<typename FUNC>
+	inline constexpr size_t function_argument_count_v =
+	  function_signature<FUNC>::argument_count;
+
+	template<typename... ARGS>
+	using native_callable_ptr_t =
+	  lox::native_result (*)(lox::virtual_machine &, ARGS...);
+
+	template<typename... ARGS, size_t... I>
+	inline lox::native_result call_native(
+	  native_callable_ptr_t<ARGS...> function,
+	  lox::virtual_machine &vm,
+	  lak::span<const lox::value> arguments,
+	  lak::index_sequence<I...>)
+	{
+		static_assert(sizeof...(ARGS) == sizeof...(I));
+		static_assert((lak::is_same_v<ARGS, const lox::value &> && ...),
+		              "Native arguments must be const lox::value &");
+		ASSERT_EQUAL(sizeof...(ARGS), arguments.size());
+		return function(vm, arguments[I]...);
+	}
+}
+
+#define LOX_NATIVE_MAKE(NAME, ...)                                            \
+	::lox::native::make(                                                        \
+	  NAME,                                                                     \
+	  [](::lox::virtual_machine &vm,                                            \
+	     ::lak::span<const ::lox::value> arguments) -> ::lox::native_result     \
+	  {                                                                         \
+			using arguments_t = ::lox::function_arguments_t<decltype(__VA_ARGS__)>; \
+			constexpr size_t argument_count =                                       \
+			  ::lox::function_argument_count_v<decltype(__VA_ARGS__)>;              \
+			static_assert(argument_count >= 1, "Requires at least 1 argument");     \
+			static_assert(                                                          \
+			  ::lak::is_same_v<                                                     \
+			    ::lak::remove_cvref_t<::lak::tuple_element_t<0, arguments_t>>,      \
+			    ::lox::virtual_machine>,                                            \
+			  "First argument must be a virtual machine");                          \
+			return ::lox::call_native(                                              \
+			  (__VA_ARGS__),                                                        \
+			  vm,                                                                   \
+			  arguments,                                                            \
+			  ::lak::make_index_sequence<argument_count - 1>{});                    \
+	  },                                                                        \
+	  ::lox::function_argument_count_v<decltype(__VA_ARGS__)> - 1)
+
+#endif
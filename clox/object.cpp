@@ -0,0 +1,158 @@
+#include "object.hpp"
+
+#include <lak/string_ostream.hpp>
+
+/* --- object_counts --- */
+
+lox::object_counts &lox::object_counts::current()
+{
+	thread_local lox::object_counts counts;
+	return counts;
+}
+
+std::ostream &lox::operator<<(std::ostream &strm,
+                              const lox::object_counts &counts)
+{
+	return strm << "string: " << counts.strings << " made\n"
+	            << "function: " << counts.functions << " made\n"
+	            << "upvalue: " << counts.upvalues << " made\n"
+	            << "closure: " << counts.closures << " made\n"
+	            << "type: " << counts.types << " made\n"
+	            << "instance: " << counts.instances << " made\n"
+	            << "bound_method: " << counts.bound_methods << " made\n"
+	            << "native: " << counts.natives << " made\n";
+}
+
+/* --- string --- */
+
+lox::string_ptr lox::string::make(lak::u8string_view str)
+{
+	++lox::object_counts::current().strings;
+	return lox::string_ptr::make(lox::string{.value = str.to_string()}).unwrap();
+}
+
+lox::string_ptr lox::string::make(lak::u8string &&str)
+{
+	++lox::object_counts::current().strings;
+	return lox::string_ptr::make(lox::string{.value = lak::move(str)}).unwrap();
+}
+
+/* --- function --- */
+
+lox::function_ptr lox::function::make(lak::u8string_view name)
+{
+	++lox::object_counts::current().functions;
+	return lox::function_ptr::make(lox::function{.name = name.to_string()})
+	  .unwrap();
+}
+
+std::ostream &lox::operator<<(std::ostream &strm, const lox::function &func)
+{
+	using lak::operator<<;
+	if (func.name.empty())
+		return strm << "<script>";
+	else
+		return strm << "<fn " << func.name << ">";
+}
+
+/* --- upvalue --- */
+
+lox::upvalue_ptr lox::upvalue::make(lox::value *slot)
+{
+	++lox::object_counts::current().upvalues;
+	return lox::upvalue_ptr::make(lox::upvalue{.location = slot, .closed = {}})
+	  .unwrap();
+}
+
+void lox::upvalue::close()
+{
+	closed   = *location;
+	location = &closed;
+}
+
+/* --- closure --- */
+
+lox::closure_ptr lox::closure::make(lox::function_ptr func)
+{
+	++lox::object_counts::current().closures;
+	std::vector<lox::upvalue_ptr> upvalues;
+	upvalues.reserve(func->upvalue_count);
+	return lox::closure_ptr::make(
+	         lox::closure{
+	           .function = lak::move(func),
+	           .upvalues = lak::move(upvalues),
+	         })
+	  .unwrap();
+}
+
+/* --- type --- */
+
+lox::type_ptr lox::type::make(lak::u8string_view name)
+{
+	++lox::object_counts::current().types;
+	return lox::type_ptr::make(lox::type{
+	                             .name    = name.to_string(),
+	                             .methods = {},
+	                           })
+	  .unwrap();
+}
+
+lak::result<const lox::closure_ptr &> lox::type::find_method(
+  const lak::u8string &method_name) const
+{
+	if (auto iter = methods.find(method_name); iter != methods.end())
+		return lak::ok_t<const lox::closure_ptr &>{iter->second};
+	return lak::err_t{};
+}
+
+std::ostream &lox::operator<<(std::ostream &strm, const lox::type &type)
+{
+	using lak::operator<<;
+	return strm << type.name;
+}
+
+/* --- instance --- */
+
+lox::instance_ptr lox::instance::make(lox::type_ptr type)
+{
+	++lox::object_counts::current().instances;
+	return lox::instance_ptr::make(lox::instance{
+	                                 .type   = lak::move(type),
+	                                 .fields = {},
+	                               })
+	  .unwrap();
+}
+
+std::ostream &lox::operator<<(std::ostream &strm, const lox::instance &inst)
+{
+	using lak::operator<<;
+	return strm << inst.type->name << " instance";
+}
+
+/* --- bound_method --- */
+
+lox::bound_method_ptr lox::bound_method::make(lox::value receiver,
+                                              lox::closure_ptr method)
+{
+	++lox::object_counts::current().bound_methods;
+	return lox::bound_method_ptr::make(lox::bound_method{
+	                                     .receiver = lak::move(receiver),
+	                                     .method   = lak::move(method),
+	                                   })
+	  .unwrap();
+}
+
+/* --- native --- */
+
+lox::native_ptr lox::native::make(lak::u8string_view name,
+                                  lox::native_function_ptr_t function,
+                                  size_t arity)
+{
+	++lox::object_counts::current().natives;
+	return lox::native_ptr::make(lox::native{
+	                               .name     = name.to_string(),
+	                               .function = function,
+	                               .arity    = arity,
+	                             })
+	  .unwrap();
+}
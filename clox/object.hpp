@@ -0,0 +1,147 @@
+#ifndef LOX_OBJECT_HPP
+#define LOX_OBJECT_HPP
+
+#include "chunk.hpp"
+#include "jit.hpp"
+#include "native.hpp"
+#include "value.hpp"
+
+#include <lak/memory.hpp>
+#include <lak/optional.hpp>
+#include <lak/string.hpp>
+#include <lak/string_view.hpp>
+
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace lox
+{
+	/* --- object_counts --- */
+
+	// How many objects of each kind have been made on this thread.
+	struct object_counts
+	{
+		size_t strings       = 0U;
+		size_t functions     = 0U;
+		size_t upvalues      = 0U;
+		size_t closures      = 0U;
+		size_t types         = 0U;
+		size_t instances     = 0U;
+		size_t bound_methods = 0U;
+		size_t natives       = 0U;
+
+		static lox::object_counts &current();
+	};
+
+	std::ostream &operator<<(std::ostream &strm,
+	                         const lox::object_counts &counts);
+
+	/* --- string --- */
+
+	struct string
+	{
+		lak::u8string value;
+
+		static lox::string_ptr make(lak::u8string_view str);
+
+		static lox::string_ptr make(lak::u8string &&str);
+	};
+
+	/* --- function --- */
+
+	struct function
+	{
+		size_t arity         = 0U;
+		size_t upvalue_count = 0U;
+		lox::chunk chunk     = {};
+		lak::u8string name   = {};
+
+#ifdef LOX_JIT
+		// counts towards virtual_machine::jit_threshold until jit is set.
+		size_t hotness                   = 0U;
+		lak::optional<lox::jit_code> jit = {};
+#endif
+
+		static lox::function_ptr make(lak::u8string_view name);
+	};
+
+	std::ostream &operator<<(std::ostream &strm, const lox::function &func);
+
+	/* --- upvalue --- */
+
+	struct upvalue
+	{
+		// points into the VM stack while open, or at closed once the variable
+		// has gone out of scope.
+		lox::value *location;
+		lox::value closed;
+
+		static lox::upvalue_ptr make(lox::value *slot);
+
+		void close();
+	};
+
+	/* --- closure --- */
+
+	struct closure
+	{
+		lox::function_ptr function;
+		std::vector<lox::upvalue_ptr> upvalues;
+
+		static lox::closure_ptr make(lox::function_ptr func);
+	};
+
+	/* --- type --- */
+
+	struct type
+	{
+		lak::u8string name;
+		std::unordered_map<lak::u8string, lox::closure_ptr> methods;
+
+		static lox::type_ptr make(lak::u8string_view name);
+
+		lak::result<const lox::closure_ptr &> find_method(
+		  const lak::u8string &method_name) const;
+	};
+
+	std::ostream &operator<<(std::ostream &strm, const lox::type &type);
+
+	/* --- instance --- */
+
+	struct instance
+	{
+		lox::type_ptr type;
+		std::unordered_map<lak::u8string, lox::value> fields;
+
+		static lox::instance_ptr make(lox::type_ptr type);
+	};
+
+	std::ostream &operator<<(std::ostream &strm, const lox::instance &inst);
+
+	/* --- bound_method --- */
+
+	struct bound_method
+	{
+		lox::value receiver;
+		lox::closure_ptr method;
+
+		static lox::bound_method_ptr make(lox::value receiver,
+		                                  lox::closure_ptr method);
+	};
+
+	/* --- native --- */
+
+	struct native
+	{
+		lak::u8string name;
+		lox::native_function_ptr_t function;
+		size_t arity;
+
+		static lox::native_ptr make(lak::u8string_view name,
+		                            lox::native_function_ptr_t function,
+		                            size_t arity);
+	};
+}
+
+#endif
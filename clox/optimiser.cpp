@@ -0,0 +1,201 @@
+#include "optimiser.hpp"
+#include "rewrite.hpp"
+
+#include <lak/debug.hpp>
+#include <lak/optional.hpp>
+
+// the longest chain of jumps that will be followed.
+constexpr size_t max_jump_chain = 8U;
+
+void thread_jumps(lox::chunk &chunk)
+{
+	for (size_t offset = 0U; offset < chunk.code.size();
+	     offset        = chunk.next_instruction(offset))
+	{
+		const auto op = static_cast<lox::opcode>(chunk.code[offset]);
+		if (op != lox::opcode::OP_JUMP && op != lox::opcode::OP_JUMP_IF_FALSE)
+			continue;
+
+		const size_t start = *chunk.jump_target(offset);
+		size_t target      = start;
+		for (size_t i = 0U; i < max_jump_chain && target < chunk.code.size();
+		     ++i)
+		{
+			// JUMP_IF_FALSE doesn't pop the condition, so a second one is certain
+			// to jump as well.
+			const auto next = static_cast<lox::opcode>(chunk.code[target]);
+			if (next == lox::opcode::OP_JUMP || next == lox::opcode::OP_LOOP ||
+			    (op == lox::opcode::OP_JUMP_IF_FALSE &&
+			     next == lox::opcode::OP_JUMP_IF_FALSE))
+				target = *chunk.jump_target(target);
+			else
+				break;
+		}
+		if (target == start) continue;
+
+		// only OP_JUMP has a backwards form
+		const bool forwards = target > offset;
+		if (!forwards && op != lox::opcode::OP_JUMP) continue;
+
+		const size_t jump =
+		  forwards ? target - (offset + 3U) : (offset + 3U) - target;
+		if (jump > UINT16_MAX) continue;
+
+		chunk.code[offset] = static_cast<uint8_t>(
+		  forwards ? op : lox::opcode::OP_LOOP);
+		chunk.code[offset + 1U] = static_cast<uint8_t>((jump >> 8) & 0xFF);
+		chunk.code[offset + 2U] = static_cast<uint8_t>(jump & 0xFF);
+	}
+}
+
+std::vector<bool> reachable_instructions(const lox::chunk &chunk)
+{
+	std::vector<bool> result(chunk.code.size(), false);
+	std::vector<size_t> pending = {0U};
+	while (!pending.empty())
+	{
+		const size_t offset = pending.back();
+		pending.pop_back();
+		if (offset >= chunk.code.size() || result[offset]) continue;
+		result[offset] = true;
+
+		if (const lak::optional<size_t> target = chunk.jump_target(offset);
+		    target)
+			pending.push_back(*target);
+
+		switch (static_cast<lox::opcode>(chunk.code[offset]))
+		{
+			case lox::opcode::OP_JUMP: [[fallthrough]];
+			case lox::opcode::OP_LOOP: [[fallthrough]];
+			case lox::opcode::OP_RETURN: break;
+			default: pending.push_back(chunk.next_instruction(offset)); break;
+		}
+	}
+	return result;
+}
+
+// constants is the chunk being rewritten, new constants are added to it.
+lak::optional<size_t> peephole(const lox::chunk &chunk,
+                               lox::chunk &constants,
+                               const std::vector<bool> &reachable,
+                               size_t offset,
+                               const std::vector<bool> &is_target,
+                               lox::chunk &out)
+{
+	const size_t next = chunk.next_instruction(offset);
+
+	if (!reachable[offset]) return next;
+
+	auto op_at = [&](size_t at) -> lak::optional<lox::opcode>
+	{
+		if (at >= chunk.code.size()) return lak::nullopt;
+		return static_cast<lox::opcode>(chunk.code[at]);
+	};
+	// the instruction at next, if this one runs straight into it.
+	const lak::optional<lox::opcode> following =
+	  next < chunk.code.size() && !is_target[next] ? op_at(next)
+	                                               : lak::nullopt;
+	auto followed_by = [&](lox::opcode op)
+	{ return following && *following == op; };
+
+	switch (static_cast<lox::opcode>(chunk.code[offset]))
+	{
+		case lox::opcode::OP_CONSTANT:
+			if (followed_by(lox::opcode::OP_POP)) return next + 1U;
+			if (followed_by(lox::opcode::OP_NEGATE))
+			{
+				if_let_ok (const double d,
+				           chunk.constants[chunk.code[offset + 1U]].as_number())
+				{
+					if (const lak::optional<uint8_t> negated =
+					      constants.number_constant(-d);
+					    negated)
+					{
+						out.push_opcode(lox::opcode::OP_CONSTANT, chunk.lines[next]);
+						out.push_code(*negated, chunk.lines[next]);
+						return next + 1U;
+					}
+				}
+			}
+			return lak::nullopt;
+
+		case lox::opcode::OP_NIL: [[fallthrough]];
+		case lox::opcode::OP_TRUE: [[fallthrough]];
+		case lox::opcode::OP_FALSE:
+			if (followed_by(lox::opcode::OP_POP)) return next + 1U;
+			if (followed_by(lox::opcode::OP_NOT))
+			{
+				const bool truthy =
+				  chunk.code[offset] == uint8_t(lox::opcode::OP_TRUE);
+				out.push_opcode(
+				  truthy ? lox::opcode::OP_FALSE : lox::opcode::OP_TRUE,
+				  chunk.lines[next]);
+				return next + 1U;
+			}
+			return lak::nullopt;
+
+		case lox::opcode::OP_GET_LOCAL: [[fallthrough]];
+		case lox::opcode::OP_GET_UPVALUE:
+			if (followed_by(lox::opcode::OP_POP)) return next + 1U;
+			return lak::nullopt;
+
+		case lox::opcode::OP_NOT:
+			if (followed_by(lox::opcode::OP_NOT))
+			{
+				// the instruction after the pair may be jumped to, the pair is
+				// only skipped on the way in.
+				const lak::optional<lox::opcode> after = op_at(next + 1U);
+				if (after && (*after == lox::opcode::OP_NOT ||
+				              *after == lox::opcode::OP_JUMP_IF_FALSE))
+					return next + 1U;
+			}
+			return lak::nullopt;
+
+		case lox::opcode::OP_JUMP:
+			if (*chunk.jump_target(offset) == next) return next;
+			return lak::nullopt;
+
+		default: return lak::nullopt;
+	}
+}
+
+void lox::optimise(lox::chunk &chunk)
+{
+	thread_jumps(chunk);
+
+	// each rewrite can expose another, e.g. a folded negation that's popped.
+	for (size_t size = 0U; size != chunk.code.size();)
+	{
+		size                              = chunk.code.size();
+		const std::vector<bool> reachable = reachable_instructions(chunk);
+		lox::rewrite_chunk(chunk,
+		                   [&](const lox::chunk &source,
+		                       size_t offset,
+		                       const std::vector<bool> &is_target,
+		                       lox::chunk &out)
+		                   {
+			                   return peephole(source,
+			                                   chunk,
+			                                   reachable,
+			                                   offset,
+			                                   is_target,
+			                                   out);
+		                   });
+	}
+}
+
+void lox::count_opcodes(const lox::function &func, std::vector<size_t> &counts)
+{
+	ASSERT_EQUAL(counts.size(), lox::opcode_count);
+
+	const lox::chunk &chunk = func.chunk;
+	for (size_t offset = 0U; offset < chunk.code_size();
+	     offset        = chunk.next_instruction(offset))
+		++counts[chunk.code_at(offset)];
+
+	for (const lox::value &constant : chunk.constants)
+	{
+		if_let_ok (const lox::function_ptr &inner, constant.as_function())
+			lox::count_opcodes(*inner, counts);
+	}
+}
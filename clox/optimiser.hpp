@@ -0,0 +1,30 @@
+#ifndef LOX_OPTIMISER_HPP
+#define LOX_OPTIMISER_HPP
+
+#include "chunk.hpp"
+#include "object.hpp"
+
+#include <lak/stdint.hpp>
+
+#include <vector>
+
+namespace lox
+{
+	// Cleans up the parser's bytecode:
+	// - jumps to a jump (or a JUMP_IF_FALSE to another) go straight to the
+	//   final target.
+	// - instructions that nothing can reach are removed.
+	// - a literal or local that is immediately popped is removed.
+	// - OP_NEGATE of a number constant and OP_NOT of a literal are folded.
+	// - OP_NOT OP_NOT is removed when the result is only tested for
+	//   truthiness, since !!x is otherwise how a value is made a bool.
+	// - OP_JUMP to the next instruction is removed.
+	// Line numbers move with the instructions that are kept.
+	void optimise(lox::chunk &chunk);
+
+	// adds the number of each opcode in func, and every function nested in
+	// it, to counts. counts must have lox::opcode_count elements.
+	void count_opcodes(const lox::function &func, std::vector<size_t> &counts);
+}
+
+#endif
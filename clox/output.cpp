@@ -0,0 +1,71 @@
+#include "output.hpp"
+
+#include <lox/number.hpp>
+
+#include <lak/debug.hpp>
+
+#include <cstring>
+
+void lox::file_sink::write(lak::span<const char> bytes)
+{
+	std::fwrite(bytes.data(), 1U, bytes.size(), file);
+}
+
+void lox::ostream_sink::write(lak::span<const char> bytes)
+{
+	strm->write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+lox::output::output(lox::output_sink &s, size_t capacity)
+: sink(&s), buffer(capacity)
+{
+	ASSERT_GREATER(capacity, lox::max_number_length);
+}
+
+lox::output::~output() { flush(); }
+
+void lox::output::write(lak::u8string_view str)
+{
+	if (str.size() > buffer.size() - used)
+	{
+		flush();
+		if (str.size() > buffer.size())
+		{
+			sink->write(lak::span<const char>(
+			  reinterpret_cast<const char *>(str.data()), str.size()));
+			return;
+		}
+	}
+	std::memcpy(buffer.data() + used, str.data(), str.size());
+	used += str.size();
+}
+
+void lox::output::write(char c)
+{
+	if (used == buffer.size()) flush();
+	buffer[used++] = c;
+}
+
+void lox::output::write(double d)
+{
+	if (buffer.size() - used < lox::max_number_length) flush();
+	char *end = lox::format_number(buffer.data() + used,
+	                               buffer.data() + buffer.size(),
+	                               d,
+	                               lox::number_format::general);
+	used = static_cast<size_t>(end - buffer.data());
+}
+
+void lox::output::flush()
+{
+	if (used == 0U) return;
+	sink->write(lak::span<const char>(buffer.data(), used));
+	used = 0U;
+}
+
+lox::output &lox::standard_output()
+{
+	static lox::file_sink sink{stdout};
+	static lox::output output{sink};
+	return output;
+}
@@ -0,0 +1,36 @@
+#ifndef LOX_PARALLEL_HPP
+#define LOX_PARALLEL_HPP
+
+#include <lak/stdint.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace lox
+{
+	// Calls func(i) for every i in [0, count) on up to thread_count threads (0
+	// for one per hardware thread), including the calling thread. Indices are
+	// handed out in order from a shared counter.
+	template<typename FUNC>
+	void parallel_for(size_t count, size_t thread_count, FUNC &&func)
+	{
+		if (thread_count == 0U)
+			thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+		thread_count = std::min(thread_count, count);
+
+		std::atomic_size_t next = 0U;
+		auto worker             = [&]
+		{
+			for (size_t i; (i = next.fetch_add(1U)) < count;) func(i);
+		};
+
+		std::vector<std::thread> threads;
+		for (size_t i = 1U; i < thread_count; ++i) threads.emplace_back(worker);
+		worker();
+		for (std::thread &thread : threads) thread.join();
+	}
+}
+
+#endif
@@ -1,7 +1,71 @@
 #include "parser.hpp"
+#include "common.hpp"
+#include "ir.hpp"
+#include "object.hpp"
+#include "optimiser.hpp"
+#include "superinstructions.hpp"
 
 #include <lak/debug.hpp>
 
+lox::chunk &lox::parser::current_chunk()
+{
+	return compiler->function->chunk;
+}
+
+lox::token lox::parser::synthetic_token(lak::u8string_view text, size_t line)
+{
+	return lox::token{
+	  .type = lox::token_type::IDENTIFIER,
+	  .line = static_cast<uint32_t>(line),
+	  .text = &scanner.lexemes.intern(text),
+	};
+}
+
+void lox::parser::begin_compiler(function_compiler &c)
+{
+	c.enclosing = compiler;
+	compiler    = &c;
+
+	// slot 0 is reserved for the callee, or the receiver in methods
+	const bool is_method = c.type == function_type::METHOD ||
+	                       c.type == function_type::INITIALISER;
+	compiler->locals.push_back(local{
+	  .name        = is_method ? synthetic_token(u8"this"_view, previous.line)
+	                           : lox::token{},
+	  .depth       = 0U,
+	  .initialised = true,
+	  .captured    = false,
+	});
+}
+
+lox::function_ptr lox::parser::end_compiler()
+{
+	emit_return();
+
+	lox::function_ptr result = compiler->function;
+
+	if (options.opt_level >= 3U &&
+	    ir_spent + result->chunk.code.size() <= options.ir_budget)
+	{
+		ir_spent += result->chunk.code.size();
+		lox::optimise_ir(result->chunk, result->arity);
+	}
+	if (options.opt_level >= 1U) lox::optimise(result->chunk);
+	if (options.backend == lox::backend::registers)
+		lox::lower_to_registers(result->chunk);
+	if (options.opt_level >= 2U) lox::fuse_superinstructions(result->chunk);
+
+#ifdef LOX_DEBUG_PRINT_CODE
+	result->chunk.disassemble(result->name.empty() ? u8"<script>"_view
+	                                               : lak::u8string_view(
+	                                                   result->name));
+#endif
+
+	compiler = compiler->enclosing;
+
+	return result;
+}
+
 bool lox::parser::empty() const
 {
 	return current.type == lox::token_type::EOF_TOK;
@@ -26,6 +90,13 @@ bool lox::parser::check(lox::token_type type) const
 	return current.type == type;
 }
 
+lox::parse_result<bool> lox::parser::match(lox::token_type type)
+{
+	if (!check(type)) return lak::ok_t{false};
+	RES_TRY(next());
+	return lak::ok_t{true};
+}
+
 lox::parse_result<const lox::token &> lox::parser::consume(
   lox::token_type type, lak::u8string_view message_on_err)
 {
@@ -39,26 +110,337 @@ lox::parse_result<const lox::token &> lox::parser::consume(
 	return lak::ok_t{previous};
 }
 
-lox::parse_result<> lox::parser::emit_constant(const lox::value &val)
+lox::parse_result<uint8_t> lox::parser::make_constant(const lox::value &val)
 {
-	size_t constant = chunk.push_constant(val);
+	size_t constant = current_chunk().push_constant(val);
 
 	if (constant > UINT8_MAX)
 		return lak::err_t{lox::parse_error::at(
-		  previous.line, u8"Too mand constants in one chunk."_str)};
+		  previous.line, u8"Too many constants in one chunk."_str)};
 
-	chunk.push_opcode(lox::opcode::OP_CONSTANT, previous.line);
-	chunk.push_code(static_cast<uint8_t>(constant), previous.line);
+	return lak::ok_t{static_cast<uint8_t>(constant)};
+}
+
+lox::parse_result<> lox::parser::emit_constant(const lox::value &val)
+{
+	RES_TRY_ASSIGN(const uint8_t constant =, make_constant(val));
+
+	current_chunk().push_opcode(lox::opcode::OP_CONSTANT, previous.line);
+	current_chunk().push_code(constant, previous.line);
 
 	return lak::ok_t{};
 }
 
-lox::parse_result<> lox::parser::parse_number()
+void lox::parser::emit_return()
+{
+	if (compiler->type == function_type::INITIALISER)
+	{
+		// initialisers implicitly return the instance
+		current_chunk().push_opcode(lox::opcode::OP_GET_LOCAL, previous.line);
+		current_chunk().push_code(0U, previous.line);
+	}
+	else
+	{
+		current_chunk().push_opcode(lox::opcode::OP_NIL, previous.line);
+	}
+	current_chunk().push_opcode(lox::opcode::OP_RETURN, previous.line);
+}
+
+lox::parse_result<uint8_t> lox::parser::identifier_constant(
+  const lox::token &name)
 {
-	return emit_constant(previous.literal);
+	return make_constant(lox::value{lox::string::make(name.lexeme())});
 }
 
-lox::parse_result<> lox::parser::parse_grouping()
+size_t lox::parser::emit_jump(lox::opcode inst)
+{
+	current_chunk().push_opcode(inst, previous.line);
+	current_chunk().push_u16(0xFFFF, previous.line);
+	return current_chunk().code.size() - 2U;
+}
+
+lox::parse_result<> lox::parser::patch_jump(size_t offset)
+{
+	lox::chunk &chunk = current_chunk();
+
+	// -2 to adjust for the jump offset itself
+	const size_t jump = chunk.code.size() - offset - 2U;
+
+	if (jump > UINT16_MAX)
+		return lak::err_t{
+		  lox::parse_error::at(previous, u8"Too much code to jump over."_str)};
+
+	chunk.code[offset]      = static_cast<uint8_t>((jump >> 8) & 0xFF);
+	chunk.code[offset + 1U] = static_cast<uint8_t>(jump & 0xFF);
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::emit_loop(size_t loop_start)
+{
+	lox::chunk &chunk = current_chunk();
+
+	chunk.push_opcode(lox::opcode::OP_LOOP, previous.line);
+
+	// +2 to adjust for the OP_LOOP operand
+	const size_t offset = chunk.code.size() - loop_start + 2U;
+	if (offset > UINT16_MAX)
+		return lak::err_t{
+		  lox::parse_error::at(previous, u8"Loop body too large."_str)};
+
+	chunk.push_u16(static_cast<uint16_t>(offset), previous.line);
+
+	return lak::ok_t{};
+}
+
+void lox::parser::begin_scope()
+{
+	++compiler->scope_depth;
+}
+
+void lox::parser::end_scope()
+{
+	--compiler->scope_depth;
+
+	auto &locals = compiler->locals;
+	while (!locals.empty() && locals.back().depth > compiler->scope_depth)
+	{
+		// captured locals get hoisted onto the heap instead of discarded
+		current_chunk().push_opcode(locals.back().captured
+		                              ? lox::opcode::OP_CLOSE_UPVALUE
+		                              : lox::opcode::OP_POP,
+		                            previous.line);
+		locals.pop_back();
+	}
+}
+
+lox::parse_result<> lox::parser::add_local(const lox::token &name)
+{
+	if (compiler->locals.size() >= LOX_LOCALS_MAX)
+		return lak::err_t{lox::parse_error::at(
+		  name, u8"Too many local variables in function."_str)};
+
+	compiler->locals.push_back(local{
+	  .name        = name,
+	  .depth       = compiler->scope_depth,
+	  .initialised = false,
+	  .captured    = false,
+	});
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<lak::optional<uint8_t>> lox::parser::resolve_local(
+  function_compiler &c, const lox::token &name)
+{
+	for (size_t i = c.locals.size(); i-- > 0U;)
+	{
+		if (c.locals[i].name.lexeme() != name.lexeme()) continue;
+
+		if (!c.locals[i].initialised)
+			return lak::err_t{lox::parse_error::at(
+			  name, u8"Can't read local variable in its own initialiser."_str)};
+
+		return lak::ok_t<lak::optional<uint8_t>>{static_cast<uint8_t>(i)};
+	}
+
+	return lak::ok_t<lak::optional<uint8_t>>{lak::nullopt};
+}
+
+lox::parse_result<uint8_t> lox::parser::add_upvalue(function_compiler &c,
+                                                    uint8_t index,
+                                                    bool is_local)
+{
+	for (size_t i = 0U; i < c.upvalues.size(); ++i)
+		if (c.upvalues[i].index == index && c.upvalues[i].is_local == is_local)
+			return lak::ok_t{static_cast<uint8_t>(i)};
+
+	if (c.upvalues.size() >= LOX_UPVALUES_MAX)
+		return lak::err_t{lox::parse_error::at(
+		  previous, u8"Too many closure variables in function."_str)};
+
+	c.upvalues.push_back(upvalue{.index = index, .is_local = is_local});
+	c.function->upvalue_count = c.upvalues.size();
+
+	return lak::ok_t{static_cast<uint8_t>(c.upvalues.size() - 1U)};
+}
+
+lox::parse_result<lak::optional<uint8_t>> lox::parser::resolve_upvalue(
+  function_compiler &c, const lox::token &name)
+{
+	if (!c.enclosing) return lak::ok_t<lak::optional<uint8_t>>{lak::nullopt};
+
+	RES_TRY_ASSIGN(lak::optional<uint8_t> local =,
+	               resolve_local(*c.enclosing, name));
+	if (local)
+	{
+		c.enclosing->locals[*local].captured = true;
+		RES_TRY_ASSIGN(const uint8_t index =, add_upvalue(c, *local, true));
+		return lak::ok_t<lak::optional<uint8_t>>{index};
+	}
+
+	RES_TRY_ASSIGN(lak::optional<uint8_t> upvalue =,
+	               resolve_upvalue(*c.enclosing, name));
+	if (upvalue)
+	{
+		RES_TRY_ASSIGN(const uint8_t index =, add_upvalue(c, *upvalue, false));
+		return lak::ok_t<lak::optional<uint8_t>>{index};
+	}
+
+	return lak::ok_t<lak::optional<uint8_t>>{lak::nullopt};
+}
+
+lox::parse_result<uint16_t> lox::parser::resolve_global(
+  const lox::token &name)
+{
+	if_let_ok (uint16_t index, globals.find_or_emplace(name.lexeme()))
+		return lak::ok_t{index};
+	else
+		return lak::err_t{
+		  lox::parse_error::at(name, u8"Too many global variables."_str)};
+}
+
+lox::parse_result<> lox::parser::declare_variable()
+{
+	if (compiler->scope_depth == 0U) return lak::ok_t{};
+
+	const auto &locals = compiler->locals;
+	for (size_t i = locals.size(); i-- > 0U;)
+	{
+		if (locals[i].initialised && locals[i].depth < compiler->scope_depth)
+			break;
+
+		if (locals[i].name.lexeme() == previous.lexeme())
+			return lak::err_t{lox::parse_error::at(
+			  previous,
+			  u8"Already a variable with this name in this scope."_str)};
+	}
+
+	return add_local(previous);
+}
+
+lox::parse_result<uint16_t> lox::parser::parse_variable_name(
+  lak::u8string_view message_on_err)
+{
+	RES_TRY(consume(lox::token_type::IDENTIFIER, message_on_err));
+
+	RES_TRY(declare_variable());
+
+	if (compiler->scope_depth > 0U) return lak::ok_t<uint16_t>{0U};
+
+	return resolve_global(previous);
+}
+
+void lox::parser::mark_initialised()
+{
+	if (compiler->scope_depth == 0U) return;
+	compiler->locals.back().initialised = true;
+}
+
+void lox::parser::define_variable(uint16_t global)
+{
+	if (compiler->scope_depth > 0U)
+	{
+		mark_initialised();
+		return;
+	}
+
+	current_chunk().push_opcode(lox::opcode::OP_DEFINE_GLOBAL, previous.line);
+	current_chunk().push_u16(global, previous.line);
+}
+
+lox::parse_result<uint8_t> lox::parser::parse_argument_list()
+{
+	uint8_t arg_count = 0U;
+
+	if (!check(lox::token_type::RIGHT_PAREN))
+	{
+		for (bool more = true; more;)
+		{
+			RES_TRY(parse_expression());
+			if (arg_count == UINT8_MAX)
+				return lak::err_t{lox::parse_error::at(
+				  previous, u8"Can't have more than 255 arguments."_str)};
+			++arg_count;
+			RES_TRY_ASSIGN(more =, match(lox::token_type::COMMA));
+		}
+	}
+
+	RES_TRY(consume(lox::token_type::RIGHT_PAREN,
+	                u8"Expected ')' after arguments."_view));
+
+	return lak::ok_t{arg_count};
+}
+
+lox::parse_result<> lox::parser::named_variable(const lox::token &name,
+                                                bool can_assign)
+{
+	lox::opcode get_op, set_op;
+	uint16_t arg;
+	bool wide = false;
+
+	RES_TRY_ASSIGN(lak::optional<uint8_t> local =,
+	               resolve_local(*compiler, name));
+
+	if (local)
+	{
+		get_op = lox::opcode::OP_GET_LOCAL;
+		set_op = lox::opcode::OP_SET_LOCAL;
+		arg    = *local;
+	}
+	else
+	{
+		RES_TRY_ASSIGN(lak::optional<uint8_t> upvalue =,
+		               resolve_upvalue(*compiler, name));
+
+		if (upvalue)
+		{
+			get_op = lox::opcode::OP_GET_UPVALUE;
+			set_op = lox::opcode::OP_SET_UPVALUE;
+			arg    = *upvalue;
+		}
+		else
+		{
+			get_op = lox::opcode::OP_GET_GLOBAL;
+			set_op = lox::opcode::OP_SET_GLOBAL;
+			wide   = true;
+			RES_TRY_ASSIGN(arg =, resolve_global(name));
+		}
+	}
+
+	RES_TRY_ASSIGN(const bool assign =,
+	               can_assign ? match(lox::token_type::EQUAL)
+	                          : lox::parse_result<bool>{lak::ok_t{false}});
+
+	if (assign) RES_TRY(parse_expression());
+
+	current_chunk().push_opcode(assign ? set_op : get_op, name.line);
+	if (wide)
+		current_chunk().push_u16(arg, name.line);
+	else
+		current_chunk().push_code(static_cast<uint8_t>(arg), name.line);
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_number(bool)
+{
+	if_let_ok (const double number, previous.number())
+		return emit_constant(lox::value{number});
+	return lak::err_t{lox::parse_error::at(previous, u8"Invalid number."_str)};
+}
+
+lox::parse_result<> lox::parser::parse_string(bool)
+{
+	return emit_constant(lox::value{lox::string::make(previous.string())});
+}
+
+lox::parse_result<> lox::parser::parse_variable(bool can_assign)
+{
+	return named_variable(previous, can_assign);
+}
+
+lox::parse_result<> lox::parser::parse_grouping(bool)
 {
 	RES_TRY(parse_expression());
 	RES_TRY(
@@ -66,7 +448,7 @@ lox::parse_result<> lox::parser::parse_grouping()
 	return lak::ok_t{};
 }
 
-lox::parse_result<> lox::parser::parse_unary()
+lox::parse_result<> lox::parser::parse_unary(bool)
 {
 	lox::token op = previous;
 
@@ -75,11 +457,11 @@ lox::parse_result<> lox::parser::parse_unary()
 	switch (op.type)
 	{
 		case lox::token_type::BANG:
-			chunk.push_opcode(lox::opcode::OP_NOT, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_NOT, op.line);
 			break;
 
 		case lox::token_type::MINUS:
-			chunk.push_opcode(lox::opcode::OP_NEGATE, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_NEGATE, op.line);
 			break;
 
 		default:
@@ -89,7 +471,7 @@ lox::parse_result<> lox::parser::parse_unary()
 	return lak::ok_t{};
 }
 
-lox::parse_result<> lox::parser::parse_binary()
+lox::parse_result<> lox::parser::parse_binary(bool)
 {
 	lox::token op = previous;
 
@@ -100,46 +482,46 @@ lox::parse_result<> lox::parser::parse_binary()
 	switch (op.type)
 	{
 		case lox::token_type::BANG_EQUAL:
-			chunk.push_opcode(lox::opcode::OP_EQUAL, op.line);
-			chunk.push_opcode(lox::opcode::OP_NOT, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_EQUAL, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_NOT, op.line);
 			break;
 
 		case lox::token_type::EQUAL_EQUAL:
-			chunk.push_opcode(lox::opcode::OP_EQUAL, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_EQUAL, op.line);
 			break;
 
 		case lox::token_type::GREATER:
-			chunk.push_opcode(lox::opcode::OP_GREATER, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_GREATER, op.line);
 			break;
 
 		case lox::token_type::GREATER_EQUAL:
-			chunk.push_opcode(lox::opcode::OP_LESS, op.line);
-			chunk.push_opcode(lox::opcode::OP_NOT, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_LESS, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_NOT, op.line);
 			break;
 
 		case lox::token_type::LESS:
-			chunk.push_opcode(lox::opcode::OP_LESS, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_LESS, op.line);
 			break;
 
 		case lox::token_type::LESS_EQUAL:
-			chunk.push_opcode(lox::opcode::OP_GREATER, op.line);
-			chunk.push_opcode(lox::opcode::OP_NOT, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_GREATER, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_NOT, op.line);
 			break;
 
 		case lox::token_type::PLUS:
-			chunk.push_opcode(lox::opcode::OP_ADD, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_ADD, op.line);
 			break;
 
 		case lox::token_type::MINUS:
-			chunk.push_opcode(lox::opcode::OP_SUBTRACT, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_SUBTRACT, op.line);
 			break;
 
 		case lox::token_type::STAR:
-			chunk.push_opcode(lox::opcode::OP_MULTIPLY, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_MULTIPLY, op.line);
 			break;
 
 		case lox::token_type::SLASH:
-			chunk.push_opcode(lox::opcode::OP_DIVIDE, op.line);
+			current_chunk().push_opcode(lox::opcode::OP_DIVIDE, op.line);
 			break;
 
 		default:
@@ -150,20 +532,134 @@ lox::parse_result<> lox::parser::parse_binary()
 	return lak::ok_t{};
 }
 
-lox::parse_result<> lox::parser::parse_literal()
+lox::parse_result<> lox::parser::parse_and(bool)
+{
+	const size_t end_jump = emit_jump(lox::opcode::OP_JUMP_IF_FALSE);
+
+	current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+	RES_TRY(parse_precedence(precedence::AND));
+
+	return patch_jump(end_jump);
+}
+
+lox::parse_result<> lox::parser::parse_or(bool)
+{
+	const size_t else_jump = emit_jump(lox::opcode::OP_JUMP_IF_FALSE);
+	const size_t end_jump  = emit_jump(lox::opcode::OP_JUMP);
+
+	RES_TRY(patch_jump(else_jump));
+	current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+
+	RES_TRY(parse_precedence(precedence::OR));
+
+	return patch_jump(end_jump);
+}
+
+lox::parse_result<> lox::parser::parse_call(bool)
+{
+	RES_TRY_ASSIGN(const uint8_t arg_count =, parse_argument_list());
+	compiler->last_call = current_chunk().code.size();
+	current_chunk().push_opcode(lox::opcode::OP_CALL, previous.line);
+	current_chunk().push_code(arg_count, previous.line);
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_dot(bool can_assign)
+{
+	RES_TRY(consume(lox::token_type::IDENTIFIER,
+	                u8"Expected property name after '.'."_view));
+	const size_t line = previous.line;
+	RES_TRY_ASSIGN(const uint8_t name =, identifier_constant(previous));
+
+	RES_TRY_ASSIGN(const bool assign =,
+	               can_assign ? match(lox::token_type::EQUAL)
+	                          : lox::parse_result<bool>{lak::ok_t{false}});
+	if (assign)
+	{
+		RES_TRY(parse_expression());
+		current_chunk().push_opcode(lox::opcode::OP_SET_PROPERTY, line);
+		current_chunk().push_code(name, line);
+		return lak::ok_t{};
+	}
+
+	RES_TRY_ASSIGN(const bool invoke =, match(lox::token_type::LEFT_PAREN));
+	if (invoke)
+	{
+		// call the method directly rather than creating a bound method
+		RES_TRY_ASSIGN(const uint8_t arg_count =, parse_argument_list());
+		compiler->last_call = current_chunk().code.size();
+		current_chunk().push_opcode(lox::opcode::OP_INVOKE, line);
+		current_chunk().push_code(name, line);
+		current_chunk().push_code(arg_count, line);
+		return lak::ok_t{};
+	}
+
+	current_chunk().push_opcode(lox::opcode::OP_GET_PROPERTY, line);
+	current_chunk().push_code(name, line);
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_this(bool)
+{
+	if (!current_class)
+		return lak::err_t{lox::parse_error::at(
+		  previous, u8"Can't use 'this' outside of a class."_str)};
+
+	return named_variable(previous, false);
+}
+
+lox::parse_result<> lox::parser::parse_super(bool)
+{
+	if (!current_class)
+		return lak::err_t{lox::parse_error::at(
+		  previous, u8"Can't use 'super' outside of a class."_str)};
+	else if (!current_class->has_superclass)
+		return lak::err_t{lox::parse_error::at(
+		  previous, u8"Can't use 'super' in a class with no superclass."_str)};
+
+	const size_t line = previous.line;
+
+	RES_TRY(
+	  consume(lox::token_type::DOT, u8"Expected '.' after 'super'."_view));
+	RES_TRY(consume(lox::token_type::IDENTIFIER,
+	                u8"Expected superclass method name."_view));
+	RES_TRY_ASSIGN(const uint8_t name =, identifier_constant(previous));
+
+	RES_TRY(named_variable(synthetic_token(u8"this"_view, line), false));
+
+	RES_TRY_ASSIGN(const bool invoke =, match(lox::token_type::LEFT_PAREN));
+	if (invoke)
+	{
+		RES_TRY_ASSIGN(const uint8_t arg_count =, parse_argument_list());
+		RES_TRY(named_variable(synthetic_token(u8"super"_view, line), false));
+		current_chunk().push_opcode(lox::opcode::OP_SUPER_INVOKE, line);
+		current_chunk().push_code(name, line);
+		current_chunk().push_code(arg_count, line);
+	}
+	else
+	{
+		RES_TRY(named_variable(synthetic_token(u8"super"_view, line), false));
+		current_chunk().push_opcode(lox::opcode::OP_GET_SUPER, line);
+		current_chunk().push_code(name, line);
+	}
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_literal(bool)
 {
 	switch (previous.type)
 	{
 		case lox::token_type::FALSE:
-			chunk.push_opcode(lox::opcode::OP_FALSE, previous.line);
+			current_chunk().push_opcode(lox::opcode::OP_FALSE, previous.line);
 			break;
 
 		case lox::token_type::NIL:
-			chunk.push_opcode(lox::opcode::OP_NIL, previous.line);
+			current_chunk().push_opcode(lox::opcode::OP_NIL, previous.line);
 			break;
 
 		case lox::token_type::TRUE:
-			chunk.push_opcode(lox::opcode::OP_TRUE, previous.line);
+			current_chunk().push_opcode(lox::opcode::OP_TRUE, previous.line);
 			break;
 
 		default:
@@ -179,6 +675,396 @@ lox::parse_result<> lox::parser::parse_expression()
 	return parse_precedence(precedence::ASSIGNMENT);
 }
 
+lox::parse_result<> lox::parser::parse_block()
+{
+	while (!check(lox::token_type::RIGHT_BRACE) &&
+	       !check(lox::token_type::EOF_TOK))
+		RES_TRY(parse_declaration());
+
+	RES_TRY(
+	  consume(lox::token_type::RIGHT_BRACE, u8"Expected '}' after block."_view));
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_print_statement()
+{
+	RES_TRY(parse_expression());
+	RES_TRY(
+	  consume(lox::token_type::SEMICOLON, u8"Expected ';' after value."_view));
+	current_chunk().push_opcode(lox::opcode::OP_PRINT, previous.line);
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_expression_statement()
+{
+	RES_TRY(parse_expression());
+	RES_TRY(consume(lox::token_type::SEMICOLON,
+	                u8"Expected ';' after expression."_view));
+	current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_if_statement()
+{
+	RES_TRY(
+	  consume(lox::token_type::LEFT_PAREN, u8"Expected '(' after 'if'."_view));
+	RES_TRY(parse_expression());
+	RES_TRY(consume(lox::token_type::RIGHT_PAREN,
+	                u8"Expected ')' after condition."_view));
+
+	const size_t then_jump = emit_jump(lox::opcode::OP_JUMP_IF_FALSE);
+	current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+	RES_TRY(parse_statement());
+
+	const size_t else_jump = emit_jump(lox::opcode::OP_JUMP);
+
+	RES_TRY(patch_jump(then_jump));
+	current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+
+	RES_TRY_ASSIGN(const bool has_else =, match(lox::token_type::ELSE));
+	if (has_else) RES_TRY(parse_statement());
+
+	return patch_jump(else_jump);
+}
+
+lox::parse_result<> lox::parser::parse_return_statement()
+{
+	if (compiler->type == function_type::SCRIPT)
+		return lak::err_t{lox::parse_error::at(
+		  previous, u8"Can't return from top-level code."_str)};
+
+	RES_TRY_ASSIGN(const bool no_value =, match(lox::token_type::SEMICOLON));
+	if (no_value)
+	{
+		emit_return();
+	}
+	else
+	{
+		if (compiler->type == function_type::INITIALISER)
+			return lak::err_t{lox::parse_error::at(
+			  previous, u8"Can't return a value from an initialiser."_str)};
+
+		RES_TRY(parse_expression());
+		RES_TRY(consume(lox::token_type::SEMICOLON,
+		                u8"Expected ';' after return value."_view));
+
+		// a call the function returns straight away can reuse its frame. the
+		// OP_RETURN is still needed for callees that don't take a frame.
+		lox::chunk &chunk = current_chunk();
+		if (compiler->last_call < chunk.code.size() &&
+		    chunk.next_instruction(compiler->last_call) == chunk.code.size())
+		{
+			uint8_t &op = chunk.code[compiler->last_call];
+			op = static_cast<uint8_t>(op == uint8_t(lox::opcode::OP_CALL)
+			                            ? lox::opcode::OP_TAIL_CALL
+			                            : lox::opcode::OP_TAIL_INVOKE);
+		}
+
+		chunk.push_opcode(lox::opcode::OP_RETURN, previous.line);
+	}
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_while_statement()
+{
+	const size_t loop_start = current_chunk().code.size();
+
+	RES_TRY(consume(lox::token_type::LEFT_PAREN,
+	                u8"Expected '(' after 'while'."_view));
+	RES_TRY(parse_expression());
+	RES_TRY(consume(lox::token_type::RIGHT_PAREN,
+	                u8"Expected ')' after condition."_view));
+
+	const size_t exit_jump = emit_jump(lox::opcode::OP_JUMP_IF_FALSE);
+	current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+	RES_TRY(parse_statement());
+	RES_TRY(emit_loop(loop_start));
+
+	RES_TRY(patch_jump(exit_jump));
+	current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_for_statement()
+{
+	begin_scope();
+
+	RES_TRY(
+	  consume(lox::token_type::LEFT_PAREN, u8"Expected '(' after 'for'."_view));
+
+	RES_TRY_ASSIGN(const bool no_init =, match(lox::token_type::SEMICOLON));
+	if (!no_init)
+	{
+		RES_TRY_ASSIGN(const bool var_init =, match(lox::token_type::VAR));
+		if (var_init)
+			RES_TRY(parse_var_declaration());
+		else
+			RES_TRY(parse_expression_statement());
+	}
+
+	size_t loop_start = current_chunk().code.size();
+
+	size_t exit_jump = 0U;
+	RES_TRY_ASSIGN(const bool no_condition =,
+	               match(lox::token_type::SEMICOLON));
+	if (!no_condition)
+	{
+		RES_TRY(parse_expression());
+		RES_TRY(consume(lox::token_type::SEMICOLON,
+		                u8"Expected ';' after loop condition."_view));
+
+		// jump out of the loop if the condition is false
+		exit_jump = emit_jump(lox::opcode::OP_JUMP_IF_FALSE);
+		current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+	}
+
+	RES_TRY_ASSIGN(const bool no_increment =,
+	               match(lox::token_type::RIGHT_PAREN));
+	if (!no_increment)
+	{
+		const size_t body_jump       = emit_jump(lox::opcode::OP_JUMP);
+		const size_t increment_start = current_chunk().code.size();
+
+		RES_TRY(parse_expression());
+		current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+		RES_TRY(consume(lox::token_type::RIGHT_PAREN,
+		                u8"Expected ')' after for clauses."_view));
+
+		RES_TRY(emit_loop(loop_start));
+		loop_start = increment_start;
+		RES_TRY(patch_jump(body_jump));
+	}
+
+	RES_TRY(parse_statement());
+	RES_TRY(emit_loop(loop_start));
+
+	if (!no_condition)
+	{
+		RES_TRY(patch_jump(exit_jump));
+		current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+	}
+
+	end_scope();
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_statement()
+{
+	switch (current.type)
+	{
+		case lox::token_type::PRINT:
+			RES_TRY(next());
+			return parse_print_statement();
+
+		case lox::token_type::IF:
+			RES_TRY(next());
+			return parse_if_statement();
+
+		case lox::token_type::RETURN:
+			RES_TRY(next());
+			return parse_return_statement();
+
+		case lox::token_type::WHILE:
+			RES_TRY(next());
+			return parse_while_statement();
+
+		case lox::token_type::FOR:
+			RES_TRY(next());
+			return parse_for_statement();
+
+		case lox::token_type::LEFT_BRACE:
+			RES_TRY(next());
+			begin_scope();
+			RES_TRY(parse_block());
+			end_scope();
+			return lak::ok_t{};
+
+		default: return parse_expression_statement();
+	}
+}
+
+lox::parse_result<> lox::parser::parse_function(function_type type)
+{
+	function_compiler c{
+	  .function = lox::function::make(previous.lexeme()),
+	  .type     = type,
+	};
+	begin_compiler(c);
+	begin_scope();
+
+	RES_TRY(consume(lox::token_type::LEFT_PAREN,
+	                u8"Expected '(' after function name."_view));
+
+	if (!check(lox::token_type::RIGHT_PAREN))
+	{
+		for (bool more = true; more;)
+		{
+			if (c.function->arity == UINT8_MAX)
+				return lak::err_t{lox::parse_error::at(
+				  current, u8"Can't have more than 255 parameters."_str)};
+			++c.function->arity;
+
+			RES_TRY_ASSIGN(
+			  const uint16_t param =,
+			  parse_variable_name(u8"Expected parameter name."_view));
+			define_variable(param);
+
+			RES_TRY_ASSIGN(more =, match(lox::token_type::COMMA));
+		}
+	}
+
+	RES_TRY(consume(lox::token_type::RIGHT_PAREN,
+	                u8"Expected ')' after parameters."_view));
+	RES_TRY(consume(lox::token_type::LEFT_BRACE,
+	                u8"Expected '{' before function body."_view));
+	RES_TRY(parse_block());
+
+	// no end_scope, the locals are discarded along with the call frame
+	lox::function_ptr function = end_compiler();
+
+	RES_TRY_ASSIGN(const uint8_t constant =, make_constant(function));
+	current_chunk().push_opcode(lox::opcode::OP_CLOSURE, previous.line);
+	current_chunk().push_code(constant, previous.line);
+
+	for (const upvalue &uv : c.upvalues)
+	{
+		current_chunk().push_code(uv.is_local ? 1U : 0U, previous.line);
+		current_chunk().push_code(uv.index, previous.line);
+	}
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_method()
+{
+	RES_TRY(consume(lox::token_type::IDENTIFIER,
+	                u8"Expected method name."_view));
+	RES_TRY_ASSIGN(const uint8_t name =, identifier_constant(previous));
+
+	RES_TRY(parse_function(previous.lexeme() == u8"init"_view
+	                         ? function_type::INITIALISER
+	                         : function_type::METHOD));
+
+	current_chunk().push_opcode(lox::opcode::OP_METHOD, previous.line);
+	current_chunk().push_code(name, previous.line);
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_class_declaration()
+{
+	RES_TRY_ASSIGN(const uint16_t global =,
+	               parse_variable_name(u8"Expected class name."_view));
+	const lox::token class_name = previous;
+	RES_TRY_ASSIGN(const uint8_t name =, identifier_constant(class_name));
+
+	current_chunk().push_opcode(lox::opcode::OP_CLASS, class_name.line);
+	current_chunk().push_code(name, class_name.line);
+	define_variable(global);
+
+	class_compiler c{.enclosing = current_class, .has_superclass = false};
+	current_class = &c;
+
+	RES_TRY_ASSIGN(const bool inherits =, match(lox::token_type::LESS));
+	if (inherits)
+	{
+		RES_TRY(consume(lox::token_type::IDENTIFIER,
+		                u8"Expected superclass name."_view));
+		RES_TRY(parse_variable(false));
+
+		if (class_name.lexeme() == previous.lexeme())
+			return lak::err_t{lox::parse_error::at(
+			  previous, u8"A class can't inherit from itself."_str)};
+
+		// bind the superclass to a local so methods can capture it as 'super'
+		begin_scope();
+		RES_TRY(add_local(synthetic_token(u8"super"_view, previous.line)));
+		define_variable(0U);
+
+		RES_TRY(named_variable(class_name, false));
+		current_chunk().push_opcode(lox::opcode::OP_INHERIT, previous.line);
+		c.has_superclass = true;
+	}
+
+	// load the class back onto the stack for OP_METHOD to bind to
+	RES_TRY(named_variable(class_name, false));
+
+	RES_TRY(consume(lox::token_type::LEFT_BRACE,
+	                u8"Expected '{' before class body."_view));
+
+	while (!check(lox::token_type::RIGHT_BRACE) &&
+	       !check(lox::token_type::EOF_TOK))
+		RES_TRY(parse_method());
+
+	RES_TRY(consume(lox::token_type::RIGHT_BRACE,
+	                u8"Expected '}' after class body."_view));
+	current_chunk().push_opcode(lox::opcode::OP_POP, previous.line);
+
+	if (c.has_superclass) end_scope();
+
+	current_class = c.enclosing;
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_fun_declaration()
+{
+	RES_TRY_ASSIGN(const uint16_t global =,
+	               parse_variable_name(u8"Expected function name."_view));
+
+	// functions may refer to themselves recursively
+	mark_initialised();
+
+	RES_TRY(parse_function(function_type::FUNCTION));
+
+	define_variable(global);
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_var_declaration()
+{
+	RES_TRY_ASSIGN(const uint16_t global =,
+	               parse_variable_name(u8"Expected variable name."_view));
+
+	RES_TRY_ASSIGN(const bool has_init =, match(lox::token_type::EQUAL));
+	if (has_init)
+		RES_TRY(parse_expression());
+	else
+		current_chunk().push_opcode(lox::opcode::OP_NIL, previous.line);
+
+	RES_TRY(consume(lox::token_type::SEMICOLON,
+	                u8"Expected ';' after variable declaration."_view));
+
+	define_variable(global);
+
+	return lak::ok_t{};
+}
+
+lox::parse_result<> lox::parser::parse_declaration()
+{
+	switch (current.type)
+	{
+		case lox::token_type::CLASS:
+			RES_TRY(next());
+			return parse_class_declaration();
+
+		case lox::token_type::FUN:
+			RES_TRY(next());
+			return parse_fun_declaration();
+
+		case lox::token_type::VAR:
+			RES_TRY(next());
+			return parse_var_declaration();
+
+		default: return parse_statement();
+	}
+}
+
 lox::parse_result<> lox::parser::parse_precedence(precedence prec)
 {
 	RES_TRY(next());
@@ -189,16 +1075,21 @@ lox::parse_result<> lox::parser::parse_precedence(precedence prec)
 		return lak::err_t{
 		  lox::parse_error::at(previous, u8"Expected expression."_str)};
 
-	RES_TRY((this->*prefix)());
+	const bool can_assign = prec <= precedence::ASSIGNMENT;
+	RES_TRY((this->*prefix)(can_assign));
 
 	while (get_rule(current.type).precedence >= prec)
 	{
 		RES_TRY(next());
 		auto infix{get_rule(previous.type).infix};
 		if (!infix) continue;
-		RES_TRY((this->*infix)());
+		RES_TRY((this->*infix)(can_assign));
 	}
 
+	if (can_assign && check(lox::token_type::EQUAL))
+		return lak::err_t{
+		  lox::parse_error::at(current, u8"Invalid assignment target."_str)};
+
 	return lak::ok_t{};
 }
 
@@ -210,8 +1101,18 @@ const lox::parser::parse_rule &lox::parser::get_rule(lox::token_type type)
 		{
 			static constexpr parse_rule rule{
 			  .prefix     = &lox::parser::parse_grouping,
-			  .infix      = nullptr,
-			  .precedence = lox::parser::precedence::NONE,
+			  .infix      = &lox::parser::parse_call,
+			  .precedence = lox::parser::precedence::CALL,
+			};
+			return rule;
+		}
+
+		case lox::token_type::DOT:
+		{
+			static constexpr parse_rule rule{
+			  .prefix     = nullptr,
+			  .infix      = &lox::parser::parse_dot,
+			  .precedence = lox::parser::precedence::CALL,
 			};
 			return rule;
 		}
@@ -290,6 +1191,26 @@ const lox::parser::parse_rule &lox::parser::get_rule(lox::token_type type)
 			return rule;
 		}
 
+		case lox::token_type::IDENTIFIER:
+		{
+			static constexpr parse_rule rule{
+			  .prefix     = &lox::parser::parse_variable,
+			  .infix      = nullptr,
+			  .precedence = lox::parser::precedence::NONE,
+			};
+			return rule;
+		}
+
+		case lox::token_type::STRING:
+		{
+			static constexpr parse_rule rule{
+			  .prefix     = &lox::parser::parse_string,
+			  .infix      = nullptr,
+			  .precedence = lox::parser::precedence::NONE,
+			};
+			return rule;
+		}
+
 		case lox::token_type::NUMBER:
 		{
 			static constexpr parse_rule rule{
@@ -300,6 +1221,26 @@ const lox::parser::parse_rule &lox::parser::get_rule(lox::token_type type)
 			return rule;
 		}
 
+		case lox::token_type::AND:
+		{
+			static constexpr parse_rule rule{
+			  .prefix     = nullptr,
+			  .infix      = &lox::parser::parse_and,
+			  .precedence = lox::parser::precedence::AND,
+			};
+			return rule;
+		}
+
+		case lox::token_type::OR:
+		{
+			static constexpr parse_rule rule{
+			  .prefix     = nullptr,
+			  .infix      = &lox::parser::parse_or,
+			  .precedence = lox::parser::precedence::OR,
+			};
+			return rule;
+		}
+
 		case lox::token_type::FALSE:
 		{
 			static constexpr parse_rule rule{
@@ -320,6 +1261,26 @@ const lox::parser::parse_rule &lox::parser::get_rule(lox::token_type type)
 			return rule;
 		}
 
+		case lox::token_type::SUPER:
+		{
+			static constexpr parse_rule rule{
+			  .prefix     = &lox::parser::parse_super,
+			  .infix      = nullptr,
+			  .precedence = lox::parser::precedence::NONE,
+			};
+			return rule;
+		}
+
+		case lox::token_type::THIS:
+		{
+			static constexpr parse_rule rule{
+			  .prefix     = &lox::parser::parse_this,
+			  .infix      = nullptr,
+			  .precedence = lox::parser::precedence::NONE,
+			};
+			return rule;
+		}
+
 		case lox::token_type::TRUE:
 		{
 			static constexpr parse_rule rule{
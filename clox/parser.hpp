@@ -2,10 +2,14 @@
 #define LOX_PARSER_HPP
 
 #include "chunk.hpp"
+#include "compile_options.hpp"
 #include "error.hpp"
+#include "global_table.hpp"
+#include "object.hpp"
 #include "scanner.hpp"
 #include "token.hpp"
 
+#include <lak/optional.hpp>
 #include <lak/result.hpp>
 #include <lak/stdint.hpp>
 
@@ -25,9 +29,66 @@ namespace lox
 
 	struct parser
 	{
+		enum struct function_type
+		{
+			FUNCTION,
+			INITIALISER,
+			METHOD,
+			SCRIPT,
+		};
+
+		struct local
+		{
+			lox::token name;
+			size_t depth;
+			bool initialised;
+			bool captured;
+		};
+
+		struct upvalue
+		{
+			uint8_t index;
+			bool is_local;
+		};
+
+		// state for the function currently being compiled, functions nested
+		// inside of it push a new compiler that points back to this one.
+		struct function_compiler
+		{
+			function_compiler *enclosing  = nullptr;
+			lox::function_ptr function    = lox::function::make({});
+			function_type type            = function_type::SCRIPT;
+			std::vector<local> locals     = {};
+			std::vector<upvalue> upvalues = {};
+			size_t scope_depth            = 0U;
+			// the offset of the last OP_CALL or OP_INVOKE, to spot calls in tail
+			// position.
+			size_t last_call = SIZE_MAX;
+		};
+
+		struct class_compiler
+		{
+			class_compiler *enclosing = nullptr;
+			bool has_superclass       = false;
+		};
+
 		lox::scanner &scanner;
-		lox::token previous, current;
-		lox::chunk chunk;
+		lox::global_table &globals;
+		lox::compile_options options  = {};
+		lox::token previous           = {}, current = {};
+		function_compiler *compiler   = nullptr;
+		class_compiler *current_class = nullptr;
+		// bytes of bytecode that have gone through the IR so far.
+		size_t ir_spent = 0U;
+
+		lox::chunk &current_chunk();
+
+		// an identifier token for text that doesn't appear in the source.
+		lox::token synthetic_token(lak::u8string_view text, size_t line);
+
+		void begin_compiler(function_compiler &c);
+
+		lox::function_ptr end_compiler();
 
 		bool empty() const;
 
@@ -35,23 +96,113 @@ namespace lox
 
 		bool check(lox::token_type type) const;
 
+		lox::parse_result<bool> match(lox::token_type type);
+
 		lox::parse_result<const lox::token &> consume(
 		  lox::token_type type, lak::u8string_view message_on_err);
 
+		lox::parse_result<uint8_t> make_constant(const lox::value &val);
+
 		lox::parse_result<> emit_constant(const lox::value &val);
 
-		lox::parse_result<> parse_number();
+		lox::parse_result<uint8_t> identifier_constant(const lox::token &name);
+
+		void emit_return();
+
+		size_t emit_jump(lox::opcode inst);
+
+		lox::parse_result<> patch_jump(size_t offset);
+
+		lox::parse_result<> emit_loop(size_t loop_start);
+
+		void begin_scope();
+
+		void end_scope();
+
+		lox::parse_result<> add_local(const lox::token &name);
+
+		lox::parse_result<lak::optional<uint8_t>> resolve_local(
+		  function_compiler &c, const lox::token &name);
+
+		lox::parse_result<uint8_t> add_upvalue(function_compiler &c,
+		                                       uint8_t index,
+		                                       bool is_local);
+
+		lox::parse_result<lak::optional<uint8_t>> resolve_upvalue(
+		  function_compiler &c, const lox::token &name);
 
-		lox::parse_result<> parse_grouping();
+		lox::parse_result<uint16_t> resolve_global(const lox::token &name);
 
-		lox::parse_result<> parse_unary();
+		lox::parse_result<> declare_variable();
 
-		lox::parse_result<> parse_binary();
+		lox::parse_result<uint16_t> parse_variable_name(
+		  lak::u8string_view message_on_err);
 
-		lox::parse_result<> parse_literal();
+		void mark_initialised();
+
+		void define_variable(uint16_t global);
+
+		lox::parse_result<uint8_t> parse_argument_list();
+
+		lox::parse_result<> named_variable(const lox::token &name,
+		                                   bool can_assign);
+
+		lox::parse_result<> parse_number(bool can_assign);
+
+		lox::parse_result<> parse_string(bool can_assign);
+
+		lox::parse_result<> parse_variable(bool can_assign);
+
+		lox::parse_result<> parse_grouping(bool can_assign);
+
+		lox::parse_result<> parse_unary(bool can_assign);
+
+		lox::parse_result<> parse_binary(bool can_assign);
+
+		lox::parse_result<> parse_and(bool can_assign);
+
+		lox::parse_result<> parse_or(bool can_assign);
+
+		lox::parse_result<> parse_call(bool can_assign);
+
+		lox::parse_result<> parse_dot(bool can_assign);
+
+		lox::parse_result<> parse_this(bool can_assign);
+
+		lox::parse_result<> parse_super(bool can_assign);
+
+		lox::parse_result<> parse_literal(bool can_assign);
 
 		lox::parse_result<> parse_expression();
 
+		lox::parse_result<> parse_block();
+
+		lox::parse_result<> parse_print_statement();
+
+		lox::parse_result<> parse_expression_statement();
+
+		lox::parse_result<> parse_if_statement();
+
+		lox::parse_result<> parse_return_statement();
+
+		lox::parse_result<> parse_while_statement();
+
+		lox::parse_result<> parse_for_statement();
+
+		lox::parse_result<> parse_statement();
+
+		lox::parse_result<> parse_function(function_type type);
+
+		lox::parse_result<> parse_method();
+
+		lox::parse_result<> parse_class_declaration();
+
+		lox::parse_result<> parse_fun_declaration();
+
+		lox::parse_result<> parse_var_declaration();
+
+		lox::parse_result<> parse_declaration();
+
 		enum struct precedence
 		{
 			NONE,
@@ -76,8 +227,8 @@ namespace lox
 
 		struct parse_rule
 		{
-			lox::parse_result<> (lox::parser::*prefix)();
-			lox::parse_result<> (lox::parser::*infix)();
+			lox::parse_result<> (lox::parser::*prefix)(bool can_assign);
+			lox::parse_result<> (lox::parser::*infix)(bool can_assign);
 			lox::parser::precedence precedence;
 		};
 
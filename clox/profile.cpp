@@ -0,0 +1,80 @@
+#include "profile.hpp"
+
+#include <lak/string_ostream.hpp>
+
+#include <algorithm>
+#include <iomanip>
+
+void lox::opcode_profile::record(const lox::chunk &chunk, size_t offset)
+{
+	const auto op = static_cast<lox::opcode>(chunk.code_at(offset));
+	const auto id = [](lox::opcode op) { return static_cast<uint32_t>(op); };
+
+	++singles[id(op)];
+
+	if (&chunk == last_chunk && offset == last_next)
+	{
+		++pairs[(id(last[1]) << 8) | id(op)];
+		if (run_length >= 2U)
+			++triples[(id(last[0]) << 16) | (id(last[1]) << 8) | id(op)];
+		++run_length;
+	}
+	else
+	{
+		run_length = 1U;
+	}
+
+	last[0]    = last[1];
+	last[1]    = op;
+	last_chunk = &chunk;
+	last_next  = chunk.next_instruction(offset);
+}
+
+void report_sequences(std::ostream &strm,
+                      const std::unordered_map<uint32_t, uint64_t> &counts,
+                      size_t length,
+                      uint64_t total,
+                      size_t top)
+{
+	using lak::operator<<;
+
+	std::vector<std::pair<uint32_t, uint64_t>> sorted(counts.begin(),
+	                                                  counts.end());
+	std::sort(sorted.begin(),
+	          sorted.end(),
+	          [](const auto &a, const auto &b) { return a.second > b.second; });
+	if (sorted.size() > top) sorted.resize(top);
+
+	for (const auto &[key, count] : sorted)
+	{
+		strm << std::setw(12) << count << std::setw(7) << std::fixed
+		     << std::setprecision(2) << (100.0 * double(count) / double(total))
+		     << "% ";
+		for (size_t i = length; i-- > 0U;)
+		{
+			const auto op = static_cast<lox::opcode>((key >> (i * 8U)) & 0xFFU);
+			strm << lox::to_string(op);
+			if (i > 0U) strm << " ";
+		}
+		strm << "\n";
+	}
+}
+
+void lox::opcode_profile::report(std::ostream &strm, size_t top) const
+{
+	uint64_t total = 0U;
+	std::unordered_map<uint32_t, uint64_t> ops;
+	for (size_t i = 0U; i < singles.size(); ++i)
+	{
+		total += singles[i];
+		if (singles[i] > 0U) ops[static_cast<uint32_t>(i)] = singles[i];
+	}
+	if (total == 0U) return;
+
+	strm << "== opcodes (" << total << " executed) ==\n";
+	report_sequences(strm, ops, 1U, total, top);
+	strm << "== pairs ==\n";
+	report_sequences(strm, pairs, 2U, total, top);
+	strm << "== triples ==\n";
+	report_sequences(strm, triples, 3U, total, top);
+}
@@ -0,0 +1,38 @@
+#ifndef LOX_PROFILE_HPP
+#define LOX_PROFILE_HPP
+
+#include "chunk.hpp"
+
+#include <lak/stdint.hpp>
+
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace lox
+{
+	// Counts how often each opcode, and each pair and triple of adjacent
+	// opcodes, is executed. A sequence is only counted when it runs straight
+	// through, since those are the ones a superinstruction could replace.
+	//
+	// Enabled with LOX_PROFILE_OPCODES.
+	struct opcode_profile
+	{
+		std::vector<uint64_t> singles = std::vector<uint64_t>(lox::opcode_count);
+		std::unordered_map<uint32_t, uint64_t> pairs;
+		std::unordered_map<uint32_t, uint64_t> triples;
+
+		const lox::chunk *last_chunk = nullptr;
+		size_t last_next             = 0U;
+		size_t run_length            = 0U;
+		lox::opcode last[2]          = {};
+
+		// called before the instruction at offset executes.
+		void record(const lox::chunk &chunk, size_t offset);
+
+		// the most frequent top opcodes, pairs and triples.
+		void report(std::ostream &strm, size_t top = 20U) const;
+	};
+}
+
+#endif
@@ -0,0 +1,30 @@
+#include "program.hpp"
+#include "virtual_machine.hpp"
+
+template<typename SOURCE>
+lox::program_result<lox::program> compile_program(
+  SOURCE &source, const lox::compile_options &options)
+{
+	// compile against the globals of a fresh VM so that the slots match those
+	// of the VMs that will run it
+	lox::virtual_machine vm;
+	vm.init_globals();
+
+	RES_TRY_ASSIGN(lox::function_ptr script =,
+	               lox::compile(source, vm.global_names, options));
+	RES_TRY_ASSIGN(std::vector<byte_t> bytecode =,
+	               lox::serialise(*script, vm.global_names));
+	return lak::ok_t{lox::program{.bytecode = lak::move(bytecode)}};
+}
+
+lox::program_result<lox::program> lox::program::compile(
+  lak::u8string_view source, const lox::compile_options &options)
+{
+	return compile_program(source, options);
+}
+
+lox::program_result<lox::program> lox::program::compile(
+  std::istream &source, const lox::compile_options &options)
+{
+	return compile_program(source, options);
+}
@@ -0,0 +1,43 @@
+#ifndef LOX_PROGRAM_HPP
+#define LOX_PROGRAM_HPP
+
+#include "bytecode.hpp"
+#include "compiler.hpp"
+#include "error.hpp"
+
+#include <lak/result.hpp>
+#include <lak/string_view.hpp>
+
+#include <istream>
+#include <vector>
+
+namespace lox
+{
+	using program_error = lox::result_set<lox::scan_error,
+	                                      lox::parse_error,
+	                                      lox::compile_error,
+	                                      lox::bytecode_error>;
+
+	template<typename T = lak::monostate>
+	using program_result = lak::result<T, lox::program_error>;
+
+	// A compiled script that any number of virtual machines can run at once,
+	// from different threads. Only the .loxc image is shared: each VM executes
+	// the code in place but makes its own constants, so no reference counted
+	// object is ever shared between threads.
+	//
+	// Global slots are assigned as if by a freshly initialised VM, so it can
+	// only be run by VMs that haven't defined any globals of their own.
+	struct program
+	{
+		std::vector<byte_t> bytecode;
+
+		static lox::program_result<lox::program> compile(
+		  lak::u8string_view source, const lox::compile_options &options = {});
+
+		static lox::program_result<lox::program> compile(
+		  std::istream &source, const lox::compile_options &options = {});
+	};
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "registers.hpp"
+#include "rewrite.hpp"
+
+lak::optional<size_t> lower(const lox::chunk &chunk,
+                            size_t offset,
+                            const std::vector<bool> &is_target,
+                            lox::chunk &out)
+{
+	// the instructions this one runs straight into, up to the longest pattern
+	size_t at[5];
+	size_t count = 0U;
+	for (size_t i = offset; count < 5U && i < chunk.code.size() &&
+	                        (count == 0U || !is_target[i]);
+	     i = chunk.next_instruction(i))
+		at[count++] = i;
+
+	auto op      = [&](size_t i)
+	{ return static_cast<lox::opcode>(chunk.code[at[i]]); };
+	auto operand = [&](size_t i) { return chunk.code[at[i] + 1U]; };
+
+	if (count < 3U) return lak::nullopt;
+
+	const bool local    = op(0) == lox::opcode::OP_GET_LOCAL;
+	const bool constant = op(0) == lox::opcode::OP_CONSTANT;
+
+	// d = a; and d = k;
+	if ((local || constant) && op(1) == lox::opcode::OP_SET_LOCAL &&
+	    op(2) == lox::opcode::OP_POP)
+	{
+		const size_t line = chunk.lines[at[1]];
+		out.push_opcode(
+		  local ? lox::opcode::OP_MOVE_RR : lox::opcode::OP_MOVE_RK, line);
+		out.push_code(operand(1), line);
+		out.push_code(operand(0), line);
+		return chunk.next_instruction(at[2]);
+	}
+
+	if (!local) return lak::nullopt;
+
+	const bool rhs_local    = op(1) == lox::opcode::OP_GET_LOCAL;
+	const bool rhs_constant = op(1) == lox::opcode::OP_CONSTANT;
+	if (!rhs_local && !rhs_constant) return lak::nullopt;
+
+	const bool store = count == 5U && op(3) == lox::opcode::OP_SET_LOCAL &&
+	                   op(4) == lox::opcode::OP_POP;
+
+	// errors are reported at the operator's line
+	const size_t line = chunk.lines[at[2]];
+
+	auto emit = [&](lox::opcode inst, bool with_destination)
+	{
+		out.push_opcode(inst, line);
+		if (with_destination) out.push_code(operand(3), line);
+		out.push_code(operand(0), line);
+		out.push_code(operand(1), line);
+	};
+
+	switch (op(2))
+	{
+#define LOX_LOWER_ARITHMETIC(OP, ...)                                         \
+	case lox::opcode::OP_##OP:                                                  \
+		if (store)                                                                \
+		{                                                                         \
+			emit(rhs_local ? lox::opcode::OP_##OP##_RRR                             \
+			               : lox::opcode::OP_##OP##_RRK,                            \
+			     true);                                                             \
+			return chunk.next_instruction(at[4]);                                   \
+		}                                                                         \
+		emit(rhs_local ? lox::opcode::OP_##OP##_RR : lox::opcode::OP_##OP##_RK,   \
+		     false);                                                              \
+		return chunk.next_instruction(at[2]);
+		LOX_REGISTER_ARITHMETIC_FOREACH(LOX_LOWER_ARITHMETIC)
+#undef LOX_LOWER_ARITHMETIC
+
+#define LOX_LOWER_COMPARISON(OP, ...)                                         \
+	case lox::opcode::OP_##OP:                                                  \
+		emit(rhs_local ? lox::opcode::OP_##OP##_RR : lox::opcode::OP_##OP##_RK,   \
+		     false);                                                              \
+		return chunk.next_instruction(at[2]);
+		LOX_REGISTER_COMPARISON_FOREACH(LOX_LOWER_COMPARISON)
+#undef LOX_LOWER_COMPARISON
+
+		default: return lak::nullopt;
+	}
+}
+
+void lox::lower_to_registers(lox::chunk &chunk)
+{
+	lox::rewrite_chunk(chunk, lower);
+}
@@ -0,0 +1,28 @@
+#ifndef LOX_REGISTERS_HPP
+#define LOX_REGISTERS_HPP
+
+#include "chunk.hpp"
+
+#include <lak/stdint.hpp>
+
+namespace lox
+{
+	enum struct backend : uint8_t
+	{
+		// every operand goes through the value stack.
+		stack,
+		// binary operators and assignments whose operands are locals or
+		// constants read and write the frame's slots directly, see
+		// LOX_REGISTER_ARITHMETIC_FOREACH.
+		registers,
+	};
+
+	// Replaces the stack instruction sequences that have a three-address form
+	// with it: a local and a local or constant feeding a binary operator,
+	// optionally stored straight to a local, and a local or constant assigned
+	// to a local. Everything else, including any sequence that is jumped into,
+	// is left on the stack.
+	void lower_to_registers(lox::chunk &chunk);
+}
+
+#endif
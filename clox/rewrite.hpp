@@ -0,0 +1,94 @@
+#ifndef LOX_REWRITE_HPP
+#define LOX_REWRITE_HPP
+
+#include "chunk.hpp"
+
+#include <lak/debug.hpp>
+#include <lak/optional.hpp>
+#include <lak/stdint.hpp>
+#include <lak/utility.hpp>
+
+#include <utility>
+#include <vector>
+
+namespace lox
+{
+	// Rebuilds chunk's code front to back. At the start of each instruction
+	// rewrite(chunk, offset, is_target, out) may push a replacement for one or
+	// more whole instructions to out and return the offset just past them, or
+	// return nullopt to have the instruction copied as is. is_target[offset] is
+	// set for every offset that something jumps to, a replacement should only
+	// swallow instructions that aren't.
+	//
+	// Jump operands are recomputed once everything has moved, a replacement
+	// that starts with a jump must keep its operand in the same place. A jump
+	// can also be replaced with nothing at all.
+	template<typename REWRITE>
+	void rewrite_chunk(lox::chunk &chunk, REWRITE &&rewrite)
+	{
+		ASSERT(chunk.mapped_code.empty());
+
+		const size_t size = chunk.code.size();
+
+		std::vector<bool> is_target(size + 1U, false);
+		for (size_t offset = 0U; offset < size;
+		     offset        = chunk.next_instruction(offset))
+		{
+			if (const lak::optional<size_t> target = chunk.jump_target(offset);
+			    target)
+				is_target[*target] = true;
+		}
+
+		lox::chunk out;
+		out.code.reserve(size);
+		out.lines.reserve(size);
+
+		// where each instruction has moved to
+		std::vector<size_t> moved(size + 1U, 0U);
+
+		// (new offset, old target) of every jump
+		std::vector<std::pair<size_t, size_t>> jumps;
+
+		for (size_t offset = 0U; offset < size;)
+		{
+			const size_t start = out.code.size();
+
+			size_t next;
+			if (const lak::optional<size_t> end =
+			      rewrite(std::as_const(chunk), offset, is_target, out);
+			    end)
+			{
+				next = *end;
+			}
+			else
+			{
+				next = chunk.next_instruction(offset);
+				for (size_t i = offset; i < next; ++i)
+					out.push_code(chunk.code[i], chunk.lines[i]);
+			}
+
+			if (const lak::optional<size_t> target = chunk.jump_target(offset);
+			    target && out.code.size() > start)
+				jumps.emplace_back(start, *target);
+
+			for (; offset < next; offset = chunk.next_instruction(offset))
+				moved[offset] = start;
+		}
+		moved[size] = out.code.size();
+
+		for (const auto &[offset, old_target] : jumps)
+		{
+			const size_t target = moved[old_target];
+			const size_t jump   = target > offset ? target - (offset + 3U)
+			                                      : (offset + 3U) - target;
+			ASSERT_LESS_OR_EQUAL(jump, UINT16_MAX);
+			out.code[offset + 1U] = static_cast<uint8_t>((jump >> 8) & 0xFF);
+			out.code[offset + 2U] = static_cast<uint8_t>(jump & 0xFF);
+		}
+
+		chunk.code  = lak::move(out.code);
+		chunk.lines = lak::move(out.lines);
+	}
+}
+
+#endif
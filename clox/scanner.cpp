@@ -15,9 +15,43 @@ bool lox::is_ident_char(char8_t c)
 
 lox::scanner::scanner(lak::u8string_view src) : source(src) {}
 
-bool lox::scanner::empty() const
+lox::scanner::scanner(std::istream &strm, size_t size)
+: stream(&strm), window_size(size)
 {
-	return current >= source.size();
+	window.reserve(window_size);
+}
+
+bool lox::scanner::refill()
+{
+	if (!stream) return false;
+
+	window.erase(window.begin(), window.begin() + start);
+	current -= start;
+	start = 0U;
+
+	// the current token fills the entire window
+	if (window.size() >= window_size) window_size *= 2U;
+
+	const size_t kept = window.size();
+	window.resize(window_size);
+	stream->read(reinterpret_cast<char *>(window.data() + kept),
+	             static_cast<std::streamsize>(window_size - kept));
+	window.resize(kept + static_cast<size_t>(stream->gcount()));
+
+	source = lak::u8string_view(window.data(), window.size());
+	return window.size() > kept;
+}
+
+bool lox::scanner::fill(size_t count)
+{
+	while (current + count > source.size())
+		if (!refill()) return false;
+	return true;
+}
+
+bool lox::scanner::empty()
+{
+	return !fill(1U);
 }
 
 char8_t lox::scanner::next()
@@ -25,14 +59,14 @@ char8_t lox::scanner::next()
 	return source[current++];
 }
 
-char8_t lox::scanner::peek() const
+char8_t lox::scanner::peek()
 {
-	return empty() ? u8'\0' : source[current];
+	return fill(1U) ? source[current] : u8'\0';
 }
 
-char8_t lox::scanner::peek_next() const
+char8_t lox::scanner::peek_next()
 {
-	return current + 1 >= source.size() ? u8'\0' : source[current + 1];
+	return fill(2U) ? source[current + 1] : u8'\0';
 }
 
 bool lox::scanner::match(char8_t expected)
@@ -42,14 +76,12 @@ bool lox::scanner::match(char8_t expected)
 	return true;
 }
 
-lak::ok_t<lox::token> lox::scanner::build_token(lox::token_type type,
-                                                lox::value literal)
+lak::ok_t<lox::token> lox::scanner::build_token(lox::token_type type)
 {
 	return {{
-	  .type    = type,
-	  .lexeme  = source.substr(start, current - start),
-	  .literal = lak::move(literal),
-	  .line    = line,
+	  .type = type,
+	  .line = static_cast<uint32_t>(line),
+	  .text = &lexemes.intern(source.substr(start, current - start)),
 	}};
 }
 
@@ -63,16 +95,15 @@ lox::scan_result<lox::token> lox::scanner::scan_string()
 
 	if (empty())
 	{
-		return lak::err_t{lox::scan_error(line, u8"Unterminated string."_str)};
+		return lak::err_t{
+		  lox::scan_error::at(line, u8"Unterminated string."_str)};
 	}
 
 	// the closing "
 	next();
 
-	// trim the surrounding quotes
-	auto value = source.substr(start + 1, (current - 1) - (start + 1));
-	return build_token(lox::token_type::STRING,
-	                   lox::value{/*value.to_string()*/});
+	// the parser builds the string constant from the lexeme
+	return build_token(lox::token_type::STRING);
 }
 
 lox::scan_result<lox::token> lox::scanner::scan_number()
@@ -86,21 +117,8 @@ lox::scan_result<lox::token> lox::scanner::scan_number()
 		while (lak::is_alphanumeric(peek())) next();
 	}
 
-	auto u8str{
-	  lak::u8string_view{source.data() + start, source.data() + current}};
-
-	auto str{lak::as_astring(u8str)};
-
-	double number;
-
-	auto result = std::from_chars(str.begin(), str.end(), number);
-
-	if (result.ec == std::errc())
-		// no error
-		return build_token(lox::token_type::NUMBER, lox::value{number});
-	else
-		return lak::err_t{lox::scan_error(
-		  line, u8"Invalid number. '"_str + lak::u8string(u8str) + u8"'"_str)};
+	// the parser decodes the value from the lexeme
+	return build_token(lox::token_type::NUMBER);
 }
 
 lox::scan_result<lox::token> lox::scanner::scan_identifier()
@@ -169,12 +187,6 @@ lox::scan_result<lox::token> lox::scanner::scan_token()
 
 			case u8'"': return scan_string();
 
-			case u8'o':
-				if (match(u8'r'))
-					return build_token(lox::token_type::OR);
-				else
-					break;
-
 			default:
 				if (lak::is_alphanumeric(c))
 					return scan_number();
@@ -189,22 +201,7 @@ lox::scan_result<lox::token> lox::scanner::scan_token()
 	}
 
 	return lak::ok_t{lox::token{
-	  .type    = lox::token_type::EOF_TOK,
-	  .lexeme  = u8"",
-	  .literal = lox::value{},
-	  .line    = line,
+	  .type = lox::token_type::EOF_TOK,
+	  .line = static_cast<uint32_t>(line),
 	}};
 }
-
-lox::scan_result<std::vector<lox::token>> lox::scanner::scan_tokens()
-{
-	std::vector<lox::token> tokens;
-
-	while (!empty())
-	{
-		RES_TRY_ASSIGN(lox::token token =, scan_token());
-		tokens.push_back(token);
-	}
-
-	return lak::ok_t<std::vector<lox::token>>{tokens};
-}
@@ -2,12 +2,14 @@
 #define LOX_SCANNER_HPP
 
 #include "error.hpp"
+#include "lexeme_table.hpp"
 #include "token.hpp"
 #include "value.hpp"
 
 #include <lak/result.hpp>
 #include <lak/string_view.hpp>
 
+#include <istream>
 #include <unordered_map>
 #include <vector>
 
@@ -44,27 +46,51 @@ namespace lox
 	template<typename T = lak::monostate>
 	using scan_result = lak::result<T, lox::scan_error>;
 
+	// Tokens are produced on demand. When scanning a stream the input is
+	// pulled through a bounded window, so memory use doesn't grow with the
+	// size of the source. Token lexemes are interned into lexemes and remain
+	// valid for the lifetime of the scanner.
 	struct scanner
 	{
+		static constexpr size_t default_window_size = 64U * 1024U;
+
+		// null when scanning a source that is already in memory.
+		std::istream *stream = nullptr;
+		std::vector<char8_t> window;
+		// only grows if a single token doesn't fit.
+		size_t window_size = default_window_size;
+
+		// the part of the input currently in memory, start and current index
+		// into this.
 		lak::u8string_view source;
 		size_t start   = 0;
 		size_t current = 0;
 		size_t line    = 1;
 
+		lox::lexeme_table lexemes;
+
 		scanner(lak::u8string_view src);
 
-		bool empty() const;
+		scanner(std::istream &strm, size_t size = default_window_size);
+
+		// discard everything before start and read more of the stream into the
+		// window. returns false at the end of the input.
+		bool refill();
+
+		// make sure there are at least count characters after current.
+		bool fill(size_t count);
+
+		bool empty();
 
 		char8_t next();
 
-		char8_t peek() const;
+		char8_t peek();
 
-		char8_t peek_next() const;
+		char8_t peek_next();
 
 		bool match(char8_t expected);
 
-		lak::ok_t<lox::token> build_token(lox::token_type type,
-		                                  lox::value literal = lox::value{});
+		lak::ok_t<lox::token> build_token(lox::token_type type);
 
 		lox::scan_result<lox::token> scan_string();
 
@@ -73,8 +99,6 @@ namespace lox
 		lox::scan_result<lox::token> scan_identifier();
 
 		lox::scan_result<lox::token> scan_token();
-
-		lox::scan_result<std::vector<lox::token>> scan_tokens();
 	};
 
 }
@@ -0,0 +1,59 @@
+#include "superinstructions.hpp"
+#include "rewrite.hpp"
+
+struct superinstruction
+{
+	lox::opcode fused;
+	lox::opcode first;
+	lox::opcode second;
+};
+
+constexpr superinstruction superinstructions[] = {
+#define LOX_SUPERINSTRUCTION_ENTRY(FUSED, FIRST, SECOND, ...)                 \
+	superinstruction{.fused  = lox::opcode::FUSED,                              \
+	                 .first  = lox::opcode::FIRST,                              \
+	                 .second = lox::opcode::SECOND},
+	LOX_SUPERINSTRUCTION_FOREACH(LOX_SUPERINSTRUCTION_ENTRY)
+#undef LOX_SUPERINSTRUCTION_ENTRY
+};
+
+lak::optional<lox::opcode> fused_opcode(uint8_t first, uint8_t second)
+{
+	for (const superinstruction &s : superinstructions)
+		if (static_cast<uint8_t>(s.first) == first &&
+		    static_cast<uint8_t>(s.second) == second)
+			return s.fused;
+	return lak::nullopt;
+}
+
+lak::optional<size_t> fuse(const lox::chunk &chunk,
+                           size_t offset,
+                           const std::vector<bool> &is_target,
+                           lox::chunk &out)
+{
+	const size_t next = chunk.next_instruction(offset);
+	if (next >= chunk.code.size() || is_target[next]) return lak::nullopt;
+
+	const lak::optional<lox::opcode> fused =
+	  fused_opcode(chunk.code[offset], chunk.code[next]);
+	if (!fused) return lak::nullopt;
+
+	const size_t end = chunk.next_instruction(next);
+
+	out.push_opcode(*fused, chunk.lines[offset]);
+	for (size_t i = offset + 1U; i < next; ++i)
+		out.push_code(chunk.code[i], chunk.lines[i]);
+	for (size_t i = next + 1U; i < end; ++i)
+		out.push_code(chunk.code[i], chunk.lines[i]);
+
+	// runtime errors are reported at the line of the last byte read, which
+	// should be the second instruction's
+	out.lines.back() = chunk.lines[end - 1U];
+
+	return end;
+}
+
+void lox::fuse_superinstructions(lox::chunk &chunk)
+{
+	lox::rewrite_chunk(chunk, fuse);
+}
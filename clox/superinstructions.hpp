@@ -0,0 +1,15 @@
+#ifndef LOX_SUPERINSTRUCTIONS_HPP
+#define LOX_SUPERINSTRUCTIONS_HPP
+
+#include "chunk.hpp"
+
+namespace lox
+{
+	// Replaces each pair in LOX_SUPERINSTRUCTION_FOREACH with its
+	// superinstruction, then moves every jump to account for the removed
+	// opcodes. Pairs are fused left to right, so of two overlapping pairs only
+	// the first is.
+	void fuse_superinstructions(lox::chunk &chunk);
+}
+
+#endif
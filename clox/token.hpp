@@ -1,9 +1,9 @@
 #ifndef LOX_TOKEN_HPP
 #define LOX_TOKEN_HPP
 
-#include "value.hpp"
-
+#include <lak/result.hpp>
 #include <lak/stdint.hpp>
+#include <lak/string.hpp>
 #include <lak/string_ostream.hpp>
 #include <lak/string_view.hpp>
 
@@ -57,7 +57,7 @@ namespace lox
 	MACRO(ERROR_TOK)                                                            \
 	MACRO(EOF_TOK)
 
-	enum struct token_type
+	enum struct token_type : uint8_t
 	{
 #define LOX_GEN_TOKEN_TYPE(TOKEN) TOKEN,
 		LOX_TOKEN_TYPE_FOREACH(LOX_GEN_TOKEN_TYPE)
@@ -66,21 +66,34 @@ namespace lox
 
 	lak::u8string_view to_string(token_type type);
 
+	// Tokens are kept to 16 bytes. The lexeme is owned by a lexeme_table (or
+	// has static storage) and literal values are decoded from it on demand.
 	struct token
 	{
 		lox::token_type type;
-		lak::u8string_view lexeme;
-		lox::value literal;
-		size_t line = 1;
+		uint32_t line             = 1U;
+		const lak::u8string *text = nullptr;
+
+		lak::u8string_view lexeme() const
+		{
+			return text ? lak::u8string_view(*text) : lak::u8string_view{};
+		}
+
+		// the value of a NUMBER token, or an error if it is out of range.
+		lak::result<double> number() const;
+
+		// the contents of a STRING token, without the surrounding quotes.
+		lak::u8string_view string() const;
 
 		friend inline std::ostream &operator<<(std::ostream &strm,
 		                                       const lox::token &token)
 		{
 			using lak::operator<<;
-			strm << lox::to_string(token.type) << " " << token.lexeme << " "
-			     << lox::to_string(token.literal);
+			strm << lox::to_string(token.type) << " " << token.lexeme();
+			return strm;
 		}
 	};
+	static_assert(sizeof(lox::token) <= 16U);
 }
 
 #endif
@@ -1,6 +1,12 @@
 #include "value.hpp"
+#include "object.hpp"
+#include "output.hpp"
+
+#include <lox/number.hpp>
 
 #include <lak/streamify.hpp>
+#include <lak/string_literals.hpp>
+#include <lak/string_ostream.hpp>
 
 lox::value::value()
 : _value(lak::in_place_index<value_type::index_of<lak::monostate>>,
@@ -24,6 +30,48 @@ lox::value::value(double d)
 {
 }
 
+lox::value::value(lox::string_ptr s)
+: _value(lak::in_place_index<value_type::index_of<lox::string_ptr>>,
+         lak::move(s))
+{
+}
+
+lox::value::value(lox::function_ptr f)
+: _value(lak::in_place_index<value_type::index_of<lox::function_ptr>>,
+         lak::move(f))
+{
+}
+
+lox::value::value(lox::closure_ptr c)
+: _value(lak::in_place_index<value_type::index_of<lox::closure_ptr>>,
+         lak::move(c))
+{
+}
+
+lox::value::value(lox::type_ptr t)
+: _value(lak::in_place_index<value_type::index_of<lox::type_ptr>>,
+         lak::move(t))
+{
+}
+
+lox::value::value(lox::instance_ptr i)
+: _value(lak::in_place_index<value_type::index_of<lox::instance_ptr>>,
+         lak::move(i))
+{
+}
+
+lox::value::value(lox::bound_method_ptr b)
+: _value(lak::in_place_index<value_type::index_of<lox::bound_method_ptr>>,
+         lak::move(b))
+{
+}
+
+lox::value::value(lox::native_ptr n)
+: _value(lak::in_place_index<value_type::index_of<lox::native_ptr>>,
+         lak::move(n))
+{
+}
+
 bool lox::value::is_nil() const
 {
 	return _value.index() == value_type::index_of<lak::monostate>;
@@ -39,15 +87,62 @@ bool lox::value::is_number() const
 	return _value.index() == value_type::index_of<double>;
 }
 
+bool lox::value::is_string() const
+{
+	return _value.index() == value_type::index_of<lox::string_ptr>;
+}
+
+bool lox::value::is_function() const
+{
+	return _value.index() == value_type::index_of<lox::function_ptr>;
+}
+
+bool lox::value::is_closure() const
+{
+	return _value.index() == value_type::index_of<lox::closure_ptr>;
+}
+
+bool lox::value::is_type() const
+{
+	return _value.index() == value_type::index_of<lox::type_ptr>;
+}
+
+bool lox::value::is_instance() const
+{
+	return _value.index() == value_type::index_of<lox::instance_ptr>;
+}
+
+bool lox::value::is_bound_method() const
+{
+	return _value.index() == value_type::index_of<lox::bound_method_ptr>;
+}
+
+bool lox::value::is_native() const
+{
+	return _value.index() == value_type::index_of<lox::native_ptr>;
+}
+
 bool lox::value::is_truthy() const
 {
 	return visit(lak::overloaded{
 	  [](lak::monostate) -> bool { return false; },
 	  [](bool b) -> bool { return b; },
-	  [](double) -> bool { return true; },
+	  [](auto &&) -> bool { return true; },
 	});
 }
 
+bool lox::value::both_numbers(const value &a, const value &b)
+{
+	constexpr size_t index = value_type::index_of<double>;
+	return ((a._value.index() ^ index) | (b._value.index() ^ index)) == 0U;
+}
+
+bool lox::value::both_strings(const value &a, const value &b)
+{
+	constexpr size_t index = value_type::index_of<lox::string_ptr>;
+	return ((a._value.index() ^ index) | (b._value.index() ^ index)) == 0U;
+}
+
 lak::result<lak::monostate &> lox::value::as_nil()
 {
 	return lak::result_from_pointer(_value.template get<lak::monostate>());
@@ -78,6 +173,78 @@ lak::result<const double &> lox::value::as_number() const
 	return lak::result_from_pointer(_value.template get<double>());
 }
 
+lak::result<lox::string_ptr &> lox::value::as_string()
+{
+	return lak::result_from_pointer(_value.template get<lox::string_ptr>());
+}
+
+lak::result<const lox::string_ptr &> lox::value::as_string() const
+{
+	return lak::result_from_pointer(_value.template get<lox::string_ptr>());
+}
+
+lak::result<lox::function_ptr &> lox::value::as_function()
+{
+	return lak::result_from_pointer(_value.template get<lox::function_ptr>());
+}
+
+lak::result<const lox::function_ptr &> lox::value::as_function() const
+{
+	return lak::result_from_pointer(_value.template get<lox::function_ptr>());
+}
+
+lak::result<lox::closure_ptr &> lox::value::as_closure()
+{
+	return lak::result_from_pointer(_value.template get<lox::closure_ptr>());
+}
+
+lak::result<const lox::closure_ptr &> lox::value::as_closure() const
+{
+	return lak::result_from_pointer(_value.template get<lox::closure_ptr>());
+}
+
+lak::result<lox::type_ptr &> lox::value::as_type()
+{
+	return lak::result_from_pointer(_value.template get<lox::type_ptr>());
+}
+
+lak::result<const lox::type_ptr &> lox::value::as_type() const
+{
+	return lak::result_from_pointer(_value.template get<lox::type_ptr>());
+}
+
+lak::result<lox::instance_ptr &> lox::value::as_instance()
+{
+	return lak::result_from_pointer(_value.template get<lox::instance_ptr>());
+}
+
+lak::result<const lox::instance_ptr &> lox::value::as_instance() const
+{
+	return lak::result_from_pointer(_value.template get<lox::instance_ptr>());
+}
+
+lak::result<lox::bound_method_ptr &> lox::value::as_bound_method()
+{
+	return lak::result_from_pointer(
+	  _value.template get<lox::bound_method_ptr>());
+}
+
+lak::result<const lox::bound_method_ptr &> lox::value::as_bound_method() const
+{
+	return lak::result_from_pointer(
+	  _value.template get<lox::bound_method_ptr>());
+}
+
+lak::result<lox::native_ptr &> lox::value::as_native()
+{
+	return lak::result_from_pointer(_value.template get<lox::native_ptr>());
+}
+
+lak::result<const lox::native_ptr &> lox::value::as_native() const
+{
+	return lak::result_from_pointer(_value.template get<lox::native_ptr>());
+}
+
 bool lox::value::operator==(const lox::value &other) const
 {
 	if (_value.index() != other._value.index()) return false;
@@ -87,6 +254,46 @@ bool lox::value::operator==(const lox::value &other) const
 	  { return b == *other._value.template get<bool>(); },
 	  [&](const double &d) -> bool
 	  { return d == *other._value.template get<double>(); },
+	  [&](const lox::string_ptr &s) -> bool
+	  {
+		  const lox::string_ptr &o = *other._value.template get<lox::string_ptr>();
+		  return s.get() == o.get() || s->value == o->value;
+	  },
+	  [&](const lox::function_ptr &f) -> bool
+	  {
+		  const lox::function_ptr &o =
+		    *other._value.template get<lox::function_ptr>();
+		  return f.get() == o.get();
+	  },
+	  [&](const lox::closure_ptr &c) -> bool
+	  {
+		  const lox::closure_ptr &o =
+		    *other._value.template get<lox::closure_ptr>();
+		  return c.get() == o.get();
+	  },
+	  [&](const lox::type_ptr &t) -> bool
+	  {
+		  const lox::type_ptr &o =
+		    *other._value.template get<lox::type_ptr>();
+		  return t.get() == o.get();
+	  },
+	  [&](const lox::instance_ptr &i) -> bool
+	  {
+		  const lox::instance_ptr &o =
+		    *other._value.template get<lox::instance_ptr>();
+		  return i.get() == o.get();
+	  },
+	  [&](const lox::bound_method_ptr &b) -> bool
+	  {
+		  const lox::bound_method_ptr &o =
+		    *other._value.template get<lox::bound_method_ptr>();
+		  return b.get() == o.get();
+	  },
+	  [&](const lox::native_ptr &n) -> bool
+	  {
+		  const lox::native_ptr &o = *other._value.template get<lox::native_ptr>();
+		  return n.get() == o.get();
+	  },
 	});
 }
 
@@ -97,9 +304,38 @@ std::ostream &lox::operator<<(std::ostream &strm, const lox::value &val)
 	    [&](lak::monostate) { strm << "nil"; },
 	    [&](const bool &b) { strm << (b ? "true" : "false"); },
 	    [&](const double &d) { strm << d; },
+	    [&](const lox::string_ptr &s)
+	    {
+		    using lak::operator<<;
+		    strm << s->value;
+	    },
+	    [&](const lox::function_ptr &f) { strm << *f; },
+	    [&](const lox::closure_ptr &c) { strm << *c->function; },
+	    [&](const lox::type_ptr &t) { strm << *t; },
+	    [&](const lox::instance_ptr &i) { strm << *i; },
+	    [&](const lox::bound_method_ptr &b) { strm << *b->method->function; },
+	    [&](const lox::native_ptr &) { strm << "<native function>"; },
 	  },
 	  val._value);
 	return strm;
 }
 
-lak::u8string lox::to_string(const lox::value &v) { return lak::streamify(v); }
+void lox::write(lox::output &out, const lox::value &val)
+{
+	lak::visit(
+	  lak::overloaded{
+	    [&](lak::monostate) { out.write(u8"nil"_view); },
+	    [&](const bool &b) { out.write(b ? u8"true"_view : u8"false"_view); },
+	    [&](const double &d) { out.write(d); },
+	    [&](const lox::string_ptr &s) { out.write(s->value); },
+	    [&](const auto &) { out.write(lox::to_string(val)); },
+	  },
+	  val._value);
+}
+
+lak::u8string lox::to_string(const lox::value &v)
+{
+	if_let_ok (const double &d, v.as_number())
+		return lox::number_to_string(d, lox::number_format::general);
+	return lak::streamify(v);
+}
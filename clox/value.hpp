@@ -1,6 +1,7 @@
 #ifndef LOX_VALUE_HPP
 #define LOX_VALUE_HPP
 
+#include <lak/memory.hpp>
 #include <lak/result.hpp>
 #include <lak/string.hpp>
 #include <lak/variant.hpp>
@@ -10,9 +11,36 @@
 
 namespace lox
 {
+	struct output;
+	struct string;
+	struct function;
+	struct closure;
+	struct upvalue;
+	struct type;
+	struct instance;
+	struct bound_method;
+	struct native;
+	using string_ptr       = lak::shared_ref<lox::string>;
+	using function_ptr     = lak::shared_ref<lox::function>;
+	using closure_ptr      = lak::shared_ref<lox::closure>;
+	using upvalue_ptr      = lak::shared_ref<lox::upvalue>;
+	using type_ptr         = lak::shared_ref<lox::type>;
+	using instance_ptr     = lak::shared_ref<lox::instance>;
+	using bound_method_ptr = lak::shared_ref<lox::bound_method>;
+	using native_ptr       = lak::shared_ref<lox::native>;
+
 	struct value
 	{
-		using value_type = lak::variant<lak::monostate, bool, double>;
+		using value_type = lak::variant<lak::monostate,
+		                                bool,
+		                                double,
+		                                lox::string_ptr,
+		                                lox::function_ptr,
+		                                lox::closure_ptr,
+		                                lox::type_ptr,
+		                                lox::instance_ptr,
+		                                lox::bound_method_ptr,
+		                                lox::native_ptr>;
 		value_type _value;
 
 		value();
@@ -23,14 +51,48 @@ namespace lox
 
 		value(double d);
 
+		value(lox::string_ptr s);
+
+		value(lox::function_ptr f);
+
+		value(lox::closure_ptr c);
+
+		value(lox::type_ptr t);
+
+		value(lox::instance_ptr i);
+
+		value(lox::bound_method_ptr b);
+
+		value(lox::native_ptr n);
+
 		bool is_nil() const;
 
 		bool is_bool() const;
 
 		bool is_number() const;
 
+		bool is_string() const;
+
+		bool is_function() const;
+
+		bool is_closure() const;
+
+		bool is_type() const;
+
+		bool is_instance() const;
+
+		bool is_bound_method() const;
+
+		bool is_native() const;
+
 		bool is_truthy() const;
 
+		// is_number/is_string of both operands of a binary operator, as a single
+		// test.
+		static bool both_numbers(const value &a, const value &b);
+
+		static bool both_strings(const value &a, const value &b);
+
 		lak::result<lak::monostate &> as_nil();
 		lak::result<const lak::monostate &> as_nil() const;
 
@@ -40,6 +102,27 @@ namespace lox
 		lak::result<double &> as_number();
 		lak::result<const double &> as_number() const;
 
+		lak::result<lox::string_ptr &> as_string();
+		lak::result<const lox::string_ptr &> as_string() const;
+
+		lak::result<lox::function_ptr &> as_function();
+		lak::result<const lox::function_ptr &> as_function() const;
+
+		lak::result<lox::closure_ptr &> as_closure();
+		lak::result<const lox::closure_ptr &> as_closure() const;
+
+		lak::result<lox::type_ptr &> as_type();
+		lak::result<const lox::type_ptr &> as_type() const;
+
+		lak::result<lox::instance_ptr &> as_instance();
+		lak::result<const lox::instance_ptr &> as_instance() const;
+
+		lak::result<lox::bound_method_ptr &> as_bound_method();
+		lak::result<const lox::bound_method_ptr &> as_bound_method() const;
+
+		lak::result<lox::native_ptr &> as_native();
+		lak::result<const lox::native_ptr &> as_native() const;
+
 		template<typename F>
 		auto visit(F &&f)
 		{
@@ -56,6 +139,10 @@ namespace lox
 
 	std::ostream &operator<<(std::ostream &strm, const lox::value &val);
 
+	// the same as operator<<, but nil, bools, numbers and strings are written
+	// without allocating.
+	void write(lox::output &out, const lox::value &val);
+
 	using value_array = std::vector<lox::value>;
 
 	lak::u8string to_string(const lox::value &v);
@@ -1,5 +1,14 @@
 #include "virtual_machine.hpp"
 #include "common.hpp"
+#include "object.hpp"
+
+#include <lak/string_literals.hpp>
+#include <lak/string_ostream.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
 
 lak::result<> lox::virtual_machine::stack_push(lox::value v)
 {
@@ -21,24 +30,345 @@ lak::result<const lox::value &> lox::virtual_machine::stack_peek(
 	return lak::ok_t<const lox::value &>{stack[stack_top - (depth + 1)]};
 }
 
-lox::interpret_result<> lox::virtual_machine::interpret(lox::chunk *c)
+uint8_t lox::call_frame::read_u8()
+{
+	return *ip++;
+}
+
+uint16_t lox::call_frame::read_u16()
+{
+	ip += 2;
+	return static_cast<uint16_t>((ip[-2] << 8) | ip[-1]);
+}
+
+const lox::value &lox::call_frame::read_constant()
+{
+	return closure->function->chunk.constants[read_u8()];
+}
+
+size_t lox::call_frame::line() const
+{
+	const lox::chunk &chunk = closure->function->chunk;
+	const size_t offset     = static_cast<size_t>(ip - chunk.code_begin()) - 1U;
+	return chunk.line_at(offset);
+}
+
+lak::err_t<lox::runtime_error> lox::virtual_machine::error(
+  lak::u8string message) const
+{
+	// errors raised before any frame has been entered (by a host call) have
+	// no line to report
+	const size_t line = frame_count > 0U ? frames[frame_count - 1U].line() : 0U;
+	return lak::err_t{lox::runtime_error::at(line, lak::move(message))};
+}
+
+lox::virtual_machine &lox::virtual_machine::define_native(
+  lox::native_ptr native)
+{
+	// natives are plain globals, so scripts may shadow or reassign them
+	const uint16_t index = global_names.find_or_emplace(native->name).unwrap();
+	if (globals.size() < global_names.size())
+		globals.resize(global_names.size());
+	globals[index] = lox::value{lak::move(native)};
+	return *this;
+}
+
+lox::native_result (*lox_clock)(lox::virtual_machine &) =
+  [](lox::virtual_machine &) -> lox::native_result
+{
+	return lak::ok_t<lox::value>{
+	  std::chrono::duration_cast<std::chrono::milliseconds>(
+	    std::chrono::system_clock::now().time_since_epoch())
+	    .count() /
+	  1000.0};
+};
+
+lox::native_result (*lox_to_string)(lox::virtual_machine &,
+                                    const lox::value &) =
+  [](lox::virtual_machine &, const lox::value &val) -> lox::native_result
+{ return lak::ok_t<lox::value>{lox::string::make(lox::to_string(val))}; };
+
+lox::virtual_machine &lox::virtual_machine::init_globals()
+{
+	define_native(LOX_NATIVE_MAKE(u8"clock"_view, lox_clock));
+
+	define_native(LOX_NATIVE_MAKE(u8"to_string"_view, lox_to_string));
+
+	return *this;
+}
+
+lox::interpret_result<> lox::virtual_machine::call(
+  const lox::closure_ptr &closure, uint8_t arg_count)
+{
+	if (arg_count != closure->function->arity)
+		return error(lak::as_u8string(
+		  "Expected " + std::to_string(closure->function->arity) +
+		  " arguments but got " + std::to_string(arg_count) + "."));
+
+	if (frame_count == frames.size()) return error(u8"Stack overflow."_str);
+
+	lox::call_frame &frame = frames[frame_count++];
+	frame.closure          = closure.get();
+	frame.ip               = closure->function->chunk.code_begin();
+	frame.slots            = stack.data() + (stack_top - arg_count - 1U);
+
+	return lak::ok_t{};
+}
+
+lox::interpret_result<> lox::virtual_machine::call_value(
+  const lox::value &callee, uint8_t arg_count)
+{
+	lox::value &slot = stack[stack_top - arg_count - 1U];
+
+	if_let_ok (const lox::closure_ptr &closure, callee.as_closure())
+		return call(closure, arg_count);
+
+	if_let_ok (const lox::native_ptr &native, callee.as_native())
+	{
+		if (arg_count != native->arity)
+			return error(lak::as_u8string(
+			  "Expected " + std::to_string(native->arity) +
+			  " arguments but got " + std::to_string(arg_count) + "."));
+
+		// hand the arguments over in place, no frame or copies required
+		const lak::span<const lox::value> arguments(
+		  stack.data() + (stack_top - arg_count), size_t(arg_count));
+
+		lox::native_result result = native->function(*this, arguments);
+		if_let_err (lak::u8string & message, result)
+			return error(lak::move(message));
+
+		stack_top -= arg_count;
+		slot = lak::move(result).unsafe_unwrap();
+		return lak::ok_t{};
+	}
+
+	if_let_ok (const lox::bound_method_ptr &bound, callee.as_bound_method())
+	{
+		// copy out before the receiver overwrites the callee's slot
+		const lox::closure_ptr method = bound->method;
+		slot                          = bound->receiver;
+		return call(method, arg_count);
+	}
+
+	if_let_ok (const lox::type_ptr &callee_type, callee.as_type())
+	{
+		const lox::type_ptr type = callee_type;
+		slot                     = lox::instance::make(type);
+
+		if_let_ok (const lox::closure_ptr &initialiser,
+		           type->find_method(u8"init"_str))
+			return call(initialiser, arg_count);
+
+		if (arg_count != 0U)
+			return error(lak::as_u8string("Expected 0 arguments but got " +
+			                              std::to_string(arg_count) + "."));
+
+		return lak::ok_t{};
+	}
+
+	return error(u8"Can only call functions and classes."_str);
+}
+
+lox::interpret_result<> lox::virtual_machine::invoke_from_type(
+  const lox::type &type, const lox::string &name, uint8_t arg_count)
+{
+	if_let_ok (const lox::closure_ptr &method, type.find_method(name.value))
+		return call(method, arg_count);
+
+	return error(u8"Undefined property '"_str + name.value + u8"'."_str);
+}
+
+lox::interpret_result<> lox::virtual_machine::invoke(const lox::string &name,
+                                                     uint8_t arg_count)
+{
+	const lox::value &receiver = stack_peek(arg_count).unwrap();
+
+	if (!receiver.is_instance())
+		return error(u8"Only instances have methods."_str);
+
+	const lox::instance_ptr instance = receiver.as_instance().unsafe_unwrap();
+
+	// fields shadow methods, so fall back to a regular call if one matches
+	if (auto field = instance->fields.find(name.value);
+	    field != instance->fields.end())
+	{
+		stack[stack_top - arg_count - 1U] = field->second;
+		return call_value(field->second, arg_count);
+	}
+
+	return invoke_from_type(*instance->type, name, arg_count);
+}
+
+lox::interpret_result<> lox::virtual_machine::bind_method(
+  const lox::type &type, const lox::string &name)
+{
+	if_let_ok (const lox::closure_ptr &method, type.find_method(name.value))
+	{
+		lox::value bound{lox::bound_method::make(stack_peek(0).unwrap(), method)};
+		stack_pop().unwrap();
+		stack_push(lak::move(bound)).unwrap();
+		return lak::ok_t{};
+	}
+
+	return error(u8"Undefined property '"_str + name.value + u8"'."_str);
+}
+
+// the closure that calling callee would run, if any.
+const lox::closure *closure_of(const lox::value &callee)
+{
+	if_let_ok (const lox::closure_ptr &closure, callee.as_closure())
+		return closure.get();
+	if_let_ok (const lox::bound_method_ptr &bound, callee.as_bound_method())
+		return bound->method.get();
+	return nullptr;
+}
+
+// the closure that invoking name on receiver would run, if any.
+const lox::closure *method_of(const lox::value &receiver,
+                              const lox::string &name)
+{
+	if_let_ok (const lox::instance_ptr &instance, receiver.as_instance())
+	{
+		if (auto field = instance->fields.find(name.value);
+		    field != instance->fields.end())
+			return closure_of(field->second);
+		if_let_ok (const lox::closure_ptr &method,
+		           instance->type->find_method(name.value))
+			return method.get();
+	}
+	return nullptr;
+}
+
+void lox::virtual_machine::reuse_frame(const lox::closure *target,
+                                       uint8_t arg_count)
+{
+	if (!target || target->function->arity != arg_count) return;
+
+	lox::call_frame &frame = frames[frame_count - 1U];
+	close_upvalues(frame.slots);
+
+	lox::value *const callee = stack.data() + (stack_top - arg_count - 1U);
+	std::move(callee, callee + arg_count + 1U, frame.slots);
+	stack_top =
+	  static_cast<size_t>(frame.slots - stack.data()) + arg_count + 1U;
+	--frame_count;
+}
+
+lox::upvalue_ptr lox::virtual_machine::capture_upvalue(lox::value *slot)
 {
-	chunk = c;
-	ip    = lak::binary_reader{lak::span<const byte_t>{lak::span{chunk->code}}};
-	return run();
+	auto it = open_upvalues.end();
+	while (it != open_upvalues.begin() && (*(it - 1))->location > slot) --it;
+
+	// share the upvalue with any other closure that captured this slot
+	if (it != open_upvalues.begin() && (*(it - 1))->location == slot)
+		return *(it - 1);
+
+	return *open_upvalues.insert(it, lox::upvalue::make(slot));
+}
+
+void lox::virtual_machine::close_upvalues(const lox::value *last)
+{
+	while (!open_upvalues.empty() && open_upvalues.back()->location >= last)
+	{
+		open_upvalues.back()->close();
+		open_upvalues.pop_back();
+	}
+}
+
+lox::interpret_result<> lox::virtual_machine::interpret(
+  lox::function_ptr function)
+{
+	stack_top   = 0U;
+	frame_count = 0U;
+	open_upvalues.clear();
+
+	lox::closure_ptr closure = lox::closure::make(lak::move(function));
+	stack_push(closure).unwrap();
+	RES_TRY(call(closure, 0U));
+	RES_TRY(run());
+
+	// discard the script's (nil) result
+	stack_top = 0U;
+	return lak::ok_t{};
 }
 
 lox::interpret_result<> lox::virtual_machine::interpret(
   lak::u8string_view file)
 {
-	RES_TRY_ASSIGN(lox::chunk chunk =, lox::compile(file));
+	RES_TRY_ASSIGN(lox::function_ptr function =,
+	               lox::compile(file, global_names, options));
+
+	globals.resize(global_names.size());
+
+	return interpret(lak::move(function));
+}
+
+lox::interpret_result<> lox::virtual_machine::interpret(std::istream &file)
+{
+	RES_TRY_ASSIGN(lox::function_ptr function =,
+	               lox::compile(file, global_names, options));
+
+	globals.resize(global_names.size());
+
+	return interpret(lak::move(function));
+}
+
+void lox::virtual_machine::enter_jit()
+{
+#ifdef LOX_JIT
+	lox::call_frame &frame  = frames[frame_count - 1U];
+	lox::function &function = *frame.closure->function;
+
+	if (!function.jit)
+	{
+		if (jit_threshold == 0U || ++function.hotness < jit_threshold) return;
+
+		if_let_ok (lox::jit_code & code, lox::jit_code::compile(function.chunk))
+		{
+			function.jit = lak::move(code);
+		}
+		else
+		{
+			// try again once it's been hot for as long again
+			function.hotness = 0U;
+			return;
+		}
+	}
+
+	const uint8_t *code = function.chunk.code_begin();
+	const size_t offset = static_cast<size_t>(frame.ip - code);
+	frame.ip            = code + function.jit->run(*this, frame, offset);
+#endif
+}
+
+const uint8_t *lox::virtual_machine::quicken(const uint8_t *ip,
+                                             lox::opcode op)
+{
+	lox::chunk &chunk = frames[frame_count - 1U].closure->function->chunk;
+	const size_t offset = static_cast<size_t>(ip - chunk.code_begin());
+
+	if (!chunk.mapped_code.empty())
+	{
+		// the mapping is shared with any other VM running the same program.
+		const uint8_t *mapped = chunk.code_begin();
+		chunk.unmap_code();
+		for (lox::call_frame &frame : lak::span(frames).first(frame_count))
+		{
+			if (&frame.closure->function->chunk == &chunk)
+				frame.ip = chunk.code_begin() + (frame.ip - mapped);
+		}
+	}
 
-	return interpret(&chunk);
+	chunk.code[offset] = static_cast<uint8_t>(op);
+	return chunk.code_begin() + offset;
 }
 
 lox::interpret_result<> lox::virtual_machine::run()
 {
-	ASSERT_NOT_EQUAL(chunk, nullptr);
+	ASSERT_GREATER(frame_count, 0U);
+
+	lox::call_frame *frame = &frames[frame_count - 1U];
 
 	for (;;)
 	{
@@ -47,18 +377,28 @@ lox::interpret_result<> lox::virtual_machine::run()
 		for (const lox::value &v : lak::span(stack).first(stack_top))
 			std::cout << "[ " << v << " ]";
 		std::cout << "\n";
-		chunk->disassemble_instruction(ip.position());
+		const lox::chunk &chunk = frame->closure->function->chunk;
+		chunk.disassemble_instruction(
+		  static_cast<size_t>(frame->ip - chunk.code_begin()));
 #endif
 
+#ifdef LOX_PROFILE_OPCODES
+		{
+			const lox::chunk &chunk = frame->closure->function->chunk;
+			profile.record(chunk,
+			               static_cast<size_t>(frame->ip - chunk.code_begin()));
+		}
+#endif
+
+		// the start of the instruction, for quicken.
+		const uint8_t *const ip = frame->ip;
+
 		lox::opcode instruction;
-		switch (instruction = static_cast<lox::opcode>(ip.read_u8().unwrap()))
+		switch (instruction = static_cast<lox::opcode>(frame->read_u8()))
 		{
 			case lox::opcode::OP_CONSTANT:
-			{
-				const lox::value &constant = chunk->constants[ip.read_u8().unwrap()];
-				stack_push(constant).unwrap();
-			}
-			break;
+				stack_push(frame->read_constant()).unwrap();
+				break;
 
 			case lox::opcode::OP_NIL: stack_push(lox::value{}).unwrap(); break;
 
@@ -68,6 +408,111 @@ lox::interpret_result<> lox::virtual_machine::run()
 				stack_push(lox::value{false}).unwrap();
 				break;
 
+			case lox::opcode::OP_POP: stack_pop().unwrap(); break;
+
+			case lox::opcode::OP_GET_LOCAL:
+				stack_push(frame->slots[frame->read_u8()]).unwrap();
+				break;
+
+			case lox::opcode::OP_SET_LOCAL:
+				frame->slots[frame->read_u8()] = stack_peek(0).unwrap();
+				break;
+
+			case lox::opcode::OP_SET_LOCAL_POP:
+				frame->slots[frame->read_u8()] = stack_pop().unwrap();
+				break;
+
+			case lox::opcode::OP_GET_GLOBAL:
+			{
+				const uint16_t index = frame->read_u16();
+				if (!globals[index])
+					return error(u8"Undefined variable '"_str +
+					             global_names.names[index] + u8"'."_str);
+				stack_push(*globals[index]).unwrap();
+			}
+			break;
+
+			case lox::opcode::OP_DEFINE_GLOBAL:
+				globals[frame->read_u16()] = stack_pop().unwrap();
+				break;
+
+			case lox::opcode::OP_SET_GLOBAL:
+			{
+				const uint16_t index = frame->read_u16();
+				if (!globals[index])
+					return error(u8"Undefined variable '"_str +
+					             global_names.names[index] + u8"'."_str);
+				globals[index] = stack_peek(0).unwrap();
+			}
+			break;
+
+			case lox::opcode::OP_GET_UPVALUE:
+			{
+				const uint8_t index = frame->read_u8();
+				stack_push(*frame->closure->upvalues[index]->location).unwrap();
+			}
+			break;
+
+			case lox::opcode::OP_SET_UPVALUE:
+				*frame->closure->upvalues[frame->read_u8()]->location =
+				  stack_peek(0).unwrap();
+				break;
+
+			case lox::opcode::OP_GET_LOCAL_PROPERTY:
+				stack_push(frame->slots[frame->read_u8()]).unwrap();
+				[[fallthrough]];
+			case lox::opcode::OP_GET_PROPERTY:
+			{
+				const lox::string &name =
+				  *frame->read_constant().as_string().unwrap();
+
+				if (!stack_peek(0).unwrap().is_instance())
+					return error(u8"Only instances have properties."_str);
+
+				const lox::instance_ptr instance =
+				  stack_peek(0).unwrap().as_instance().unsafe_unwrap();
+
+				if (auto field = instance->fields.find(name.value);
+				    field != instance->fields.end())
+				{
+					stack_pop().unwrap();
+					stack_push(field->second).unwrap();
+				}
+				else
+				{
+					RES_TRY(bind_method(*instance->type, name));
+				}
+			}
+			break;
+
+			case lox::opcode::OP_SET_PROPERTY:
+			{
+				const lox::string &name =
+				  *frame->read_constant().as_string().unwrap();
+
+				if (!stack_peek(1).unwrap().is_instance())
+					return error(u8"Only instances have fields."_str);
+
+				lox::value value{stack_pop().unwrap()};
+				stack_pop()
+				  .unwrap()
+				  .as_instance()
+				  .unsafe_unwrap()
+				  ->fields.insert_or_assign(name.value, value);
+				stack_push(lak::move(value)).unwrap();
+			}
+			break;
+
+			case lox::opcode::OP_GET_SUPER:
+			{
+				const lox::string &name =
+				  *frame->read_constant().as_string().unwrap();
+				const lox::type_ptr superclass =
+				  stack_pop().unwrap().as_type().unwrap();
+				RES_TRY(bind_method(*superclass, name));
+			}
+			break;
+
 			case lox::opcode::OP_EQUAL:
 			{
 				const auto a{stack_pop().unwrap()};
@@ -76,48 +521,459 @@ lox::interpret_result<> lox::virtual_machine::run()
 			}
 			break;
 
+			case lox::opcode::OP_NOT_EQUAL:
+			{
+				const auto a{stack_pop().unwrap()};
+				const auto b{stack_pop().unwrap()};
+				stack_push(!(a == b)).unwrap();
+			}
+			break;
+
 #define LOX_BINARY_OP(op)                                                     \
 	do                                                                          \
 	{                                                                           \
-		if (!stack_peek(0).unwrap().is_number() ||                                \
-		    !stack_peek(1).unwrap().is_number())                                  \
-			return lak::err_t{lox::runtime_error::at(                               \
-			  chunk->lines[ip.position() - 1], u8"Operands must be numbers."_str)}; \
-		const double b{stack_pop().unsafe_unwrap().as_number().unsafe_unwrap()};  \
-		const double a{stack_pop().unsafe_unwrap().as_number().unsafe_unwrap()};  \
-		stack_push(a op b).unwrap();                                              \
+		const lox::value &b{stack[stack_top - 1U]};                               \
+		lox::value &a{stack[stack_top - 2U]};                                     \
+		if (!a.is_number() || !b.is_number())                                     \
+			return error(u8"Operands must be numbers."_str);                        \
+		/* write the result over the lhs operand instead of pop/pop/push */       \
+		a = lox::value{a.as_number().unsafe_unwrap() op                           \
+		               b.as_number().unsafe_unwrap()};                            \
+		--stack_top;                                                              \
 	} while (false)
 
-			case lox::opcode::OP_GREATER: LOX_BINARY_OP(>); break;
-			case lox::opcode::OP_LESS: LOX_BINARY_OP(<); break;
-			case lox::opcode::OP_ADD: LOX_BINARY_OP(+); break;
-			case lox::opcode::OP_SUBTRACT: LOX_BINARY_OP(-); break;
-			case lox::opcode::OP_MULTIPLY: LOX_BINARY_OP(*); break;
-			case lox::opcode::OP_DIVIDE: LOX_BINARY_OP(/); break;
+// as LOX_BINARY_OP, quickening the instruction to QUICK if it has numbers.
+#define LOX_QUICKENING_BINARY_OP(op, QUICK)                                   \
+	do                                                                          \
+	{                                                                           \
+		if (lox::value::both_numbers(stack[stack_top - 2U],                       \
+		                             stack[stack_top - 1U]))                      \
+			quicken(ip, lox::opcode::QUICK);                                        \
+		LOX_BINARY_OP(op);                                                        \
+	} while (false)
+
+			case lox::opcode::OP_GREATER:
+				LOX_QUICKENING_BINARY_OP(>, OP_GREATER_NUMBER);
+				break;
+			case lox::opcode::OP_LESS_CONSTANT:
+				stack_push(frame->read_constant()).unwrap();
+				LOX_QUICKENING_BINARY_OP(<, OP_LESS_CONSTANT_NUMBER);
+				break;
+			case lox::opcode::OP_LESS:
+				LOX_QUICKENING_BINARY_OP(<, OP_LESS_NUMBER);
+				break;
+			case lox::opcode::OP_ADD_CONSTANT:
+				stack_push(frame->read_constant()).unwrap();
+				[[fallthrough]];
+			case lox::opcode::OP_ADD:
+			{
+				const bool constant = instruction == lox::opcode::OP_ADD_CONSTANT;
+				if (lox::value::both_strings(stack_peek(1).unwrap(),
+				                             stack_peek(0).unwrap()))
+				{
+					quicken(ip,
+					        constant ? lox::opcode::OP_ADD_CONSTANT_STRING
+					                 : lox::opcode::OP_ADD_STRING);
+					const lox::value b{stack_pop().unsafe_unwrap()};
+					const lox::value a{stack_pop().unsafe_unwrap()};
+					stack_push(lox::string::make(
+					             a.as_string().unsafe_unwrap()->value +
+					             b.as_string().unsafe_unwrap()->value))
+					  .unwrap();
+				}
+				else if (lox::value::both_numbers(stack_peek(1).unwrap(),
+				                                  stack_peek(0).unwrap()))
+				{
+					quicken(ip,
+					        constant ? lox::opcode::OP_ADD_CONSTANT_NUMBER
+					                 : lox::opcode::OP_ADD_NUMBER);
+					LOX_BINARY_OP(+);
+				}
+				else
+				{
+					return error(
+					  u8"Operands must be two numbers or two strings."_str);
+				}
+			}
+			break;
+			case lox::opcode::OP_SUBTRACT_CONSTANT:
+				stack_push(frame->read_constant()).unwrap();
+				LOX_QUICKENING_BINARY_OP(-, OP_SUBTRACT_CONSTANT_NUMBER);
+				break;
+			case lox::opcode::OP_SUBTRACT:
+				LOX_QUICKENING_BINARY_OP(-, OP_SUBTRACT_NUMBER);
+				break;
+			case lox::opcode::OP_MULTIPLY:
+				LOX_QUICKENING_BINARY_OP(*, OP_MULTIPLY_NUMBER);
+				break;
+			case lox::opcode::OP_DIVIDE:
+				LOX_QUICKENING_BINARY_OP(/, OP_DIVIDE_NUMBER);
+				break;
+
+			// !(a > b) rather than a <= b, which differs when either is NaN
+			case lox::opcode::OP_NOT_GREATER:
+				LOX_BINARY_OP(>);
+				stack[stack_top - 1U] =
+				  lox::value{!stack[stack_top - 1U].is_truthy()};
+				break;
+			case lox::opcode::OP_NOT_LESS:
+				LOX_BINARY_OP(<);
+				stack[stack_top - 1U] =
+				  lox::value{!stack[stack_top - 1U].is_truthy()};
+				break;
+#undef LOX_QUICKENING_BINARY_OP
 #undef LOX_BINARY_OP
 
+			// quickened instructions, see LOX_QUICKENING_FOREACH. when the operands
+			// aren't what they expect they're put back to GENERIC, which is then
+			// dispatched to in their place.
+
+#define LOX_QUICK_DEQUICKEN(GENERIC)                                          \
+	{                                                                           \
+		frame->ip = quicken(ip, lox::opcode::GENERIC);                            \
+		continue;                                                                 \
+	}
+
+#define LOX_QUICK_STACK                                                       \
+	const lox::value &b{stack[stack_top - 1U]};                                 \
+	lox::value &a{stack[stack_top - 2U]};                                       \
+	constexpr size_t pop = 1U;
+#define LOX_QUICK_CONSTANT                                                    \
+	const lox::value &b{frame->read_constant()};                                \
+	lox::value &a{stack[stack_top - 1U]};                                       \
+	constexpr size_t pop = 0U;
+
+#define LOX_QUICK_NUMBER_CASE(QUICK, GENERIC, op, OPERANDS)                   \
+	case lox::opcode::QUICK:                                                    \
+	{                                                                           \
+		OPERANDS                                                                  \
+		if (!lox::value::both_numbers(a, b)) LOX_QUICK_DEQUICKEN(GENERIC)         \
+		a = lox::value{a.as_number().unsafe_unwrap() op                           \
+		               b.as_number().unsafe_unwrap()};                            \
+		stack_top -= pop;                                                         \
+	}                                                                           \
+	break;
+
+#define LOX_QUICK_STRING_CASE(QUICK, GENERIC, OPERANDS)                       \
+	case lox::opcode::QUICK:                                                    \
+	{                                                                           \
+		OPERANDS                                                                  \
+		if (!lox::value::both_strings(a, b)) LOX_QUICK_DEQUICKEN(GENERIC)         \
+		a = lox::string::make(a.as_string().unsafe_unwrap()->value +              \
+		                      b.as_string().unsafe_unwrap()->value);              \
+		stack_top -= pop;                                                         \
+	}                                                                           \
+	break;
+
+			LOX_QUICK_NUMBER_CASE(OP_ADD_NUMBER, OP_ADD, +, LOX_QUICK_STACK)
+			LOX_QUICK_NUMBER_CASE(
+			  OP_SUBTRACT_NUMBER, OP_SUBTRACT, -, LOX_QUICK_STACK)
+			LOX_QUICK_NUMBER_CASE(
+			  OP_MULTIPLY_NUMBER, OP_MULTIPLY, *, LOX_QUICK_STACK)
+			LOX_QUICK_NUMBER_CASE(OP_DIVIDE_NUMBER, OP_DIVIDE, /, LOX_QUICK_STACK)
+			LOX_QUICK_NUMBER_CASE(OP_LESS_NUMBER, OP_LESS, <, LOX_QUICK_STACK)
+			LOX_QUICK_NUMBER_CASE(
+			  OP_GREATER_NUMBER, OP_GREATER, >, LOX_QUICK_STACK)
+			LOX_QUICK_NUMBER_CASE(
+			  OP_ADD_CONSTANT_NUMBER, OP_ADD_CONSTANT, +, LOX_QUICK_CONSTANT)
+			LOX_QUICK_NUMBER_CASE(OP_SUBTRACT_CONSTANT_NUMBER,
+			                      OP_SUBTRACT_CONSTANT,
+			                      -,
+			                      LOX_QUICK_CONSTANT)
+			LOX_QUICK_NUMBER_CASE(
+			  OP_LESS_CONSTANT_NUMBER, OP_LESS_CONSTANT, <, LOX_QUICK_CONSTANT)
+			LOX_QUICK_STRING_CASE(OP_ADD_STRING, OP_ADD, LOX_QUICK_STACK)
+			LOX_QUICK_STRING_CASE(
+			  OP_ADD_CONSTANT_STRING, OP_ADD_CONSTANT, LOX_QUICK_CONSTANT)
+
+#undef LOX_QUICK_CONSTANT
+#undef LOX_QUICK_STACK
+#undef LOX_QUICK_STRING_CASE
+#undef LOX_QUICK_NUMBER_CASE
+#undef LOX_QUICK_DEQUICKEN
+
+			// register instructions, see LOX_REGISTER_ARITHMETIC_FOREACH. each reads
+			// its operands into a and b, then OPERATION defines result.
+
+#define LOX_REGISTER_RR                                                       \
+	const lox::value &a{frame->slots[frame->read_u8()]};                        \
+	const lox::value &b{frame->slots[frame->read_u8()]};
+#define LOX_REGISTER_RK                                                       \
+	const lox::value &a{frame->slots[frame->read_u8()]};                        \
+	const lox::value &b{frame->read_constant()};
+
+#define LOX_REGISTER_PUSH_CASES(OP, OPERATION)                                \
+	case lox::opcode::OP_##OP##_RR:                                             \
+	{                                                                           \
+		LOX_REGISTER_RR                                                           \
+		OPERATION                                                                 \
+		stack_push(result).unwrap();                                              \
+	}                                                                           \
+	break;                                                                      \
+	case lox::opcode::OP_##OP##_RK:                                             \
+	{                                                                           \
+		LOX_REGISTER_RK                                                           \
+		OPERATION                                                                 \
+		stack_push(result).unwrap();                                              \
+	}                                                                           \
+	break;
+
+#define LOX_REGISTER_STORE_CASES(OP, OPERATION)                               \
+	case lox::opcode::OP_##OP##_RRR:                                            \
+	{                                                                           \
+		lox::value &d{frame->slots[frame->read_u8()]};                            \
+		LOX_REGISTER_RR                                                           \
+		OPERATION                                                                 \
+		d = result;                                                               \
+	}                                                                           \
+	break;                                                                      \
+	case lox::opcode::OP_##OP##_RRK:                                            \
+	{                                                                           \
+		lox::value &d{frame->slots[frame->read_u8()]};                            \
+		LOX_REGISTER_RK                                                           \
+		OPERATION                                                                 \
+		d = result;                                                               \
+	}                                                                           \
+	break;
+
+#define LOX_REGISTER_NUMBERS(op)                                              \
+	if (!a.is_number() || !b.is_number())                                       \
+		return error(u8"Operands must be numbers."_str);                          \
+	const lox::value result{a.as_number().unsafe_unwrap()                       \
+	                          op b.as_number().unsafe_unwrap()};
+
+#define LOX_REGISTER_ADD                                                      \
+	lox::value result;                                                          \
+	if (a.is_number() && b.is_number())                                         \
+		result = lox::value{a.as_number().unsafe_unwrap() +                       \
+		                    b.as_number().unsafe_unwrap()};                       \
+	else if (a.is_string() && b.is_string())                                    \
+		result = lox::string::make(a.as_string().unsafe_unwrap()->value +         \
+		                           b.as_string().unsafe_unwrap()->value);         \
+	else                                                                        \
+		return error(u8"Operands must be two numbers or two strings."_str);
+
+#define LOX_REGISTER_EQUAL const lox::value result{a == b};
+
+			LOX_REGISTER_PUSH_CASES(ADD, LOX_REGISTER_ADD)
+			LOX_REGISTER_STORE_CASES(ADD, LOX_REGISTER_ADD)
+			LOX_REGISTER_PUSH_CASES(SUBTRACT, LOX_REGISTER_NUMBERS(-))
+			LOX_REGISTER_STORE_CASES(SUBTRACT, LOX_REGISTER_NUMBERS(-))
+			LOX_REGISTER_PUSH_CASES(MULTIPLY, LOX_REGISTER_NUMBERS(*))
+			LOX_REGISTER_STORE_CASES(MULTIPLY, LOX_REGISTER_NUMBERS(*))
+			LOX_REGISTER_PUSH_CASES(DIVIDE, LOX_REGISTER_NUMBERS(/))
+			LOX_REGISTER_STORE_CASES(DIVIDE, LOX_REGISTER_NUMBERS(/))
+			LOX_REGISTER_PUSH_CASES(LESS, LOX_REGISTER_NUMBERS(<))
+			LOX_REGISTER_PUSH_CASES(GREATER, LOX_REGISTER_NUMBERS(>))
+			LOX_REGISTER_PUSH_CASES(EQUAL, LOX_REGISTER_EQUAL)
+
+#undef LOX_REGISTER_EQUAL
+#undef LOX_REGISTER_ADD
+#undef LOX_REGISTER_NUMBERS
+#undef LOX_REGISTER_STORE_CASES
+#undef LOX_REGISTER_PUSH_CASES
+#undef LOX_REGISTER_RK
+#undef LOX_REGISTER_RR
+
+			case lox::opcode::OP_MOVE_RR:
+			{
+				const uint8_t destination = frame->read_u8();
+				frame->slots[destination] = frame->slots[frame->read_u8()];
+			}
+			break;
+
+			case lox::opcode::OP_MOVE_RK:
+			{
+				const uint8_t destination = frame->read_u8();
+				frame->slots[destination] = frame->read_constant();
+			}
+			break;
+
 			case lox::opcode::OP_NOT:
-				stack_push(!stack_pop().unwrap().is_truthy());
+				stack_push(!stack_pop().unwrap().is_truthy()).unwrap();
 				break;
 
 			case lox::opcode::OP_NEGATE:
 			{
 				if (!stack_peek(0).unwrap().is_number())
-				{
-					return lak::err_t{
-					  lox::runtime_error::at(chunk->lines[ip.position() - 1],
-					                         u8"Operand must be a number."_str)};
-				}
+					return error(u8"Operand must be a number."_str);
 				stack_push(-stack_pop().unsafe_unwrap().as_number().unsafe_unwrap())
 				  .unwrap();
 			}
 			break;
 
+			case lox::opcode::OP_PRINT:
+			{
+				const lox::value value = stack_pop().unwrap();
+				if (out)
+				{
+					lox::write(*out, value);
+					out->write('\n');
+				}
+			}
+			break;
+
+			case lox::opcode::OP_JUMP:
+			{
+				const uint16_t offset = frame->read_u16();
+				frame->ip += offset;
+			}
+			break;
+
+			case lox::opcode::OP_JUMP_IF_FALSE:
+			{
+				const uint16_t offset = frame->read_u16();
+				if (!stack_peek(0).unwrap().is_truthy()) frame->ip += offset;
+			}
+			break;
+
+			case lox::opcode::OP_JUMP_IF_FALSE_POP:
+			{
+				const uint16_t offset = frame->read_u16();
+				// the falsey condition is left for the POP at the jump target
+				if (!stack_peek(0).unwrap().is_truthy())
+					frame->ip += offset;
+				else
+					stack_pop().unwrap();
+			}
+			break;
+
+			case lox::opcode::OP_LOOP:
+			{
+				const uint16_t offset = frame->read_u16();
+				frame->ip -= offset;
+				enter_jit();
+			}
+			break;
+
+			case lox::opcode::OP_CALL:
+			{
+				const uint8_t arg_count = frame->read_u8();
+				RES_TRY(call_value(stack_peek(arg_count).unwrap(), arg_count));
+				frame = &frames[frame_count - 1U];
+				enter_jit();
+			}
+			break;
+
+			case lox::opcode::OP_TAIL_CALL:
+			{
+				const uint8_t arg_count = frame->read_u8();
+				reuse_frame(closure_of(stack_peek(arg_count).unwrap()), arg_count);
+				RES_TRY(call_value(stack_peek(arg_count).unwrap(), arg_count));
+				frame = &frames[frame_count - 1U];
+				enter_jit();
+			}
+			break;
+
+			case lox::opcode::OP_TAIL_INVOKE:
+			{
+				const lox::string &name =
+				  *frame->read_constant().as_string().unwrap();
+				const uint8_t arg_count = frame->read_u8();
+				reuse_frame(method_of(stack_peek(arg_count).unwrap(), name),
+				            arg_count);
+				RES_TRY(invoke(name, arg_count));
+				frame = &frames[frame_count - 1U];
+				enter_jit();
+			}
+			break;
+
+			case lox::opcode::OP_INVOKE:
+			{
+				const lox::string &name =
+				  *frame->read_constant().as_string().unwrap();
+				const uint8_t arg_count = frame->read_u8();
+				RES_TRY(invoke(name, arg_count));
+				frame = &frames[frame_count - 1U];
+				enter_jit();
+			}
+			break;
+
+			case lox::opcode::OP_SUPER_INVOKE:
+			{
+				const lox::string &name =
+				  *frame->read_constant().as_string().unwrap();
+				const uint8_t arg_count = frame->read_u8();
+				const lox::type_ptr superclass =
+				  stack_pop().unwrap().as_type().unwrap();
+				RES_TRY(invoke_from_type(*superclass, name, arg_count));
+				frame = &frames[frame_count - 1U];
+				enter_jit();
+			}
+			break;
+
+			case lox::opcode::OP_CLOSURE:
+			{
+				lox::closure_ptr closure = lox::closure::make(
+				  frame->read_constant().as_function().unwrap());
+				for (size_t i = 0U; i < closure->function->upvalue_count; ++i)
+				{
+					const uint8_t is_local = frame->read_u8();
+					const uint8_t index    = frame->read_u8();
+					closure->upvalues.push_back(
+					  is_local ? capture_upvalue(frame->slots + index)
+					           : frame->closure->upvalues[index]);
+				}
+				stack_push(lak::move(closure)).unwrap();
+			}
+			break;
+
+			case lox::opcode::OP_CLOSE_UPVALUE:
+				close_upvalues(stack.data() + stack_top - 1U);
+				stack_pop().unwrap();
+				break;
+
 			case lox::opcode::OP_RETURN:
 			{
-				std::cout << stack_pop().unwrap() << "\n";
-				return lak::ok_t{};
+				lox::value result = stack_pop().unwrap();
+				close_upvalues(frame->slots);
+
+				stack_top = static_cast<size_t>(frame->slots - stack.data());
+				stack_push(lak::move(result)).unwrap();
+
+				// the outermost call leaves its result in place of the callee for
+				// whoever started the VM to collect
+				if (--frame_count == 0U) return lak::ok_t{};
+
+				frame = &frames[frame_count - 1U];
+				enter_jit();
 			}
+			break;
+
+			case lox::opcode::OP_CLASS:
+				stack_push(lox::type::make(
+				             frame->read_constant().as_string().unwrap()->value))
+				  .unwrap();
+				break;
+
+			case lox::opcode::OP_INHERIT:
+			{
+				if (!stack_peek(1).unwrap().is_type())
+					return error(u8"Superclass must be a class."_str);
+
+				const lox::type_ptr &superclass =
+				  stack_peek(1).unwrap().as_type().unsafe_unwrap();
+				const lox::type_ptr &subclass =
+				  stack_peek(0).unwrap().as_type().unwrap();
+
+				// copy down the inherited methods, the subclass' own methods are
+				// defined after this so they will override these
+				subclass->methods = superclass->methods;
+				stack_pop().unwrap();
+			}
+			break;
+
+			case lox::opcode::OP_METHOD:
+			{
+				const lox::string &name =
+				  *frame->read_constant().as_string().unwrap();
+				lox::closure_ptr method =
+				  stack_peek(0).unwrap().as_closure().unwrap();
+				stack_peek(1).unwrap().as_type().unwrap()->methods.insert_or_assign(
+				  name.value, lak::move(method));
+				stack_pop().unwrap();
+			}
+			break;
 		}
 	}
 }
@@ -125,9 +981,83 @@ lox::interpret_result<> lox::virtual_machine::run()
 lox::virtual_machine::run_file_result lox::virtual_machine::run_file(
   const std::filesystem::path &file_path)
 {
-	RES_TRY_ASSIGN(const lak::array<byte_t> &arr =, lak::read_file(file_path));
-	RES_TRY(
-	  interpret(lak::u8string_view(lak::span<const char8_t>(lak::span(arr)))));
+	if (file_path.extension() == ".loxc")
+	{
+		RES_TRY_ASSIGN(lox::mapped_file file =, lox::mapped_file::open(file_path));
+		RES_TRY_ASSIGN(lox::function_ptr script =,
+		               lox::deserialise(file.data(), global_names));
+		globals.resize(global_names.size());
+		mapped_files.push_back(lak::move(file));
+		RES_TRY(interpret(lak::move(script)));
+		return lak::ok_t{};
+	}
+
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file) return lak::err_t{lak::errno_error{errno}};
+
+	if (!cache)
+	{
+		RES_TRY(interpret(file));
+		return lak::ok_t{};
+	}
+
+	const uint64_t key = lox::compile_cache::key(file, options);
+
+	lox::mapped_file mapping;
+	if_let_ok (lox::function_ptr & script,
+	           cache->load(key, global_names, mapping))
+	{
+		globals.resize(global_names.size());
+		mapped_files.push_back(lak::move(mapping));
+		RES_TRY(interpret(lak::move(script)));
+		return lak::ok_t{};
+	}
+
+	// scan the file again from the start
+	file.clear();
+	file.seekg(0);
+	RES_TRY_ASSIGN(lox::function_ptr script =,
+	               lox::compile(file, global_names, options));
+	cache->store(key, *script, global_names);
+	globals.resize(global_names.size());
+	RES_TRY(interpret(lak::move(script)));
+	return lak::ok_t{};
+}
+
+lox::virtual_machine::run_bundle_result lox::virtual_machine::run_bundle(
+  lak::span<const std::filesystem::path> files, size_t thread_count)
+{
+	RES_TRY_ASSIGN(
+	  std::vector<lox::function_ptr> scripts =,
+	  lox::compile_bundle(files, global_names, thread_count, options));
+	globals.resize(global_names.size());
+	for (lox::function_ptr &script : scripts)
+		RES_TRY(interpret(lak::move(script)));
+	return lak::ok_t{};
+}
+
+lox::virtual_machine::run_file_result lox::virtual_machine::run_program(
+  const lox::program &program)
+{
+	RES_TRY_ASSIGN(
+	  lox::function_ptr script =,
+	  lox::deserialise(lak::span<const byte_t>(program.bytecode), global_names));
+	globals.resize(global_names.size());
+	RES_TRY(interpret(lak::move(script)));
+	return lak::ok_t{};
+}
+
+lox::virtual_machine::run_file_result lox::virtual_machine::compile_file(
+  const std::filesystem::path &file_path,
+  const std::filesystem::path &output_path)
+{
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file) return lak::err_t{lak::errno_error{errno}};
+	RES_TRY_ASSIGN(lox::function_ptr script =,
+	               lox::compile(file, global_names, options));
+	RES_TRY_ASSIGN(const std::vector<byte_t> bytecode =,
+	               lox::serialise(*script, global_names));
+	RES_TRY(lak::save_file(output_path, lak::span<const byte_t>(bytecode)));
 	return lak::ok_t{};
 }
 
@@ -137,6 +1067,7 @@ lox::interpret_result<> lox::virtual_machine::run_prompt()
 	{
 		using lak::operator<<;
 
+		if (out) out->flush();
 		std::cout << "> ";
 
 		lak::astring string;
@@ -149,6 +1080,7 @@ lox::interpret_result<> lox::virtual_machine::run_prompt()
 		if_let_err (const lox::interpret_error & err,
 		            interpret(lak::as_u8string(string)))
 		{
+			if (out) out->flush();
 			err.visit(
 			  []<typename TAG>(const lox::positional_error<TAG> &err)
 			  {
@@ -1,17 +1,29 @@
 #ifndef LOX_VIRTUAL_MACHINE_HPP
 #define LOX_VIRTUAL_MACHINE_HPP
 
+#include "bundle.hpp"
+#include "bytecode.hpp"
 #include "chunk.hpp"
 #include "common.hpp"
+#include "compile_cache.hpp"
 #include "compiler.hpp"
 #include "error.hpp"
+#include "global_table.hpp"
+#include "mapped_file.hpp"
+#include "native.hpp"
+#include "object.hpp"
+#include "output.hpp"
+#include "profile.hpp"
+#include "program.hpp"
 #include "value.hpp"
 
 #include <lak/array.hpp>
-#include <lak/binary_reader.hpp>
 #include <lak/memory.hpp>
+#include <lak/optional.hpp>
 #include <lak/result.hpp>
 
+#include <vector>
+
 namespace lox
 {
 	struct runtime_error_tag
@@ -27,33 +39,143 @@ namespace lox
 	template<typename T = lak::monostate>
 	using interpret_result = lak::result<T, lox::interpret_error>;
 
-	struct virtual_machine
+	struct call_frame
 	{
-		lox::chunk *chunk{nullptr};
+		lox::closure *closure{nullptr};
+
+		const uint8_t *ip{nullptr};
+
+		// the start of this frame's window into the VM stack, slot 0 is the
+		// callee followed by the arguments.
+		lox::value *slots{nullptr};
+
+		uint8_t read_u8();
+		uint16_t read_u16();
+		const lox::value &read_constant();
 
-		lak::binary_reader ip;
+		// the line of the most recently read instruction.
+		size_t line() const;
+	};
+
+	struct virtual_machine
+	{
+		lak::array<lox::call_frame, LOX_FRAMES_MAX> frames;
+		size_t frame_count{0U};
 
 		lak::array<lox::value, LOX_STACK_MAX> stack;
 		size_t stack_top{0U};
 
+		// sorted by stack slot, so the most recently opened is at the back.
+		std::vector<lox::upvalue_ptr> open_upvalues;
+
+		lox::global_table global_names;
+		std::vector<lak::optional<lox::value>> globals;
+
+		// precompiled scripts execute directly out of these mappings.
+		std::vector<lox::mapped_file> mapped_files;
+
+		// how scripts run from source are compiled.
+		lox::compile_options options = {};
+
+		// scripts run from source are looked up here first, if set.
+		lak::optional<lox::compile_cache> cache;
+
+		// where print statements write to, or nullptr to discard. VMs running on
+		// different threads should each be given their own output.
+		lox::output *out = &lox::standard_output();
+
+#ifdef LOX_PROFILE_OPCODES
+		lox::opcode_profile profile;
+#endif
+
+#ifdef LOX_JIT
+		// 0 to never compile.
+		size_t jit_threshold = LOX_JIT_THRESHOLD;
+#endif
+
 		lak::result<> stack_push(lox::value v);
 		lak::result<lox::value> stack_pop();
 		lak::result<const lox::value &> stack_peek(size_t depth) const;
 
-		lox::interpret_result<> interpret(lox::chunk *c);
+		lak::err_t<lox::runtime_error> error(lak::u8string message) const;
+
+		virtual_machine &define_native(lox::native_ptr native);
+
+		virtual_machine &init_globals();
+
+		lox::interpret_result<> call(const lox::closure_ptr &closure,
+		                             uint8_t arg_count);
+
+		lox::interpret_result<> call_value(const lox::value &callee,
+		                                   uint8_t arg_count);
+
+		lox::interpret_result<> invoke_from_type(const lox::type &type,
+		                                         const lox::string &name,
+		                                         uint8_t arg_count);
+
+		lox::interpret_result<> invoke(const lox::string &name,
+		                               uint8_t arg_count);
+
+		lox::interpret_result<> bind_method(const lox::type &type,
+		                                    const lox::string &name);
+
+		// for a call in tail position: if target takes arg_count arguments, the
+		// callee and its arguments are slid down over the current frame so that
+		// the call replaces it. otherwise the frame is kept, the call may fail
+		// and need it for the error.
+		void reuse_frame(const lox::closure *target, uint8_t arg_count);
+
+		lox::upvalue_ptr capture_upvalue(lox::value *slot);
+
+		void close_upvalues(const lox::value *last);
+
+		lox::interpret_result<> interpret(lox::function_ptr function);
 
 		lox::interpret_result<> interpret(lak::u8string_view file);
 
+		lox::interpret_result<> interpret(std::istream &file);
+
+		// rewrites the instruction at ip in the current frame's chunk to op, see
+		// LOX_QUICKENING_FOREACH. a mapped chunk is unmapped first and every
+		// frame executing it is moved over to the copy, so the instruction's new
+		// address is returned.
+		const uint8_t *quicken(const uint8_t *ip, lox::opcode op);
+
+		// if the current frame's function is hot, runs it natively from the
+		// current instruction until it needs the interpreter again. does nothing
+		// without LOX_JIT.
+		void enter_jit();
+
 		lox::interpret_result<> run();
 
 		using run_file_error  = lox::result_set<lak::errno_error,
 		                                        lox::scan_error,
 		                                        lox::parse_error,
 		                                        lox::compile_error,
-		                                        lox::runtime_error>;
+		                                        lox::runtime_error,
+		                                        lox::bytecode_error>;
 		using run_file_result = lak::result<lak::monostate, run_file_error>;
+		// .loxc files are loaded as precompiled bytecode, anything else is
+		// compiled from source (or fetched from the cache).
 		run_file_result run_file(const std::filesystem::path &file_path);
 
+		using run_bundle_error  = lox::result_set<lox::bundle_error,
+		                                          lox::scan_error,
+		                                          lox::parse_error,
+		                                          lox::compile_error,
+		                                          lox::runtime_error>;
+		using run_bundle_result = lak::result<lak::monostate, run_bundle_error>;
+		// the files are compiled in parallel by compile_bundle, then run one
+		// after the other. bundles bypass the cache.
+		run_bundle_result run_bundle(lak::span<const std::filesystem::path> files,
+		                             size_t thread_count = 0U);
+
+		// program must outlive the call, its code is executed in place.
+		run_file_result run_program(const lox::program &program);
+
+		run_file_result compile_file(const std::filesystem::path &file_path,
+		                             const std::filesystem::path &output_path);
+
 		lox::interpret_result<> run_prompt();
 	};
 }
@@ -0,0 +1,75 @@
+#ifndef LOX_NUMBER_HPP
+#define LOX_NUMBER_HPP
+
+#include <lak/debug.hpp>
+#include <lak/result.hpp>
+#include <lak/string.hpp>
+#include <lak/string_view.hpp>
+
+#include <charconv>
+
+// Number conversions shared by clox and jlox. Everything goes through
+// std::to_chars/std::from_chars, so there's no locale, no stream and (except
+// for number_to_string) no allocation.
+
+namespace lox
+{
+	enum struct number_format
+	{
+		// the fewest digits that parse back to the same double (Ryu).
+		shortest,
+		// printf's %g, as clox prints numbers.
+		general,
+		// printf's %f, as jlox prints numbers.
+		fixed,
+	};
+
+	// Enough for any double in any format. %f is the longest: DBL_MAX has 309
+	// digits before the point and 6 after.
+	inline constexpr size_t max_number_length = 320U;
+
+	// Writes d to [first, last) and returns the end of what was written.
+	// [first, last) must be at least max_number_length long.
+	inline char *format_number(char *first,
+	                           char *last,
+	                           double d,
+	                           lox::number_format format)
+	{
+		std::to_chars_result result;
+		switch (format)
+		{
+			case lox::number_format::general:
+				result = std::to_chars(first, last, d, std::chars_format::general, 6);
+				break;
+			case lox::number_format::fixed:
+				result = std::to_chars(first, last, d, std::chars_format::fixed, 6);
+				break;
+			default: result = std::to_chars(first, last, d); break;
+		}
+		ASSERT(result.ec == std::errc());
+		return result.ptr;
+	}
+
+	inline lak::u8string number_to_string(
+	  double d, lox::number_format format = lox::number_format::shortest)
+	{
+		char buffer[lox::max_number_length];
+		const char *end =
+		  lox::format_number(buffer, buffer + sizeof(buffer), d, format);
+		return lak::u8string(reinterpret_cast<const char8_t *>(buffer),
+		                     reinterpret_cast<const char8_t *>(end));
+	}
+
+	// Parses the whole of str as a decimal number, straight from the view.
+	inline lak::result<double> parse_number(lak::u8string_view str)
+	{
+		const char *begin = reinterpret_cast<const char *>(str.data());
+		const char *end   = begin + str.size();
+		double result;
+		const auto [ptr, ec] = std::from_chars(begin, end, result);
+		if (ec != std::errc() || ptr != end) return lak::err_t{};
+		return lak::ok_t{result};
+	}
+}
+
+#endif
@@ -0,0 +1,936 @@
+#include "ast_cache.hpp"
+
+#include "interpreter.hpp"
+
+#include <lak/file.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+enum struct expr_tag : uint8_t
+{
+	ASSIGN,
+	BINARY,
+	CALL,
+	GET,
+	GROUPING,
+	LITERAL,
+	LOGICAL,
+	SET,
+	SUPER,
+	THIS,
+	UNARY,
+	VARIABLE,
+};
+
+enum struct stmt_tag : uint8_t
+{
+	BLOCK,
+	TYPE,
+	EXPR,
+	BRANCH,
+	PRINT,
+	VAR,
+	LOOP,
+	FUNCTION,
+	RET,
+};
+
+enum struct object_tag : uint8_t
+{
+	NIL,
+	STRING,
+	NUMBER,
+	BOOL,
+};
+
+// distance written for variables that resolve to a global
+static constexpr uint32_t unresolved = UINT32_MAX;
+
+static constexpr byte_t ast_cache_magic[] = {'L', 'O', 'X', 'A'};
+
+/* --- writing --- */
+
+struct ast_writer
+{
+	lox::interpreter &interpreter;
+	std::vector<byte_t> out;
+
+	void write_u8(uint8_t v) { out.push_back(static_cast<byte_t>(v)); }
+
+	void write_u16(uint16_t v)
+	{
+		write_u8(static_cast<uint8_t>(v & 0xFF));
+		write_u8(static_cast<uint8_t>((v >> 8) & 0xFF));
+	}
+
+	void write_u32(uint32_t v)
+	{
+		write_u16(static_cast<uint16_t>(v & 0xFFFF));
+		write_u16(static_cast<uint16_t>((v >> 16) & 0xFFFF));
+	}
+
+	void write_u64(uint64_t v)
+	{
+		write_u32(static_cast<uint32_t>(v & 0xFFFF'FFFF));
+		write_u32(static_cast<uint32_t>((v >> 32) & 0xFFFF'FFFF));
+	}
+
+	lak::result<> write_size(size_t v)
+	{
+		if (v >= unresolved) return lak::err_t{};
+		write_u32(static_cast<uint32_t>(v));
+		return lak::ok_t{};
+	}
+
+	lak::result<> write_string(lak::u8string_view str)
+	{
+		RES_TRY(write_size(str.size()));
+		for (const char8_t c : str) write_u8(static_cast<uint8_t>(c));
+		return lak::ok_t{};
+	}
+
+	lak::result<> write_object(const lox::object &obj)
+	{
+		if (const lak::u8string *str = obj.get_string(); str)
+		{
+			write_u8(static_cast<uint8_t>(object_tag::STRING));
+			RES_TRY(write_string(*str));
+		}
+		else if (const double *num = obj.get_number(); num)
+		{
+			uint64_t bits;
+			static_assert(sizeof(bits) == sizeof(*num));
+			std::memcpy(&bits, num, sizeof(bits));
+			write_u8(static_cast<uint8_t>(object_tag::NUMBER));
+			write_u64(bits);
+		}
+		else if (const bool *b = obj.get_bool(); b)
+		{
+			write_u8(static_cast<uint8_t>(object_tag::BOOL));
+			write_u8(*b ? 1U : 0U);
+		}
+		else if (obj == lox::object{})
+		{
+			write_u8(static_cast<uint8_t>(object_tag::NIL));
+		}
+		else
+		{
+			// callables and instances never appear in a freshly parsed AST
+			return lak::err_t{};
+		}
+		return lak::ok_t{};
+	}
+
+	lak::result<> write_token(const lox::token &token)
+	{
+		write_u8(static_cast<uint8_t>(token.type));
+		RES_TRY(write_string(token.lexeme()));
+		return write_size(token.line);
+	}
+
+	template<typename T>
+	void write_distance(const T &expr)
+	{
+		if_let_ok (const size_t distance, interpreter.find(expr))
+			write_u32(static_cast<uint32_t>(distance));
+		else
+			write_u32(unresolved);
+	}
+
+	lak::result<> write_optional(const lak::optional<lox::expr_ptr> &expr)
+	{
+		if_ref (const lox::expr_ptr &e, expr)
+		{
+			write_u8(1U);
+			return e->visit(*this);
+		}
+		write_u8(0U);
+		return lak::ok_t{};
+	}
+
+	lak::result<> write_stmts(lak::span<const lox::stmt_ptr> stmts)
+	{
+		RES_TRY(write_size(stmts.size()));
+		for (const lox::stmt_ptr &s : stmts) RES_TRY(s->visit(*this));
+		return lak::ok_t{};
+	}
+
+	lak::result<> write_function(const lox::stmt::function &func)
+	{
+		RES_TRY(write_token(func.name));
+		RES_TRY(write_size(func.parameters.size()));
+		for (const lox::token &param : func.parameters)
+			RES_TRY(write_token(param));
+		lak::span<const lox::capture> captures = interpreter.find_captures(func);
+		RES_TRY(write_size(captures.size()));
+		for (const lox::capture &captured : captures)
+		{
+			RES_TRY(write_string(captured.name));
+			write_u32(static_cast<uint32_t>(captured.distance));
+		}
+		return write_stmts(func.body);
+	}
+
+	lak::result<> operator()(const lox::expr::assign &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::ASSIGN));
+		RES_TRY(write_token(expr.name));
+		RES_TRY(expr.value->visit(*this));
+		write_distance(expr);
+		return lak::ok_t{};
+	}
+
+	lak::result<> operator()(const lox::expr::binary &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::BINARY));
+		RES_TRY(expr.left->visit(*this));
+		RES_TRY(write_token(expr.op));
+		return expr.right->visit(*this);
+	}
+
+	lak::result<> operator()(const lox::expr::call &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::CALL));
+		RES_TRY(expr.callee->visit(*this));
+		RES_TRY(write_token(expr.paren));
+		RES_TRY(write_size(expr.arguments.size()));
+		for (const lox::expr_ptr &arg : expr.arguments)
+			RES_TRY(arg->visit(*this));
+		write_u8(interpreter.is_tail_call(expr) ? 1U : 0U);
+		return lak::ok_t{};
+	}
+
+	lak::result<> operator()(const lox::expr::get &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::GET));
+		RES_TRY(expr.object->visit(*this));
+		return write_token(expr.name);
+	}
+
+	lak::result<> operator()(const lox::expr::grouping &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::GROUPING));
+		return expr.expression->visit(*this);
+	}
+
+	lak::result<> operator()(const lox::expr::literal &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::LITERAL));
+		return write_object(expr.value);
+	}
+
+	lak::result<> operator()(const lox::expr::logical &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::LOGICAL));
+		RES_TRY(expr.left->visit(*this));
+		RES_TRY(write_token(expr.op));
+		return expr.right->visit(*this);
+	}
+
+	lak::result<> operator()(const lox::expr::set &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::SET));
+		RES_TRY(expr.object->visit(*this));
+		RES_TRY(write_token(expr.name));
+		return expr.value->visit(*this);
+	}
+
+	lak::result<> operator()(const lox::expr::super_keyword &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::SUPER));
+		RES_TRY(write_token(expr.keyword));
+		RES_TRY(write_token(expr.method));
+		write_distance(expr);
+		return lak::ok_t{};
+	}
+
+	lak::result<> operator()(const lox::expr::this_keyword &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::THIS));
+		RES_TRY(write_token(expr.keyword));
+		write_distance(expr);
+		return lak::ok_t{};
+	}
+
+	lak::result<> operator()(const lox::expr::unary &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::UNARY));
+		RES_TRY(write_token(expr.op));
+		return expr.right->visit(*this);
+	}
+
+	lak::result<> operator()(const lox::expr::variable &expr)
+	{
+		write_u8(static_cast<uint8_t>(expr_tag::VARIABLE));
+		RES_TRY(write_token(expr.name));
+		write_distance(expr);
+		return lak::ok_t{};
+	}
+
+	lak::result<> operator()(const lox::stmt::block &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::BLOCK));
+		RES_TRY(write_stmts(stmt.statements));
+		write_u8(interpreter.is_scopeless(stmt) ? 1U : 0U);
+		return lak::ok_t{};
+	}
+
+	lak::result<> operator()(const lox::stmt::type &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::TYPE));
+		RES_TRY(write_token(stmt.name));
+		if_ref (const lox::expr::variable &superclass, stmt.superclass)
+		{
+			write_u8(1U);
+			RES_TRY(write_token(superclass.name));
+			write_distance(superclass);
+		}
+		else
+			write_u8(0U);
+		RES_TRY(write_size(stmt.methods.size()));
+		for (const lox::stmt::function_ptr &method : stmt.methods)
+			RES_TRY(write_function(*method));
+		return lak::ok_t{};
+	}
+
+	lak::result<> operator()(const lox::stmt::expr &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::EXPR));
+		return stmt.expression->visit(*this);
+	}
+
+	lak::result<> operator()(const lox::stmt::branch &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::BRANCH));
+		RES_TRY(stmt.condition->visit(*this));
+		RES_TRY(stmt.then_branch->visit(*this));
+		if_ref (const lox::stmt_ptr &else_branch, stmt.else_branch)
+		{
+			write_u8(1U);
+			return else_branch->visit(*this);
+		}
+		write_u8(0U);
+		return lak::ok_t{};
+	}
+
+	lak::result<> operator()(const lox::stmt::print &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::PRINT));
+		return stmt.expression->visit(*this);
+	}
+
+	lak::result<> operator()(const lox::stmt::var &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::VAR));
+		RES_TRY(write_token(stmt.name));
+		return write_optional(stmt.init);
+	}
+
+	lak::result<> operator()(const lox::stmt::loop &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::LOOP));
+		RES_TRY(stmt.condition->visit(*this));
+		return stmt.body->visit(*this);
+	}
+
+	lak::result<> operator()(const lox::stmt::function_ptr &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::FUNCTION));
+		return write_function(*stmt);
+	}
+
+	lak::result<> operator()(const lox::stmt::ret &stmt)
+	{
+		write_u8(static_cast<uint8_t>(stmt_tag::RET));
+		RES_TRY(write_token(stmt.keyword));
+		return write_optional(stmt.value);
+	}
+};
+
+/* --- reading --- */
+
+struct ast_reader
+{
+	lak::span<const byte_t> data;
+	lox::lexeme_table &lexemes;
+	size_t cursor = 0U;
+
+	// only handed to the interpreter once the whole tree has been read, so a
+	// corrupt entry never leaves dangling pointers behind.
+	std::vector<std::pair<const lox::expr::variable *, size_t>> variables{};
+	std::vector<std::pair<const lox::expr::assign *, size_t>> assigns{};
+	std::vector<std::pair<const lox::expr::super_keyword *, size_t>> supers{};
+	std::vector<std::pair<const lox::expr::this_keyword *, size_t>> thises{};
+	std::vector<const lox::expr::call *> tail_calls{};
+	std::vector<std::pair<const lox::stmt::function *, lox::capture>> captures{};
+	std::vector<const lox::stmt::block *> scopeless_blocks{};
+
+	lak::result<lak::span<const byte_t>> read_bytes(size_t count)
+	{
+		if (count > data.size() - cursor) return lak::err_t{};
+		lak::span<const byte_t> result = data.subspan(cursor, count);
+		cursor += count;
+		return lak::ok_t{result};
+	}
+
+	lak::result<uint8_t> read_u8()
+	{
+		RES_TRY_ASSIGN(lak::span<const byte_t> bytes =, read_bytes(1U));
+		return lak::ok_t{static_cast<uint8_t>(bytes[0])};
+	}
+
+	lak::result<uint16_t> read_u16()
+	{
+		RES_TRY_ASSIGN(const uint8_t lo =, read_u8());
+		RES_TRY_ASSIGN(const uint8_t hi =, read_u8());
+		return lak::ok_t{
+		  static_cast<uint16_t>(uint16_t(lo) | (uint16_t(hi) << 8))};
+	}
+
+	lak::result<uint32_t> read_u32()
+	{
+		RES_TRY_ASSIGN(const uint16_t lo =, read_u16());
+		RES_TRY_ASSIGN(const uint16_t hi =, read_u16());
+		return lak::ok_t{uint32_t(lo) | (uint32_t(hi) << 16)};
+	}
+
+	lak::result<uint64_t> read_u64()
+	{
+		RES_TRY_ASSIGN(const uint32_t lo =, read_u32());
+		RES_TRY_ASSIGN(const uint32_t hi =, read_u32());
+		return lak::ok_t{uint64_t(lo) | (uint64_t(hi) << 32)};
+	}
+
+	lak::result<bool> read_flag()
+	{
+		RES_TRY_ASSIGN(const uint8_t flag =, read_u8());
+		if (flag > 1U) return lak::err_t{};
+		return lak::ok_t{flag == 1U};
+	}
+
+	lak::result<lak::u8string_view> read_string()
+	{
+		RES_TRY_ASSIGN(const uint32_t size =, read_u32());
+		RES_TRY_ASSIGN(lak::span<const byte_t> bytes =, read_bytes(size));
+		return lak::ok_t{lak::u8string_view(
+		  reinterpret_cast<const char8_t *>(bytes.data()), bytes.size())};
+	}
+
+	lak::result<lox::object> read_object()
+	{
+		RES_TRY_ASSIGN(const uint8_t tag =, read_u8());
+		switch (static_cast<object_tag>(tag))
+		{
+			case object_tag::NIL: return lak::ok_t{lox::object{}};
+
+			case object_tag::STRING:
+			{
+				RES_TRY_ASSIGN(lak::u8string_view str =, read_string());
+				return lak::ok_t{lox::object{str.to_string()}};
+			}
+
+			case object_tag::NUMBER:
+			{
+				RES_TRY_ASSIGN(const uint64_t bits =, read_u64());
+				double d;
+				std::memcpy(&d, &bits, sizeof(d));
+				return lak::ok_t{lox::object{d}};
+			}
+
+			case object_tag::BOOL:
+			{
+				RES_TRY_ASSIGN(const bool b =, read_flag());
+				return lak::ok_t{lox::object{b}};
+			}
+
+			default: return lak::err_t{};
+		}
+	}
+
+	lak::result<lox::token> read_token()
+	{
+		RES_TRY_ASSIGN(const uint8_t type =, read_u8());
+		if (type > static_cast<uint8_t>(lox::token_type::EOF_TOK))
+			return lak::err_t{};
+		RES_TRY_ASSIGN(lak::u8string_view lexeme =, read_string());
+		RES_TRY_ASSIGN(const uint32_t line =, read_u32());
+		return lak::ok_t{lox::token{
+		  .type = static_cast<lox::token_type>(type),
+		  .line = line,
+		  .text = &lexemes.intern(lexeme),
+		}};
+	}
+
+	template<typename T>
+	lak::result<> read_distance(
+	  const T *expr, std::vector<std::pair<const T *, size_t>> &resolved)
+	{
+		RES_TRY_ASSIGN(const uint32_t distance =, read_u32());
+		if (distance != unresolved) resolved.emplace_back(expr, distance);
+		return lak::ok_t{};
+	}
+
+	lak::result<lak::optional<lox::expr_ptr>> read_optional()
+	{
+		RES_TRY_ASSIGN(const bool present =, read_flag());
+		if (!present) return lak::ok_t{lak::optional<lox::expr_ptr>{}};
+		RES_TRY_ASSIGN(lox::expr_ptr expr =, read_expr());
+		return lak::ok_t{lak::optional<lox::expr_ptr>{lak::move(expr)}};
+	}
+
+	lak::result<std::vector<lox::expr_ptr>> read_exprs()
+	{
+		RES_TRY_ASSIGN(const uint32_t count =, read_u32());
+		std::vector<lox::expr_ptr> result;
+		for (uint32_t i = 0U; i < count; ++i)
+		{
+			RES_TRY_ASSIGN(lox::expr_ptr expr =, read_expr());
+			result.push_back(lak::move(expr));
+		}
+		return lak::move_ok(result);
+	}
+
+	lak::result<std::vector<lox::stmt_ptr>> read_stmts()
+	{
+		RES_TRY_ASSIGN(const uint32_t count =, read_u32());
+		std::vector<lox::stmt_ptr> result;
+		for (uint32_t i = 0U; i < count; ++i)
+		{
+			RES_TRY_ASSIGN(lox::stmt_ptr stmt =, read_stmt());
+			result.push_back(lak::move(stmt));
+		}
+		return lak::move_ok(result);
+	}
+
+	lak::result<lox::stmt::function_ptr> read_function()
+	{
+		RES_TRY_ASSIGN(lox::token name =, read_token());
+		RES_TRY_ASSIGN(const uint32_t parameter_count =, read_u32());
+		std::vector<lox::token> parameters;
+		for (uint32_t i = 0U; i < parameter_count; ++i)
+		{
+			RES_TRY_ASSIGN(lox::token param =, read_token());
+			parameters.push_back(lak::move(param));
+		}
+		RES_TRY_ASSIGN(const uint32_t capture_count =, read_u32());
+		std::vector<lox::capture> function_captures;
+		for (uint32_t i = 0U; i < capture_count; ++i)
+		{
+			RES_TRY_ASSIGN(lak::u8string_view captured =, read_string());
+			RES_TRY_ASSIGN(const uint32_t distance =, read_u32());
+			function_captures.push_back(lox::capture{
+			  .name     = lexemes.intern(captured),
+			  .distance = distance,
+			});
+		}
+		RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> body =, read_stmts());
+		lox::stmt::function_ptr result = lox::stmt::make_function_ptr({
+		  .name       = lak::move(name),
+		  .parameters = lak::move(parameters),
+		  .body       = lak::move(body),
+		});
+		for (const lox::capture &captured : function_captures)
+			captures.emplace_back(&*result, captured);
+		return lak::move_ok(result);
+	}
+
+	lak::result<lox::expr_ptr> read_expr()
+	{
+		RES_TRY_ASSIGN(const uint8_t tag =, read_u8());
+		switch (static_cast<expr_tag>(tag))
+		{
+			case expr_tag::ASSIGN:
+			{
+				RES_TRY_ASSIGN(lox::token name =, read_token());
+				RES_TRY_ASSIGN(lox::expr_ptr value =, read_expr());
+				lox::expr_ptr result = lox::expr::make_assign({
+				  .name  = lak::move(name),
+				  .value = lak::move(value),
+				});
+				RES_TRY(read_distance(
+				  result->value.template get<lox::expr::assign>(), assigns));
+				return lak::move_ok(result);
+			}
+
+			case expr_tag::BINARY:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr left =, read_expr());
+				RES_TRY_ASSIGN(lox::token op =, read_token());
+				RES_TRY_ASSIGN(lox::expr_ptr right =, read_expr());
+				return lak::ok_t{lox::expr::make_binary({
+				  .left  = lak::move(left),
+				  .op    = lak::move(op),
+				  .right = lak::move(right),
+				})};
+			}
+
+			case expr_tag::CALL:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr callee =, read_expr());
+				RES_TRY_ASSIGN(lox::token paren =, read_token());
+				RES_TRY_ASSIGN(std::vector<lox::expr_ptr> arguments =, read_exprs());
+				lox::expr_ptr result = lox::expr::make_call({
+				  .callee    = lak::move(callee),
+				  .paren     = lak::move(paren),
+				  .arguments = lak::move(arguments),
+				});
+				RES_TRY_ASSIGN(const bool tail =, read_flag());
+				if (tail)
+					tail_calls.push_back(result->value.template get<lox::expr::call>());
+				return lak::move_ok(result);
+			}
+
+			case expr_tag::GET:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr object =, read_expr());
+				RES_TRY_ASSIGN(lox::token name =, read_token());
+				return lak::ok_t{lox::expr::make_get({
+				  .object = lak::move(object),
+				  .name   = lak::move(name),
+				})};
+			}
+
+			case expr_tag::GROUPING:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr expression =, read_expr());
+				return lak::ok_t{
+				  lox::expr::make_grouping({.expression = lak::move(expression)})};
+			}
+
+			case expr_tag::LITERAL:
+			{
+				RES_TRY_ASSIGN(lox::object value =, read_object());
+				return lak::ok_t{
+				  lox::expr::make_literal({.value = lak::move(value)})};
+			}
+
+			case expr_tag::LOGICAL:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr left =, read_expr());
+				RES_TRY_ASSIGN(lox::token op =, read_token());
+				RES_TRY_ASSIGN(lox::expr_ptr right =, read_expr());
+				return lak::ok_t{lox::expr::make_logical({
+				  .left  = lak::move(left),
+				  .op    = lak::move(op),
+				  .right = lak::move(right),
+				})};
+			}
+
+			case expr_tag::SET:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr object =, read_expr());
+				RES_TRY_ASSIGN(lox::token name =, read_token());
+				RES_TRY_ASSIGN(lox::expr_ptr value =, read_expr());
+				return lak::ok_t{lox::expr::make_set({
+				  .object = lak::move(object),
+				  .name   = lak::move(name),
+				  .value  = lak::move(value),
+				})};
+			}
+
+			case expr_tag::SUPER:
+			{
+				RES_TRY_ASSIGN(lox::token keyword =, read_token());
+				RES_TRY_ASSIGN(lox::token method =, read_token());
+				lox::expr_ptr result = lox::expr::make_super({
+				  .keyword = lak::move(keyword),
+				  .method  = lak::move(method),
+				});
+				RES_TRY(read_distance(
+				  result->value.template get<lox::expr::super_keyword>(), supers));
+				return lak::move_ok(result);
+			}
+
+			case expr_tag::THIS:
+			{
+				RES_TRY_ASSIGN(lox::token keyword =, read_token());
+				lox::expr_ptr result =
+				  lox::expr::make_this({.keyword = lak::move(keyword)});
+				RES_TRY(read_distance(
+				  result->value.template get<lox::expr::this_keyword>(), thises));
+				return lak::move_ok(result);
+			}
+
+			case expr_tag::UNARY:
+			{
+				RES_TRY_ASSIGN(lox::token op =, read_token());
+				RES_TRY_ASSIGN(lox::expr_ptr right =, read_expr());
+				return lak::ok_t{lox::expr::make_unary({
+				  .op    = lak::move(op),
+				  .right = lak::move(right),
+				})};
+			}
+
+			case expr_tag::VARIABLE:
+			{
+				RES_TRY_ASSIGN(lox::token name =, read_token());
+				lox::expr_ptr result =
+				  lox::expr::make_variable({.name = lak::move(name)});
+				RES_TRY(read_distance(
+				  result->value.template get<lox::expr::variable>(), variables));
+				return lak::move_ok(result);
+			}
+
+			default: return lak::err_t{};
+		}
+	}
+
+	lak::result<lox::stmt_ptr> read_stmt()
+	{
+		RES_TRY_ASSIGN(const uint8_t tag =, read_u8());
+		switch (static_cast<stmt_tag>(tag))
+		{
+			case stmt_tag::BLOCK:
+			{
+				RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> statements =,
+				               read_stmts());
+				RES_TRY_ASSIGN(const bool scopeless =, read_flag());
+				lox::stmt_ptr result =
+				  lox::stmt::make_block({.statements = lak::move(statements)});
+				if (scopeless)
+					scopeless_blocks.push_back(
+					  result->value.template get<lox::stmt::block>());
+				return lak::move_ok(result);
+			}
+
+			case stmt_tag::TYPE:
+			{
+				RES_TRY_ASSIGN(lox::token name =, read_token());
+				lox::stmt_ptr result = lox::stmt::make_type({
+				  .name       = lak::move(name),
+				  .superclass = lak::nullopt,
+				  .methods    = {},
+				});
+				// the superclass is stored inline, so it must be read into its
+				// final location before its address can be recorded
+				lox::stmt::type *type = result->value.template get<lox::stmt::type>();
+				RES_TRY_ASSIGN(const bool has_superclass =, read_flag());
+				if (has_superclass)
+				{
+					RES_TRY_ASSIGN(lox::token superclass =, read_token());
+					type->superclass =
+					  lox::expr::variable{.name = lak::move(superclass)};
+					RES_TRY(read_distance(&*type->superclass, variables));
+				}
+				RES_TRY_ASSIGN(const uint32_t method_count =, read_u32());
+				for (uint32_t i = 0U; i < method_count; ++i)
+				{
+					RES_TRY_ASSIGN(lox::stmt::function_ptr method =, read_function());
+					type->methods.push_back(lak::move(method));
+				}
+				return lak::move_ok(result);
+			}
+
+			case stmt_tag::EXPR:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr expression =, read_expr());
+				return lak::ok_t{
+				  lox::stmt::make_expr({.expression = lak::move(expression)})};
+			}
+
+			case stmt_tag::BRANCH:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr condition =, read_expr());
+				RES_TRY_ASSIGN(lox::stmt_ptr then_branch =, read_stmt());
+				RES_TRY_ASSIGN(const bool has_else =, read_flag());
+				lak::optional<lox::stmt_ptr> else_branch;
+				if (has_else)
+				{
+					RES_TRY_ASSIGN(lox::stmt_ptr stmt =, read_stmt());
+					else_branch = lak::move(stmt);
+				}
+				return lak::ok_t{lox::stmt::make_branch({
+				  .condition   = lak::move(condition),
+				  .then_branch = lak::move(then_branch),
+				  .else_branch = lak::move(else_branch),
+				})};
+			}
+
+			case stmt_tag::PRINT:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr expression =, read_expr());
+				return lak::ok_t{
+				  lox::stmt::make_print({.expression = lak::move(expression)})};
+			}
+
+			case stmt_tag::VAR:
+			{
+				RES_TRY_ASSIGN(lox::token name =, read_token());
+				RES_TRY_ASSIGN(lak::optional<lox::expr_ptr> init =, read_optional());
+				return lak::ok_t{lox::stmt::make_var({
+				  .name = lak::move(name),
+				  .init = lak::move(init),
+				})};
+			}
+
+			case stmt_tag::LOOP:
+			{
+				RES_TRY_ASSIGN(lox::expr_ptr condition =, read_expr());
+				RES_TRY_ASSIGN(lox::stmt_ptr body =, read_stmt());
+				return lak::ok_t{lox::stmt::make_loop({
+				  .condition = lak::move(condition),
+				  .body      = lak::move(body),
+				})};
+			}
+
+			case stmt_tag::FUNCTION:
+			{
+				RES_TRY_ASSIGN(lox::stmt::function_ptr function =, read_function());
+				return lak::ok_t{
+				  lox::stmt::make_function_from_ptr(lak::move(function))};
+			}
+
+			case stmt_tag::RET:
+			{
+				RES_TRY_ASSIGN(lox::token keyword =, read_token());
+				RES_TRY_ASSIGN(lak::optional<lox::expr_ptr> value =, read_optional());
+				return lak::ok_t{lox::stmt::make_ret({
+				  .keyword = lak::move(keyword),
+				  .value   = lak::move(value),
+				})};
+			}
+
+			default: return lak::err_t{};
+		}
+	}
+};
+
+/* --- ast_cache --- */
+
+lox::ast_cache lox::ast_cache::make_default()
+{
+	if (const char *dir = std::getenv("LOX_CACHE_DIR"); dir && *dir)
+		return lox::ast_cache{.directory = dir};
+
+	std::error_code ec;
+	std::filesystem::path temp = std::filesystem::temp_directory_path(ec);
+	// an empty directory just means every lookup misses
+	if (ec) return lox::ast_cache{};
+	return lox::ast_cache{.directory = temp / "lox-cache"};
+}
+
+uint64_t lox::ast_cache::key(std::istream &source)
+{
+	// 64 bit FNV-1a, seeded with the format version so that entries written by
+	// a different build are never picked up.
+	uint64_t hash = 0xCBF2'9CE4'8422'2325U;
+	auto mix      = [&](uint8_t b)
+	{
+		hash ^= b;
+		hash *= 0x0000'0100'0000'01B3U;
+	};
+	mix(static_cast<uint8_t>(lox::ast_cache_version & 0xFF));
+	mix(static_cast<uint8_t>(lox::ast_cache_version >> 8));
+	char block[4096];
+	do
+	{
+		source.read(block, sizeof(block));
+		const size_t count = static_cast<size_t>(source.gcount());
+		for (size_t i = 0U; i < count; ++i) mix(static_cast<uint8_t>(block[i]));
+	} while (source);
+	return hash;
+}
+
+std::filesystem::path lox::ast_cache::entry_path(uint64_t key) const
+{
+	char name[32];
+	std::snprintf(
+	  name, sizeof(name), "%016llx.loxa", static_cast<unsigned long long>(key));
+	return directory / name;
+}
+
+lak::result<std::vector<byte_t>> lox::serialise_ast(
+  lox::interpreter &interpreter, lak::span<const lox::stmt_ptr> stmts)
+{
+	ast_writer writer{.interpreter = interpreter, .out = {}};
+	for (const byte_t b : ast_cache_magic) writer.write_u8(b);
+	writer.write_u16(lox::ast_cache_version);
+	RES_TRY(writer.write_stmts(stmts));
+	return lak::move_ok(writer.out);
+}
+
+lak::result<std::vector<lox::stmt_ptr>> lox::deserialise_ast(
+  lox::interpreter &interpreter, lak::span<const byte_t> data)
+{
+	ast_reader reader{.data = data, .lexemes = interpreter.lexemes};
+
+	RES_TRY_ASSIGN(lak::span<const byte_t> magic =,
+	               reader.read_bytes(sizeof(ast_cache_magic)));
+	if (std::memcmp(magic.data(), ast_cache_magic, sizeof(ast_cache_magic)) !=
+	    0)
+		return lak::err_t{};
+	RES_TRY_ASSIGN(const uint16_t version =, reader.read_u16());
+	if (version != lox::ast_cache_version) return lak::err_t{};
+
+	RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =, reader.read_stmts());
+	if (reader.cursor != reader.data.size()) return lak::err_t{};
+
+	for (const auto &[expr, distance] : reader.variables)
+		interpreter.resolve(*expr, distance);
+	for (const auto &[expr, distance] : reader.assigns)
+		interpreter.resolve(*expr, distance);
+	for (const auto &[expr, distance] : reader.supers)
+		interpreter.resolve(*expr, distance);
+	for (const auto &[expr, distance] : reader.thises)
+		interpreter.resolve(*expr, distance);
+	for (const lox::expr::call *expr : reader.tail_calls)
+		interpreter.resolve_tail_call(*expr);
+	for (const auto &[func, captured] : reader.captures)
+		interpreter.resolve_capture(*func, captured);
+	for (const lox::stmt::block *stmt : reader.scopeless_blocks)
+		interpreter.resolve_scopeless(*stmt);
+
+	return lak::move_ok(stmts);
+}
+
+lak::result<std::vector<lox::stmt_ptr>> lox::ast_cache::load(
+  lox::interpreter &interpreter, uint64_t key)
+{
+	auto read = [&]() -> lak::result<std::vector<lox::stmt_ptr>>
+	{
+		if (directory.empty()) return lak::err_t{};
+
+		RES_TRY_ASSIGN(const lak::array<byte_t> file =,
+		               lak::read_file(entry_path(key))
+		                 .map_err([](auto &&) -> lak::monostate { return {}; }));
+
+		return lox::deserialise_ast(interpreter,
+		                            lak::span<const byte_t>(lak::span(file)));
+	};
+
+	if_let_ok (std::vector<lox::stmt_ptr> & stmts, read())
+	{
+		++hits;
+		return lak::move_ok(stmts);
+	}
+
+	++misses;
+	return lak::err_t{};
+}
+
+void lox::ast_cache::store(lox::interpreter &interpreter,
+                           uint64_t key,
+                           lak::span<const lox::stmt_ptr> stmts) const
+{
+	if (directory.empty()) return;
+
+	if_let_ok (const std::vector<byte_t> &image,
+	           lox::serialise_ast(interpreter, stmts))
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(directory, ec);
+		if (ec) return;
+
+		// write then rename so that a concurrent run never reads a partially
+		// written entry
+		const std::filesystem::path path = entry_path(key);
+		std::filesystem::path temp       = path;
+		temp += ".tmp";
+		if (lak::save_file(temp, lak::span<const byte_t>(image)).is_err())
+			return;
+		std::filesystem::rename(temp, path, ec);
+		if (ec) std::filesystem::remove(temp, ec);
+	}
+}
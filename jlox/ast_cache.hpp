@@ -0,0 +1,64 @@
+#ifndef LOX_AST_CACHE_HPP
+#define LOX_AST_CACHE_HPP
+
+#include "stmt.hpp"
+
+#include <lak/result.hpp>
+#include <lak/span.hpp>
+#include <lak/stdint.hpp>
+
+#include <filesystem>
+#include <istream>
+#include <vector>
+
+namespace lox
+{
+	struct interpreter;
+
+	// Bump whenever the AST or the encoding below changes.
+	//
+	// Resolved variable distances are stored inline after the node they belong
+	// to, calls are followed by whether they're in tail position, blocks by
+	// whether they get an environment, and functions' parameters by the
+	// variables they capture.
+	inline constexpr uint16_t ast_cache_version = 6U;
+
+	// The encoding used for cache entries. Resolved distances are read from
+	// interpreter when serialising and registered with it when deserialising.
+	lak::result<std::vector<byte_t>> serialise_ast(
+	  lox::interpreter &interpreter, lak::span<const lox::stmt_ptr> stmts);
+
+	lak::result<std::vector<lox::stmt_ptr>> deserialise_ast(
+	  lox::interpreter &interpreter, lak::span<const byte_t> data);
+
+	// An on-disk cache of scanned, parsed and resolved scripts, keyed by a hash
+	// of the source bytes and ast_cache_version.
+	struct ast_cache
+	{
+		std::filesystem::path directory;
+
+		size_t hits   = 0U;
+		size_t misses = 0U;
+
+		// $LOX_CACHE_DIR if set, otherwise "lox-cache" in the temp directory.
+		static lox::ast_cache make_default();
+
+		// hashes the rest of source in fixed size blocks.
+		static uint64_t key(std::istream &source);
+
+		std::filesystem::path entry_path(uint64_t key) const;
+
+		// On a hit the resolved distances are registered with interpreter as if
+		// the resolver had run. Missing or corrupt entries count as a miss.
+		lak::result<std::vector<lox::stmt_ptr>> load(lox::interpreter &interpreter,
+		                                             uint64_t key);
+
+		// Failing to write an entry is not an error, the script just won't be
+		// cached.
+		void store(lox::interpreter &interpreter,
+		           uint64_t key,
+		           lak::span<const lox::stmt_ptr> stmts) const;
+	};
+}
+
+#endif
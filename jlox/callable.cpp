@@ -9,6 +9,8 @@
 
 struct lox::callable::impl
 {
+	static constexpr char pool_name[] = "callable";
+
 	struct native
 	{
 		lak::result<lox::object> (*function)(lox::interpreter &,
@@ -38,8 +40,7 @@ lox::callable::callable(native_function_ptr_t function, size_t arity)
                                             .function = function,
                                             .arity    = arity,
                                           },
-                                      })
-          .unwrap())
+                                      }))
 {
 }
 
@@ -53,8 +54,7 @@ lox::callable::callable(lox::stmt::function_ptr function,
                                             .closure  = closure,
                                             .is_init  = is_init,
                                           },
-                                      })
-          .unwrap())
+                                      }))
 {
 }
 
@@ -64,8 +64,7 @@ lox::callable::callable(const lox::type &type)
                                           lox::callable::impl::constructor{
                                             .type = type,
                                           },
-                                      })
-          .unwrap())
+                                      }))
 {
 }
 
@@ -115,7 +114,7 @@ lak::u8string lox::callable::to_string() const
 	    [](const lox::callable::impl::native &) -> lak::u8string
 	    { return u8"<native function>"; },
 	    [](const lox::callable::impl::interpreted &c) -> lak::u8string
-	    { return u8"<fn " + c.function->name.lexeme.to_string() + u8">"; },
+	    { return u8"<fn " + c.function->name.lexeme().to_string() + u8">"; },
 	    [](const lox::callable::impl::constructor &c) -> lak::u8string
 	    { return u8"<ctor " + c.type.name() + u8">"; },
 	  },
@@ -152,44 +151,63 @@ bool lox::callable::operator==(const callable &rhs) const
 	  _impl->value);
 }
 
-lak::result<lox::object> lox::callable::operator()(
+lak::result<lox::activation> lox::callable::activate(
   lox::interpreter &interpreter, std::vector<lox::object> &&arguments) const
 {
 	return lak::visit(
 	  lak::overloaded{
-	    [&](const lox::callable::impl::native &c) -> lak::result<lox::object>
-	    { return c.function(interpreter, lak::move(arguments)); },
-	    [&](
-	      const lox::callable::impl::interpreted &c) -> lak::result<lox::object>
+	    [&](const lox::callable::impl::native &c) -> lak::result<lox::activation>
+	    {
+		    RES_TRY_ASSIGN(lox::object result =,
+		                   c.function(interpreter, lak::move(arguments)));
+		    return lak::ok_t{lox::activation{
+		      .body        = {},
+		      .environment = {},
+		      .result      = lak::optional<lox::object>{lak::move(result)},
+		    }};
+	    },
+	    [&](const lox::callable::impl::interpreted &c)
+	      -> lak::result<lox::activation>
 	    {
 		    lox::environment_ptr env = lox::environment::make(c.closure);
 
 		    for (size_t i = 0; i < c.function->parameters.size(); ++i)
-			    env->emplace(c.function->parameters[i].lexeme, arguments[i]);
+			    env->emplace(c.function->parameters[i].lexeme(), arguments[i]);
 
-		    RES_TRY_ASSIGN(
-		      lox::object result =,
-		      interpreter.execute_block(
-		        lak::span<const lox::stmt_ptr>(c.function->body), env));
+		    lak::optional<lox::object> result;
+		    if (c.is_init) result.emplace(*c.closure->find(u8"this"_view));
 
-		    if (c.is_init)
-			    return lak::ok_t<lox::object>{*c.closure->find(u8"this"_view)};
-		    else
-			    return lak::ok_t{result};
+		    return lak::ok_t{lox::activation{
+		      .body        = lak::span<const lox::stmt_ptr>(c.function->body),
+		      .environment = lak::move(env),
+		      .result      = lak::move(result),
+		    }};
 	    },
-	    [&](
-	      const lox::callable::impl::constructor &c) -> lak::result<lox::object>
+	    [&](const lox::callable::impl::constructor &c)
+	      -> lak::result<lox::activation>
 	    {
 		    lox::instance instance = lox::instance(c.type, {});
 
 		    return c.type.find_bound_method(u8"init"_view, instance)
 		      .visit(lak::overloaded{
-		        [&](const lox::callable &init) -> lak::result<lox::object>
-		        { return init(interpreter, lak::move(arguments)); },
-		        [&](const lak::monostate &) -> lak::result<lox::object>
-		        { return lak::ok_t<lox::object>{instance}; },
+		        [&](const lox::callable &init) -> lak::result<lox::activation>
+		        { return init.activate(interpreter, lak::move(arguments)); },
+		        [&](const lak::monostate &) -> lak::result<lox::activation>
+		        {
+			        return lak::ok_t{lox::activation{
+			          .body        = {},
+			          .environment = {},
+			          .result = lak::optional<lox::object>{lox::object{instance}},
+			        }};
+		        },
 		      });
 	    },
 	  },
 	  _impl->value);
 }
+
+lak::result<lox::object> lox::callable::operator()(
+  lox::interpreter &interpreter, std::vector<lox::object> &&arguments) const
+{
+	return interpreter.call(*this, lak::move(arguments));
+}
@@ -3,9 +3,11 @@
 
 #include "interpreter.hpp"
 #include "object.hpp"
+#include "pool.hpp"
 #include "stmt.hpp"
 
 #include <lak/memory.hpp>
+#include <lak/optional.hpp>
 #include <lak/span.hpp>
 #include <lak/string.hpp>
 #include <lak/string_view.hpp>
@@ -17,11 +19,22 @@ namespace lox
 {
 	struct type;
 
+	// an interpreted function's body, to be run in environment (where its
+	// parameters are bound).
+	struct activation
+	{
+		lak::span<const lox::stmt_ptr> body;
+		lox::environment_ptr environment;
+		// returned in place of what body returns, if set: the instance that an
+		// initialiser was bound to, or the result of a call with no body.
+		lak::optional<lox::object> result;
+	};
+
 	struct callable
 	{
 	private:
 		struct impl;
-		using impl_ptr = lak::shared_ref<impl>;
+		using impl_ptr = lox::pool_ptr<impl>;
 
 		impl_ptr _impl;
 
@@ -55,6 +68,13 @@ namespace lox
 
 		bool operator==(const callable &rhs) const;
 
+		// natives, and constructors without an initialiser, are called right
+		// away. anything else is left for the caller to run, so that calls
+		// between interpreted functions don't nest on the native stack.
+		lak::result<lox::activation> activate(
+		  lox::interpreter &interpreter,
+		  std::vector<lox::object> &&arguments) const;
+
 		lak::result<lox::object> operator()(
 		  lox::interpreter &interpreter,
 		  std::vector<lox::object> &&arguments) const;
@@ -2,6 +2,15 @@
 
 #include <lak/utility.hpp>
 
+#include <vector>
+
+// blocks and calls leave their environments here, so that the next ones to
+// be entered don't need to allocate an environment and its buckets.
+thread_local std::vector<lox::environment_ptr> free_environments;
+
+// enough for the environments of a few dozen nested calls.
+constexpr size_t max_free_environments = 256U;
+
 lox::environment *find_ancestor(lox::environment *env, size_t distance)
 {
 	while (env && distance-- > 0) env = env->enclosing.get();
@@ -11,19 +20,22 @@ lox::environment *find_ancestor(lox::environment *env, size_t distance)
 const lox::object &lox::environment::emplace(lak::u8string_view k,
                                              lox::object v)
 {
-	return values.insert_or_assign(k.to_string(), lak::move(v)).first->second;
+	return values
+	  .insert_or_assign(k.to_string(),
+	                    variable{.value = lak::move(v), .box = {}})
+	  .first->second.get();
 }
 
 const lox::object &lox::environment::emplace(const lox::token &k,
                                              lox::object v)
 {
-	return emplace(k.lexeme, lak::move(v));
+	return emplace(k.lexeme(), lak::move(v));
 }
 
 const lox::object *lox::environment::find(lak::u8string_view k)
 {
 	if (auto it = values.find(k); it != values.end())
-		return &it->second;
+		return &it->second.get();
 	else if (enclosing)
 		return enclosing->find(k);
 	else
@@ -39,21 +51,22 @@ const lox::object *lox::environment::find(lak::u8string_view k,
 
 const lox::object *lox::environment::find(const lox::token &k)
 {
-	return find(k.lexeme);
+	return find(k.lexeme());
 }
 
 const lox::object *lox::environment::find(const lox::token &k, size_t distance)
 {
-	return find(k.lexeme, distance);
+	return find(k.lexeme(), distance);
 }
 
 const lox::object *lox::environment::replace(const lox::token &k,
                                              lox::object v)
 {
-	if (auto it = values.find(k.lexeme); it != values.end())
+	if (auto it = values.find(k.lexeme()); it != values.end())
 	{
-		it->second = lak::move(v);
-		return &it->second;
+		lox::object &value = it->second.get();
+		value              = lak::move(v);
+		return &value;
 	}
 	else if (enclosing)
 		return enclosing->replace(k, lak::move(v));
@@ -69,7 +82,49 @@ const lox::object *lox::environment::replace(const lox::token &k,
 	return env ? env->replace(k, lak::move(v)) : nullptr;
 }
 
+const lox::object *lox::environment::capture(lak::u8string_view k,
+                                             lox::environment &source,
+                                             size_t distance)
+{
+	for (lox::environment *env = find_ancestor(&source, distance); env;
+	     env                   = env->enclosing.get())
+	{
+		auto it = env->values.find(k);
+		if (it == env->values.end()) continue;
+
+		variable &captured = it->second;
+		if (!captured.box)
+		{
+			captured.box   = box_ptr::make(lak::move(captured.value));
+			captured.value = lox::object{};
+		}
+
+		return &values
+		          .insert_or_assign(k.to_string(),
+		                            variable{.value = {}, .box = captured.box})
+		          .first->second.get();
+	}
+
+	return nullptr;
+}
+
 lox::environment_ptr lox::environment::make(lox::environment_ptr enclosing)
 {
-	return lox::environment_ptr::make(lox::environment{.enclosing = enclosing});
+	if (free_environments.empty())
+		return lox::environment_ptr::make(
+		  lox::environment{.enclosing = lak::move(enclosing)});
+
+	lox::environment_ptr result = lak::move(free_environments.back());
+	free_environments.pop_back();
+	result->enclosing = lak::move(enclosing);
+	return result;
+}
+
+void lox::environment::recycle(lox::environment_ptr &&env)
+{
+	if (free_environments.size() >= max_free_environments) return;
+
+	env->values.clear();
+	env->enclosing = {};
+	free_environments.push_back(lak::move(env));
 }
@@ -2,6 +2,7 @@
 #define LOX_ENVIRONMENT_HPP
 
 #include "object.hpp"
+#include "pool.hpp"
 #include "string_map.hpp"
 #include "token.hpp"
 
@@ -13,10 +14,23 @@ namespace lox
 {
 	struct environment
 	{
-		using environment_ptr = lak::shared_ptr<environment>;
+		using environment_ptr = lox::pool_ptr<environment>;
+		using box_ptr         = lak::shared_ptr<lox::object>;
+
+		// once a closure captures a variable its value moves into a box, which
+		// the closure's environment shares.
+		struct variable
+		{
+			lox::object value;
+			box_ptr box;
+
+			lox::object &get() { return box ? *box : value; }
+		};
+
+		static constexpr char pool_name[] = "environment";
 
 		environment_ptr enclosing;
-		lox::string_map<char8_t, lox::object> values;
+		lox::string_map<char8_t, variable> values;
 
 		const lox::object &emplace(lak::u8string_view k, lox::object v);
 
@@ -36,7 +50,19 @@ namespace lox
 		                           lox::object v,
 		                           size_t distance);
 
+		// declares k here, sharing the box of the variable k that's declared
+		// distance environments above source. returns nullptr if there isn't
+		// one.
+		const lox::object *capture(lak::u8string_view k,
+		                           lox::environment &source,
+		                           size_t distance);
+
+		// reuses an environment given to recycle if there are any.
 		static environment_ptr make(environment_ptr enclosing = {});
+
+		// hands env back to make once its scope has been left. nothing else can
+		// still refer to env.
+		static void recycle(environment_ptr &&env);
 	};
 
 	using environment_ptr = lox::environment::environment_ptr;
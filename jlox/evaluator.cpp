@@ -3,74 +3,13 @@
 #include "callable.hpp"
 #include "type.hpp"
 
-#include <lak/defer.hpp>
 #include <lak/string_ostream.hpp>
 
-lak::err_t<> lox::evaluator::error(const lox::token &token,
-                                   lak::u8string_view message,
-                                   const std::source_location srcloc)
-{
-	interpreter.error(token, message, srcloc);
-	return lak::err_t{};
-}
-
-lak::result<lak::u8string> lox::evaluator::execute_block(
-  lak::span<const lox::stmt_ptr> statements, const lox::environment_ptr &env)
+lak::result<lox::object> binary_operation(lox::evaluator &eval,
+                                          const lox::expr::binary &expr,
+                                          const lox::object &left,
+                                          const lox::object &right)
 {
-	lox::environment_ptr previous = std::exchange(environment, env);
-	DEFER(environment = previous);
-
-	for (const auto &s : statements)
-	{
-		RES_TRY(s->visit(*this));
-		if (block_ret_value) break;
-	}
-
-	return lak::ok_t<lak::u8string>{};
-}
-
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::assign &expr)
-{
-	return expr.value->visit(*this).and_then(
-	  [&](const lox::object &value) -> lak::result<lox::object>
-	  {
-		  return interpreter.find(expr).visit(lak::overloaded{
-		    [&](size_t distance) -> lak::result<lox::object>
-		    {
-			    return lak::copy_result_from_pointer(
-			             environment->replace(expr.name, value, distance))
-			      .or_else(
-			        [&](auto &&) -> lak::result<lox::object>
-			        {
-				        return error(expr.name,
-				                     u8"Undefined local variable '"_str +
-				                       expr.name.lexeme.to_string() + u8"'.");
-			        });
-		    },
-		    [&](lak::monostate) -> lak::result<lox::object>
-		    {
-			    return lak::copy_result_from_pointer(
-			             interpreter.global_environment->replace(expr.name, value))
-			      .or_else(
-			        [&](auto &&) -> lak::result<lox::object>
-			        {
-				        return error(expr.name,
-				                     u8"Undefined global variable '"_str +
-				                       expr.name.lexeme.to_string() + u8"'.");
-			        });
-		    },
-		  });
-	  });
-}
-
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::binary &expr)
-{
-	RES_TRY_ASSIGN(lox::object left =, expr.left->visit(*this));
-
-	RES_TRY_ASSIGN(lox::object right =, expr.right->visit(*this));
-
 	switch (expr.op.type)
 	{
 		using enum lox::token_type;
@@ -84,7 +23,7 @@ lak::result<lox::object> lox::evaluator::operator()(
 			auto left_num  = left.get_number();
 			auto right_num = right.get_number();
 			if (!left_num || !right_num)
-				return error(expr.op, u8"Operands must be numbers.");
+				return eval.error(expr.op, u8"Operands must be numbers.");
 			return lak::ok_t{lox::object{*left_num > *right_num}};
 		}
 
@@ -93,7 +32,7 @@ lak::result<lox::object> lox::evaluator::operator()(
 			auto left_num  = left.get_number();
 			auto right_num = right.get_number();
 			if (!left_num || !right_num)
-				return error(expr.op, u8"Operands must be numbers.");
+				return eval.error(expr.op, u8"Operands must be numbers.");
 			return lak::ok_t{lox::object{*left_num >= *right_num}};
 		}
 
@@ -102,7 +41,7 @@ lak::result<lox::object> lox::evaluator::operator()(
 			auto left_num  = left.get_number();
 			auto right_num = right.get_number();
 			if (!left_num || !right_num)
-				return error(expr.op, u8"Operands must be numbers.");
+				return eval.error(expr.op, u8"Operands must be numbers.");
 			return lak::ok_t{lox::object{*left_num < *right_num}};
 		}
 
@@ -111,7 +50,7 @@ lak::result<lox::object> lox::evaluator::operator()(
 			auto left_num  = left.get_number();
 			auto right_num = right.get_number();
 			if (!left_num || !right_num)
-				return error(expr.op, u8"Operands must be numbers.");
+				return eval.error(expr.op, u8"Operands must be numbers.");
 			return lak::ok_t{lox::object{*left_num <= *right_num}};
 		}
 
@@ -129,7 +68,8 @@ lak::result<lox::object> lox::evaluator::operator()(
 				if (left_string && right_string)
 					return lak::ok_t{lox::object{*left_string + *right_string}};
 			}
-			return error(expr.op, u8"Operands must be two numbers or two strings.");
+			return eval.error(expr.op,
+			                  u8"Operands must be two numbers or two strings.");
 		}
 
 		case MINUS:
@@ -137,7 +77,7 @@ lak::result<lox::object> lox::evaluator::operator()(
 			auto left_num  = left.get_number();
 			auto right_num = right.get_number();
 			if (!left_num || !right_num)
-				return error(expr.op, u8"Operands must be numbers.");
+				return eval.error(expr.op, u8"Operands must be numbers.");
 			return lak::ok_t{lox::object{*left_num - *right_num}};
 		}
 
@@ -146,7 +86,7 @@ lak::result<lox::object> lox::evaluator::operator()(
 			auto left_num  = left.get_number();
 			auto right_num = right.get_number();
 			if (!left_num || !right_num)
-				return error(expr.op, u8"Operands must be numbers.");
+				return eval.error(expr.op, u8"Operands must be numbers.");
 			return lak::ok_t{lox::object{*left_num / *right_num}};
 		}
 
@@ -155,7 +95,7 @@ lak::result<lox::object> lox::evaluator::operator()(
 			auto left_num  = left.get_number();
 			auto right_num = right.get_number();
 			if (!left_num || !right_num)
-				return error(expr.op, u8"Operands must be numbers.");
+				return eval.error(expr.op, u8"Operands must be numbers.");
 			return lak::ok_t{lox::object{*left_num * *right_num}};
 		}
 	}
@@ -163,100 +103,183 @@ lak::result<lox::object> lox::evaluator::operator()(
 	return lak::ok_t<lox::object>{};
 }
 
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::call &expr)
+
+lak::err_t<> lox::evaluator::error(const lox::token &token,
+                                   lak::u8string_view message,
+                                   const std::source_location srcloc)
 {
-	RES_TRY_ASSIGN(lox::object callee =, expr.callee->visit(*this));
+	interpreter.error(token, message, srcloc);
+	return lak::err_t{};
+}
 
-	const lox::callable *maybe_callable = callee.get_callable();
-	if (!maybe_callable)
-		return error(expr.paren, u8"Can only call functions and classes.");
+lak::result<lox::object> lox::evaluator::run(const lox::expr &expr)
+{
+	tasks.push_back(evaluate{&expr});
+	RES_TRY(run());
+	return lak::ok_t{pop()};
+}
 
-	const lox::callable &callable = *maybe_callable;
+lak::result<lak::u8string> lox::evaluator::run(const lox::stmt &stmt)
+{
+	RES_TRY(stmt.visit(*this));
+	RES_TRY(run());
+	return lak::ok_t{lak::move(output)};
+}
 
-	std::vector<lox::object> arguments;
-	arguments.reserve(expr.arguments.size());
-	for (const auto &argument : expr.arguments)
+lak::result<lox::object> lox::evaluator::run(lox::activation &&activation)
+{
+	RES_TRY(enter(lak::move(activation)));
+	RES_TRY(run());
+	return lak::ok_t{pop()};
+}
+
+lak::result<> lox::evaluator::run()
+{
+	while (!tasks.empty())
 	{
-		RES_TRY_ASSIGN(lox::object obj =, argument->visit(*this));
-		arguments.push_back(lak::move(obj));
+		task next = tasks.back();
+		tasks.pop_back();
+		if (const evaluate *e = next.template get<evaluate>(); e)
+			RES_TRY(e->expr->visit(*this));
+		else
+			RES_TRY(lak::visit(*this, next));
 	}
 
-	if (arguments.size() != callable.arity())
-		return error(expr.paren,
-		             lak::as_u8string("Expected " +
-		                              std::to_string(callable.arity()) +
-		                              " arguments but got " +
-		                              std::to_string(arguments.size()) + "."));
+	return lak::ok_t{};
+}
 
-	return callable(interpreter, lak::move(arguments));
+lox::object lox::evaluator::pop()
+{
+	lox::object result = lak::move(values.back());
+	values.pop_back();
+	return result;
 }
 
-lak::result<lox::object> lox::evaluator::operator()(const lox::expr::get &expr)
+lak::result<> lox::evaluator::evaluate_next(const lox::expr &expr)
 {
-	RES_TRY_ASSIGN(lox::object object =, expr.object->visit(*this));
+	if (expr.value.template get<lox::expr::variable>() ||
+	    expr.value.template get<lox::expr::literal>())
+		return expr.visit(*this);
 
-	if_ref (const lox::instance & instance, object.get_instance())
-		return instance.find(expr.name).or_else(
-		  [&](auto &&) -> lak::result<lox::object>
-		  {
-			  return error(expr.name,
-			               u8"Undefined property '" + expr.name.lexeme.to_string() +
-			                 u8"'.");
-		  });
-	else
-		return error(expr.name, u8"Only instances have properties.");
+	tasks.push_back(evaluate{&expr});
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::enter(lox::activation &&activation)
+{
+	if (activation.body.empty())
+	{
+		values.push_back(activation.result ? lak::move(*activation.result)
+		                                   : lox::object{});
+		return lak::ok_t{};
+	}
+
+	frames.push_back(frame{
+	  .environment = std::exchange(environment, activation.environment),
+	  .result      = lak::move(activation.result),
+	  .scopes      = scopes.size(),
+	});
+	tasks.push_back(leave_call{});
+
+	sequence body{
+	  .next = activation.body.data(),
+	  .end  = activation.body.data() + activation.body.size(),
+	};
+	return (*this)(body);
 }
 
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::grouping &expr)
+void lox::evaluator::unwind()
 {
-	return expr.expression->visit(*this);
+	while (!tasks.back().template get<leave_call>()) tasks.pop_back();
+	while (scopes.size() > frames.back().scopes) leave_scope();
 }
 
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::literal &expr)
+void lox::evaluator::leave_scope()
 {
-	return lak::ok_t{expr.value};
+	lox::environment::recycle(
+	  std::exchange(environment, lak::move(scopes.back())));
+	scopes.pop_back();
 }
 
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::logical &expr)
+void lox::evaluator::leave_frame()
 {
-	RES_TRY_ASSIGN(lox::object left =, expr.left->visit(*this));
+	frame &f = frames.back();
+	lox::environment::recycle(
+	  std::exchange(environment, lak::move(f.environment)));
+	if (f.result) values.back() = lak::move(*f.result);
+	frames.pop_back();
+}
 
-	if (expr.op.type == lox::token_type::OR)
-	{
-		if (left.is_truthy()) return lak::ok_t{lak::move(left)};
-	}
-	else
+lak::result<lox::environment_ptr> lox::evaluator::capture(
+  const lox::stmt::function &func)
+{
+	lak::span<const lox::capture> captures = interpreter.find_captures(func);
+	if (captures.empty()) return lak::ok_t{lox::environment_ptr{}};
+
+	lox::environment_ptr closure = lox::environment::make();
+	for (const lox::capture &captured : captures)
 	{
-		if (!left.is_truthy()) return lak::ok_t{lak::move(left)};
+		if (!closure->capture(captured.name, *environment, captured.distance))
+			return error(func.name,
+			             u8"Undefined local variable '"_str +
+			               captured.name.to_string() + u8"'.");
 	}
+	return lak::move_ok(closure);
+}
 
-	return expr.right->visit(*this);
+/* --- expressions --- */
+
+lak::result<> lox::evaluator::operator()(const lox::expr::assign &expr)
+{
+	tasks.push_back(resume<lox::expr::assign>{&expr});
+	return evaluate_next(*expr.value);
 }
 
-lak::result<lox::object> lox::evaluator::operator()(const lox::expr::set &expr)
+lak::result<> lox::evaluator::operator()(const lox::expr::binary &expr)
 {
-	RES_TRY_ASSIGN(lox::object object =, expr.object->visit(*this));
+	tasks.push_back(resume<lox::expr::binary>{&expr});
+	tasks.push_back(evaluate{&*expr.right});
+	return evaluate_next(*expr.left);
+}
 
-	lox::instance *maybe_instance = object.get_instance();
-	if (!maybe_instance)
-		return error(expr.name, u8"Only instances have fields.");
+lak::result<> lox::evaluator::operator()(const lox::expr::call &expr)
+{
+	tasks.push_back(call_callee{.node = &expr, .tail = false});
+	return evaluate_next(*expr.callee);
+}
 
-	RES_TRY_ASSIGN(lox::object value =, expr.value->visit(*this));
+lak::result<> lox::evaluator::operator()(const lox::expr::get &expr)
+{
+	tasks.push_back(resume<lox::expr::get>{&expr});
+	return evaluate_next(*expr.object);
+}
 
-	const lox::object &result =
-	  maybe_instance->emplace(expr.name, lak::move(value));
+lak::result<> lox::evaluator::operator()(const lox::expr::grouping &expr)
+{
+	return evaluate_next(*expr.expression);
+}
 
-	return lak::ok_t{result};
+lak::result<> lox::evaluator::operator()(const lox::expr::literal &expr)
+{
+	values.push_back(expr.value);
+	return lak::ok_t{};
 }
 
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::super_keyword &expr)
+lak::result<> lox::evaluator::operator()(const lox::expr::logical &expr)
 {
-	auto invalid_super = [&](auto &&...) -> lak::result<lox::object>
+	tasks.push_back(resume<lox::expr::logical>{&expr});
+	return evaluate_next(*expr.left);
+}
+
+lak::result<> lox::evaluator::operator()(const lox::expr::set &expr)
+{
+	tasks.push_back(resume<lox::expr::set>{&expr});
+	return evaluate_next(*expr.object);
+}
+
+lak::result<> lox::evaluator::operator()(const lox::expr::super_keyword &expr)
+{
+	auto invalid_super = [&](auto &&...) -> lak::result<>
 	{ return error(expr.keyword, u8"Invalid 'super'."); };
 
 	RES_TRY_ASSIGN(size_t distance =,
@@ -278,67 +301,65 @@ lak::result<lox::object> lox::evaluator::operator()(
 
 	RES_TRY_ASSIGN(
 	  lox::callable method =,
-	  maybe_super->find_bound_method(expr.method.lexeme, *maybe_instance)
+	  maybe_super->find_bound_method(expr.method.lexeme(), *maybe_instance)
 	    .if_err(
 	      [&](auto &&)
 	      {
 		      error(expr.method,
-		            u8"Undefined property '" + expr.method.lexeme.to_string() +
+		            u8"Undefined property '" + expr.method.lexeme().to_string() +
 		              u8"'.");
 	      }));
 
-	return lak::ok_t<lox::object>{method};
+	values.push_back(lox::object{method});
+	return lak::ok_t{};
 }
 
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::this_keyword &expr)
+lak::result<> lox::evaluator::operator()(const lox::expr::this_keyword &expr)
 {
-	return find_variable(expr.keyword, expr);
+	RES_TRY_ASSIGN(lox::object value =, find_variable(expr.keyword, expr));
+	values.push_back(lak::move(value));
+	return lak::ok_t{};
 }
 
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::unary &expr)
+lak::result<> lox::evaluator::operator()(const lox::expr::unary &expr)
 {
-	RES_TRY_ASSIGN(lox::object right =, expr.right->visit(*this));
-
-	switch (expr.op.type)
-	{
-		using enum lox::token_type;
-
-		case BANG: return lak::ok_t<lox::object>{!right.is_truthy()};
-
-		case MINUS:
-		{
-			if_ref (const auto &num, right.get_number())
-				return lak::ok_t<lox::object>{-num};
-			else
-				return error(expr.op, u8"Operand must be a number.");
-		}
-
-		default: return lak::ok_t<lox::object>{};
-	}
+	tasks.push_back(resume<lox::expr::unary>{&expr});
+	return evaluate_next(*expr.right);
 }
 
-lak::result<lox::object> lox::evaluator::operator()(
-  const lox::expr::variable &expr)
+lak::result<> lox::evaluator::operator()(const lox::expr::variable &expr)
 {
-	return find_variable(expr.name, expr);
+	RES_TRY_ASSIGN(lox::object value =, find_variable(expr.name, expr));
+	values.push_back(lak::move(value));
+	return lak::ok_t{};
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::block &stmt)
+/* --- statements --- */
+
+lak::result<> lox::evaluator::operator()(const lox::stmt::block &stmt)
 {
-	return execute_block(lak::span(stmt.statements),
-	                     lox::environment::make(environment));
+	// blocks at the top level always get a scope, since that's what stops
+	// the expression statements in them from being echoed.
+	if (!interpreter.is_scopeless(stmt) || (scopes.empty() && frames.empty()))
+	{
+		scopes.push_back(
+		  std::exchange(environment, lox::environment::make(environment)));
+		tasks.push_back(leave_block{});
+	}
+	tasks.push_back(sequence{
+	  .next = stmt.statements.data(),
+	  .end  = stmt.statements.data() + stmt.statements.size(),
+	});
+	return lak::ok_t{};
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::type &stmt)
+lak::result<> lox::evaluator::operator()(const lox::stmt::type &stmt)
 {
 	const lox::type *superclass = nullptr;
 	if_ref (const auto &supervar, stmt.superclass)
 	{
-		RES_TRY_ASSIGN(lox::object super =, (*this)(supervar));
+		RES_TRY_ASSIGN(lox::object super =,
+		               find_variable(supervar.name, supervar));
 
 		const lox::type *maybe_type = super.get_type();
 		if (!maybe_type)
@@ -358,106 +379,348 @@ lak::result<lak::u8string> lox::evaluator::operator()(
 	lox::string_map<char8_t, lox::object> methods;
 	for (const lox::stmt::function_ptr &method : stmt.methods)
 	{
-		methods[method->name.lexeme] = lox::object{
-		  lox::callable(method, environment, method->name.lexeme == u8"init")};
+		const bool is_init = method->name.lexeme() == u8"init";
+		RES_TRY_ASSIGN(lox::environment_ptr closure =, capture(*method));
+		methods[method->name.lexeme()] =
+		  lox::object{lox::callable(method, closure, is_init)};
 	}
 
 	lox::type type =
-	  superclass ? lox::type(stmt.name.lexeme, lak::move(methods), *superclass)
-	             : lox::type(stmt.name.lexeme, lak::move(methods));
+	  superclass ? lox::type(stmt.name.lexeme(), lak::move(methods), *superclass)
+	             : lox::type(stmt.name.lexeme(), lak::move(methods));
 
 	if (superclass) environment = environment->enclosing;
 
 	environment->replace(stmt.name, lox::object{type});
 
-	return lak::ok_t<lak::u8string>{};
+	return lak::ok_t{};
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::expr &stmt)
+lak::result<> lox::evaluator::operator()(const lox::stmt::expr &stmt)
 {
-	return stmt.expression->visit(*this).map(
-	  [](const lox::object &obj) { return obj.to_string() + u8"\n"; });
+	tasks.push_back(resume<lox::stmt::expr>{&stmt});
+	return evaluate_next(*stmt.expression);
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::branch &stmt)
+lak::result<> lox::evaluator::operator()(const lox::stmt::branch &stmt)
 {
-	return stmt.condition->visit(*this).and_then(
-	  [&](const lox::object &condition) -> lak::result<lak::u8string>
-	  {
-		  if (condition.is_truthy())
-			  return stmt.then_branch->visit(*this);
-		  else if_ref (const auto &else_branch, stmt.else_branch)
-			  return else_branch->visit(*this);
-		  else
-			  return lak::ok_t<lak::u8string>{};
-	  });
+	tasks.push_back(resume<lox::stmt::branch>{&stmt});
+	return evaluate_next(*stmt.condition);
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::print &stmt)
+lak::result<> lox::evaluator::operator()(const lox::stmt::print &stmt)
 {
-	RES_TRY_ASSIGN(lox::object value =, stmt.expression->visit(*this));
-
-	using lak::operator<<;
-	std::cout << value.to_string() << "\n";
-
-	return lak::ok_t<lak::u8string>{};
+	tasks.push_back(resume<lox::stmt::print>{&stmt});
+	return evaluate_next(*stmt.expression);
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::var &stmt)
+lak::result<> lox::evaluator::operator()(const lox::stmt::var &stmt)
 {
 	if_ref (const auto &init, stmt.init)
-		return init->visit(*this).map(
-		  [&](lox::object &&value) -> lak::u8string
-		  {
-			  environment->emplace(stmt.name, lak::move(value));
-			  return {};
-		  });
+	{
+		tasks.push_back(resume<lox::stmt::var>{&stmt});
+		return evaluate_next(*init);
+	}
 
 	environment->emplace(stmt.name, lox::object{});
 
-	return lak::ok_t<lak::u8string>{};
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(const lox::stmt::loop &stmt)
+{
+	tasks.push_back(resume<lox::stmt::loop>{&stmt});
+	return evaluate_next(*stmt.condition);
+}
+
+lak::result<> lox::evaluator::operator()(const lox::stmt::function_ptr &stmt)
+{
+	// declared before its closure is made, so that it can capture itself.
+	environment->emplace(stmt->name, lox::object{});
+	RES_TRY_ASSIGN(lox::environment_ptr closure =, capture(*stmt));
+	environment->replace(stmt->name,
+	                     lox::object{lox::callable(stmt, closure, false)});
+	return lak::ok_t{};
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::loop &stmt)
+lak::result<> lox::evaluator::operator()(const lox::stmt::ret &stmt)
 {
-	RES_TRY_ASSIGN(lox::object condition =, stmt.condition->visit(*this));
+	tasks.push_back(resume<lox::stmt::ret>{&stmt});
+
+	if_ref (const auto &value, stmt.value)
+	{
+		// a tail call replaces the frame of the function that's returning, so
+		// the depth of tail recursion isn't limited.
+		if_ref (const lox::expr::call &call,
+		        value->value.template get<lox::expr::call>())
+		{
+			if (interpreter.is_tail_call(call))
+			{
+				tasks.back() = call_callee{.node = &call, .tail = true};
+				return evaluate_next(*call.callee);
+			}
+		}
+		return evaluate_next(*value);
+	}
+	else
+		values.push_back(lox::object{});
 
-	lak::u8string result;
+	return lak::ok_t{};
+}
 
-	while (condition.is_truthy())
+/* --- continuations --- */
+
+lak::result<> lox::evaluator::operator()(evaluate &task)
+{
+	return task.expr->visit(*this);
+}
+
+lak::result<> lox::evaluator::operator()(sequence &task)
+{
+	const lox::stmt &stmt = **task.next;
+	if (++task.next != task.end) tasks.push_back(task);
+	return stmt.visit(*this);
+}
+
+lak::result<> lox::evaluator::operator()(leave_block &)
+{
+	leave_scope();
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(leave_call &)
+{
+	// the body finished without returning
+	values.push_back(lox::object{});
+	leave_frame();
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::expr::assign> &task)
+{
+	const lox::expr::assign &expr = *task.node;
+	const lox::object &value      = values.back();
+
+	return interpreter.find(expr).visit(lak::overloaded{
+	  [&](size_t distance) -> lak::result<>
+	  {
+		  if (environment->replace(expr.name, value, distance))
+			  return lak::ok_t{};
+		  return error(expr.name,
+		               u8"Undefined local variable '"_str +
+		                 expr.name.lexeme().to_string() + u8"'.");
+	  },
+	  [&](lak::monostate) -> lak::result<>
+	  {
+		  if (interpreter.global_environment->replace(expr.name, value))
+			  return lak::ok_t{};
+		  return error(expr.name,
+		               u8"Undefined global variable '"_str +
+		                 expr.name.lexeme().to_string() + u8"'.");
+	  },
+	});
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::expr::binary> &task)
+{
+	const lox::object right = pop();
+	RES_TRY_ASSIGN(values.back() =,
+	               binary_operation(*this, *task.node, values.back(), right));
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(call_callee &task)
+{
+	if (!values.back().get_callable())
+		return error(task.node->paren, u8"Can only call functions and classes.");
+
+	tasks.push_back(call_arguments{.node = task.node, .tail = task.tail});
+
+	const std::vector<lox::expr_ptr> &arguments = task.node->arguments;
+	if (arguments.empty()) return lak::ok_t{};
+	for (size_t i = arguments.size() - 1U; i > 0U; --i)
+		tasks.push_back(evaluate{&*arguments[i]});
+	return evaluate_next(*arguments.front());
+}
+
+lak::result<> lox::evaluator::operator()(call_arguments &task)
+{
+	const lox::expr::call &expr = *task.node;
+
+	const auto first = values.end() - ptrdiff_t(expr.arguments.size());
+	std::vector<lox::object> arguments(std::make_move_iterator(first),
+	                                   std::make_move_iterator(values.end()));
+	values.erase(first, values.end());
+	const lox::object callee      = pop();
+	const lox::callable &callable = *callee.get_callable();
+
+	if (arguments.size() != callable.arity())
+		return error(expr.paren,
+		             lak::as_u8string("Expected " +
+		                              std::to_string(callable.arity()) +
+		                              " arguments but got " +
+		                              std::to_string(arguments.size()) + "."));
+
+	RES_TRY_ASSIGN(lox::activation activation =,
+	               callable.activate(interpreter, lak::move(arguments)));
+
+	if (!task.tail)
+	{
+		if (!activation.body.empty() && frames.size() == interpreter.max_depth)
+			return error(expr.paren, u8"Stack overflow.");
+		return enter(lak::move(activation));
+	}
+
+	// the callee takes over the frame of the function that's returning
+	unwind();
+	if (activation.body.empty())
 	{
-		RES_TRY_ASSIGN(result +=, stmt.body->visit(*this));
+		RES_TRY(enter(lak::move(activation)));
+		tasks.pop_back();
+		leave_frame();
+		return lak::ok_t{};
+	}
 
-		if (block_ret_value) return lak::ok_t{result};
+	frame &f = frames.back();
+	lox::environment::recycle(
+	  std::exchange(environment, lak::move(activation.environment)));
+	if (!f.result) f.result = lak::move(activation.result);
 
-		RES_TRY_ASSIGN(condition =, stmt.condition->visit(*this));
+	sequence body{
+	  .next = activation.body.data(),
+	  .end  = activation.body.data() + activation.body.size(),
+	};
+	return (*this)(body);
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::expr::get> &task)
+{
+	const lox::expr::get &expr = *task.node;
+	lox::object &object        = values.back();
+
+	if_ref (const lox::instance & instance, object.get_instance())
+	{
+		RES_TRY_ASSIGN(
+		  object =,
+		  instance.find(expr.name).or_else(
+		    [&](auto &&) -> lak::result<lox::object>
+		    {
+			    return error(expr.name,
+			                 u8"Undefined property '" +
+			                   expr.name.lexeme().to_string() + u8"'.");
+		    }));
+		return lak::ok_t{};
 	}
+	else
+		return error(expr.name, u8"Only instances have properties.");
+}
 
-	return lak::ok_t{result};
+lak::result<> lox::evaluator::operator()(resume<lox::expr::logical> &task)
+{
+	const lox::expr::logical &expr = *task.node;
+	const bool truthy              = values.back().is_truthy();
+
+	// the left operand is the result if it short circuits
+	if (expr.op.type == lox::token_type::OR ? truthy : !truthy)
+		return lak::ok_t{};
+
+	values.pop_back();
+	return evaluate_next(*expr.right);
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::function_ptr &stmt)
+lak::result<> lox::evaluator::operator()(resume<lox::expr::set> &task)
 {
-	environment->emplace(stmt->name.lexeme,
-	                     lox::object{lox::callable(stmt, environment, false)});
-	return lak::ok_t<lak::u8string>{};
+	if (!values.back().get_instance())
+		return error(task.node->name, u8"Only instances have fields.");
+
+	tasks.push_back(set_field{task.node});
+	return evaluate_next(*task.node->value);
 }
 
-lak::result<lak::u8string> lox::evaluator::operator()(
-  const lox::stmt::ret &stmt)
+lak::result<> lox::evaluator::operator()(set_field &task)
 {
-	if_ref (const auto &value, stmt.value)
+	lox::object value   = pop();
+	lox::object &object = values.back();
+
+	object = object.get_instance()->emplace(task.node->name, lak::move(value));
+
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::expr::unary> &task)
+{
+	const lox::expr::unary &expr = *task.node;
+	lox::object &right           = values.back();
+
+	switch (expr.op.type)
 	{
-		RES_TRY_ASSIGN(block_ret_value =, value->visit(*this));
+		using enum lox::token_type;
+
+		case BANG: right = lox::object{!right.is_truthy()}; break;
+
+		case MINUS:
+		{
+			if_ref (const auto &num, right.get_number())
+				right = lox::object{-num};
+			else
+				return error(expr.op, u8"Operand must be a number.");
+		}
+		break;
+
+		default: right = lox::object{}; break;
 	}
+
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::stmt::expr> &)
+{
+	const lox::object value = pop();
+	if (scopes.empty() && frames.empty())
+		output += value.to_string() + u8"\n";
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::stmt::branch> &task)
+{
+	const lox::stmt::branch &stmt = *task.node;
+
+	if (pop().is_truthy())
+		return stmt.then_branch->visit(*this);
+	else if_ref (const auto &else_branch, stmt.else_branch)
+		return else_branch->visit(*this);
 	else
-		block_ret_value = lox::object{};
+		return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::stmt::print> &)
+{
+	pop().write(*interpreter.out);
+	interpreter.out->write('\n');
 
-	return lak::ok_t<lak::u8string>{};
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::stmt::var> &task)
+{
+	environment->emplace(task.node->name, pop());
+	return lak::ok_t{};
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::stmt::loop> &task)
+{
+	if (!pop().is_truthy()) return lak::ok_t{};
+
+	tasks.push_back(task);
+	tasks.push_back(evaluate{&*task.node->condition});
+	return task.node->body->visit(*this);
+}
+
+lak::result<> lox::evaluator::operator()(resume<lox::stmt::ret> &)
+{
+	// skip the rest of the function's body, its return value is on values
+	unwind();
+	tasks.pop_back();
+	leave_frame();
+	return lak::ok_t{};
 }
@@ -1,6 +1,7 @@
 #ifndef LOX_EVALUATOR_HPP
 #define LOX_EVALUATOR_HPP
 
+#include "callable.hpp"
 #include "environment.hpp"
 #include "expr.hpp"
 #include "interpreter.hpp"
@@ -10,21 +11,119 @@
 #include <lak/optional.hpp>
 #include <lak/span.hpp>
 #include <lak/string.hpp>
+#include <lak/variant.hpp>
 
 #include <source_location>
+#include <vector>
 
 namespace lox
 {
+	// Walks the AST without recursing on the native stack. Visiting a node
+	// only pushes the work it needs doing onto tasks: its operands to be
+	// evaluated, followed by a continuation that picks them up from values
+	// once they're done. Calls to interpreted functions push a frame rather
+	// than running their body in a nested evaluator, so the depth of the
+	// script's recursion is bounded by interpreter.max_depth rather than by
+	// the size of the native stack.
 	struct evaluator
 	{
+		// evaluate expr, leaving its value on values.
+		struct evaluate
+		{
+			const lox::expr *expr;
+		};
+
+		// the statements of a block or function body that are yet to run.
+		struct sequence
+		{
+			const lox::stmt_ptr *next;
+			const lox::stmt_ptr *end;
+		};
+
+		// the end of a block, restores the environment from scopes.
+		struct leave_block
+		{
+		};
+
+		// the end of a call to an interpreted function, returns to the caller
+		// in frames. a return statement unwinds tasks to here.
+		struct leave_call
+		{
+		};
+
+		// what a call to an interpreted function returns to.
+		struct frame
+		{
+			lox::environment_ptr environment;
+			// returned in place of the function's return value.
+			lak::optional<lox::object> result;
+			// how many of scopes belong to the caller.
+			size_t scopes;
+		};
+
+		// continues with node once the operands it pushed are on values.
+		template<typename T>
+		struct resume
+		{
+			const T *node;
+		};
+
+		// the callee of node is on values, its arguments are next. a tail
+		// call reuses the frame of the function it returns from.
+		struct call_callee
+		{
+			const lox::expr::call *node;
+			bool tail;
+		};
+
+		// the callee and arguments of node are on values.
+		struct call_arguments
+		{
+			const lox::expr::call *node;
+			bool tail;
+		};
+
+		// the instance and value of node are on values.
+		struct set_field
+		{
+			const lox::expr::set *node;
+		};
+
+		using task = lak::variant<evaluate,
+		                          sequence,
+		                          leave_block,
+		                          leave_call,
+		                          resume<lox::expr::assign>,
+		                          resume<lox::expr::binary>,
+		                          call_callee,
+		                          call_arguments,
+		                          resume<lox::expr::get>,
+		                          resume<lox::expr::logical>,
+		                          resume<lox::expr::set>,
+		                          set_field,
+		                          resume<lox::expr::unary>,
+		                          resume<lox::stmt::expr>,
+		                          resume<lox::stmt::branch>,
+		                          resume<lox::stmt::print>,
+		                          resume<lox::stmt::var>,
+		                          resume<lox::stmt::loop>,
+		                          resume<lox::stmt::ret>>;
+
 		lox::interpreter &interpreter;
 		lox::environment_ptr environment;
-		lak::optional<lox::object> block_ret_value;
+
+		std::vector<task> tasks;
+		std::vector<lox::object> values;
+		// the environments that enclosing blocks will restore.
+		std::vector<lox::environment_ptr> scopes;
+		// the calls to interpreted functions that are in progress.
+		std::vector<frame> frames;
+
+		// what expression statements at the top level evaluated to.
+		lak::u8string output;
 
 		inline evaluator(lox::interpreter &i)
-		: interpreter(i),
-		  environment(i.global_environment),
-		  block_ret_value(lak::nullopt)
+		: interpreter(i), environment(i.global_environment)
 		{
 		}
 
@@ -33,36 +132,86 @@ namespace lox
 		  lak::u8string_view message,
 		  const std::source_location srcloc = std::source_location::current());
 
-		lak::result<lak::u8string> execute_block(
-		  lak::span<const lox::stmt_ptr> statements,
-		  const lox::environment_ptr &env);
+		lak::result<lox::object> run(const lox::expr &expr);
+
+		// returns what an expression statement at the top level would echo.
+		lak::result<lak::u8string> run(const lox::stmt &stmt);
+
+		lak::result<lox::object> run(lox::activation &&activation);
+
+		// runs tasks until there are none left.
+		lak::result<> run();
+
+		lox::object pop();
+
+		// evaluates expr before anything already on tasks. variables and
+		// literals are evaluated right away, since doing so doesn't recurse.
+		lak::result<> evaluate_next(const lox::expr &expr);
+
+		// the closure of a function declared in environment, which holds just
+		// the variables it captures.
+		lak::result<lox::environment_ptr> capture(
+		  const lox::stmt::function &func);
+
+		// pushes a frame for activation and starts running its body.
+		lak::result<> enter(lox::activation &&activation);
+
+		// unwinds tasks to the current call's leave_call, leaving the blocks
+		// it's in.
+		void unwind();
+
+		// leaves the innermost block, restoring the environment from scopes.
+		void leave_scope();
+
+		// returns from the current call, with its return value on values.
+		void leave_frame();
 
 		template<typename T>
 		lak::result<lox::object> find_variable(const lox::token &name,
 		                                       const T &expr);
 
-		lak::result<lox::object> operator()(const lox::expr::assign &expr);
-		lak::result<lox::object> operator()(const lox::expr::binary &expr);
-		lak::result<lox::object> operator()(const lox::expr::call &expr);
-		lak::result<lox::object> operator()(const lox::expr::get &expr);
-		lak::result<lox::object> operator()(const lox::expr::grouping &expr);
-		lak::result<lox::object> operator()(const lox::expr::literal &expr);
-		lak::result<lox::object> operator()(const lox::expr::logical &expr);
-		lak::result<lox::object> operator()(const lox::expr::set &expr);
-		lak::result<lox::object> operator()(const lox::expr::super_keyword &expr);
-		lak::result<lox::object> operator()(const lox::expr::this_keyword &expr);
-		lak::result<lox::object> operator()(const lox::expr::unary &expr);
-		lak::result<lox::object> operator()(const lox::expr::variable &expr);
-
-		lak::result<lak::u8string> operator()(const lox::stmt::block &stmt);
-		lak::result<lak::u8string> operator()(const lox::stmt::type &stmt);
-		lak::result<lak::u8string> operator()(const lox::stmt::expr &stmt);
-		lak::result<lak::u8string> operator()(const lox::stmt::branch &stmt);
-		lak::result<lak::u8string> operator()(const lox::stmt::print &stmt);
-		lak::result<lak::u8string> operator()(const lox::stmt::var &stmt);
-		lak::result<lak::u8string> operator()(const lox::stmt::loop &stmt);
-		lak::result<lak::u8string> operator()(const lox::stmt::function_ptr &stmt);
-		lak::result<lak::u8string> operator()(const lox::stmt::ret &stmt);
+		lak::result<> operator()(const lox::expr::assign &expr);
+		lak::result<> operator()(const lox::expr::binary &expr);
+		lak::result<> operator()(const lox::expr::call &expr);
+		lak::result<> operator()(const lox::expr::get &expr);
+		lak::result<> operator()(const lox::expr::grouping &expr);
+		lak::result<> operator()(const lox::expr::literal &expr);
+		lak::result<> operator()(const lox::expr::logical &expr);
+		lak::result<> operator()(const lox::expr::set &expr);
+		lak::result<> operator()(const lox::expr::super_keyword &expr);
+		lak::result<> operator()(const lox::expr::this_keyword &expr);
+		lak::result<> operator()(const lox::expr::unary &expr);
+		lak::result<> operator()(const lox::expr::variable &expr);
+
+		lak::result<> operator()(const lox::stmt::block &stmt);
+		lak::result<> operator()(const lox::stmt::type &stmt);
+		lak::result<> operator()(const lox::stmt::expr &stmt);
+		lak::result<> operator()(const lox::stmt::branch &stmt);
+		lak::result<> operator()(const lox::stmt::print &stmt);
+		lak::result<> operator()(const lox::stmt::var &stmt);
+		lak::result<> operator()(const lox::stmt::loop &stmt);
+		lak::result<> operator()(const lox::stmt::function_ptr &stmt);
+		lak::result<> operator()(const lox::stmt::ret &stmt);
+
+		lak::result<> operator()(evaluate &task);
+		lak::result<> operator()(sequence &task);
+		lak::result<> operator()(leave_block &task);
+		lak::result<> operator()(leave_call &task);
+		lak::result<> operator()(resume<lox::expr::assign> &task);
+		lak::result<> operator()(resume<lox::expr::binary> &task);
+		lak::result<> operator()(call_callee &task);
+		lak::result<> operator()(call_arguments &task);
+		lak::result<> operator()(resume<lox::expr::get> &task);
+		lak::result<> operator()(resume<lox::expr::logical> &task);
+		lak::result<> operator()(resume<lox::expr::set> &task);
+		lak::result<> operator()(set_field &task);
+		lak::result<> operator()(resume<lox::expr::unary> &task);
+		lak::result<> operator()(resume<lox::stmt::expr> &task);
+		lak::result<> operator()(resume<lox::stmt::branch> &task);
+		lak::result<> operator()(resume<lox::stmt::print> &task);
+		lak::result<> operator()(resume<lox::stmt::var> &task);
+		lak::result<> operator()(resume<lox::stmt::loop> &task);
+		lak::result<> operator()(resume<lox::stmt::ret> &task);
 	};
 }
 
@@ -79,7 +228,7 @@ lak::result<lox::object> lox::evaluator::find_variable(const lox::token &name,
 		      {
 			      return error(name,
 			                   u8"Undefined local variable '"_str +
-			                     name.lexeme.to_string() + u8"'.");
+			                     name.lexeme().to_string() + u8"'.");
 		      });
 	  },
 	  [&](lak::monostate) -> lak::result<lox::object>
@@ -91,7 +240,7 @@ lak::result<lox::object> lox::evaluator::find_variable(const lox::token &name,
 		      {
 			      return error(name,
 			                   u8"Undefined global variable '"_str +
-			                     name.lexeme.to_string() + u8"'.");
+			                     name.lexeme().to_string() + u8"'.");
 		      });
 	  },
 	});
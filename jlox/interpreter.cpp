@@ -3,8 +3,10 @@
 #include "callable.hpp"
 #include "evaluator.hpp"
 #include "lox.hpp"
+#include "parallel.hpp"
 #include "parser.hpp"
 #include "printer.hpp"
+#include "program.hpp"
 #include "resolver.hpp"
 #include "scanner.hpp"
 
@@ -12,23 +14,29 @@
 #include <lak/file.hpp>
 #include <lak/string_ostream.hpp>
 
+#include <cerrno>
 #include <chrono>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 
 void lox::interpreter::report(size_t line,
                               lak::u8string_view where,
                               lak::u8string_view message,
                               const std::source_location srcloc)
 {
+	// keep what the script printed ahead of the error
+	out->flush();
+
 #ifndef NDEBUG
-	std::cerr << srcloc.file_name() << ":" << srcloc.line() << ":"
-	          << srcloc.column() << ": ";
+	*diagnostics << srcloc.file_name() << ":" << srcloc.line() << ":"
+	             << srcloc.column() << ": ";
 #else
 	(void)srcloc;
 #endif
 	using lak::operator<<;
-	std::cerr << "[line " << line << "] Error" << where << ": " << message
-	          << "\n";
+	*diagnostics << "[line " << line << "] Error" << where << ": " << message
+	             << "\n";
 	had_error = true;
 }
 
@@ -40,7 +48,7 @@ void lox::interpreter::error(const lox::token &token,
 		report(token.line, u8" at end", message, srcloc);
 	else
 		report(token.line,
-		       u8" at '" + token.lexeme.to_string() + u8"'",
+		       u8" at '" + token.lexeme().to_string() + u8"'",
 		       message,
 		       srcloc);
 }
@@ -54,24 +62,21 @@ void lox::interpreter::error(size_t line,
 
 lak::result<lox::object> lox::interpreter::evaluate(const lox::expr &expr)
 {
-	return expr.visit(lox::evaluator(*this));
+	return lox::evaluator(*this).run(expr);
 }
 
 lak::result<lak::monostate> lox::interpreter::execute(const lox::stmt &stmt)
 {
-	return stmt.visit(lox::evaluator(*this))
-	  .map([](auto &&) -> lak::monostate { return {}; });
+	return lox::evaluator(*this).run(stmt).map(
+	  [](auto &&) -> lak::monostate { return {}; });
 }
 
-lak::result<lox::object> lox::interpreter::execute_block(
-  lak::span<const lox::stmt_ptr> stmts, const lox::environment_ptr &env)
+lak::result<lox::object> lox::interpreter::call(
+  const lox::callable &callee, std::vector<lox::object> &&arguments)
 {
-	lox::evaluator eval{*this};
-	return eval.execute_block(stmts, env)
-	  .map(
-	    [&](auto &&) -> lox::object {
-		    return eval.block_ret_value ? *eval.block_ret_value : lox::object{};
-	    });
+	RES_TRY_ASSIGN(lox::activation activation =,
+	               callee.activate(*this, lak::move(arguments)));
+	return lox::evaluator(*this).run(lak::move(activation));
 }
 
 void lox::interpreter::resolve(const lox::expr::variable &expr,
@@ -97,6 +102,22 @@ void lox::interpreter::resolve(const lox::expr::this_keyword &expr,
 	local_this[&expr] = distance;
 }
 
+void lox::interpreter::resolve_tail_call(const lox::expr::call &expr)
+{
+	tail_calls.insert(&expr);
+}
+
+void lox::interpreter::resolve_capture(const lox::stmt::function &func,
+                                       lox::capture capture)
+{
+	captures[&func].push_back(capture);
+}
+
+void lox::interpreter::resolve_scopeless(const lox::stmt::block &stmt)
+{
+	scopeless_blocks.insert(&stmt);
+}
+
 lak::result<size_t> lox::interpreter::find(const lox::expr::variable &expr)
 {
 	auto distance = local_declares.find(&expr);
@@ -134,16 +155,32 @@ lak::result<size_t> lox::interpreter::find(const lox::expr::this_keyword &expr)
 		return lak::err_t{};
 }
 
+bool lox::interpreter::is_tail_call(const lox::expr::call &expr) const
+{
+	return tail_calls.contains(&expr);
+}
+
+lak::span<const lox::capture> lox::interpreter::find_captures(
+  const lox::stmt::function &func) const
+{
+	auto found = captures.find(&func);
+	if (found != captures.end())
+		return lak::span<const lox::capture>(found->second);
+	else
+		return {};
+}
+
+bool lox::interpreter::is_scopeless(const lox::stmt::block &stmt) const
+{
+	return scopeless_blocks.contains(&stmt);
+}
+
 lak::result<std::vector<lox::stmt_ptr>> lox::interpreter::parse(
-  lak::u8string_view file)
+  lox::scanner &scanner)
 {
 	ASSERT(global_environment);
 
-	lox::scanner scanner{*this, file};
-	auto tokens{scanner.scan_tokens()};
-	if (had_error) return lak::err_t{};
-
-	lox::parser parser{*this, lak::move(tokens)};
+	lox::parser parser{*this, scanner};
 	RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =, parser.parse());
 	if (had_error) return lak::err_t{};
 
@@ -155,22 +192,64 @@ lak::result<std::vector<lox::stmt_ptr>> lox::interpreter::parse_file(
 {
 	ASSERT(global_environment);
 
-	return lak::read_file(file_path)
-	  .map_err(
-	    [&](const lak::errno_error &err) -> lak::monostate
-	    {
-		    std::cerr << "Failed to read file '" << file_path << "': " << err
-		              << "\n";
-		    return {};
-	    })
-	  .and_then(
-	    [&](const lak::array<byte_t> &arr)
-	      -> lak::result<std::vector<lox::stmt_ptr>>
-	    {
-		    auto span{lak::span<const char8_t>(lak::span(arr))};
-		    sources.push_back(std::vector<char8_t>(span.begin(), span.end()));
-		    return parse(lak::u8string_view(sources.back()));
-	    });
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file)
+	{
+		*diagnostics << "Failed to read file '" << file_path
+		             << "': " << lak::errno_error{errno} << "\n";
+		return lak::err_t{};
+	}
+
+	lox::scanner scanner{*this, file};
+	return parse(scanner);
+}
+
+lak::result<std::vector<lox::stmt_ptr>> lox::interpreter::parse_bundle(
+  lak::span<const std::filesystem::path> files, size_t thread_count)
+{
+	struct unit
+	{
+		lox::interpreter parser;
+		std::stringstream diagnostics;
+		std::vector<lox::stmt_ptr> stmts;
+	};
+
+	std::vector<unit> units(files.size());
+
+	auto parse = [&](size_t i)
+	{
+		unit &u              = units[i];
+		u.parser.diagnostics = &u.diagnostics;
+		if_let_ok (std::vector<lox::stmt_ptr> & stmts,
+		           u.parser.init_globals().parse_file(files[i]))
+			u.stmts = lak::move(stmts);
+		else
+			u.parser.had_error = true;
+	};
+	lox::parallel_for(files.size(), thread_count, parse);
+
+	std::vector<lox::stmt_ptr> result;
+	for (size_t i = 0U; i < units.size(); ++i)
+	{
+		unit &u = units[i];
+
+		for (std::string line; std::getline(u.diagnostics, line);)
+			*diagnostics << files[i].string() << ": " << line << "\n";
+
+		// the statements' tokens point into the unit's lexemes
+		lexemes.adopt(lak::move(u.parser.lexemes));
+
+		if (u.parser.had_error)
+			had_error = true;
+		else
+			result.insert(result.end(),
+			              std::make_move_iterator(u.stmts.begin()),
+			              std::make_move_iterator(u.stmts.end()));
+	}
+
+	if (had_error) return lak::err_t{};
+
+	return lak::move_ok(result);
 }
 
 lak::u8string lox::interpreter::interpret(const lox::expr &expr)
@@ -181,7 +260,7 @@ lak::u8string lox::interpreter::interpret(const lox::expr &expr)
 
 lak::result<lak::u8string> lox::interpreter::interpret(const lox::stmt &stmt)
 {
-	return stmt.visit(lox::evaluator(*this));
+	return lox::evaluator(*this).run(stmt);
 }
 
 lak::result<lak::u8string> lox::interpreter::interpret(
@@ -233,51 +312,105 @@ lox::interpreter &lox::interpreter::init_globals()
 	return *this;
 }
 
+lak::result<std::vector<lox::stmt_ptr>> lox::interpreter::load(
+  lox::scanner &scanner)
+{
+	RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =, parse(scanner));
+
+	lox::resolver resolver{*this};
+	RES_TRY(resolver.resolve(stmts));
+	if (had_error) return lak::err_t{};
+
+	return lak::move_ok(stmts);
+}
+
 lak::result<> lox::interpreter::run(lak::u8string_view file,
                                     lak::u8string *out_str)
 {
 	ASSERT(global_environment);
 
 	lox::scanner scanner{*this, file};
-	auto tokens{scanner.scan_tokens()};
-	if (had_error) return lak::err_t{};
+	RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =, load(scanner));
 
-	lox::parser parser{*this, lak::move(tokens)};
-	RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =, parser.parse());
+	RES_TRY_ASSIGN(lak::u8string result =, interpret(stmts));
 	if (had_error) return lak::err_t{};
 
+	if (out_str) *out_str += result;
+
+	return lak::ok_t{};
+}
+
+lak::result<> lox::interpreter::run_file(
+  const std::filesystem::path &file_path)
+{
+	ASSERT(global_environment);
+
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file)
+	{
+		*diagnostics << "Failed to read file '" << file_path
+		             << "': " << lak::errno_error{errno} << "\n";
+		return lak::err_t{};
+	}
+
+	auto execute = [&](lak::span<const lox::stmt_ptr> stmts) -> lak::result<>
+	{
+		RES_TRY(interpret(stmts));
+		if (had_error) return lak::err_t{};
+		return lak::ok_t{};
+	};
+
+	if (!cache)
+	{
+		lox::scanner scanner{*this, file};
+		RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =, load(scanner));
+		return execute(stmts);
+	}
+
+	const uint64_t key = lox::ast_cache::key(file);
+
+	if_let_ok (std::vector<lox::stmt_ptr> & stmts, cache->load(*this, key))
+		return execute(stmts);
+
+	// scan the file again from the start
+	file.clear();
+	file.seekg(0);
+	lox::scanner scanner{*this, file};
+	RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =, load(scanner));
+	cache->store(*this, key, stmts);
+	return execute(stmts);
+}
+
+lak::result<> lox::interpreter::run_bundle(
+  lak::span<const std::filesystem::path> files, size_t thread_count)
+{
+	ASSERT(global_environment);
+
+	RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =,
+	               parse_bundle(files, thread_count));
+
 	lox::resolver resolver{*this};
 	RES_TRY(resolver.resolve(stmts));
 	if (had_error) return lak::err_t{};
 
-	RES_TRY_ASSIGN(lak::u8string result =, interpret(stmts));
+	RES_TRY(interpret(stmts));
 	if (had_error) return lak::err_t{};
 
-	if (out_str) *out_str += result;
-
 	return lak::ok_t{};
 }
 
-lak::result<> lox::interpreter::run_file(
-  const std::filesystem::path &file_path)
+lak::result<> lox::interpreter::run_program(const lox::program &program)
 {
 	ASSERT(global_environment);
 
-	return lak::read_file(file_path)
-	  .map_err(
-	    [&](const lak::errno_error &err) -> lak::monostate
-	    {
-		    std::cerr << "Failed to read file '" << file_path << "': " << err
-		              << "\n";
-		    return {};
-	    })
-	  .and_then(
-	    [&](const lak::array<byte_t> &arr) -> lak::result<>
-	    {
-		    auto span{lak::span<const char8_t>(lak::span(arr))};
-		    sources.push_back(std::vector<char8_t>(span.begin(), span.end()));
-		    return run(lak::u8string_view(sources.back()));
-	    });
+	RES_TRY_ASSIGN(
+	  std::vector<lox::stmt_ptr> stmts =,
+	  lox::deserialise_ast(*this, lak::span<const byte_t>(program.image)));
+
+	RES_TRY(interpret(stmts));
+	if (had_error) return lak::err_t{};
+
+	return lak::ok_t{};
 }
 
 lak::result<> lox::interpreter::run_prompt()
@@ -288,6 +421,7 @@ lak::result<> lox::interpreter::run_prompt()
 	{
 		using lak::operator<<;
 
+		this->out->flush();
 		std::cout << "> ";
 
 		lak::astring string;
@@ -300,6 +434,7 @@ lak::result<> lox::interpreter::run_prompt()
 		lak::u8string out;
 		run(lak::as_u8string(string), &out).discard();
 
+		this->out->flush();
 		std::cout << out;
 
 		had_error = false;
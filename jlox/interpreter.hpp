@@ -1,30 +1,72 @@
 #ifndef LOX_INTERPRETER_HPP
 #define LOX_INTERPRETER_HPP
 
+#include "ast_cache.hpp"
 #include "environment.hpp"
 #include "expr.hpp"
+#include "lexeme_table.hpp"
+#include "output.hpp"
 #include "stmt.hpp"
 #include "token.hpp"
 
 #include <lak/result.hpp>
 
 #include <filesystem>
+#include <iostream>
 #include <source_location>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace lox
 {
+	struct callable;
+	struct program;
+	struct scanner;
+
+	// a variable that a function's closure shares with the scope that the
+	// function is declared in.
+	struct capture
+	{
+		lak::u8string_view name;
+		// from the environment the function is declared in.
+		size_t distance;
+	};
+
 	struct interpreter
 	{
 		bool had_error = false;
 
+		// where report() writes errors.
+		std::ostream *diagnostics = &std::cerr;
+
+		// where print statements write.
+		lox::output *out = &lox::standard_output();
+
 		lox::environment_ptr global_environment;
 		std::unordered_map<const lox::expr::variable *, size_t> local_declares;
 		std::unordered_map<const lox::expr::assign *, size_t> local_assigns;
 		std::unordered_map<const lox::expr::super_keyword *, size_t> local_super;
 		std::unordered_map<const lox::expr::this_keyword *, size_t> local_this;
-
-		std::vector<std::vector<char8_t>> sources;
+		// calls that are the value of a return statement.
+		std::unordered_set<const lox::expr::call *> tail_calls;
+		// the variables each function captures. a function that isn't here
+		// doesn't capture anything.
+		std::unordered_map<const lox::stmt::function *, std::vector<lox::capture>>
+		  captures;
+		// blocks that don't declare anything, so don't get an environment.
+		std::unordered_set<const lox::stmt::block *> scopeless_blocks;
+
+		// how many calls to interpreted functions can be in progress at once,
+		// any more is a stack overflow. tail calls don't count.
+		size_t max_depth = 1U << 16;
+
+		// every token's lexeme lives here, so that the AST (and closures made
+		// from it) remain valid after the source has been discarded.
+		lox::lexeme_table lexemes;
+
+		// scripts are looked up here before being scanned, if set.
+		lak::optional<lox::ast_cache> cache;
 
 		void report(
 		  size_t line,
@@ -46,23 +88,38 @@ namespace lox
 
 		lak::result<lak::monostate> execute(const lox::stmt &stmt);
 
-		lak::result<lox::object> execute_block(
-		  lak::span<const lox::stmt_ptr> stmts, const lox::environment_ptr &env);
+		lak::result<lox::object> call(const lox::callable &callee,
+		                              std::vector<lox::object> &&arguments);
 
 		void resolve(const lox::expr::variable &expr, size_t distance);
 		void resolve(const lox::expr::assign &expr, size_t distance);
 		void resolve(const lox::expr::super_keyword &expr, size_t distance);
 		void resolve(const lox::expr::this_keyword &expr, size_t distance);
+		void resolve_tail_call(const lox::expr::call &expr);
+		void resolve_capture(const lox::stmt::function &func,
+		                     lox::capture capture);
+		void resolve_scopeless(const lox::stmt::block &stmt);
 
 		lak::result<size_t> find(const lox::expr::variable &expr);
 		lak::result<size_t> find(const lox::expr::assign &expr);
 		lak::result<size_t> find(const lox::expr::super_keyword &expr);
 		lak::result<size_t> find(const lox::expr::this_keyword &expr);
+		bool is_tail_call(const lox::expr::call &expr) const;
+		lak::span<const lox::capture> find_captures(
+		  const lox::stmt::function &func) const;
+		bool is_scopeless(const lox::stmt::block &stmt) const;
 
-		lak::result<std::vector<lox::stmt_ptr>> parse(lak::u8string_view file);
+		lak::result<std::vector<lox::stmt_ptr>> parse(lox::scanner &scanner);
 		lak::result<std::vector<lox::stmt_ptr>> parse_file(
 		  const std::filesystem::path &file);
 
+		// Parses each file with its own interpreter on a pool of thread_count
+		// threads (0 for one per hardware thread). The statements, lexemes and
+		// any errors are then merged back in the order the files were given, so
+		// the result is the same however the threads were scheduled.
+		lak::result<std::vector<lox::stmt_ptr>> parse_bundle(
+		  lak::span<const std::filesystem::path> files, size_t thread_count = 0U);
+
 		lak::u8string interpret(const lox::expr &expr);
 
 		lak::result<lak::u8string> interpret(const lox::stmt &stmt);
@@ -71,11 +128,24 @@ namespace lox
 
 		interpreter &init_globals();
 
+		// scan, parse and resolve.
+		lak::result<std::vector<lox::stmt_ptr>> load(lox::scanner &scanner);
+
 		lak::result<> run(lak::u8string_view file,
 		                  lak::u8string *out_str = nullptr);
 
+		// the file is scanned incrementally rather than being read up front,
+		// unless the cache already has it.
 		lak::result<> run_file(const std::filesystem::path &file_path);
 
+		// parse_bundle, then resolve and run the files as one program.
+		lak::result<> run_bundle(lak::span<const std::filesystem::path> files,
+		                         size_t thread_count = 0U);
+
+		// run a script compiled by lox::program::compile. globals must not have
+		// been defined beyond init_globals.
+		lak::result<> run_program(const lox::program &program);
+
 		lak::result<> run_prompt();
 	};
 }
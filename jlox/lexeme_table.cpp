@@ -0,0 +1,18 @@
+#include "lexeme_table.hpp"
+
+const lak::u8string &lox::lexeme_table::intern(lak::u8string_view lexeme)
+{
+	// unordered_set never moves its elements, so references to them stay valid
+	if (auto iter = lexemes.find(lexeme); iter != lexemes.end())
+		return *iter;
+	return *lexemes.emplace(lexeme.to_string()).first;
+}
+
+void lox::lexeme_table::adopt(lox::lexeme_table &&other)
+{
+	// merge relinks the nodes rather than copying them
+	lexemes.merge(other.lexemes);
+	if (!other.lexemes.empty()) duplicates.push_back(lak::move(other.lexemes));
+	for (set_type &set : other.duplicates) duplicates.push_back(lak::move(set));
+	other.duplicates.clear();
+}
@@ -0,0 +1,38 @@
+#ifndef LOX_LEXEME_TABLE_HPP
+#define LOX_LEXEME_TABLE_HPP
+
+#include "string_map.hpp"
+
+#include <lak/functional.hpp>
+#include <lak/string.hpp>
+#include <lak/string_view.hpp>
+
+#include <unordered_set>
+#include <vector>
+
+namespace lox
+{
+	// Owns one copy of each distinct lexeme, so that tokens remain valid after
+	// the scanner's window has moved past the text they came from.
+	struct lexeme_table
+	{
+		using set_type = std::unordered_set<lak::u8string,
+		                                    lox::string_hash<char8_t>,
+		                                    lak::equal_to<>>;
+
+		set_type lexemes;
+
+		// lexemes adopted from other tables that were already in this one. they
+		// are kept because tokens may still refer to them.
+		std::vector<set_type> duplicates;
+
+		// the returned string is valid for the lifetime of the table.
+		const lak::u8string &intern(lak::u8string_view lexeme);
+
+		// takes ownership of every lexeme in other without moving or copying
+		// them, so tokens interned by other remain valid.
+		void adopt(lox::lexeme_table &&other);
+	};
+}
+
+#endif
@@ -1,9 +1,34 @@
 #include "lox.hpp"
 
+#include <fstream>
 #include <iostream>
+#include <string>
 
 int lox::usage()
 {
-	std::cerr << "Usage: jlox [script] [--dot]\n";
+	std::cerr << "Usage: jlox [script] [--dot] [--no-cache] [--cache-stats]\n"
+	             "            [--alloc-stats] [--max-depth n]\n"
+	             "       jlox --bundle [--threads n] [--max-depth n]\n"
+	             "            (script | @manifest)...\n"
+	             "       jlox --runs m [--threads n] script\n";
 	return EXIT_FAILURE;
 }
+
+lak::result<std::vector<std::filesystem::path>> lox::read_manifest(
+  const std::filesystem::path &manifest)
+{
+	std::ifstream strm(manifest);
+	if (!strm) return lak::err_t{};
+
+	const std::filesystem::path directory = manifest.parent_path();
+
+	std::vector<std::filesystem::path> result;
+	for (std::string line; std::getline(strm, line);)
+	{
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty() || line.front() == '#') continue;
+		result.push_back(directory / line);
+	}
+
+	return lak::move_ok(result);
+}
@@ -1,9 +1,19 @@
 #ifndef LOX_LOX_HPP
 #define LOX_LOX_HPP
 
+#include <lak/result.hpp>
+
+#include <filesystem>
+#include <vector>
+
 namespace lox
 {
 	int usage();
+
+	// One file per line, relative to the directory the manifest is in. Blank
+	// lines and lines starting with # are skipped.
+	lak::result<std::vector<std::filesystem::path>> read_manifest(
+	  const std::filesystem::path &manifest);
 }
 
 #endif
@@ -2,26 +2,96 @@
 #include "interpreter.hpp"
 #include "lox.hpp"
 #include "object.hpp"
+#include "output.hpp"
 #include "parser.hpp"
+#include "parallel.hpp"
+#include "pool.hpp"
 #include "printer.hpp"
+#include "program.hpp"
 #include "scanner.hpp"
 #include "token.hpp"
 
 #include <lak/string_literals.hpp>
 #include <lak/string_ostream.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
-int main(int argc, char *argv[])
+// compile file once, then run it runs times across a pool of threads. each
+// run gets a fresh interpreter with its output discarded.
+int run_stress(const std::filesystem::path &file,
+               size_t runs,
+               size_t thread_count)
 {
-	if (argc > 3) return lox::usage();
+	lox::program program;
+	if_let_ok (lox::program & compiled, lox::program::compile(file))
+		program = lak::move(compiled);
+	else
+		return EXIT_FAILURE;
+
+	if (thread_count == 0U)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+
+	std::atomic_size_t failures = 0U;
+	auto run                    = [&](size_t)
+	{
+		std::ostringstream strm;
+		lox::ostream_sink sink{strm};
+		lox::output out{sink};
+		lox::interpreter interpreter;
+		interpreter.out         = &out;
+		interpreter.diagnostics = &strm;
+		if (interpreter.init_globals().run_program(program).is_err()) ++failures;
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	lox::parallel_for(runs, thread_count, run);
+	const std::chrono::duration<double> elapsed =
+	  std::chrono::steady_clock::now() - start;
 
+	std::cerr << runs << " runs on " << thread_count << " threads in "
+	          << elapsed.count() << "s (" << (runs / elapsed.count())
+	          << " scripts/s)\n";
+
+	if (failures > 0U)
+	{
+		std::cerr << failures << " runs failed\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+// the objects made on this thread, and how many are still alive.
+void print_alloc_stats()
+{
+	for (const lox::pool_counter *counter = lox::pool_counter::first(); counter;
+	     counter                          = counter->next)
+		std::cerr << counter->name << ": " << counter->made << " made, "
+		          << (counter->made - counter->freed) << " live\n";
+	std::cerr << "slabs: " << lox::pool::slabs() << "\n";
+}
+
+int main(int argc, char *argv[])
+{
 	lak::optional<std::filesystem::path> file;
-	bool print_dot = false;
+	std::vector<std::filesystem::path> bundle;
+	size_t thread_count = 0U;
+	size_t runs         = 0U;
+	size_t max_depth    = lox::interpreter{}.max_depth;
+	bool bundle_mode    = false;
+	bool print_dot      = false;
+	bool use_cache      = true;
+	bool cache_stats    = false;
+	bool alloc_stats    = false;
 
-	while (argc-- > 1)
+	for (int i = 1; i < argc; ++i)
 	{
-		const auto arg{lak::astring_view::from_c_str(argv[argc])};
+		const auto arg{lak::astring_view::from_c_str(argv[i])};
 		if (arg == "--help"_view)
 		{
 			lox::usage();
@@ -32,15 +102,97 @@ int main(int argc, char *argv[])
 			if (print_dot) return lox::usage();
 			print_dot = true;
 		}
+		else if (arg == "--no-cache"_view)
+		{
+			if (!use_cache) return lox::usage();
+			use_cache = false;
+		}
+		else if (arg == "--cache-stats"_view)
+		{
+			if (cache_stats) return lox::usage();
+			cache_stats = true;
+		}
+		else if (arg == "--alloc-stats"_view)
+		{
+			if (alloc_stats) return lox::usage();
+			alloc_stats = true;
+		}
+		else if (arg == "--bundle"_view)
+		{
+			if (bundle_mode) return lox::usage();
+			bundle_mode = true;
+		}
+		else if (arg == "--threads"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto count{lak::astring_view::from_c_str(argv[i])};
+			if (std::from_chars(count.begin(), count.end(), thread_count).ec !=
+			    std::errc())
+				return lox::usage();
+		}
+		else if (arg == "--runs"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto count{lak::astring_view::from_c_str(argv[i])};
+			if (std::from_chars(count.begin(), count.end(), runs).ec !=
+			      std::errc() ||
+			    runs == 0U)
+				return lox::usage();
+		}
+		else if (arg == "--max-depth"_view)
+		{
+			if (++i == argc) return lox::usage();
+			const auto count{lak::astring_view::from_c_str(argv[i])};
+			if (std::from_chars(count.begin(), count.end(), max_depth).ec !=
+			      std::errc() ||
+			    max_depth == 0U)
+				return lox::usage();
+		}
+		else if (bundle_mode && !arg.empty() && arg[0] == '@')
+		{
+			const std::filesystem::path manifest{lak::astring(arg.substr(1))};
+			if_let_ok (const std::vector<std::filesystem::path> &files,
+			           lox::read_manifest(manifest))
+			{
+				bundle.insert(bundle.end(), files.begin(), files.end());
+			}
+			else
+			{
+				std::cerr << "Failed to read manifest '" << manifest.string()
+				          << "'.\n";
+				return EXIT_FAILURE;
+			}
+		}
+		else if (bundle_mode)
+		{
+			bundle.push_back(lak::astring(arg));
+		}
+		else if (file)
+		{
+			return lox::usage();
+		}
 		else
 		{
 			file = lak::astring(arg);
 		}
 	}
 
+	if (bundle_mode && (print_dot || file || bundle.empty()))
+		return lox::usage();
+	if (runs > 0U && (bundle_mode || print_dot || !file)) return lox::usage();
+
+	if (runs > 0U) return run_stress(*file, runs, thread_count);
+
 	lox::interpreter interpreter;
+	interpreter.max_depth = max_depth;
 
-	if (print_dot)
+	if (bundle_mode)
+	{
+		return interpreter.init_globals().run_bundle(bundle, thread_count).is_ok()
+		         ? EXIT_SUCCESS
+		         : EXIT_FAILURE;
+	}
+	else if (print_dot)
 	{
 		if (!file)
 		{
@@ -68,8 +220,17 @@ int main(int argc, char *argv[])
 	}
 	else if (file)
 	{
-		return interpreter.init_globals().run_file(*file).is_ok() ? EXIT_SUCCESS
-		                                                          : EXIT_FAILURE;
+		if (use_cache) interpreter.cache = lox::ast_cache::make_default();
+
+		const bool ok = interpreter.init_globals().run_file(*file).is_ok();
+
+		if (cache_stats && interpreter.cache)
+			std::cerr << "cache: " << interpreter.cache->hits << " hits, "
+			          << interpreter.cache->misses << " misses\n";
+
+		if (alloc_stats) print_alloc_stats();
+
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 	else
 	{
@@ -1,71 +1,69 @@
 #include "object.hpp"
 
 #include "callable.hpp"
+#include "output.hpp"
 #include "type.hpp"
 
+#include <lox/number.hpp>
+
 #include <lak/string.hpp>
 #include <lak/visit.hpp>
 
 struct lox::object::impl
 {
+	static constexpr char pool_name[] = "object";
+
 	lox::object::value_type value;
 };
 
-lox::object::object() : _impl(lox::object::impl_ptr::make().unwrap()) {}
+lox::object::object() : _impl(lox::object::impl_ptr::make()) {}
 
 lox::object::object(lak::monostate value)
 : _impl(lox::object::impl_ptr::make(lox::object::impl{
                                       .value = value,
-                                    })
-          .unwrap())
+                                    }))
 {
 }
 
 lox::object::object(lak::u8string value)
 : _impl(lox::object::impl_ptr::make(lox::object::impl{
                                       .value = value,
-                                    })
-          .unwrap())
+                                    }))
 {
 }
 
 lox::object::object(double value)
 : _impl(lox::object::impl_ptr::make(lox::object::impl{
                                       .value = value,
-                                    })
-          .unwrap())
+                                    }))
 {
 }
 
 lox::object::object(bool value)
 : _impl(lox::object::impl_ptr::make(lox::object::impl{
                                       .value = value,
-                                    })
-          .unwrap())
+                                    }))
 {
 }
 
 lox::object::object(const lox::callable &value)
 : _impl(lox::object::impl_ptr::make(lox::object::impl{
                                       .value = value,
-                                    })
-          .unwrap())
+                                    }))
 {
 }
 
 lox::object::object(const lox::type &value)
 : _impl(lox::object::impl_ptr::make(lox::object::impl{
                                       .value = value,
-                                    })
-          .unwrap())
+                                    }))
 {
 }
 
 lox::object::object(const lox::instance &value)
 : _impl(lox::object::impl_ptr::make(lox::object::impl{
                                       .value = value,
-                                    })
-          .unwrap())
+                                    }))
 {
 }
 
@@ -159,10 +157,26 @@ lak::u8string lox::object::to_string() const
 	  [&](const lak::u8string &str) -> lak::u8string
 	  { return u8"\"" + str + u8"\""; },
 	  [&](const double &number) -> lak::u8string
-	  { return lak::as_u8string(std::to_string(number)).to_string(); },
+	  { return lox::number_to_string(number, lox::number_format::fixed); },
 	  [&](const bool &b) -> lak::u8string { return b ? u8"true" : u8"false"; },
 	  [&](const lox::callable &c) -> lak::u8string { return c.to_string(); },
 	  [&](const lox::type &t) -> lak::u8string { return t.to_string(); },
 	  [&](const lox::instance &i) -> lak::u8string { return i.to_string(); },
 	});
 }
+
+void lox::object::write(lox::output &out) const
+{
+	visit(lak::overloaded{
+	  [&](lak::monostate) { out.write(u8"nil"); },
+	  [&](const lak::u8string &str)
+	  {
+		  out.write('"');
+		  out.write(str);
+		  out.write('"');
+	  },
+	  [&](const double &number) { out.write(number); },
+	  [&](const bool &b) { out.write(b ? u8"true" : u8"false"); },
+	  [&](const auto &) { out.write(to_string()); },
+	});
+}
@@ -1,6 +1,8 @@
 #ifndef LOX_OBJECT_HPP
 #define LOX_OBJECT_HPP
 
+#include "pool.hpp"
+
 #include <lak/memory.hpp>
 #include <lak/string_ostream.hpp>
 #include <lak/string_view.hpp>
@@ -11,6 +13,7 @@
 namespace lox
 {
 	struct callable;
+	struct output;
 	struct type;
 	struct instance;
 
@@ -26,7 +29,7 @@ namespace lox
 
 	private:
 		struct impl;
-		using impl_ptr = lak::shared_ref<impl>;
+		using impl_ptr = lox::pool_ptr<impl>;
 
 		impl_ptr _impl;
 
@@ -45,6 +48,10 @@ namespace lox
 
 		lak::u8string to_string() const;
 
+		// the same as to_string, but nil, bools, numbers and strings are written
+		// without allocating.
+		void write(lox::output &out) const;
+
 		bool is_truthy() const;
 
 		value_type &value();
@@ -0,0 +1,74 @@
+#ifndef LOX_OUTPUT_HPP
+#define LOX_OUTPUT_HPP
+
+#include <lak/span.hpp>
+#include <lak/string_view.hpp>
+
+#include <cstdio>
+#include <ostream>
+#include <vector>
+
+namespace lox
+{
+	// Receives print output in large blocks. Embedders implement this to
+	// capture what a script prints.
+	struct output_sink
+	{
+		virtual ~output_sink() = default;
+
+		virtual void write(lak::span<const char> bytes) = 0;
+	};
+
+	struct file_sink final : lox::output_sink
+	{
+		std::FILE *file;
+
+		explicit file_sink(std::FILE *f) : file(f) {}
+
+		void write(lak::span<const char> bytes) override;
+	};
+
+	struct ostream_sink final : lox::output_sink
+	{
+		std::ostream *strm;
+
+		explicit ostream_sink(std::ostream &s) : strm(&s) {}
+
+		void write(lak::span<const char> bytes) override;
+	};
+
+	// Buffers print output in front of a sink. Numbers are formatted with
+	// std::to_chars straight into the buffer, so printing doesn't allocate.
+	// The buffer is handed to the sink when it fills up, on flush() and on
+	// destruction.
+	struct output
+	{
+		static constexpr size_t default_capacity = 0x10000U;
+
+		lox::output_sink *sink;
+		std::vector<char> buffer;
+		size_t used = 0U;
+
+		explicit output(lox::output_sink &s,
+		                size_t capacity = default_capacity);
+
+		output(const output &)            = delete;
+		output &operator=(const output &) = delete;
+
+		~output();
+
+		void write(lak::u8string_view str);
+
+		void write(char c);
+
+		// formatted like std::to_string (%f).
+		void write(double d);
+
+		void flush();
+	};
+
+	// stdout, flushed at exit.
+	lox::output &standard_output();
+}
+
+#endif
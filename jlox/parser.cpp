@@ -2,6 +2,13 @@
 
 #include <lak/debug.hpp>
 
+#include <utility>
+
+lox::parser::parser(lox::interpreter &interp, lox::scanner &scan)
+: interpreter(interp), scanner(scan), current(scanner.scan_token())
+{
+}
+
 bool lox::parser::empty() const
 {
 	return peek().type == lox::token_type::EOF_TOK;
@@ -9,18 +16,18 @@ bool lox::parser::empty() const
 
 const lox::token &lox::parser::last()
 {
-	return tokens[current - 1];
+	return previous;
 }
 
 const lox::token &lox::parser::next()
 {
-	if (!empty()) ++current;
+	if (!empty()) previous = std::exchange(current, scanner.scan_token());
 	return last();
 }
 
 const lox::token &lox::parser::peek() const
 {
-	return tokens[current];
+	return current;
 }
 
 bool lox::parser::check(lox::token_type type) const
@@ -43,13 +50,14 @@ bool lox::parser::match(std::initializer_list<lox::token_type> types)
 	return false;
 }
 
-const lox::token *lox::parser::consume(lox::token_type type,
-                                       lak::u8string_view message_on_err,
-                                       const std::source_location srcloc)
+lak::optional<lox::token> lox::parser::consume(
+  lox::token_type type,
+  lak::u8string_view message_on_err,
+  const std::source_location srcloc)
 {
-	if (check(type)) return &next();
+	if (check(type)) return next();
 	interpreter.error(peek(), message_on_err, srcloc);
-	return nullptr;
+	return lak::nullopt;
 }
 
 void lox::parser::sync()
@@ -85,8 +93,18 @@ lak::result<lox::expr_ptr> lox::parser::parse_primary()
 		return lak::ok_t{lox::expr::make_literal({.value = true})};
 	if (match({NIL})) return lak::ok_t{lox::expr::make_literal({})};
 
-	if (match({NUMBER, STRING}))
-		return lak::ok_t{lox::expr::make_literal({.value = last().literal})};
+	if (match({NUMBER}))
+	{
+		if_let_ok (const double number, last().number())
+			return lak::ok_t{
+			  lox::expr::make_literal({.value = lox::object{number}})};
+		interpreter.error(last(), u8"Invalid number.");
+		return lak::err_t{};
+	}
+
+	if (match({STRING}))
+		return lak::ok_t{lox::expr::make_literal(
+		  {.value = lox::object{last().string().to_string()}})};
 
 	if (match({SUPER}))
 	{
@@ -94,7 +112,7 @@ lak::result<lox::expr_ptr> lox::parser::parse_primary()
 
 		if (!consume(DOT, u8"Expected '.' after 'super'.")) return lak::err_t{};
 
-		const lox::token *method =
+		lak::optional<lox::token> method =
 		  consume(IDENTIFIER, u8"Expected superclass method name.");
 		if (!method) return lak::err_t{};
 
@@ -142,7 +160,7 @@ lak::result<lox::expr_ptr> lox::parser::parse_call()
 			} while (match({lox::token_type::COMMA}));
 		}
 
-		const lox::token *paren =
+		lak::optional<lox::token> paren =
 		  consume(lox::token_type::RIGHT_PAREN, u8"Expected ')' after arguments.");
 		if (!paren) return lak::err_t{};
 
@@ -163,8 +181,8 @@ lak::result<lox::expr_ptr> lox::parser::parse_call()
 		}
 		else if (match({lox::token_type::DOT}))
 		{
-			const lox::token *name = consume(lox::token_type::IDENTIFIER,
-			                                 u8"Expected property name after '.'.");
+			lak::optional<lox::token> name = consume(
+			  lox::token_type::IDENTIFIER, u8"Expected property name after '.'.");
 			if (!name) return lak::err_t{};
 			expr = lox::expr::make_get({
 			  .object = lak::move(expr),
@@ -391,7 +409,7 @@ lak::result<lox::stmt_ptr> lox::parser::parse_expression_statement()
 lak::result<lox::stmt::function_ptr> lox::parser::parse_function_ptr(
   const lak::u8string &kind)
 {
-	const lox::token *name =
+	lak::optional<lox::token> name =
 	  consume(lox::token_type::IDENTIFIER, u8"Expected " + kind + u8" name.");
 	if (!name) return lak::err_t{};
 
@@ -410,12 +428,10 @@ lak::result<lox::stmt::function_ptr> lox::parser::parse_function_ptr(
 				return lak::err_t{};
 			}
 
-			if_ref (const lox::token & param,
-			        consume(lox::token_type::IDENTIFIER,
-			                u8"Expected parameter name."))
-				parameters.emplace_back(param);
-			else
-				return lak::err_t{};
+			lak::optional<lox::token> param =
+			  consume(lox::token_type::IDENTIFIER, u8"Expected parameter name.");
+			if (!param) return lak::err_t{};
+			parameters.emplace_back(lak::move(*param));
 		} while (match({lox::token_type::COMMA}));
 	}
 
@@ -592,7 +608,7 @@ lak::result<lox::stmt_ptr> lox::parser::parse_statement()
 
 lak::result<lox::stmt_ptr> lox::parser::parse_var_declaration()
 {
-	const lox::token *name =
+	lak::optional<lox::token> name =
 	  consume(lox::token_type::IDENTIFIER, u8"Expected variable name.");
 	if (!name) return lak::err_t{};
 
@@ -612,7 +628,7 @@ lak::result<lox::stmt_ptr> lox::parser::parse_var_declaration()
 
 lak::result<lox::stmt_ptr> lox::parser::parse_class_declaration()
 {
-	const lox::token *name =
+	lak::optional<lox::token> name =
 	  consume(lox::token_type::IDENTIFIER, u8"Expected class name.");
 	if (!name) return lak::err_t{};
 
@@ -3,9 +3,11 @@
 
 #include "expr.hpp"
 #include "interpreter.hpp"
+#include "scanner.hpp"
 #include "stmt.hpp"
 #include "token.hpp"
 
+#include <lak/optional.hpp>
 #include <lak/result.hpp>
 #include <lak/stdint.hpp>
 
@@ -15,11 +17,16 @@
 
 namespace lox
 {
+	// Pulls tokens from the scanner as it goes, only the previous and current
+	// tokens are held at any one time.
 	struct parser
 	{
 		lox::interpreter &interpreter;
-		std::vector<lox::token> tokens;
-		size_t current = 0;
+		lox::scanner &scanner;
+		lox::token previous = {};
+		lox::token current  = {};
+
+		parser(lox::interpreter &interp, lox::scanner &scan);
 
 		bool empty() const;
 
@@ -33,7 +40,7 @@ namespace lox
 
 		bool match(std::initializer_list<lox::token_type> types);
 
-		const lox::token *consume(
+		lak::optional<lox::token> consume(
 		  lox::token_type type,
 		  lak::u8string_view message_on_err,
 		  const std::source_location srcloc = std::source_location::current());
@@ -0,0 +1,135 @@
+#include "pool.hpp"
+
+#include <atomic>
+#include <utility>
+
+// a block on a free list.
+struct free_block
+{
+	free_block *next;
+};
+
+constexpr size_t size_class_count =
+  lox::pool::max_size / lox::pool::granularity;
+
+size_t size_class(size_t size)
+{
+	return (size - 1U) / lox::pool::granularity;
+}
+
+// trivially destructible, so that blocks can still be freed to it while the
+// thread's other thread_locals (and at exit, static objects) are destroyed.
+struct thread_pool
+{
+	free_block *free_lists[size_class_count];
+	// the part of the current slab that blocks haven't been cut from yet.
+	byte_t *slab_next;
+	byte_t *slab_end;
+	size_t slabs;
+	const lox::pool_counter *counters;
+};
+
+thread_local thread_pool this_thread_pool = {};
+
+// the free blocks left behind by threads that have exited. a thread takes a
+// size class's whole list at once, so pushing onto one can't suffer from
+// ABA.
+std::atomic<free_block *> depot[size_class_count] = {};
+
+// leaves the thread's free blocks in the depot once it exits.
+struct thread_pool_guard
+{
+	bool active = false;
+
+	~thread_pool_guard()
+	{
+		for (size_t i = 0U; i < size_class_count; ++i)
+		{
+			free_block *first =
+			  std::exchange(this_thread_pool.free_lists[i], nullptr);
+			if (!first) continue;
+
+			free_block *last = first;
+			while (last->next) last = last->next;
+
+			last->next = depot[i].load(std::memory_order_relaxed);
+			while (!depot[i].compare_exchange_weak(
+			  last->next, first, std::memory_order_release))
+				;
+		}
+	}
+};
+
+thread_local thread_pool_guard this_thread_guard;
+
+// the free list of index is empty, take the depot's or cut a new block.
+void *refill(thread_pool &pool, size_t index)
+{
+	// constructs the guard, if this is the first time through
+	this_thread_guard.active = true;
+
+	if (depot[index].load(std::memory_order_relaxed))
+	{
+		if (free_block *block =
+		      depot[index].exchange(nullptr, std::memory_order_acquire);
+		    block)
+		{
+			pool.free_lists[index] = block->next;
+			return block;
+		}
+	}
+
+	const size_t block_size = (index + 1U) * lox::pool::granularity;
+	if (static_cast<size_t>(pool.slab_end - pool.slab_next) < block_size)
+	{
+		// the rest of the old slab is abandoned, it's smaller than a block.
+		pool.slab_next =
+		  static_cast<byte_t *>(::operator new(lox::pool::slab_size));
+		pool.slab_end = pool.slab_next + lox::pool::slab_size;
+		++pool.slabs;
+	}
+
+	return std::exchange(pool.slab_next, pool.slab_next + block_size);
+}
+
+void *lox::pool::allocate(size_t size)
+{
+	if (size > max_size) return ::operator new(size);
+
+	thread_pool &pool  = this_thread_pool;
+	const size_t index = size_class(size);
+	if (free_block *block = pool.free_lists[index]; block)
+	{
+		pool.free_lists[index] = block->next;
+		return block;
+	}
+
+	return refill(pool, index);
+}
+
+void lox::pool::deallocate(void *ptr, size_t size)
+{
+	if (size > max_size) return ::operator delete(ptr);
+
+	thread_pool &pool      = this_thread_pool;
+	const size_t index     = size_class(size);
+	pool.free_lists[index] = ::new (ptr) free_block{
+	  .next = pool.free_lists[index],
+	};
+}
+
+size_t lox::pool::slabs()
+{
+	return this_thread_pool.slabs;
+}
+
+lox::pool_counter::pool_counter(const char *n)
+: name(n), next(this_thread_pool.counters)
+{
+	this_thread_pool.counters = this;
+}
+
+const lox::pool_counter *lox::pool_counter::first()
+{
+	return this_thread_pool.counters;
+}
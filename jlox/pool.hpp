@@ -0,0 +1,138 @@
+#ifndef LOX_POOL_HPP
+#define LOX_POOL_HPP
+
+#include <lak/stdint.hpp>
+#include <lak/utility.hpp>
+
+#include <new>
+#include <utility>
+
+namespace lox
+{
+	// An allocator for the interpreter's small, short lived objects. Blocks are
+	// cut from slabs and segregated into size classes, each with a thread-local
+	// free list that freed blocks are pushed onto and reused from. When a
+	// thread exits its free blocks are left in a depot for the other threads.
+	// Slabs are never handed back to the system. Anything bigger than the
+	// largest size class goes to the general heap.
+	struct pool
+	{
+		static constexpr size_t granularity = 16U;
+		static constexpr size_t max_size    = 256U;
+		static constexpr size_t slab_size   = 64U * 1024U;
+
+		static void *allocate(size_t size);
+
+		// size must be the size ptr was allocated with. ptr may have been
+		// allocated on another thread.
+		static void deallocate(void *ptr, size_t size);
+
+		// how many slabs this thread has cut blocks from.
+		static size_t slabs();
+	};
+
+	// How many objects of one type have been made and freed on this thread.
+	struct pool_counter
+	{
+		const char *name;
+		size_t made  = 0U;
+		size_t freed = 0U;
+		// the counter used on this thread before this one.
+		const pool_counter *next;
+
+		// adds the counter to this thread's list.
+		pool_counter(const char *n);
+
+		// the last counter used on this thread, nullptr if none have been.
+		static const pool_counter *first();
+	};
+
+	// A reference counted pointer to a T allocated from the pool. T needs a
+	// static pool_name to be counted under. Like lak::shared_ptr, T only has to
+	// be complete where the pointer is made. The count isn't atomic, so the
+	// pointee must not be shared between threads.
+	template<typename T>
+	struct pool_ptr
+	{
+	private:
+		// lives just before the T. destroy is set by make, where T is complete.
+		struct alignas(lox::pool::granularity) header
+		{
+			size_t references;
+			void (*destroy)(header *);
+		};
+
+		T *_value = nullptr;
+
+		header *head() const { return reinterpret_cast<header *>(_value) - 1; }
+
+		static lox::pool_counter &counter()
+		{
+			thread_local lox::pool_counter result(T::pool_name);
+			return result;
+		}
+
+		static void destroy(header *head)
+		{
+			reinterpret_cast<T *>(head + 1)->~T();
+			lox::pool::deallocate(head, sizeof(header) + sizeof(T));
+			++counter().freed;
+		}
+
+		void release()
+		{
+			if (_value)
+			{
+				header *h = head();
+				if (--h->references == 0U) h->destroy(h);
+			}
+		}
+
+	public:
+		pool_ptr() = default;
+
+		pool_ptr(std::nullptr_t) {}
+
+		pool_ptr(const pool_ptr &other) : _value(other._value)
+		{
+			if (_value) ++head()->references;
+		}
+
+		pool_ptr(pool_ptr &&other) : _value(std::exchange(other._value, nullptr))
+		{
+		}
+
+		pool_ptr &operator=(pool_ptr other)
+		{
+			std::swap(_value, other._value);
+			return *this;
+		}
+
+		~pool_ptr() { release(); }
+
+		template<typename... ARGS>
+		static pool_ptr make(ARGS &&...args)
+		{
+			static_assert(alignof(T) <= lox::pool::granularity);
+
+			header *h = ::new (lox::pool::allocate(sizeof(header) + sizeof(T)))
+			  header{.references = 1U, .destroy = &destroy};
+			pool_ptr result;
+			result._value = ::new (h + 1) T(lak::forward<ARGS>(args)...);
+			++counter().made;
+			return result;
+		}
+
+		T *get() const { return _value; }
+
+		T &operator*() const { return *_value; }
+
+		T *operator->() const { return _value; }
+
+		explicit operator bool() const { return _value != nullptr; }
+
+		bool operator==(const pool_ptr &rhs) const = default;
+	};
+}
+
+#endif
@@ -258,7 +258,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
 		});
 
 	result += subgraph(ptr_to_string(&stmt),
-	                   u8"{type|"_str + stmt.name.lexeme.to_string() + u8"}",
+	                   u8"{type|"_str + stmt.name.lexeme().to_string() + u8"}",
 	                   entries);
 
 	if_ref (const auto &superclass, stmt.superclass)
@@ -340,7 +340,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
 		});
 
 	result += subgraph(ptr_to_string(&stmt),
-	                   u8"{var|"_str + stmt.name.lexeme.to_string() + u8"}",
+	                   u8"{var|"_str + stmt.name.lexeme().to_string() + u8"}",
 	                   entries);
 
 	if_ref (const auto &init, stmt.init) result += init->visit(*this);
@@ -379,11 +379,11 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
 		});
 
 	lak::u8string function_sig;
-	function_sig += stmt->name.lexeme;
+	function_sig += stmt->name.lexeme();
 	function_sig += u8"(";
 	for (const auto &param : stmt->parameters)
 	{
-		function_sig += param.lexeme;
+		function_sig += param.lexeme();
 		function_sig += u8", ";
 	}
 	while (!function_sig.empty() &&
@@ -423,7 +423,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
   const lox::expr::assign &expr) const
 {
 	return subgraph(ptr_to_string(&expr),
-	                u8"{assign|"_str + escape(expr.name.lexeme.to_string()) +
+	                u8"{assign|"_str + escape(expr.name.lexeme().to_string()) +
 	                  u8"}",
 	                {subgraph_entry{
 	                  .to{expr.value->visit(visit_ptr_string)},
@@ -436,7 +436,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
   const lox::expr::binary &expr) const
 {
 	return subgraph(ptr_to_string(&expr),
-	                u8"{binary|"_str + escape(expr.op.lexeme) + u8"}",
+	                u8"{binary|"_str + escape(expr.op.lexeme()) + u8"}",
 	                {subgraph_entry{
 	                   .to{expr.left->visit(visit_ptr_string)},
 	                   .label{u8"L"},
@@ -479,7 +479,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
   const lox::expr::get &expr) const
 {
 	return subgraph(ptr_to_string(&expr),
-	                u8"{get|."_str + expr.name.lexeme.to_string() + u8"}",
+	                u8"{get|."_str + expr.name.lexeme().to_string() + u8"}",
 	                {subgraph_entry{
 	                  .to{expr.object->visit(visit_ptr_string)},
 	                  .label{u8"object"},
@@ -491,7 +491,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
   const lox::expr::super_keyword &expr) const
 {
 	return subgraph(ptr_to_string(&expr),
-	                u8"{super|"_str + expr.method.lexeme.to_string() + u8"}");
+	                u8"{super|"_str + expr.method.lexeme().to_string() + u8"}");
 }
 
 lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
@@ -523,7 +523,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
   const lox::expr::logical &expr) const
 {
 	return subgraph(ptr_to_string(&expr),
-	                u8"{logical|"_str + escape(expr.op.lexeme) + u8"}",
+	                u8"{logical|"_str + escape(expr.op.lexeme()) + u8"}",
 	                {subgraph_entry{
 	                   .to{expr.left->visit(visit_ptr_string)},
 	                   .label{u8"L"},
@@ -539,7 +539,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
   const lox::expr::set &expr) const
 {
 	return subgraph(ptr_to_string(&expr),
-	                u8"{set|."_str + expr.name.lexeme.to_string() + u8"}",
+	                u8"{set|."_str + expr.name.lexeme().to_string() + u8"}",
 	                {subgraph_entry{
 	                   .to{expr.object->visit(visit_ptr_string)},
 	                   .label{u8"object"},
@@ -555,7 +555,7 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
   const lox::expr::unary &expr) const
 {
 	return subgraph(ptr_to_string(&expr),
-	                u8"{unary|"_str + escape(expr.op.lexeme) + u8"}",
+	                u8"{unary|"_str + escape(expr.op.lexeme()) + u8"}",
 	                {subgraph_entry{
 	                  .to{expr.right->visit(visit_ptr_string)},
 	                  .label{u8"R"},
@@ -567,5 +567,5 @@ lak::u8string lox::dot_subgraph_ast_printer_t::operator()(
   const lox::expr::variable &expr) const
 {
 	return subgraph(ptr_to_string(&expr),
-	                u8"{variable|"_str + escape(expr.name.lexeme) + u8"}");
+	                u8"{variable|"_str + escape(expr.name.lexeme()) + u8"}");
 }
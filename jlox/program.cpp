@@ -0,0 +1,23 @@
+#include "program.hpp"
+
+#include "ast_cache.hpp"
+#include "interpreter.hpp"
+#include "resolver.hpp"
+
+lak::result<lox::program> lox::program::compile(
+  const std::filesystem::path &file)
+{
+	lox::interpreter interpreter;
+	interpreter.init_globals();
+
+	RES_TRY_ASSIGN(std::vector<lox::stmt_ptr> stmts =,
+	               interpreter.parse_file(file));
+
+	lox::resolver resolver{interpreter};
+	RES_TRY(resolver.resolve(stmts));
+	if (interpreter.had_error) return lak::err_t{};
+
+	RES_TRY_ASSIGN(std::vector<byte_t> image =,
+	               lox::serialise_ast(interpreter, stmts));
+	return lak::ok_t{lox::program{.image = lak::move(image)}};
+}
@@ -0,0 +1,26 @@
+#ifndef LOX_PROGRAM_HPP
+#define LOX_PROGRAM_HPP
+
+#include <lak/result.hpp>
+#include <lak/stdint.hpp>
+
+#include <filesystem>
+#include <vector>
+
+namespace lox
+{
+	// A scanned, parsed and resolved script that any number of interpreters can
+	// run at once, from different threads. Only the serialised AST is shared:
+	// each interpreter rebuilds its own tree, lexemes and resolved distances
+	// from it, so no reference counted object is ever shared between threads.
+	struct program
+	{
+		std::vector<byte_t> image;
+
+		// errors are reported to std::cerr.
+		static lak::result<lox::program> compile(
+		  const std::filesystem::path &file);
+	};
+}
+
+#endif
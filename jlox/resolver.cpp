@@ -1,7 +1,16 @@
 #include "resolver.hpp"
 
+#include <algorithm>
 #include <assert.h>
 
+// whether stmt declares anything in the scope that it's in.
+bool declares(const lox::stmt &stmt)
+{
+	return stmt.value.template get<lox::stmt::var>() ||
+	       stmt.value.template get<lox::stmt::function_ptr>() ||
+	       stmt.value.template get<lox::stmt::type>();
+}
+
 lak::err_t<> lox::resolver::error(const lox::token &token,
                                   lak::u8string_view message,
                                   const std::source_location srcloc)
@@ -23,6 +32,18 @@ lak::result<> lox::resolver::resolve_function(
 	lox::function_type enclosing_function_type = current_function;
 	current_function                           = type;
 
+	functions.push_back(enclosing_function{
+	  .function = &*func,
+	  .captures = scopes.size(),
+	});
+	scopes.emplace_back();
+
+	if (type == lox::function_type::METHOD || type == lox::function_type::INIT)
+	{
+		scopes.emplace_back();
+		scopes.back().insert_or_assign(u8"this", true);
+	}
+
 	scopes.emplace_back();
 
 	for (const lox::token &param : func->parameters)
@@ -33,23 +54,58 @@ lak::result<> lox::resolver::resolve_function(
 
 	RES_TRY(resolve(func->body));
 
-	scopes.pop_back();
+	scopes.resize(functions.back().captures);
+	functions.pop_back();
 
 	current_function = enclosing_function_type;
 
 	return lak::ok_t{};
 }
 
+lak::optional<size_t> lox::resolver::find_scope(lak::u8string_view name,
+                                                size_t level)
+{
+	const size_t first = level > 0U ? functions[level - 1U].captures : 0U;
+	const size_t last =
+	  level < functions.size() ? functions[level].captures : scopes.size();
+
+	for (size_t i = last; i-- > first;)
+		if (scopes[i].find(name) != scopes[i].end()) return i;
+
+	if (level == 0U) return lak::nullopt;
+
+	lak::optional<size_t> declared = find_scope(name, level - 1U);
+	if (!declared) return lak::nullopt;
+
+	// first is the function's captures scope, and the scope it was declared
+	// in is the one before it.
+	scopes[first].insert_or_assign(name.to_string(), true);
+	interpreter.resolve_capture(*functions[level - 1U].function,
+	                            lox::capture{
+	                              .name     = name,
+	                              .distance = (first - 1U) - *declared,
+	                            });
+	return first;
+}
+
+lak::optional<size_t> lox::resolver::resolve_name(lak::u8string_view name)
+{
+	if_ref (const size_t scope, find_scope(name, functions.size()))
+		return (scopes.size() - 1U) - scope;
+	else
+		return lak::nullopt;
+}
+
 lak::result<> lox::resolver::declare(const lox::token &name)
 {
 	if (!scopes.empty())
 	{
 		auto &scope = scopes.back();
 
-		if (scope.find(name.lexeme) != scope.end())
+		if (scope.find(name.lexeme()) != scope.end())
 			return error(name, u8"Already a variable with this name in this scope.");
 
-		scope.emplace(name.lexeme, false);
+		scope.emplace(name.lexeme(), false);
 	}
 
 	return lak::ok_t{};
@@ -60,10 +116,10 @@ void lox::resolver::define(const lox::token &name)
 	if (scopes.empty()) return;
 
 	auto &scope = scopes.back();
-	if (auto iter = scope.find(name.lexeme); iter != scope.end())
+	if (auto iter = scope.find(name.lexeme()); iter != scope.end())
 		iter->second = true;
 	else
-		scope.emplace(name.lexeme, true);
+		scope.emplace(name.lexeme(), true);
 }
 
 lak::result<> lox::resolver::operator()(const lox::expr::assign &expr)
@@ -137,6 +193,10 @@ lak::result<> lox::resolver::operator()(const lox::expr::super_keyword &expr)
 
 	resolve_local(expr, expr.keyword);
 
+	// the method is bound to the 'this' beside 'super', which a function
+	// nested in the method needs to capture too.
+	(void)resolve_name(u8"this");
+
 	return lak::ok_t{};
 }
 
@@ -158,7 +218,7 @@ lak::result<> lox::resolver::operator()(const lox::expr::unary &expr)
 lak::result<> lox::resolver::operator()(const lox::expr::variable &expr)
 {
 	if (!scopes.empty())
-		if (auto iter = scopes.back().find(expr.name.lexeme);
+		if (auto iter = scopes.back().find(expr.name.lexeme());
 		    iter != scopes.back().end() && iter->second == false)
 			return error(expr.name,
 			             u8"Can't read local variable in its own initialiser.");
@@ -170,6 +230,16 @@ lak::result<> lox::resolver::operator()(const lox::expr::variable &expr)
 
 lak::result<> lox::resolver::operator()(const lox::stmt::block &stmt)
 {
+	// nothing could be looked up in the block's own scope, so it runs in the
+	// environment that encloses it.
+	if (std::none_of(stmt.statements.begin(),
+	                 stmt.statements.end(),
+	                 [](const lox::stmt_ptr &s) { return declares(*s); }))
+	{
+		interpreter.resolve_scopeless(stmt);
+		return resolve(stmt.statements);
+	}
+
 	scopes.emplace_back();
 
 	RES_TRY(resolve(stmt.statements));
@@ -190,7 +260,7 @@ lak::result<> lox::resolver::operator()(const lox::stmt::type &stmt)
 
 	if_ref (const auto &superclass, stmt.superclass)
 	{
-		if (stmt.name.lexeme == superclass.name.lexeme)
+		if (stmt.name.lexeme() == superclass.name.lexeme())
 			return error(superclass.name, u8"A class can't inherit from itself.");
 
 		current_class = lox::class_type::SUBCLASS;
@@ -202,18 +272,12 @@ lak::result<> lox::resolver::operator()(const lox::stmt::type &stmt)
 		scopes.back().insert_or_assign(u8"super", true);
 	}
 
-	scopes.emplace_back();
-
-	scopes.back().insert_or_assign(u8"this", true);
-
 	for (const lox::stmt::function_ptr &method : stmt.methods)
 		RES_TRY(resolve_function(method,
-		                         method->name.lexeme == u8"init"
+		                         method->name.lexeme() == u8"init"
 		                           ? lox::function_type::INIT
 		                           : lox::function_type::METHOD));
 
-	scopes.pop_back();
-
 	if (stmt.superclass) scopes.pop_back();
 
 	current_class = enclosing_class_type;
@@ -282,6 +346,9 @@ lak::result<> lox::resolver::operator()(const lox::stmt::ret &stmt)
 		if (current_function == lox::function_type::INIT)
 			return error(stmt.keyword,
 			             u8"Can't return a value from an initialiser.");
+		if_ref (const lox::expr::call &call,
+		        value->value.template get<lox::expr::call>())
+			interpreter.resolve_tail_call(call);
 		return value->visit(*this);
 	}
 	else
@@ -6,6 +6,8 @@
 #include "stmt.hpp"
 #include "string_map.hpp"
 
+#include <lak/optional.hpp>
+
 #include <vector>
 
 namespace lox
@@ -25,16 +27,30 @@ namespace lox
 		SUBCLASS,
 	};
 
+	// Resolves each variable to the scope it was declared in. A function's
+	// environment doesn't enclose the scope it was declared in, instead its
+	// closure captures just the variables that its body (or any function
+	// nested in it) refers to. Each function's scopes start with one holding
+	// what it captures, followed by one holding 'this' if it's a method.
 	struct resolver
 	{
+		struct enclosing_function
+		{
+			const lox::stmt::function *function;
+			// the index in scopes of the scope holding what it captures.
+			size_t captures;
+		};
+
 		lox::interpreter &interpreter;
 		std::vector<lox::string_map<char8_t, bool>> scopes;
+		std::vector<enclosing_function> functions;
 		lox::function_type current_function;
 		lox::class_type current_class;
 
 		inline resolver(lox::interpreter &i)
 		: interpreter(i),
 		  scopes(),
+		  functions(),
 		  current_function(function_type::NONE),
 		  current_class(lox::class_type::NONE)
 		{
@@ -50,6 +66,15 @@ namespace lox
 		lak::result<> resolve_function(const lox::stmt::function_ptr &func,
 		                               lox::function_type type);
 
+		// the index in scopes of where name is declared, as seen from the
+		// function at level (0 for the top level). if that's outside of the
+		// function, the function and every one between it and the declaration
+		// capture it. nullopt for globals.
+		lak::optional<size_t> find_scope(lak::u8string_view name, size_t level);
+
+		// the distance to name from the innermost scope, nullopt for globals.
+		lak::optional<size_t> resolve_name(lak::u8string_view name);
+
 		template<typename T>
 		void resolve_local(const T &expr, const lox::token &name);
 
@@ -84,9 +109,8 @@ namespace lox
 template<typename T>
 void lox::resolver::resolve_local(const T &expr, const lox::token &name)
 {
-	for (size_t i = scopes.size(); i-- > 0U;)
-		if (auto &scope = scopes[i]; scope.find(name.lexeme) != scope.end())
-			return interpreter.resolve(expr, (scopes.size() - 1U) - i);
+	if_ref (const size_t distance, resolve_name(name.lexeme()))
+		interpreter.resolve(expr, distance);
 }
 
 #endif
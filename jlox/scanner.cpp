@@ -18,9 +18,45 @@ lox::scanner::scanner(lox::interpreter &interp, lak::u8string_view src)
 {
 }
 
-bool lox::scanner::empty() const
+lox::scanner::scanner(lox::interpreter &interp,
+                      std::istream &strm,
+                      size_t size)
+: interpreter(interp), stream(&strm), window_size(size)
 {
-	return current >= source.size();
+	window.reserve(window_size);
+}
+
+bool lox::scanner::refill()
+{
+	if (!stream) return false;
+
+	window.erase(window.begin(), window.begin() + start);
+	current -= start;
+	start = 0U;
+
+	// the current token fills the entire window
+	if (window.size() >= window_size) window_size *= 2U;
+
+	const size_t kept = window.size();
+	window.resize(window_size);
+	stream->read(reinterpret_cast<char *>(window.data() + kept),
+	             static_cast<std::streamsize>(window_size - kept));
+	window.resize(kept + static_cast<size_t>(stream->gcount()));
+
+	source = lak::u8string_view(window.data(), window.size());
+	return window.size() > kept;
+}
+
+bool lox::scanner::fill(size_t count)
+{
+	while (current + count > source.size())
+		if (!refill()) return false;
+	return true;
+}
+
+bool lox::scanner::empty()
+{
+	return !fill(1U);
 }
 
 char8_t lox::scanner::next()
@@ -28,14 +64,14 @@ char8_t lox::scanner::next()
 	return source[current++];
 }
 
-char8_t lox::scanner::peek() const
+char8_t lox::scanner::peek()
 {
-	return empty() ? u8'\0' : source[current];
+	return fill(1U) ? source[current] : u8'\0';
 }
 
-char8_t lox::scanner::peek_next() const
+char8_t lox::scanner::peek_next()
 {
-	return current + 1 >= source.size() ? u8'\0' : source[current + 1];
+	return fill(2U) ? source[current + 1] : u8'\0';
 }
 
 bool lox::scanner::match(char8_t expected)
@@ -45,17 +81,17 @@ bool lox::scanner::match(char8_t expected)
 	return true;
 }
 
-void lox::scanner::add_token(lox::token_type type, lox::object literal)
+lox::token lox::scanner::make_token(lox::token_type type)
 {
-	tokens.push_back(lox::token{
-	  .type    = type,
-	  .lexeme  = source.substr(start, current - start),
-	  .literal = lak::move(literal),
-	  .line    = line,
-	});
+	const lak::u8string_view lexeme = source.substr(start, current - start);
+	return lox::token{
+	  .type = type,
+	  .line = static_cast<uint32_t>(line),
+	  .text = &interpreter.lexemes.intern(lexeme),
+	};
 }
 
-void lox::scanner::scan_string()
+lak::optional<lox::token> lox::scanner::scan_string()
 {
 	while (peek() != '"' && !empty())
 	{
@@ -66,18 +102,17 @@ void lox::scanner::scan_string()
 	if (empty())
 	{
 		interpreter.error(line, u8"Unterminated string.");
-		return;
+		return lak::nullopt;
 	}
 
 	// the closing "
 	next();
 
-	// trim the surrounding quotes
-	auto value = source.substr(start + 1, (current - 1) - (start + 1));
-	add_token(lox::token_type::STRING, lox::object{value.to_string()});
+	// the parser decodes the value from the lexeme
+	return make_token(lox::token_type::STRING);
 }
 
-void lox::scanner::scan_number()
+lox::token lox::scanner::scan_number()
 {
 	while (lak::is_alphanumeric(peek())) next();
 
@@ -88,114 +123,95 @@ void lox::scanner::scan_number()
 		while (lak::is_alphanumeric(peek())) next();
 	}
 
-	double number;
-
-	auto result =
-	  std::from_chars(reinterpret_cast<const char *>(source.data()) + start,
-	                  reinterpret_cast<const char *>(source.data()) + current,
-	                  number);
-
-	if (result.ec == std::errc())
-		// no error
-		add_token(lox::token_type::NUMBER, lox::object{number});
-	else
-		interpreter.error(line, u8"Invalid number.");
+	// the parser decodes the value from the lexeme
+	return make_token(lox::token_type::NUMBER);
 }
 
-void lox::scanner::scan_identifier()
+lox::token lox::scanner::scan_identifier()
 {
 	while (lox::is_ident_char(peek())) next();
 	if (auto iter =
 	      lox::keywords.find(source.substr(start, current - start).to_string());
 	    iter != lox::keywords.end())
-		add_token(iter->second);
+		return make_token(iter->second);
 	else
-		add_token(lox::token_type::IDENTIFIER);
+		return make_token(lox::token_type::IDENTIFIER);
 }
 
-void lox::scanner::scan_token()
-{
-	auto c = next();
-	switch (c)
-	{
-		case u8'(': add_token(lox::token_type::LEFT_PAREN); break;
-		case u8')': add_token(lox::token_type::RIGHT_PAREN); break;
-		case u8'{': add_token(lox::token_type::LEFT_BRACE); break;
-		case u8'}': add_token(lox::token_type::RIGHT_BRACE); break;
-		case u8',': add_token(lox::token_type::COMMA); break;
-		case u8'.': add_token(lox::token_type::DOT); break;
-		case u8'-': add_token(lox::token_type::MINUS); break;
-		case u8'+': add_token(lox::token_type::PLUS); break;
-		case u8';': add_token(lox::token_type::SEMICOLON); break;
-		case u8'*': add_token(lox::token_type::STAR); break;
-
-		case u8'!':
-			add_token(match(u8'=') ? lox::token_type::BANG_EQUAL
-			                       : lox::token_type::BANG);
-			break;
-
-		case u8'=':
-			add_token(match(u8'=') ? lox::token_type::EQUAL_EQUAL
-			                       : lox::token_type::EQUAL);
-			break;
-
-		case u8'<':
-			add_token(match(u8'=') ? lox::token_type::LESS_EQUAL
-			                       : lox::token_type::LESS);
-			break;
-
-		case u8'>':
-			add_token(match(u8'=') ? lox::token_type::GREATER_EQUAL
-			                       : lox::token_type::GREATER);
-			break;
-
-		case u8'/':
-			if (match('/'))
-				// a comment goes until the end of the line
-				while (peek() != u8'\n' && !empty()) next();
-			else
-				add_token(lox::token_type::SLASH);
-			break;
-
-		case u8' ': [[fallthrough]];
-		case u8'\r': [[fallthrough]];
-		case u8'\t':
-			// ignore whitespace
-			break;
-
-		case u8'\n': ++line; break;
-
-		case u8'"': scan_string(); break;
-
-		case u8'o':
-			if (match(u8'r')) add_token(lox::token_type::OR);
-			break;
-
-		default:
-			if (lak::is_alphanumeric(c))
-				scan_number();
-			else if (lox::is_latin_letter(c))
-				scan_identifier();
-			else
-				interpreter.error(line, u8"Unexpected character.");
-			break;
-	}
-}
-
-std::vector<lox::token> lox::scanner::scan_tokens()
+lox::token lox::scanner::scan_token()
 {
 	while (!empty())
 	{
 		start = current;
-		scan_token();
+		auto c = next();
+		switch (c)
+		{
+			case u8'(': return make_token(lox::token_type::LEFT_PAREN);
+			case u8')': return make_token(lox::token_type::RIGHT_PAREN);
+			case u8'{': return make_token(lox::token_type::LEFT_BRACE);
+			case u8'}': return make_token(lox::token_type::RIGHT_BRACE);
+			case u8',': return make_token(lox::token_type::COMMA);
+			case u8'.': return make_token(lox::token_type::DOT);
+			case u8'-': return make_token(lox::token_type::MINUS);
+			case u8'+': return make_token(lox::token_type::PLUS);
+			case u8';': return make_token(lox::token_type::SEMICOLON);
+			case u8'*': return make_token(lox::token_type::STAR);
+
+			case u8'!':
+				return make_token(match(u8'=') ? lox::token_type::BANG_EQUAL
+				                               : lox::token_type::BANG);
+
+			case u8'=':
+				return make_token(match(u8'=') ? lox::token_type::EQUAL_EQUAL
+				                               : lox::token_type::EQUAL);
+
+			case u8'<':
+				return make_token(match(u8'=') ? lox::token_type::LESS_EQUAL
+				                               : lox::token_type::LESS);
+
+			case u8'>':
+				return make_token(match(u8'=') ? lox::token_type::GREATER_EQUAL
+				                               : lox::token_type::GREATER);
+
+			case u8'/':
+				if (match('/'))
+				{
+					// a comment goes until the end of the line
+					while (peek() != u8'\n' && !empty()) next();
+					break;
+				}
+				return make_token(lox::token_type::SLASH);
+
+			case u8' ': [[fallthrough]];
+			case u8'\r': [[fallthrough]];
+			case u8'\t':
+				// ignore whitespace
+				break;
+
+			case u8'\n': ++line; break;
+
+			case u8'"':
+				if (lak::optional<lox::token> token = scan_string(); token)
+					return lak::move(*token);
+				break;
+
+			case u8'o':
+				if (match(u8'r')) return make_token(lox::token_type::OR);
+				break;
+
+			default:
+				if (lak::is_alphanumeric(c))
+					return scan_number();
+				else if (lox::is_latin_letter(c))
+					return scan_identifier();
+				else
+					interpreter.error(line, u8"Unexpected character.");
+				break;
+		}
 	}
 
-	tokens.push_back(lox::token{
-	  .type    = lox::token_type::EOF_TOK,
-	  .lexeme  = u8"",
-	  .literal = lox::object{},
-	  .line    = line,
-	});
-
-	return tokens;
+	return lox::token{
+	  .type = lox::token_type::EOF_TOK,
+	  .line = static_cast<uint32_t>(line),
+	};
 }
@@ -2,11 +2,12 @@
 #define LOX_SCANNER_HPP
 
 #include "interpreter.hpp"
-#include "object.hpp"
 #include "token.hpp"
 
+#include <lak/optional.hpp>
 #include <lak/string_view.hpp>
 
+#include <istream>
 #include <unordered_map>
 #include <vector>
 
@@ -35,40 +36,64 @@ namespace lox
 	  {u8"while"_str, lox::token_type::WHILE},
 	};
 
+	// Tokens are produced on demand. When scanning a stream the input is
+	// pulled through a bounded window, so memory use doesn't grow with the
+	// size of the source. Token lexemes are interned into the interpreter's
+	// lexeme table, so they outlive the scanner.
 	struct scanner
 	{
+		static constexpr size_t default_window_size = 64U * 1024U;
+
 		lox::interpreter &interpreter;
+
+		// null when scanning a source that is already in memory.
+		std::istream *stream = nullptr;
+		std::vector<char8_t> window;
+		// only grows if a single token doesn't fit.
+		size_t window_size = default_window_size;
+
+		// the part of the input currently in memory, start and current index
+		// into this.
 		lak::u8string_view source;
-		std::vector<lox::token> tokens;
 		size_t start   = 0;
 		size_t current = 0;
 		size_t line    = 1;
 
 		scanner(lox::interpreter &interp, lak::u8string_view src);
 
-		bool empty() const;
+		scanner(lox::interpreter &interp,
+		        std::istream &strm,
+		        size_t size = default_window_size);
+
+		// discard everything before start and read more of the stream into the
+		// window. returns false at the end of the input.
+		bool refill();
+
+		// make sure there are at least count characters after current.
+		bool fill(size_t count);
+
+		bool empty();
 
 		char8_t next();
 
-		char8_t peek() const;
+		char8_t peek();
 
-		char8_t peek_next() const;
+		char8_t peek_next();
 
 		bool match(char8_t expected);
 
-		void add_token(lox::token_type type, lox::object literal = lox::object{});
+		lox::token make_token(lox::token_type type);
 
-		void scan_string();
+		lak::optional<lox::token> scan_string();
 
-		void scan_number();
+		lox::token scan_number();
 
-		void scan_identifier();
+		lox::token scan_identifier();
 
-		void scan_token();
-
-		std::vector<lox::token> scan_tokens();
+		// returns EOF_TOK once the input is exhausted. scan errors are reported
+		// to the interpreter and skipped over.
+		lox::token scan_token();
 	};
-
 }
 
 #endif
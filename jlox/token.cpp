@@ -1,5 +1,7 @@
 #include "token.hpp"
 
+#include <lox/number.hpp>
+
 #include <lak/string_literals.hpp>
 #include <lak/string_ostream.hpp>
 
@@ -19,3 +21,15 @@ std::ostream &lox::operator<<(std::ostream &strm, const lox::token_type &type)
 {
 	return strm << lox::token_type_name(type);
 }
+
+lak::result<double> lox::token::number() const
+{
+	return lox::parse_number(lexeme());
+}
+
+lak::u8string_view lox::token::string() const
+{
+	const lak::u8string_view str = lexeme();
+	if (str.size() < 2U) return {};
+	return str.substr(1U, str.size() - 2U);
+}
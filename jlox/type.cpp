@@ -6,6 +6,8 @@
 
 struct lox::type::impl
 {
+	static constexpr char pool_name[] = "type";
+
 	lak::u8string name;
 	lak::optional<lox::type> superclass;
 	lox::string_map<char8_t, lox::object> methods;
@@ -19,8 +21,7 @@ lox::type::type(lak::u8string_view name,
                                     .superclass  = lak::nullopt,
                                     .methods     = methods,
                                     .constructor = {},
-                                  })
-          .unwrap())
+                                  }))
 {
 	_impl->constructor = lox::callable(*this);
 }
@@ -33,8 +34,7 @@ lox::type::type(lak::u8string_view name,
                                     .superclass  = superclass,
                                     .methods     = methods,
                                     .constructor = {},
-                                  })
-          .unwrap())
+                                  }))
 {
 	_impl->constructor = lox::callable(*this);
 }
@@ -78,7 +78,7 @@ lak::result<const lox::callable &> lox::type::find_method(
 lak::result<const lox::callable &> lox::type::find_method(
   const lox::token &method_name) const
 {
-	return find_method(method_name.lexeme);
+	return find_method(method_name.lexeme());
 }
 
 lak::result<lox::callable> lox::type::find_bound_method(
@@ -94,7 +94,7 @@ lak::result<lox::callable> lox::type::find_bound_method(
 lak::result<lox::callable> lox::type::find_bound_method(
   const lox::token &method_name, const lox::instance &instance) const
 {
-	return find_bound_method(method_name.lexeme, instance);
+	return find_bound_method(method_name.lexeme(), instance);
 }
 
 lox::callable &lox::type::constructor()
@@ -126,6 +126,8 @@ bool lox::type::operator!=(const lox::type &rhs) const
 
 struct lox::instance::impl
 {
+	static constexpr char pool_name[] = "instance";
+
 	lox::type type;
 	lox::string_map<char8_t, lox::object> fields;
 };
@@ -135,8 +137,7 @@ lox::instance::instance(const lox::type &type,
 : _impl(lox::instance::impl_ptr::make(lox::instance::impl{
                                         .type   = type,
                                         .fields = lak::move(fields),
-                                      })
-          .unwrap())
+                                      }))
 {
 }
 
@@ -144,18 +145,18 @@ const lox::object &lox::instance::emplace(const lox::token &name,
                                           lox::object value)
 {
 	return _impl->fields
-	  .insert_or_assign(name.lexeme.to_string(), lak::move(value))
+	  .insert_or_assign(name.lexeme().to_string(), lak::move(value))
 	  .first->second;
 }
 
 lak::result<lox::object> lox::instance::find(const lox::token &name) const
 {
-	return lox::find(_impl->fields, name.lexeme)
+	return lox::find(_impl->fields, name.lexeme())
 	  .map([](const auto &pair) { return pair.second; })
 	  .or_else(
 	    [&](const auto &)
 	    {
-		    return _impl->type.find_bound_method(name.lexeme, *this)
+		    return _impl->type.find_bound_method(name.lexeme(), *this)
 		      .map([](const lox::callable &callable) -> lox::object
 		           { return {callable}; });
 	    });
@@ -3,6 +3,7 @@
 
 #include "callable.hpp"
 #include "expr.hpp"
+#include "pool.hpp"
 #include "string_map.hpp"
 #include "token.hpp"
 
@@ -22,7 +23,7 @@ namespace lox
 	{
 	private:
 		struct impl;
-		using impl_ptr = lak::shared_ref<impl>;
+		using impl_ptr = lox::pool_ptr<impl>;
 
 		impl_ptr _impl;
 
@@ -69,7 +70,7 @@ namespace lox
 	{
 	private:
 		struct impl;
-		using impl_ptr = lak::shared_ref<impl>;
+		using impl_ptr = lox::pool_ptr<impl>;
 
 		impl_ptr _impl;
 